@@ -547,6 +547,14 @@ void TFE_OpSetCancellationManager(TFE_Op* op,
   status->status = tensorflow::Status::OK();
 }
 
+void TFE_OpSetKernelPinning(TFE_Op* op, unsigned char enable,
+                            TF_Status* status) {
+  tensorflow::EagerOperation* operation =
+      tensorflow::OperationFromInterface(tensorflow::unwrap(op));
+  operation->SetKernelPinning(enable);
+  status->status = tensorflow::Status::OK();
+}
+
 TFE_Executor* TFE_NewExecutor(bool is_async) {
   return new TFE_Executor(is_async);
 }
@@ -328,6 +328,15 @@ TF_CAPI_EXPORT extern void TFE_OpSetCancellationManager(
     TFE_Op* op, TFE_CancellationManager* cancellation_manager,
     TF_Status* status);
 
+// Enables or disables kernel pinning for `op`. A pinned op that is executed
+// repeatedly, with its inputs cleared and re-added between executions, reuses
+// the kernel of its first execution without recomputing the kernel cache key
+// or re-running device placement, as long as the new inputs have the same
+// dtypes and devices. Setting an attribute or device on `op` unpins the kernel.
+TF_CAPI_EXPORT extern void TFE_OpSetKernelPinning(TFE_Op* op,
+                                                  unsigned char enable,
+                                                  TF_Status* status);
+
 // -----------------------------------------------------------------------------
 // Eager Executor APIs.
 typedef struct TFE_Executor TFE_Executor;
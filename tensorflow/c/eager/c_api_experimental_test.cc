@@ -441,6 +441,59 @@ void Executor_MatMul_CPU(bool async) {
 TEST(CAPI, Executor_MatMul_CPU) { Executor_MatMul_CPU(false); }
 TEST(CAPI, Executor_MatMul_CPUAsync) { Executor_MatMul_CPU(true); }
 
+TEST(CAPI, KernelPinning_MatMul_CPU) {
+  TF_Status* status = TF_NewStatus();
+  TFE_ContextOptions* opts = TFE_NewContextOptions();
+  TFE_Context* ctx = TFE_NewContext(opts, status);
+  CHECK_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+  TFE_DeleteContextOptions(opts);
+
+  TFE_TensorHandle* m = TestMatrixTensorHandle(ctx);
+  TFE_Op* matmul = MatMulOp(ctx, m, m);
+  TFE_OpSetKernelPinning(matmul, true, status);
+  ASSERT_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+  for (int i = 0; i < 3; ++i) {
+    if (i > 0) {
+      // Execute released the previous inputs; only the inputs are swapped.
+      TFE_OpAddInput(matmul, m, status);
+      ASSERT_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+      TFE_OpAddInput(matmul, m, status);
+      ASSERT_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+    }
+    if (i == 2) {
+      // Setting an attribute falls back to the regular dispatch path.
+      TFE_OpSetAttrBool(matmul, "transpose_a", 1);
+    }
+    TFE_TensorHandle* retvals[1] = {nullptr};
+    int num_retvals = 1;
+    TFE_Execute(matmul, &retvals[0], &num_retvals, status);
+    ASSERT_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+    ASSERT_EQ(1, num_retvals);
+    TF_Tensor* t = TFE_TensorHandleResolve(retvals[0], status);
+    ASSERT_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+    TFE_DeleteTensorHandle(retvals[0]);
+    float product[4] = {0};
+    EXPECT_EQ(sizeof(product), TF_TensorByteSize(t));
+    memcpy(&product[0], TF_TensorData(t), TF_TensorByteSize(t));
+    TF_DeleteTensor(t);
+    if (i < 2) {
+      EXPECT_EQ(7, product[0]);
+      EXPECT_EQ(10, product[1]);
+      EXPECT_EQ(15, product[2]);
+      EXPECT_EQ(22, product[3]);
+    } else {
+      EXPECT_EQ(10, product[0]);
+      EXPECT_EQ(14, product[1]);
+      EXPECT_EQ(14, product[2]);
+      EXPECT_EQ(20, product[3]);
+    }
+  }
+  TFE_DeleteOp(matmul);
+  TFE_DeleteTensorHandle(m);
+  TFE_DeleteContext(ctx);
+  TF_DeleteStatus(status);
+}
+
 void Deleter(void* data, size_t unused, void* tensor_handle) {
   TFE_DeleteTensorHandle(static_cast<TFE_TensorHandle*>(tensor_handle));
 }
@@ -0,0 +1,479 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/all_reduce_batcher.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/profiler/lib/traceme.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+// Used when CollImplDetails.fusion_cycle_time_us is not positive.
+constexpr int64 kDefaultCycleTimeUs = 1000;
+
+int64 Fingerprint(const string& exec_key) {
+  return static_cast<int64>(Hash64(exec_key));
+}
+
+AllocatorAttributes HostAttr() {
+  AllocatorAttributes attr;
+  attr.set_on_host(true);
+  return attr;
+}
+
+// Copies every first tensor into the second one, on `device`.
+Status CopyInDevice(
+    Device* device, const std::vector<DeviceContext*>& dev_ctxs,
+    const std::vector<std::pair<const Tensor*, Tensor*>>& copies) {
+  BlockingCounter pending(copies.size());
+  mutex mu;
+  Status status;
+  for (size_t i = 0; i < copies.size(); ++i) {
+    DeviceContext* dev_ctx = dev_ctxs[i];
+    // For GPU devices when only one compute stream is used (the default)
+    // the OpKernelContext does not supply a DeviceContext.
+    const DeviceBase::GpuDeviceInfo* gpu_info =
+        device->tensorflow_gpu_device_info();
+    if (dev_ctx == nullptr && gpu_info != nullptr) {
+      dev_ctx = gpu_info->default_context;
+    }
+    device->CopyTensorInSameDevice(
+        copies[i].first, copies[i].second, dev_ctx,
+        [&pending, &mu, &status](const Status& s) {
+          if (!s.ok()) {
+            mutex_lock l(mu);
+            status.Update(s);
+          }
+          pending.DecrementCount();
+        });
+  }
+  pending.Wait();
+  return status;
+}
+
+}  // namespace
+
+constexpr int AllReduceBatcher::kMaxBatchSize;
+
+AllReduceBatcher::AllReduceBatcher(CollectiveExecutor* col_exec,
+                                   const DeviceMgr* dev_mgr,
+                                   RunCollectiveFn run_collective)
+    : col_exec_(col_exec),
+      dev_mgr_(dev_mgr),
+      run_collective_(std::move(run_collective)) {}
+
+AllReduceBatcher::~AllReduceBatcher() {}
+
+/*static*/
+bool AllReduceBatcher::IsEligible(OpKernelContext* ctx,
+                                  const CollectiveParams& col_params) {
+  const CollImplDetails& details = col_params.instance.impl_details;
+  if (details.fusion_threshold_bytes <= 0 ||
+      col_params.instance.type != REDUCTION_COLLECTIVE ||
+      details.collective_name != "RingReduce" ||
+      !details.dependencies.empty() || col_params.group.group_size < 2 ||
+      !col_params.merge_op) {
+    return false;
+  }
+  switch (col_params.instance.data_type) {
+    case DT_HALF:
+    case DT_FLOAT:
+    case DT_DOUBLE:
+    case DT_INT64:
+      break;
+    default:
+      return false;
+  }
+  return ctx->input(0).TotalBytes() < details.fusion_threshold_bytes;
+}
+
+std::shared_ptr<AllReduceBatcher::Bucket> AllReduceBatcher::GetBucket(
+    OpKernelContext* ctx, const CollectiveParams& col_params) {
+  const string name = strings::StrCat(
+      "allreduce_fusion:", col_params.group.group_key, ":",
+      DataTypeString(col_params.instance.data_type), ":",
+      col_params.merge_op->type_string(), ":",
+      col_params.final_op ? col_params.final_op->type_string() : "");
+  const string bucket_key =
+      strings::StrCat(name, ":", col_params.default_rank);
+  mutex_lock l(mu_);
+  std::shared_ptr<Bucket>& bucket = buckets_[bucket_key];
+  if (bucket == nullptr) {
+    bucket = std::make_shared<Bucket>(name);
+    bucket->recv_buf = Tensor(DT_INT64, TensorShape({kMaxBatchSize + 1}));
+    if (!status_.ok()) {
+      mutex_lock bl(bucket->mu);
+      bucket->status = status_;
+    }
+  }
+  return bucket;
+}
+
+void AllReduceBatcher::Enqueue(OpKernelContext* ctx,
+                               const CollectiveParams& col_params,
+                               const string& exec_key,
+                               const StatusCallback& done) {
+  std::shared_ptr<Bucket> bucket = GetBucket(ctx, col_params);
+  const CollImplDetails& details = col_params.instance.impl_details;
+  Status status;
+  if (col_params.default_rank == 0) {
+    std::vector<Entry> entries;
+    int64 batch = -1;
+    int64 timer_batch = -1;
+    {
+      mutex_lock l(bucket->mu);
+      status = bucket->status;
+      if (status.ok()) {
+        bucket->queued.push_back(
+            {ctx, &col_params, exec_key, done, ctx->op_device_context()});
+        bucket->queued_bytes += ctx->input(0).TotalBytes();
+        if (bucket->queued.size() == 1) timer_batch = bucket->num_batches;
+        if (bucket->queued_bytes >= details.fusion_threshold_bytes ||
+            bucket->queued.size() >= static_cast<size_t>(kMaxBatchSize)) {
+          batch = bucket->num_batches++;
+          entries.swap(bucket->queued);
+          bucket->queued_bytes = 0;
+        }
+      }
+    }
+    if (batch >= 0) {
+      Flush(bucket, &entries, batch);
+    } else if (timer_batch >= 0) {
+      FlushAfter(bucket, timer_batch,
+                 details.fusion_cycle_time_us > 0
+                     ? details.fusion_cycle_time_us
+                     : kDefaultCycleTimeUs);
+    }
+  } else {
+    {
+      mutex_lock l(bucket->mu);
+      status = bucket->status;
+      if (status.ok()) {
+        bucket->issued.emplace(Fingerprint(exec_key),
+                               Entry{ctx, &col_params, exec_key, done,
+                                     ctx->op_device_context()});
+      }
+    }
+    if (status.ok()) {
+      LaunchDecided(bucket);
+      MaybeRecvDecision(bucket);
+    }
+  }
+  if (!status.ok()) done(status);
+}
+
+void AllReduceBatcher::FlushAfter(const std::shared_ptr<Bucket>& bucket,
+                                  int64 batch, int64 delay_us) {
+  std::weak_ptr<Bucket> weak_bucket(bucket);
+  SchedNonBlockingClosureAfter(delay_us, [this, weak_bucket, batch] {
+    std::shared_ptr<Bucket> bucket = weak_bucket.lock();
+    if (bucket == nullptr) return;
+    std::vector<Entry> entries;
+    {
+      mutex_lock l(bucket->mu);
+      // The batch was already launched because it grew large enough.
+      if (bucket->num_batches != batch || bucket->queued.empty()) return;
+      ++bucket->num_batches;
+      entries.swap(bucket->queued);
+      bucket->queued_bytes = 0;
+    }
+    // The queued ops are pending, so the step, and this object, are alive.
+    Flush(bucket, &entries, batch);
+  });
+}
+
+void AllReduceBatcher::Flush(const std::shared_ptr<Bucket>& bucket,
+                             std::vector<Entry>* entries, int64 batch) {
+  const Entry& first = entries->front();
+  const CollectiveParams& col_params = *first.col_params;
+  Device* device = nullptr;
+  Status status = dev_mgr_->LookupDevice(
+      col_params.instance.device_names[col_params.default_rank], &device);
+  if (!status.ok()) {
+    for (const Entry& entry : *entries) entry.done(status);
+    return;
+  }
+  VLOG(1) << "Fusing " << entries->size() << " all-reduces in " << bucket->name
+          << " batch " << batch;
+  auto decision = std::make_shared<Tensor>(
+      DT_INT64, TensorShape({kMaxBatchSize + 1}));
+  auto ids = decision->flat<int64>();
+  ids(0) = entries->size();
+  for (size_t i = 0; i < entries->size(); ++i) {
+    ids(i + 1) = Fingerprint((*entries)[i].exec_key);
+  }
+  for (int rank = 1; rank < col_params.group.group_size; ++rank) {
+    col_exec_->PostToPeer(
+        col_params.instance.device_names[rank],
+        col_params.instance.task_names[rank],
+        DecisionKey(*bucket, batch, rank), device,
+        first.op_device_context, HostAttr(), decision.get(),
+        device->attributes().locality(), [decision](const Status& s) {
+          // A member that does not get the decision fails the batch itself.
+          if (!s.ok()) VLOG(1) << "Failed to send fusion decision: " << s;
+        });
+  }
+  std::vector<Entry> batch_entries;
+  batch_entries.swap(*entries);
+  col_exec_->RunClosure([this, batch_entries = std::move(batch_entries)] {
+    RunBatch(batch_entries);
+  });
+}
+
+void AllReduceBatcher::LaunchDecided(const std::shared_ptr<Bucket>& bucket) {
+  std::vector<std::vector<Entry>> ready;
+  {
+    mutex_lock l(bucket->mu);
+    while (!bucket->decisions.empty()) {
+      const std::vector<int64>& ids = bucket->decisions.front();
+      bool all_issued = true;
+      for (int64 id : ids) {
+        if (bucket->issued.find(id) == bucket->issued.end()) {
+          all_issued = false;
+          break;
+        }
+      }
+      if (!all_issued) break;
+      std::vector<Entry> entries;
+      entries.reserve(ids.size());
+      for (int64 id : ids) {
+        auto it = bucket->issued.find(id);
+        entries.push_back(std::move(it->second));
+        bucket->issued.erase(it);
+      }
+      ready.push_back(std::move(entries));
+      bucket->decisions.pop_front();
+    }
+  }
+  for (auto& entries : ready) {
+    col_exec_->RunClosure(
+        [this, entries = std::move(entries)] { RunBatch(entries); });
+  }
+}
+
+void AllReduceBatcher::MaybeRecvDecision(
+    const std::shared_ptr<Bucket>& bucket) {
+  int64 batch;
+  int rank;
+  string device_name;
+  string peer_device;
+  string peer_task;
+  bool peer_is_local;
+  DeviceContext* op_device_context;
+  {
+    mutex_lock l(bucket->mu);
+    // Decisions are received one at a time, and only once the previous ones
+    // have been launched, when some issued all-reduces are still waiting.
+    if (!bucket->status.ok() || bucket->recv_pending ||
+        !bucket->decisions.empty() || bucket->issued.empty()) {
+      return;
+    }
+    bucket->recv_pending = true;
+    batch = bucket->num_decisions;
+    // Copy what the receive needs while the entry is known to be issued:
+    // once the lock is released, an abort may run its `done` callback, after
+    // which its context and params must not be used.
+    const Entry& entry = bucket->issued.begin()->second;
+    const CollectiveParams& col_params = *entry.col_params;
+    rank = col_params.default_rank;
+    device_name = col_params.instance.device_names[rank];
+    peer_device = col_params.instance.device_names[0];
+    peer_task = col_params.instance.task_names[0];
+    peer_is_local = col_params.task.is_local[0];
+    op_device_context = entry.op_device_context;
+  }
+  Device* device = nullptr;
+  Status status = dev_mgr_->LookupDevice(device_name, &device);
+  if (!status.ok()) {
+    RecvDone(bucket, status);
+    return;
+  }
+  col_exec_->RecvFromPeer(
+      peer_device, peer_task, peer_is_local,
+      DecisionKey(*bucket, batch, rank), device, op_device_context,
+      HostAttr(), &bucket->recv_buf, device->attributes().locality(),
+      0 /*dev_to_dev_stream_index*/,
+      [this, bucket](const Status& s) { RecvDone(bucket, s); });
+}
+
+void AllReduceBatcher::RecvDone(const std::shared_ptr<Bucket>& bucket,
+                                const Status& s) {
+  std::vector<Entry> failed;
+  Status status = s;
+  {
+    mutex_lock l(bucket->mu);
+    bucket->recv_pending = false;
+    if (status.ok()) {
+      auto ids = bucket->recv_buf.flat<int64>();
+      const int64 size = ids(0);
+      if (size < 1 || size > kMaxBatchSize) {
+        status = errors::Internal("Invalid all-reduce fusion decision of size ",
+                                  size, " in ", bucket->name);
+      } else {
+        bucket->decisions.emplace_back(ids.data() + 1,
+                                       ids.data() + 1 + size);
+        ++bucket->num_decisions;
+      }
+    }
+    if (!status.ok()) {
+      bucket->status.Update(status);
+      for (auto& it : bucket->issued) failed.push_back(std::move(it.second));
+      bucket->issued.clear();
+      bucket->decisions.clear();
+    }
+  }
+  for (const Entry& entry : failed) entry.done(status);
+  if (status.ok()) {
+    LaunchDecided(bucket);
+    MaybeRecvDecision(bucket);
+  }
+}
+
+void AllReduceBatcher::RunBatch(const std::vector<Entry>& entries) {
+  profiler::TraceMe activity(
+      [&] {
+        return strings::StrCat("AllReduceBatch:", entries.size());
+      },
+      profiler::TraceMeLevel::kInfo);
+  Status status = RunBatchInternal(entries);
+  for (const Entry& entry : entries) entry.done(status);
+}
+
+Status AllReduceBatcher::RunBatchInternal(const std::vector<Entry>& entries) {
+  const Entry& first = entries.front();
+  const CollectiveParams& col_params = *first.col_params;
+  Device* device = nullptr;
+  TF_RETURN_IF_ERROR(dev_mgr_->LookupDevice(
+      col_params.instance.device_names[col_params.default_rank], &device));
+
+  // Every input starts on an aligned boundary of the packed buffer.
+  const DataType dtype = col_params.instance.data_type;
+  const int64 align = std::max<int64>(
+      1, Allocator::kAllocatorAlignment / DataTypeSize(dtype));
+  std::vector<int64> offsets;
+  offsets.reserve(entries.size());
+  int64 total = 0;
+  for (const Entry& entry : entries) {
+    offsets.push_back(total);
+    const int64 n = entry.ctx->input(0).NumElements();
+    total += (n + align - 1) / align * align;
+  }
+  Tensor packed(device->GetAllocator(first.ctx->output_alloc_attr(0)), dtype,
+                TensorShape({total}));
+  std::vector<Tensor> slices;
+  slices.reserve(entries.size());
+  std::vector<DeviceContext*> dev_ctxs;
+  std::vector<std::pair<const Tensor*, Tensor*>> copies;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const Tensor& input = entries[i].ctx->input(0);
+    slices.push_back(
+        packed.Slice(offsets[i], offsets[i] + input.NumElements()));
+    if (input.NumElements() == 0) continue;
+    dev_ctxs.push_back(entries[i].ctx->op_device_context());
+    copies.emplace_back(&input, &slices.back());
+  }
+  TF_RETURN_IF_ERROR(CopyInDevice(device, dev_ctxs, copies));
+
+  CollectiveParams fused_params;
+  fused_params.name = strings::StrCat(col_params.name, "/fused");
+  fused_params.group = col_params.group;
+  fused_params.instance = col_params.instance;
+  fused_params.instance.impl_details.collective_name =
+      col_params.instance.impl_details.collective_name;
+  fused_params.instance.shape = TensorShape({total});
+  fused_params.task = col_params.task;
+  fused_params.default_rank = col_params.default_rank;
+  fused_params.subdiv_rank = col_params.subdiv_rank;
+  Status status;
+  fused_params.merge_op = CreateOpKernel(
+      col_params.group.device_type, device,
+      device->GetAllocator(AllocatorAttributes()), col_params.merge_op->def(),
+      TF_GRAPH_DEF_VERSION, &status);
+  TF_RETURN_IF_ERROR(status);
+  if (col_params.final_op) {
+    fused_params.final_op = CreateOpKernel(
+        col_params.group.device_type, device,
+        device->GetAllocator(AllocatorAttributes()),
+        col_params.final_op->def(), TF_GRAPH_DEF_VERSION, &status);
+    TF_RETURN_IF_ERROR(status);
+  }
+  // The fused collective unblocks the instance of the first all-reduce.
+  for (size_t i = 1; i < entries.size(); ++i) {
+    col_exec_->UnblockDependencies(*entries[i].col_params);
+  }
+  Notification note;
+  run_collective_(first.ctx, fused_params,
+                  strings::StrCat(first.exec_key, ":fused"), &packed, &packed,
+                  [&note, &status](const Status& s) {
+                    status = s;
+                    note.Notify();
+                  });
+  note.WaitForNotification();
+  TF_RETURN_IF_ERROR(status);
+
+  dev_ctxs.clear();
+  copies.clear();
+  for (size_t i = 0; i < entries.size(); ++i) {
+    Tensor* output = entries[i].ctx->mutable_output(0);
+    if (output->NumElements() == 0) continue;
+    dev_ctxs.push_back(entries[i].ctx->op_device_context());
+    copies.emplace_back(&slices[i], output);
+  }
+  return CopyInDevice(device, dev_ctxs, copies);
+}
+
+void AllReduceBatcher::StartAbort(const Status& s) {
+  std::vector<std::shared_ptr<Bucket>> buckets;
+  {
+    mutex_lock l(mu_);
+    if (!status_.ok()) return;
+    status_ = s;
+    for (auto& it : buckets_) buckets.push_back(it.second);
+  }
+  for (const auto& bucket : buckets) {
+    std::vector<Entry> failed;
+    {
+      mutex_lock l(bucket->mu);
+      bucket->status.Update(s);
+      failed.swap(bucket->queued);
+      bucket->queued_bytes = 0;
+      for (auto& it : bucket->issued) failed.push_back(std::move(it.second));
+      bucket->issued.clear();
+      bucket->decisions.clear();
+    }
+    for (const Entry& entry : failed) entry.done(s);
+  }
+}
+
+string AllReduceBatcher::DecisionKey(const Bucket& bucket, int64 batch,
+                                     int rank) const {
+  return strings::StrCat(bucket.name, ":", batch, ":", rank);
+}
+
+}  // namespace tensorflow
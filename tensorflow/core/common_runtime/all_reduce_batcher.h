@@ -0,0 +1,153 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_ALL_REDUCE_BATCHER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_ALL_REDUCE_BATCHER_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+class DeviceMgr;
+
+// Fuses small all-reduces issued close together into a single all-reduce
+// of a packed buffer.
+//
+// Every all-reduce pays the latency of a full ring, which dominates when a
+// step issues thousands of tiny ones, e.g. one per gradient.  All-reduces
+// of the same group, data type and reduction ops that run on the same device
+// are queued in a bucket.  In each group, the device of rank 0 decides which
+// queued all-reduces are fused together, once its bucket holds enough bytes
+// or its oldest entry has waited long enough, and sends the list to the other
+// members, which wait for the listed all-reduces to be issued locally before
+// running the batch.  Since the members follow the decisions of rank 0 in the
+// order it made them, they always pack the same all-reduces in the same
+// order, no matter in which order they were issued on each device.
+//
+// One AllReduceBatcher serves all the devices of a step.
+class AllReduceBatcher {
+ public:
+  // Runs a collective described by `col_params` that reduces `input` into
+  // `output`, on behalf of the op of `ctx`.
+  typedef std::function<void(OpKernelContext* ctx,
+                             const CollectiveParams& col_params,
+                             const string& exec_key, const Tensor* input,
+                             Tensor* output, const StatusCallback& done)>
+      RunCollectiveFn;
+
+  AllReduceBatcher(CollectiveExecutor* col_exec, const DeviceMgr* dev_mgr,
+                   RunCollectiveFn run_collective);
+  ~AllReduceBatcher();
+
+  // Returns true if the all-reduce of the input of `ctx` described by
+  // `col_params` may be fused with others.  This only depends on values that
+  // all the members of the collective agree on.
+  static bool IsEligible(OpKernelContext* ctx,
+                         const CollectiveParams& col_params);
+
+  // Queues the eligible all-reduce of the input of `ctx` into its output.
+  // `done` is called once the batch that it is part of has completed.
+  // `ctx` and `col_params` must outlive the call to `done`.
+  void Enqueue(OpKernelContext* ctx, const CollectiveParams& col_params,
+               const string& exec_key, const StatusCallback& done);
+
+  // Fails all the queued all-reduces, and the ones enqueued afterwards, with
+  // `s`.
+  void StartAbort(const Status& s);
+
+  // Upper bound on the number of all-reduces fused together.
+  static constexpr int kMaxBatchSize = 256;
+
+ private:
+  struct Entry {
+    OpKernelContext* ctx;
+    const CollectiveParams* col_params;
+    string exec_key;
+    StatusCallback done;
+    // The device context of `ctx`, which remains valid after `done` ran.
+    DeviceContext* op_device_context;
+  };
+
+  // The all-reduces of one device that may be fused together.
+  struct Bucket {
+    explicit Bucket(const string& name) : name(name) {}
+    const string name;
+    mutex mu;
+    Status status TF_GUARDED_BY(mu);
+    // Rank 0 only: the queued all-reduces, in the order they were issued,
+    // and their total size.
+    std::vector<Entry> queued TF_GUARDED_BY(mu);
+    int64 queued_bytes TF_GUARDED_BY(mu) = 0;
+    // Rank 0 only: number of batches launched so far.  Also identifies the
+    // batch that a flush timer was set for.
+    int64 num_batches TF_GUARDED_BY(mu) = 0;
+    // Other ranks: the all-reduces that were issued but not run yet, keyed by
+    // the fingerprint of their exec_key.
+    std::unordered_map<int64, Entry> issued TF_GUARDED_BY(mu);
+    // Other ranks: decisions received from rank 0 but not run yet.
+    std::deque<std::vector<int64>> decisions TF_GUARDED_BY(mu);
+    int64 num_decisions TF_GUARDED_BY(mu) = 0;
+    bool recv_pending TF_GUARDED_BY(mu) = false;
+    Tensor recv_buf;
+  };
+
+  std::shared_ptr<Bucket> GetBucket(OpKernelContext* ctx,
+                                    const CollectiveParams& col_params);
+
+  // Rank 0: sends the list of `entries` to the other members and launches
+  // their batch.
+  void Flush(const std::shared_ptr<Bucket>& bucket,
+             std::vector<Entry>* entries, int64 batch);
+  // Rank 0: flushes the bucket after `delay_us` unless `batch` was launched
+  // in the meantime.
+  void FlushAfter(const std::shared_ptr<Bucket>& bucket, int64 batch,
+                  int64 delay_us);
+
+  // Other ranks: launches the batches of the received decisions whose
+  // all-reduces have all been issued.
+  void LaunchDecided(const std::shared_ptr<Bucket>& bucket);
+  // Other ranks: asks for the next decision if some issued all-reduces are
+  // not part of any received one.
+  void MaybeRecvDecision(const std::shared_ptr<Bucket>& bucket);
+  void RecvDone(const std::shared_ptr<Bucket>& bucket, const Status& s);
+
+  // Packs the inputs of `entries`, all-reduces them at once and unpacks the
+  // results.  Runs on the collective executor's blockable threads.
+  void RunBatch(const std::vector<Entry>& entries);
+  Status RunBatchInternal(const std::vector<Entry>& entries);
+
+  string DecisionKey(const Bucket& bucket, int64 batch, int rank) const;
+
+  CollectiveExecutor* const col_exec_;  // Not owned.
+  const DeviceMgr* const dev_mgr_;      // Not owned.
+  const RunCollectiveFn run_collective_;
+  mutex mu_;
+  Status status_ TF_GUARDED_BY(mu_);
+  std::unordered_map<string, std::shared_ptr<Bucket>> buckets_
+      TF_GUARDED_BY(mu_);
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_ALL_REDUCE_BATCHER_H_
@@ -0,0 +1,271 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/all_reduce_batcher.h"
+
+#include <algorithm>
+#include <random>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/device_resolver_local.h"
+#include "tensorflow/core/common_runtime/test_collective_executor_mgr.h"
+#include "tensorflow/core/common_runtime/threadpool_device.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/unbounded_work_queue.h"
+#include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+static int64 kStepId = 123;
+static const char kTaskName[] = "/job:localhost/replica:0/task:0";
+
+std::unique_ptr<OpKernel> GetBinOp(const string& op, DeviceBase* device) {
+  NodeDef node_def;
+  TF_CHECK_OK(NodeDefBuilder(strings::StrCat(op, "_node"), op)
+                  .Attr("T", DT_FLOAT)
+                  .Input(FakeInput(DT_FLOAT))
+                  .Input(FakeInput(DT_FLOAT))
+                  .Finalize(&node_def));
+  Status status;
+  std::unique_ptr<OpKernel> k = CreateOpKernel(
+      DEVICE_CPU, device, device->GetAllocator(AllocatorAttributes()),
+      node_def, TF_GRAPH_DEF_VERSION, &status);
+  TF_CHECK_OK(status);
+  return k;
+}
+
+// One all-reduce op on one device.
+struct Op {
+  ~Op() { dev_ctx->Unref(); }
+
+  CollectiveParams col_params;
+  Tensor tensor;
+  gtl::InlinedVector<TensorValue, 4> inputs;
+  gtl::InlinedVector<AllocatorAttributes, 4> input_aa;
+  AllocatorAttributes output_attr;
+  int forward_from = 0;
+  DeviceContext* dev_ctx = new DeviceContext;
+  std::unique_ptr<OpKernel> kernel;
+  OpKernelContext::Params params;
+  std::unique_ptr<OpKernelContext> ctx;
+  Status status;
+};
+
+class AllReduceBatcherTest : public ::testing::Test {
+ protected:
+  ~AllReduceBatcherTest() override {
+    ops_.clear();
+    if (col_exec_) col_exec_->Unref();
+  }
+
+  void Init(int num_devices) {
+    std::vector<std::unique_ptr<Device>> local_devices;
+    SessionOptions sess_opts;
+    sess_opts.env = Env::Default();
+    Bytes mem_limit(4 << 20);
+    DeviceLocality dev_locality;
+    for (int di = 0; di < num_devices; ++di) {
+      local_devices.push_back(absl::make_unique<ThreadPoolDevice>(
+          sess_opts, strings::StrCat(kTaskName, "/cpu:", di), mem_limit,
+          dev_locality, cpu_allocator()));
+    }
+    dev_mgr_ = absl::make_unique<StaticDeviceMgr>(std::move(local_devices));
+    dev_resolver_ = absl::make_unique<DeviceResolverLocal>(dev_mgr_.get());
+    work_queue_ = std::make_shared<UnboundedWorkQueue>(Env::Default(), "test");
+    auto* rma = new CollectiveRemoteAccessLocal(
+        dev_mgr_.get(), dev_resolver_.get(), work_queue_, kStepId);
+    col_exec_ = new BaseCollectiveExecutor(&col_exec_mgr_, rma, kStepId,
+                                           dev_mgr_.get(), &gpu_ring_order_);
+    num_devices_ = num_devices;
+  }
+
+  // Adds an all-reduce of a tensor of `len` floats on every device.
+  void AddAllReduce(int len, int64 fusion_threshold_bytes) {
+    const int instance = static_cast<int>(ops_.size()) / num_devices_;
+    for (int rank = 0; rank < num_devices_; ++rank) {
+      Device* device = nullptr;
+      TF_CHECK_OK(dev_mgr_->LookupDevice(
+          strings::StrCat(kTaskName, "/cpu:", rank), &device));
+      auto op = absl::make_unique<Op>();
+      CollectiveParams& cp = op->col_params;
+      cp.name = strings::StrCat("all_reduce_", instance);
+      cp.group.group_key = 5;
+      cp.group.group_size = num_devices_;
+      cp.group.device_type = DEVICE_CPU;
+      cp.group.num_tasks = 1;
+      cp.instance.instance_key = 100 + instance;
+      cp.instance.type = REDUCTION_COLLECTIVE;
+      cp.instance.data_type = DT_FLOAT;
+      cp.instance.shape = TensorShape({len});
+      cp.instance.same_num_devices_per_task = true;
+      cp.instance.num_devices_per_task[kTaskName] = num_devices_;
+      cp.instance.impl_details.collective_name = "RingReduce";
+      cp.instance.impl_details.subdiv_offsets = {0};
+      cp.instance.impl_details.subdiv_permutations.emplace_back();
+      for (int r = 0; r < num_devices_; ++r) {
+        cp.instance.device_names.push_back(
+            strings::StrCat(kTaskName, "/cpu:", r));
+        cp.instance.task_names.push_back(kTaskName);
+        cp.instance.impl_details.subdiv_permutations[0].push_back(r);
+        cp.task.is_local.push_back(true);
+      }
+      cp.instance.impl_details.fusion_threshold_bytes = fusion_threshold_bytes;
+      cp.default_rank = rank;
+      cp.subdiv_rank = {rank};
+      cp.merge_op = GetBinOp("Add", device);
+      cp.final_op = GetBinOp("Div", device);
+
+      op->tensor = Tensor(DT_FLOAT, TensorShape({len}));
+      for (int i = 0; i < len; ++i) {
+        op->tensor.flat<float>()(i) = rank * 100 + instance + i;
+      }
+      op->inputs.push_back(TensorValue(&op->tensor));
+      op->input_aa.push_back(AllocatorAttributes());
+      op->kernel = GetBinOp("Add", device);
+      op->params.step_id = kStepId;
+      op->params.device = device;
+      op->params.inputs = &op->inputs;
+      op->params.input_alloc_attrs = &op->input_aa;
+      op->params.op_device_context = op->dev_ctx;
+      op->params.forward_from_array = &op->forward_from;
+      op->params.output_attr_array = &op->output_attr;
+      op->params.op_kernel = op->kernel.get();
+      op->ctx = absl::make_unique<OpKernelContext>(&op->params, 1);
+      Tensor* output = nullptr;
+      TF_CHECK_OK(op->ctx->forward_input_or_allocate_output(
+          {0}, 0, op->tensor.shape(), &output));
+      ops_.push_back(std::move(op));
+    }
+  }
+
+  // Issues the all-reduces, in a different order on every device, and waits
+  // for all of them to complete.
+  void Run(bool skip_rank_zero = false) {
+    const int num_instances = static_cast<int>(ops_.size()) / num_devices_;
+    std::vector<Op*> order;
+    for (int rank = 0; rank < num_devices_; ++rank) {
+      if (skip_rank_zero && rank == 0) continue;
+      std::vector<Op*> device_ops;
+      for (int i = 0; i < num_instances; ++i) {
+        device_ops.push_back(ops_[i * num_devices_ + rank].get());
+      }
+      std::shuffle(device_ops.begin(), device_ops.end(),
+                   std::mt19937(rank + 1));
+      order.insert(order.end(), device_ops.begin(), device_ops.end());
+    }
+    pending_ = absl::make_unique<BlockingCounter>(order.size());
+    for (Op* op : order) {
+      col_exec_->ExecuteAsync(
+          op->ctx.get(), op->col_params,
+          strings::StrCat(op->col_params.instance.instance_key, ":0:0"),
+          [this, op](const Status& s) {
+            op->status = s;
+            pending_->DecrementCount();
+          });
+    }
+  }
+
+  void Wait() { pending_->Wait(); }
+
+  void CheckResults() {
+    for (const auto& op : ops_) {
+      TF_EXPECT_OK(op->status);
+      const int instance = op->col_params.instance.instance_key - 100;
+      const Tensor& output = *op->ctx->mutable_output(0);
+      for (int i = 0; i < output.NumElements(); ++i) {
+        float expected = 0;
+        for (int rank = 0; rank < num_devices_; ++rank) {
+          expected += rank * 100 + instance + i;
+        }
+        expected /= num_devices_;
+        EXPECT_EQ(expected, output.flat<float>()(i))
+            << "Mismatch in " << op->col_params.name << " on rank "
+            << op->col_params.default_rank << " at index " << i;
+      }
+    }
+  }
+
+  TestCollectiveExecutorMgr col_exec_mgr_;
+  CollectiveExecutor* col_exec_ = nullptr;
+  std::unique_ptr<DeviceResolverLocal> dev_resolver_;
+  std::shared_ptr<UnboundedWorkQueue> work_queue_;
+  std::unique_ptr<DeviceMgr> dev_mgr_;
+  string gpu_ring_order_;
+  int num_devices_ = 0;
+  std::vector<std::unique_ptr<Op>> ops_;
+  std::unique_ptr<BlockingCounter> pending_;
+};
+
+TEST_F(AllReduceBatcherTest, FusesAllReducesIssuedInAnyOrder) {
+  Init(/*num_devices=*/4);
+  for (int i = 0; i < 40; ++i) {
+    AddAllReduce(/*len=*/i + 1, /*fusion_threshold_bytes=*/1 << 20);
+  }
+  Run();
+  Wait();
+  CheckResults();
+}
+
+TEST_F(AllReduceBatcherTest, LaunchesFullBatches) {
+  Init(/*num_devices=*/3);
+  // Each batch is launched as soon as it holds 256 bytes.
+  for (int i = 0; i < 50; ++i) {
+    AddAllReduce(/*len=*/i % 16 + 1, /*fusion_threshold_bytes=*/256);
+  }
+  Run();
+  Wait();
+  CheckResults();
+}
+
+TEST_F(AllReduceBatcherTest, RunsLargeAllReducesAlone) {
+  Init(/*num_devices=*/4);
+  for (int i = 0; i < 20; ++i) {
+    AddAllReduce(/*len=*/i % 2 ? 8 : 1001, /*fusion_threshold_bytes=*/1024);
+  }
+  Run();
+  Wait();
+  CheckResults();
+}
+
+TEST_F(AllReduceBatcherTest, Abort) {
+  Init(/*num_devices=*/2);
+  for (int i = 0; i < 4; ++i) {
+    AddAllReduce(/*len=*/4, /*fusion_threshold_bytes=*/1 << 20);
+  }
+  // Rank 1 waits for a decision of rank 0, which never issues its ops.
+  Run(/*skip_rank_zero=*/true);
+  col_exec_->StartAbort(errors::Cancelled("aborted"));
+  Wait();
+  for (const auto& op : ops_) {
+    if (op->col_params.default_rank == 0) continue;
+    EXPECT_FALSE(op->status.ok());
+  }
+}
+
+}  // namespace
+}  // namespace tensorflow
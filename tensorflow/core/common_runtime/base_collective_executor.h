@@ -18,6 +18,7 @@ limitations under the License.
 #include <memory>
 #include <string>
 
+#include "tensorflow/core/common_runtime/all_reduce_batcher.h"
 #include "tensorflow/core/common_runtime/buf_rendezvous.h"
 #include "tensorflow/core/framework/collective.h"
 #include "tensorflow/core/framework/device_attributes.pb.h"
@@ -102,7 +103,14 @@ class BaseCollectiveExecutor : public CollectiveExecutor {
         step_id_(step_id),
         dev_mgr_(dev_mgr),
         remote_access_(remote_access),
-        gpu_ring_order_(gpu_ring_order) {}
+        gpu_ring_order_(gpu_ring_order),
+        all_reduce_batcher_(
+            this, dev_mgr,
+            [this](OpKernelContext* ctx, const CollectiveParams& col_params,
+                   const string& exec_key, const Tensor* input, Tensor* output,
+                   const StatusCallback& done) {
+              RunCollective(ctx, col_params, exec_key, input, output, done);
+            }) {}
 
   ~BaseCollectiveExecutor() override;
 
@@ -166,8 +174,13 @@ class BaseCollectiveExecutor : public CollectiveExecutor {
   // collective instance key -> number of local devices for which NCCL ops have
   // been launched.
   std::unordered_map<int32, int32> launched_ TF_GUARDED_BY(launch_mu_);
+  AllReduceBatcher all_reduce_batcher_;
 
  private:
+  // Runs the collective described by `col_params` from `input` to `output`.
+  void RunCollective(OpKernelContext* ctx, const CollectiveParams& col_params,
+                     const string& exec_key, const Tensor* input,
+                     Tensor* output, const StatusCallback& done_safe);
   Status CreateCollective(const CollectiveParams& col_params,
                           CollectiveImplementationInterface** col_impl);
   // Check if all ops on which this collective depends on have launched.
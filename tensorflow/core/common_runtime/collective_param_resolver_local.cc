@@ -45,6 +45,12 @@ CollectiveParamResolverLocal::CollectiveParamResolverLocal(
     const ConfigProto& config, const DeviceMgr* dev_mgr,
     DeviceResolverInterface* dev_resolver, const string& task_name)
     : nccl_(config.experimental().collective_nccl()),
+      ring_segment_bytes_(
+          config.experimental().collective_ring_segment_bytes()),
+      fusion_threshold_bytes_(
+          config.experimental().collective_fusion_threshold_bytes()),
+      fusion_cycle_time_us_(
+          config.experimental().collective_fusion_cycle_time_us()),
       dev_mgr_(dev_mgr),
       dev_resolver_(dev_resolver),
       task_name_(task_name) {}
@@ -65,7 +71,15 @@ const char* GetCollectiveName(const CollectiveParams* cp, bool nccl) {
       return "HierarchicalTreeBroadcast";
 
     case REDUCTION_COLLECTIVE:
-      return nccl ? "NcclReduce" : "RingReduce";
+      if (nccl) return "NcclReduce";
+      // With a single device per task there is nothing to reduce within
+      // the tasks, so the hierarchical reduction would be a plain ring.
+      if (cp->instance.impl_details.communication_hint == "hierarchical" &&
+          cp->group.device_type == DEVICE_CPU &&
+          cp->group.num_tasks < cp->group.group_size) {
+        return "HierarchicalRingReduce";
+      }
+      return "RingReduce";
 
     case GATHER_COLLECTIVE:
       return "RingGather";
@@ -722,6 +736,9 @@ void CollectiveParamResolverLocal::AssignCollectiveType(CollectiveParams* cp) {
       CollectiveRegistry::LookupParamResolverInstance("NcclReduce", &col_impl)
           .ok();
   cp->instance.impl_details.collective_name = GetCollectiveName(cp, use_nccl);
+  cp->instance.impl_details.ring_segment_bytes = ring_segment_bytes_;
+  cp->instance.impl_details.fusion_threshold_bytes = fusion_threshold_bytes_;
+  cp->instance.impl_details.fusion_cycle_time_us = fusion_cycle_time_us_;
   VLOG(1) << "AssignCollectiveType "
           << cp->instance.impl_details.collective_name;
 }
@@ -191,22 +191,26 @@ Status EagerContext::RegisterFunction(AbstractFunction* f) {
 // eager_operation.cc we can avoid a circular dependency between them.
 Status EagerOperation::Execute(absl::Span<AbstractTensorHandle*> retvals,
                                int* num_retvals) {
-  // Run eager placement logic.
-  VariantDevice device;
-  TF_RETURN_IF_ERROR(eager::MaybePinToCustomDevice(&device, *this));
-  if (device == kVariantDeviceNull) {
-    TF_RETURN_IF_ERROR(eager::MaybePinToResourceDevice(&device, *this));
-  }
-  if (device == kVariantDeviceNull && ctx_.PinSmallOpsToCPU()) {
-    bool pin_to_cpu;
-    TF_RETURN_IF_ERROR(eager::MaybePinSmallOpsToCpu(
-        &pin_to_cpu, Name(), GetInputs(), ctx_.HostCPU()->name()));
-    if (pin_to_cpu) {
-      device = ctx_.HostCPU();
+  // A pinned kernel already carries the result of the placement logic below,
+  // and the op's device was set when it was pinned.
+  if (PinnedKernelForInputs() == nullptr) {
+    // Run eager placement logic.
+    VariantDevice device;
+    TF_RETURN_IF_ERROR(eager::MaybePinToCustomDevice(&device, *this));
+    if (device == kVariantDeviceNull) {
+      TF_RETURN_IF_ERROR(eager::MaybePinToResourceDevice(&device, *this));
+    }
+    if (device == kVariantDeviceNull && ctx_.PinSmallOpsToCPU()) {
+      bool pin_to_cpu;
+      TF_RETURN_IF_ERROR(eager::MaybePinSmallOpsToCpu(
+          &pin_to_cpu, Name(), GetInputs(), ctx_.HostCPU()->name()));
+      if (pin_to_cpu) {
+        device = ctx_.HostCPU();
+      }
+    }
+    if (device != kVariantDeviceNull) {
+      SetDevice(device);
     }
-  }
-  if (device != kVariantDeviceNull) {
-    SetDevice(device);
   }
   return EagerExecute(
       this, reinterpret_cast<tensorflow::TensorHandle**>(retvals.data()),
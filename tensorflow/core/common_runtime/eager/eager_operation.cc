@@ -40,38 +40,45 @@ void EagerOperation::Clear() {
 
 Status EagerOperation::SetAttrValue(const char* attr_name,
                                     const AttrValue& value) {
+  UnpinKernel();
   MutableAttrs()->Set(attr_name, value);
   return Status::OK();
 }
 
 Status EagerOperation::SetAttrString(const char* attr_name, const char* data,
                                      size_t length) {
+  UnpinKernel();
   MutableAttrs()->Set(attr_name, StringPiece(data, length));
   return Status::OK();
 }
 
 Status EagerOperation::SetAttrInt(const char* attr_name, int64_t value) {
+  UnpinKernel();
   MutableAttrs()->Set(attr_name, static_cast<int64>(value));
   return Status::OK();
 }
 
 Status EagerOperation::SetAttrFloat(const char* attr_name, float value) {
+  UnpinKernel();
   MutableAttrs()->Set(attr_name, value);
   return Status::OK();
 }
 
 Status EagerOperation::SetAttrBool(const char* attr_name, bool value) {
+  UnpinKernel();
   MutableAttrs()->Set(attr_name, value);
   return Status::OK();
 }
 
 Status EagerOperation::SetAttrType(const char* attr_name, DataType value) {
+  UnpinKernel();
   MutableAttrs()->Set(attr_name, value);
   return Status::OK();
 }
 
 Status EagerOperation::SetAttrShape(const char* attr_name, const int64_t* dims,
                                     const int num_dims) {
+  UnpinKernel();
   if (num_dims > TensorShape::MaxDimensions()) {
     return errors::InvalidArgument("Value specified for `", attr_name, "` has ",
                                    num_dims,
@@ -95,6 +102,7 @@ Status EagerOperation::SetAttrShape(const char* attr_name, const int64_t* dims,
 
 Status EagerOperation::SetAttrFunction(const char* attr_name,
                                        const AbstractOperation* value) {
+  UnpinKernel();
   AttrValue attr_value;
   NameAttrList* func = attr_value.mutable_func();
   func->set_name(value->Name());
@@ -106,6 +114,7 @@ Status EagerOperation::SetAttrFunction(const char* attr_name,
 
 Status EagerOperation::SetAttrFunctionName(const char* attr_name,
                                            const char* data, size_t length) {
+  UnpinKernel();
   AttrValue attr_value;
   NameAttrList* func = attr_value.mutable_func();
   func->set_name(data, length);
@@ -115,6 +124,7 @@ Status EagerOperation::SetAttrFunctionName(const char* attr_name,
 
 Status EagerOperation::SetAttrTensor(const char* attr_name,
                                      AbstractTensorInterface* tensor) {
+  UnpinKernel();
   Tensor t = TensorFromInterface(tensor);
   MutableAttrs()->Set(attr_name, t);
   return Status::OK();
@@ -124,6 +134,7 @@ Status EagerOperation::SetAttrStringList(const char* attr_name,
                                          const void* const* values,
                                          const size_t* lengths,
                                          int num_values) {
+  UnpinKernel();
   std::vector<StringPiece> v(num_values);
   for (int i = 0; i < num_values; ++i) {
     v[i] = StringPiece(static_cast<const char*>(values[i]), lengths[i]);
@@ -135,6 +146,7 @@ Status EagerOperation::SetAttrStringList(const char* attr_name,
 
 Status EagerOperation::SetAttrFloatList(const char* attr_name,
                                         const float* values, int num_values) {
+  UnpinKernel();
   MutableAttrs()->Set(attr_name,
                       gtl::ArraySlice<const float>(values, num_values));
   return Status::OK();
@@ -142,6 +154,7 @@ Status EagerOperation::SetAttrFloatList(const char* attr_name,
 
 Status EagerOperation::SetAttrIntList(const char* attr_name,
                                       const int64_t* values, int num_values) {
+  UnpinKernel();
   MutableAttrs()->Set(attr_name,
                       gtl::ArraySlice<const int64>(
                           reinterpret_cast<const int64*>(values), num_values));
@@ -150,6 +163,7 @@ Status EagerOperation::SetAttrIntList(const char* attr_name,
 
 Status EagerOperation::SetAttrTypeList(const char* attr_name,
                                        const DataType* values, int num_values) {
+  UnpinKernel();
   MutableAttrs()->Set(attr_name,
                       gtl::ArraySlice<const DataType>(values, num_values));
   return Status::OK();
@@ -158,6 +172,7 @@ Status EagerOperation::SetAttrTypeList(const char* attr_name,
 Status EagerOperation::SetAttrBoolList(const char* attr_name,
                                        const unsigned char* values,
                                        int num_values) {
+  UnpinKernel();
   std::unique_ptr<bool[]> b(new bool[num_values]);
   for (int i = 0; i < num_values; ++i) {
     b[i] = values[i];
@@ -170,6 +185,7 @@ Status EagerOperation::SetAttrBoolList(const char* attr_name,
 Status EagerOperation::SetAttrShapeList(const char* attr_name,
                                         const int64_t** dims,
                                         const int* num_dims, int num_values) {
+  UnpinKernel();
   std::unique_ptr<TensorShapeProto[]> proto(new TensorShapeProto[num_values]);
   for (int i = 0; i < num_values; ++i) {
     const auto num_dims_i = num_dims[i];
@@ -197,6 +213,7 @@ Status EagerOperation::SetAttrShapeList(const char* attr_name,
 
 Status EagerOperation::SetAttrFunctionList(
     const char* attr_name, absl::Span<const AbstractOperation*> values) {
+  UnpinKernel();
   size_t num_values = values.size();
   std::unique_ptr<NameAttrList[]> funcs(new NameAttrList[num_values]);
   for (int i = 0; i < num_values; i++) {
@@ -278,6 +295,7 @@ Status EagerOperation::AddInputList(
 }
 
 Status EagerOperation::SetUseXla(bool enable) {
+  UnpinKernel();
   use_xla_ = enable;
   return Status::OK();
 }
@@ -288,6 +306,8 @@ Status EagerOperation::Reset(
     const absl::optional<EagerRemoteFunctionParams> remote_func_params) {
   DCHECK(inputs_.empty());
   ClearInferenceState();
+  kernel_pinning_ = false;
+  UnpinKernel();
   bool is_function = false;
   TF_RETURN_IF_ERROR(AttrTypeMapForOp(op, &attr_types_, &is_function));
 
@@ -399,6 +419,7 @@ Status EagerOperation::SetDeviceName(const char* c_name) {
     }
     last_set_device_name_ = name;
     device_name_ = DeviceNameUtils::ParsedNameToString(device_parsed_name_);
+    UnpinKernel();
     CustomDevice* custom_device;
     if (ctx_.FindCustomDeviceFromName(device_name_, &custom_device)) {
       device_ = custom_device;
@@ -411,6 +432,47 @@ Status EagerOperation::SetDeviceName(const char* c_name) {
   return Status::OK();
 }
 
+void EagerOperation::SetKernelPinning(bool enable) {
+  kernel_pinning_ = enable;
+  if (!enable) UnpinKernel();
+}
+
+KernelAndDevice* EagerOperation::PinnedKernelForInputs() const {
+  if (pinned_kernel_ == nullptr ||
+      pinned_kernel_generation_ != ctx_.KernelCacheGeneration() ||
+      pinned_allow_soft_placement_ != ctx_.AllowSoftPlacement() ||
+      inputs_.size() != pinned_inputs_.size()) {
+    return nullptr;
+  }
+  for (int i = 0, end = inputs_.size(); i < end; ++i) {
+    const TensorHandle* input = inputs_[i];
+    const PinnedInput& pinned = pinned_inputs_[i];
+    if (input->dtype != pinned.dtype ||
+        input->resource_device() != pinned.resource_device ||
+        input->DeviceOrHostCPU(ctx_) != pinned.device) {
+      return nullptr;
+    }
+  }
+  return pinned_kernel_.get();
+}
+
+void EagerOperation::MaybePinKernel(KernelAndDevice* kernel) {
+  UnpinKernel();
+  if (!kernel_pinning_ || is_function_ || !IsLocal() ||
+      VariantDeviceIsCustom(device_)) {
+    return;
+  }
+  kernel->Ref();
+  pinned_kernel_.reset(kernel);
+  pinned_inputs_.reserve(inputs_.size());
+  for (const TensorHandle* input : inputs_) {
+    pinned_inputs_.push_back(
+        {input->dtype, input->DeviceOrHostCPU(ctx_), input->resource_device()});
+  }
+  pinned_kernel_generation_ = ctx_.KernelCacheGeneration();
+  pinned_allow_soft_placement_ = ctx_.AllowSoftPlacement();
+}
+
 bool EagerOperation::IsLocal() const {
   if (ctx_.remote_device_mgr() == nullptr) return true;
 
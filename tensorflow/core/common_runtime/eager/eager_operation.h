@@ -167,6 +167,29 @@ class EagerOperation : public ImmediateExecutionOperation {
 
   EagerExecutor& Executor() { return *executor_; }
 
+  // Kernel pinning lets a caller that executes the same op repeatedly (only
+  // swapping its inputs via Clear()/AddInput()) skip the kernel cache lookup,
+  // which fingerprints all attributes, and the eager placement logic.
+  //
+  // When enabled, the first execution pins the KernelAndDevice it used to this
+  // operation. Later executions reuse it directly as long as the inputs have
+  // the same dtypes, devices and resource devices as when it was pinned, and
+  // neither the attributes, the requested device nor the context's kernel
+  // cache have changed since. Otherwise the regular path runs and re-pins.
+  //
+  // Only primitive ops placed on a physical, local device are pinned. Pinning
+  // is disabled again by Reset().
+  void SetKernelPinning(bool enable);
+  bool kernel_pinning() const { return kernel_pinning_; }
+
+  // Returns the pinned kernel if it can run the current inputs, or nullptr.
+  KernelAndDevice* PinnedKernelForInputs() const;
+
+  // If kernel pinning is enabled and this op can be pinned, pins `kernel` for
+  // the current inputs. Must be called before the inputs are copied to the
+  // kernel's devices.
+  void MaybePinKernel(KernelAndDevice* kernel);
+
   string DebugString() const;
 
   const absl::optional<EagerRemoteFunctionParams>& remote_func_params() const {
@@ -192,6 +215,11 @@ class EagerOperation : public ImmediateExecutionOperation {
     inference_attrs_.clear_no_resize();
   }
 
+  void UnpinKernel() {
+    pinned_kernel_.reset();
+    pinned_inputs_.clear();
+  }
+
   Status MaybeInferSingleInputAttrs(TensorHandle* handle);
   Status InferInputListAttrs(int num_inputs);
 
@@ -235,6 +263,18 @@ class EagerOperation : public ImmediateExecutionOperation {
   EagerExecutor* executor_;                              // Not owned.
   absl::optional<EagerRemoteFunctionParams> remote_func_params_;
 
+  // Kernel pinning state, see SetKernelPinning().
+  struct PinnedInput {
+    DataType dtype;
+    VariantDevice device;
+    tensorflow::Device* resource_device;
+  };
+  bool kernel_pinning_ = false;
+  core::RefCountPtr<KernelAndDevice> pinned_kernel_;
+  absl::InlinedVector<PinnedInput, 4> pinned_inputs_;
+  int64 pinned_kernel_generation_ = 0;
+  bool pinned_allow_soft_placement_ = false;
+
   // Inference information
   const tensorflow::OpDef* op_def_;  // op definition from protobuf
   int inference_arg_idx_;  // arg definition index for the next input to be
@@ -48,5 +48,70 @@ TEST(EagerOperationTest, DeviceName) {
   ctx->Unref();
 }
 
+TEST(EagerOperationTest, KernelPinning) {
+  StaticDeviceMgr device_mgr(DeviceFactory::NewDevice(
+      "CPU", {}, "/job:localhost/replica:0/task:0/device:CPU:0"));
+  Device* device = device_mgr.ListDevices().at(0);
+  auto ctx = new EagerContext(
+      SessionOptions(),
+      tensorflow::ContextDevicePlacementPolicy::DEVICE_PLACEMENT_SILENT,
+      tensorflow::ContextMirroringPolicy::MIRRORING_NONE, false, false,
+      &device_mgr, false, nullptr, nullptr, nullptr);
+
+  Tensor f(DT_FLOAT, TensorShape({}));
+  TensorHandle* float_handle =
+      TensorHandle::CreateLocalHandle(std::move(f), device, device, ctx);
+  Tensor i(DT_INT32, TensorShape({}));
+  TensorHandle* int_handle =
+      TensorHandle::CreateLocalHandle(std::move(i), device, device, ctx);
+
+  auto op = new EagerOperation(ctx);
+  TF_ASSERT_OK(op->Reset("Identity", nullptr, false, nullptr));
+  op->SetDevice(device);
+  op->SetKernelPinning(true);
+  TF_ASSERT_OK(op->AddInput(float_handle));
+
+  core::RefCountPtr<KernelAndDevice> kernel(new KernelAndDeviceOp(
+      nullptr, false, nullptr, nullptr, nullptr, device));
+  op->MaybePinKernel(kernel.get());
+  EXPECT_EQ(kernel.get(), op->PinnedKernelForInputs());
+
+  // Swapping in an input of the same dtype and device keeps the kernel.
+  op->Clear();
+  TF_ASSERT_OK(op->AddInput(float_handle));
+  EXPECT_EQ(kernel.get(), op->PinnedKernelForInputs());
+
+  // Inputs of a different dtype or count do not match.
+  op->Clear();
+  TF_ASSERT_OK(op->AddInput(int_handle));
+  EXPECT_EQ(nullptr, op->PinnedKernelForInputs());
+  op->Clear();
+  EXPECT_EQ(nullptr, op->PinnedKernelForInputs());
+
+  // Setting an attribute unpins the kernel.
+  TF_ASSERT_OK(op->AddInput(float_handle));
+  EXPECT_EQ(kernel.get(), op->PinnedKernelForInputs());
+  TF_ASSERT_OK(op->SetAttrType("T", DT_FLOAT));
+  EXPECT_EQ(nullptr, op->PinnedKernelForInputs());
+
+  // So does clearing the context's kernel cache.
+  op->MaybePinKernel(kernel.get());
+  EXPECT_EQ(kernel.get(), op->PinnedKernelForInputs());
+  ctx->ClearCachesAndDefaultExecutor();
+  EXPECT_EQ(nullptr, op->PinnedKernelForInputs());
+
+  // Nothing is pinned once pinning is disabled.
+  op->SetKernelPinning(false);
+  op->MaybePinKernel(kernel.get());
+  EXPECT_EQ(nullptr, op->PinnedKernelForInputs());
+
+  op->Clear();
+  delete op;
+  float_handle->Unref();
+  int_handle->Unref();
+  kernel.reset();
+  ctx->Unref();
+}
+
 }  // namespace
 }  // namespace tensorflow
@@ -617,8 +617,24 @@ Status EagerLocalExecute(EagerOperation* op, TensorHandle** retvals,
   TF_RETURN_IF_ERROR(executor.status());
 
   core::RefCountPtr<KernelAndDevice> kernel;
-  TF_RETURN_IF_ERROR(
-      GetOrCreateKernelAndDevice(op, retvals, num_retvals, &kernel));
+  KernelAndDevice* pinned_kernel = op->PinnedKernelForInputs();
+  if (pinned_kernel != nullptr) {
+    // Skips the attribute fingerprinting and kernel cache lookup.
+    if (pinned_kernel->num_outputs() > *num_retvals) {
+      return errors::InvalidArgument("Expecting ", pinned_kernel->num_outputs(),
+                                     " outputs, but *num_retvals is ",
+                                     *num_retvals);
+    }
+    *num_retvals = pinned_kernel->num_outputs();
+    pinned_kernel->Ref();
+    kernel.reset(pinned_kernel);
+  } else {
+    TF_RETURN_IF_ERROR(
+        GetOrCreateKernelAndDevice(op, retvals, num_retvals, &kernel));
+    if (op->kernel_pinning()) {
+      op->MaybePinKernel(kernel.get());
+    }
+  }
 
   int num_outputs = kernel->num_outputs();
   TF_RETURN_IF_ERROR(ValidateInputTypeAndPlacement(&ctx, op, kernel));
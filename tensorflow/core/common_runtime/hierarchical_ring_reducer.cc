@@ -0,0 +1,374 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_ring_reducer.h"
+
+#include <algorithm>
+#include <deque>
+#include <utility>
+
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/collective_util.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/profiler/lib/traceme.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns a scalar holding `group_size` as a `dtype` host tensor.
+Status GroupSizeScalar(DataType dtype, int group_size, Tensor* scalar) {
+  switch (dtype) {
+    case DT_HALF:
+      *scalar = Tensor(static_cast<Eigen::half>(group_size));
+      break;
+    case DT_FLOAT:
+      *scalar = Tensor(static_cast<float>(group_size));
+      break;
+    case DT_DOUBLE:
+      *scalar = Tensor(static_cast<double>(group_size));
+      break;
+    case DT_INT32:
+      *scalar = Tensor(static_cast<int32>(group_size));
+      break;
+    case DT_INT64:
+      *scalar = Tensor(static_cast<int64>(group_size));
+      break;
+    default:
+      return errors::Internal("Unsupported type ", DataTypeString(dtype));
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+HierarchicalRingReducer::HierarchicalRingReducer()
+    : col_ctx_(nullptr), col_params_(nullptr), leader_ring_(nullptr) {}
+
+HierarchicalRingReducer::~HierarchicalRingReducer() {
+  if (leader_ring_ != nullptr) leader_ring_->Unref();
+}
+
+/* static */
+std::vector<int> HierarchicalRingReducer::TaskMembers(
+    const CollectiveParams& col_params, int rank) {
+  std::vector<int> members;
+  const string& task_name = col_params.instance.task_names[rank];
+  for (int r = 0; r < col_params.group.group_size; ++r) {
+    if (col_params.instance.task_names[r] == task_name) {
+      members.push_back(r);
+    }
+  }
+  return members;
+}
+
+/* static */
+std::vector<int> HierarchicalRingReducer::TaskLeaders(
+    const CollectiveParams& col_params) {
+  std::vector<int> leaders;
+  for (int r = 0; r < col_params.group.group_size; ++r) {
+    if (TaskMembers(col_params, r).front() == r) {
+      leaders.push_back(r);
+    }
+  }
+  return leaders;
+}
+
+Status HierarchicalRingReducer::InitializeCollectiveParams(
+    CollectiveParams* col_params) {
+  CHECK_EQ(col_params->instance.type, REDUCTION_COLLECTIVE);
+  CHECK_EQ(col_params->instance.impl_details.collective_name,
+           "HierarchicalRingReduce");
+  if (col_params->group.device_type != DEVICE_CPU) {
+    return errors::Unimplemented(
+        "HierarchicalRingReduce only supports CPU devices, got ",
+        col_params->group.device_type.type_string());
+  }
+  return Status::OK();
+}
+
+Status HierarchicalRingReducer::InitializeCollectiveContext(
+    std::shared_ptr<CollectiveContext> col_ctx) {
+  DCHECK(col_ctx->dev_mgr);
+  col_ctx_ = col_ctx;
+  col_params_ = &col_ctx->col_params;
+  TF_RETURN_IF_ERROR(collective_util::InitializeDeviceAndLocality(
+      col_ctx->dev_mgr, col_ctx->device_name, &col_ctx->device,
+      &col_ctx->device_locality));
+  const int rank = col_params_->default_rank;
+  members_ = TaskMembers(*col_params_, rank);
+  if (members_.front() != rank) return Status::OK();
+  const std::vector<int> leaders = TaskLeaders(*col_params_);
+  if (leaders.size() == 1) return Status::OK();
+  return InitializeLeaderRing(leaders);
+}
+
+void HierarchicalRingReducer::Run(StatusCallback done) {
+  CHECK(col_ctx_);
+  CHECK(col_params_);
+  Status s;
+  if (members_.front() != col_params_->default_rank) {
+    col_ctx_->col_exec->UnblockDependencies(*col_params_);
+    s = ExchangeWithLeader(members_.front());
+  } else {
+    // When there is a ring among the leaders, the RingReducer unblocks the
+    // dependencies on behalf of this device.
+    if (leader_ring_ == nullptr) {
+      col_ctx_->col_exec->UnblockDependencies(*col_params_);
+    }
+    if ((col_ctx_->input != col_ctx_->output) &&
+        (DMAHelper::base(col_ctx_->input) !=
+         DMAHelper::base(col_ctx_->output))) {
+      Notification note;
+      profiler::TraceMe activity("MemCpyAsync", profiler::TraceMeLevel::kInfo);
+      CollectiveRemoteAccessLocal::MemCpyAsync(
+          col_ctx_->op_ctx->op_device_context(),
+          col_ctx_->op_ctx->op_device_context(), col_ctx_->device,
+          col_ctx_->device, col_ctx_->op_ctx->input_alloc_attr(0),
+          col_ctx_->op_ctx->output_alloc_attr(0), col_ctx_->input,
+          col_ctx_->output, 0 /*dev_to_dev_stream_index*/,
+          [&note, &s](const Status& copy_status) {
+            s.Update(copy_status);
+            note.Notify();
+          });
+      note.WaitForNotification();
+    }
+    if (s.ok()) s = ReduceWithinTask(members_);
+    if (s.ok() && leader_ring_ != nullptr) s = ReduceAmongLeaders();
+    if (s.ok()) s = Finalize();
+    if (s.ok()) s = BroadcastWithinTask(members_);
+  }
+  if (!s.ok()) StartAbort(s);
+  done(s);
+}
+
+Status HierarchicalRingReducer::ReduceWithinTask(
+    const std::vector<int>& members) {
+  profiler::TraceMe activity("ReduceWithinTask",
+                             profiler::TraceMeLevel::kInfo);
+  const int num_peers = static_cast<int>(members.size()) - 1;
+  if (num_peers == 0) return Status::OK();
+  AllocatorAttributes attr = col_ctx_->op_ctx->output_alloc_attr(0);
+  Allocator* allocator = col_ctx_->device->GetAllocator(attr);
+  std::vector<Tensor> values(num_peers);
+  mutex mu;
+  condition_variable cv;
+  std::deque<int> arrived;
+  Status status;
+  for (int i = 0; i < num_peers; ++i) {
+    const int peer = members[i + 1];
+    values[i] = Tensor(allocator, col_ctx_->output->dtype(),
+                       col_ctx_->output->shape());
+    col_ctx_->col_exec->RecvFromPeer(
+        col_params_->instance.device_names[peer],
+        col_params_->instance.task_names[peer],
+        col_params_->task.is_local[peer], BufKey("up", peer), col_ctx_->device,
+        col_ctx_->op_ctx->op_device_context(), attr, &values[i],
+        col_ctx_->device_locality, 0 /*dev_to_dev_stream_index*/,
+        [this, i, &mu, &cv, &arrived, &status](const Status& s) {
+          if (!s.ok()) StartAbort(s);
+          mutex_lock l(mu);
+          status.Update(s);
+          arrived.push_back(i);
+          cv.notify_one();
+        });
+  }
+  // Merge the values in the order in which they arrive.  All the callbacks
+  // must have run before returning, even after an error, since they refer to
+  // the locals of this function.
+  for (int n = 0; n < num_peers; ++n) {
+    int i;
+    {
+      mutex_lock l(mu);
+      while (arrived.empty()) cv.wait(l);
+      i = arrived.front();
+      arrived.pop_front();
+      if (!status.ok()) continue;
+    }
+    Status s = collective_util::ComputeBinOp(
+        col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+        col_params_->merge_op.get(), col_ctx_->output, &values[i]);
+    if (!s.ok()) {
+      StartAbort(s);
+      mutex_lock l(mu);
+      status.Update(s);
+    }
+  }
+  return status;
+}
+
+Status HierarchicalRingReducer::InitializeLeaderRing(
+    const std::vector<int>& leaders) {
+  const int rank = col_params_->default_rank;
+  leader_params_.name = col_params_->name;
+  leader_params_.group.group_key = col_params_->group.group_key;
+  leader_params_.group.group_size = static_cast<int>(leaders.size());
+  leader_params_.group.device_type = col_params_->group.device_type;
+  leader_params_.group.num_tasks = static_cast<int>(leaders.size());
+  leader_params_.instance = col_params_->instance;
+  leader_params_.instance.device_names.clear();
+  leader_params_.instance.task_names.clear();
+  leader_params_.instance.same_num_devices_per_task = true;
+  leader_params_.instance.impl_details.collective_name = "RingReduce";
+  leader_params_.instance.impl_details.subdiv_offsets.clear();
+  leader_params_.instance.impl_details.subdiv_permutations.clear();
+  for (int leader : leaders) {
+    if (leader == rank) {
+      leader_params_.default_rank =
+          static_cast<int>(leader_params_.instance.device_names.size());
+    }
+    leader_params_.instance.device_names.push_back(
+        col_params_->instance.device_names[leader]);
+    leader_params_.instance.task_names.push_back(
+        col_params_->instance.task_names[leader]);
+    leader_params_.task.is_local.push_back(col_params_->task.is_local[leader]);
+  }
+  // The leaders only merge partial sums; final_op is applied afterwards with
+  // the size of the whole group.
+  Status status;
+  leader_params_.merge_op = CreateOpKernel(
+      col_params_->group.device_type, col_ctx_->device,
+      col_ctx_->device->GetAllocator(AllocatorAttributes()),
+      col_params_->merge_op->def(), TF_GRAPH_DEF_VERSION, &status);
+  TF_RETURN_IF_ERROR(status);
+
+  leader_ring_ = new RingReducer;
+  TF_RETURN_IF_ERROR(leader_ring_->InitializeCollectiveParams(&leader_params_));
+  auto ring_ctx = std::make_shared<CollectiveContext>(
+      col_ctx_->col_exec, col_ctx_->dev_mgr, col_ctx_->op_ctx,
+      col_ctx_->op_params, leader_params_,
+      strings::StrCat(col_ctx_->exec_key, ":leaders"), col_ctx_->step_id,
+      col_ctx_->output, col_ctx_->output);
+  return leader_ring_->InitializeCollectiveContext(ring_ctx);
+}
+
+Status HierarchicalRingReducer::ReduceAmongLeaders() {
+  Status status;
+  Notification note;
+  leader_ring_->Run([&note, &status](const Status& s) {
+    status = s;
+    note.Notify();
+  });
+  note.WaitForNotification();
+  return status;
+}
+
+Status HierarchicalRingReducer::Finalize() {
+  if (!col_params_->final_op) return Status::OK();
+  Tensor group_size;
+  TF_RETURN_IF_ERROR(GroupSizeScalar(col_ctx_->output->dtype(),
+                                     col_params_->group.group_size,
+                                     &group_size));
+  return collective_util::ComputeBinOp(
+      col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+      col_params_->final_op.get(), col_ctx_->output, &group_size);
+}
+
+Status HierarchicalRingReducer::BroadcastWithinTask(
+    const std::vector<int>& members) {
+  profiler::TraceMe activity("BroadcastWithinTask",
+                             profiler::TraceMeLevel::kInfo);
+  const int num_peers = static_cast<int>(members.size()) - 1;
+  if (num_peers == 0) return Status::OK();
+  BlockingCounter pending(num_peers);
+  mutex mu;
+  Status status;
+  for (int i = 1; i <= num_peers; ++i) {
+    const int peer = members[i];
+    col_ctx_->col_exec->PostToPeer(
+        col_params_->instance.device_names[peer],
+        col_params_->instance.task_names[peer], BufKey("down", peer),
+        col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
+        col_ctx_->op_ctx->output_alloc_attr(0), col_ctx_->output,
+        col_ctx_->device_locality,
+        [this, &pending, &mu, &status](const Status& s) {
+          if (!s.ok()) {
+            StartAbort(s);
+            mutex_lock l(mu);
+            status.Update(s);
+          }
+          pending.DecrementCount();
+        });
+  }
+  pending.Wait();
+  return status;
+}
+
+Status HierarchicalRingReducer::ExchangeWithLeader(int leader) {
+  const int rank = col_params_->default_rank;
+  const string& leader_device = col_params_->instance.device_names[leader];
+  const string& leader_task = col_params_->instance.task_names[leader];
+  Status status;
+  {
+    profiler::TraceMe activity("SendToLeader", profiler::TraceMeLevel::kInfo);
+    Notification note;
+    col_ctx_->col_exec->PostToPeer(
+        leader_device, leader_task, BufKey("up", rank), col_ctx_->device,
+        col_ctx_->op_ctx->op_device_context(),
+        col_ctx_->op_ctx->input_alloc_attr(0), col_ctx_->input,
+        col_ctx_->device_locality, [&note, &status](const Status& s) {
+          status = s;
+          note.Notify();
+        });
+    note.WaitForNotification();
+  }
+  if (!status.ok()) return status;
+  profiler::TraceMe activity("RecvFromLeader", profiler::TraceMeLevel::kInfo);
+  Notification note;
+  col_ctx_->col_exec->RecvFromPeer(
+      leader_device, leader_task, col_params_->task.is_local[leader],
+      BufKey("down", rank), col_ctx_->device,
+      col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->output_alloc_attr(0), col_ctx_->output,
+      col_ctx_->device_locality, 0 /*dev_to_dev_stream_index*/,
+      [&note, &status](const Status& s) {
+        status = s;
+        note.Notify();
+      });
+  note.WaitForNotification();
+  return status;
+}
+
+string HierarchicalRingReducer::BufKey(const string& direction,
+                                       int rank) const {
+  return strings::StrCat(col_ctx_->exec_key, ":", direction, ":", rank);
+}
+
+void HierarchicalRingReducer::StartAbort(const Status& s) {
+  {
+    mutex_lock l(status_mu_);
+    if (!status_.ok()) return;
+    LOG(ERROR) << "Aborting HierarchicalRingReduce with " << s;
+    status_ = s;
+  }
+  col_ctx_->col_exec->StartAbort(s);
+}
+
+namespace {
+REGISTER_COLLECTIVE(HierarchicalRingReduce, HierarchicalRingReducer);
+}  // namespace
+
+}  // namespace tensorflow
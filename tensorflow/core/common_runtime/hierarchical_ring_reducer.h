@@ -0,0 +1,106 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_RING_REDUCER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_RING_REDUCER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/common_runtime/ring_reducer.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+class Device;
+
+// Two level implementation of collective all-reduce for CPU devices.
+//
+// The devices of every task first reduce their values into the first device
+// of the task, its leader, through local memory copies.  The leaders then
+// all-reduce among themselves with a RingReducer, so that only one device
+// per task takes part in the transfers between tasks, and finally every
+// leader copies the result back to the other devices of its task.
+//
+// Selected for CPU reductions whose communication_hint is "hierarchical" and
+// whose group has more devices than tasks; with one device per task there is
+// nothing to reduce locally and the resolver picks RingReduce instead.
+class HierarchicalRingReducer : public CollectiveImplementationInterface {
+ public:
+  HierarchicalRingReducer();
+  ~HierarchicalRingReducer() override;
+
+  // Checks that the group is made of CPU devices.  The ring among the
+  // leaders is set up when the collective runs.
+  Status InitializeCollectiveParams(CollectiveParams* col_params) override;
+
+  // Initializes members of CollectiveContext not yet initialized, i.e. device
+  // and device_locality.  Also saves the CollectiveContext in this object,
+  // and on task leaders sets up the ring among the leaders.
+  Status InitializeCollectiveContext(
+      std::shared_ptr<CollectiveContext> col_ctx) override;
+
+  // No-op for hierarchical ring reduce.
+  Status InitializeCollectiveGroupRuntimeDetails(
+      CollGroupRuntimeDetails*) override {
+    return Status::OK();
+  }
+
+  // Begins async execution of the hierarchical reduction.
+  // Must be called in a blockable thread.
+  void Run(StatusCallback done) override;
+
+  // Returns the ranks of the devices that share the task of device `rank`,
+  // in rank order.  The first one is the leader of the task.
+  static std::vector<int> TaskMembers(const CollectiveParams& col_params,
+                                      int rank);
+
+  // Returns the ranks of the task leaders, in rank order.
+  static std::vector<int> TaskLeaders(const CollectiveParams& col_params);
+
+ private:
+  // Reduces the values of the other devices of the task into the output.
+  Status ReduceWithinTask(const std::vector<int>& members);
+  // Sets up leader_ring_ to all-reduce the output among the task leaders.
+  Status InitializeLeaderRing(const std::vector<int>& leaders);
+  // All-reduces the output among the task leaders.
+  Status ReduceAmongLeaders();
+  // Applies final_op to the fully reduced output.
+  Status Finalize();
+  // Sends the output to the other devices of the task.
+  Status BroadcastWithinTask(const std::vector<int>& members);
+  // Sends the input to the leader and receives the result from it.
+  Status ExchangeWithLeader(int leader);
+
+  string BufKey(const string& direction, int rank) const;
+  // Aborts the collective executor on the first error.
+  void StartAbort(const Status& s);
+
+  std::shared_ptr<CollectiveContext> col_ctx_;
+  const CollectiveParams* col_params_;  // Not owned
+  // Ranks of the devices of the task of this device, leader first.
+  std::vector<int> members_;
+  // On task leaders, when there are several tasks: the params and
+  // implementation of the ring among the leaders.
+  CollectiveParams leader_params_;
+  RingReducer* leader_ring_;
+  mutex status_mu_;
+  Status status_ TF_GUARDED_BY(status_mu_);
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_RING_REDUCER_H_
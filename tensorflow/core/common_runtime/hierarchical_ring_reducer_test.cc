@@ -0,0 +1,269 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_ring_reducer.h"
+
+#include <atomic>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/device_resolver_local.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/common_runtime/test_collective_executor_mgr.h"
+#include "tensorflow/core/common_runtime/threadpool_device.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/unbounded_work_queue.h"
+#include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+static int64 kStepId = 123;
+
+std::unique_ptr<OpKernel> GetKernel(const NodeDef& node, DeviceBase* device) {
+  Status status;
+  std::unique_ptr<OpKernel> k = CreateOpKernel(
+      DEVICE_CPU, device, device->GetAllocator(AllocatorAttributes()), node,
+      TF_GRAPH_DEF_VERSION, &status);
+  TF_CHECK_OK(status);
+  return k;
+}
+
+std::unique_ptr<OpKernel> GetBinOp(const string& op, DataType dtype,
+                                   DeviceBase* device) {
+  NodeDef node_def;
+  TF_CHECK_OK(NodeDefBuilder(strings::StrCat(op, "_node"), op)
+                  .Attr("T", dtype)
+                  .Input(FakeInput(dtype))
+                  .Input(FakeInput(dtype))
+                  .Finalize(&node_def));
+  return GetKernel(node_def, device);
+}
+
+string TaskName(int wi) {
+  return strings::StrCat("/job:worker/replica:0/task:", wi);
+}
+
+class HierarchicalRingReducerTest : public ::testing::Test {
+ protected:
+  ~HierarchicalRingReducerTest() override {
+    if (col_exec_) col_exec_->Unref();
+  }
+
+  // Sets up `num_workers` tasks of `num_devices` CPU devices each, all in
+  // this process.
+  void Init(int num_workers, int num_devices, DataType dtype, int tensor_len) {
+    std::vector<std::unique_ptr<Device>> local_devices;
+    SessionOptions sess_opts;
+    sess_opts.env = Env::Default();
+    Bytes mem_limit(4 << 20);
+    DeviceLocality dev_locality;
+    for (int wi = 0; wi < num_workers; ++wi) {
+      for (int di = 0; di < num_devices; ++di) {
+        local_devices.push_back(absl::make_unique<ThreadPoolDevice>(
+            sess_opts, strings::StrCat(TaskName(wi), "/cpu:", di), mem_limit,
+            dev_locality, cpu_allocator()));
+      }
+    }
+    dev_mgr_ = absl::make_unique<StaticDeviceMgr>(std::move(local_devices));
+    dev_resolver_ = absl::make_unique<DeviceResolverLocal>(dev_mgr_.get());
+    work_queue_ = std::make_shared<UnboundedWorkQueue>(Env::Default(), "test");
+    rma_ = new CollectiveRemoteAccessLocal(dev_mgr_.get(), dev_resolver_.get(),
+                                           work_queue_, kStepId);
+    col_exec_ = new BaseCollectiveExecutor(&col_exec_mgr_, rma_, kStepId,
+                                           dev_mgr_.get(), &gpu_ring_order_);
+    col_params_.name = "test_collective";
+    col_params_.group.group_key = 5;
+    col_params_.group.device_type = DEVICE_CPU;
+    col_params_.group.group_size = num_workers * num_devices;
+    col_params_.group.num_tasks = num_workers;
+    col_params_.instance.instance_key = 17;
+    col_params_.instance.type = REDUCTION_COLLECTIVE;
+    col_params_.instance.data_type = dtype;
+    col_params_.instance.shape = TensorShape({tensor_len});
+    col_params_.instance.impl_details.collective_name =
+        "HierarchicalRingReduce";
+    col_params_.instance.impl_details.subdiv_offsets = {0};
+    col_params_.instance.same_num_devices_per_task = true;
+    for (int wi = 0; wi < num_workers; ++wi) {
+      col_params_.instance.num_devices_per_task[TaskName(wi)] = num_devices;
+      for (int di = 0; di < num_devices; ++di) {
+        col_params_.instance.device_names.push_back(
+            strings::StrCat(TaskName(wi), "/cpu:", di));
+        col_params_.instance.task_names.push_back(TaskName(wi));
+        col_params_.task.is_local.push_back(true);
+      }
+    }
+  }
+
+  template <typename T>
+  void RunTest(DataType dtype, int num_workers, int num_devices,
+               int tensor_len) {
+    Init(num_workers, num_devices, dtype, tensor_len);
+    const int group_size = num_workers * num_devices;
+    std::vector<Tensor> tensors(group_size);
+    std::vector<Status> statuses(group_size);
+    std::vector<T> expected(tensor_len, 0);
+    for (int rank = 0; rank < group_size; ++rank) {
+      tensors[rank] = Tensor(dtype, TensorShape({tensor_len}));
+      for (int i = 0; i < tensor_len; ++i) {
+        const T value = static_cast<T>(rank * 10 + i);
+        tensors[rank].flat<T>()(i) = value;
+        expected[i] += value;
+      }
+    }
+    for (int i = 0; i < tensor_len; ++i) {
+      expected[i] /= static_cast<T>(group_size);
+    }
+    std::atomic<int> done(0);
+    for (int rank = 0; rank < group_size; ++rank) {
+      SchedClosure([this, rank, &tensors, &statuses, &done] {
+        statuses[rank] = DoReduce(rank, &tensors[rank]);
+        ++done;
+      });
+    }
+    while (done < group_size) {
+      Env::Default()->SleepForMicroseconds(1000);
+    }
+    for (int rank = 0; rank < group_size; ++rank) {
+      TF_EXPECT_OK(statuses[rank]);
+      for (int i = 0; i < tensor_len; ++i) {
+        EXPECT_EQ(expected[i], tensors[rank].flat<T>()(i))
+            << "Mismatch at device " << rank << " index " << i;
+      }
+    }
+  }
+
+  Status DoReduce(int rank, Tensor* tensor) {
+    Device* device = nullptr;
+    TF_CHECK_OK(dev_mgr_->LookupDevice(col_params_.instance.device_names[rank],
+                                       &device));
+    CollectiveParams col_params;
+    col_params.name = col_params_.name;
+    col_params.group = col_params_.group;
+    col_params.instance = col_params_.instance;
+    col_params.instance.impl_details.collective_name =
+        col_params_.instance.impl_details.collective_name;
+    col_params.task.is_local = col_params_.task.is_local;
+    col_params.default_rank = rank;
+    col_params.merge_op = GetBinOp("Add", tensor->dtype(), device);
+    col_params.final_op = GetBinOp("Div", tensor->dtype(), device);
+
+    // Prepare an OpKernelContext.
+    OpKernelContext::Params op_params;
+    op_params.step_id = kStepId;
+    op_params.device = device;
+    gtl::InlinedVector<TensorValue, 4> inputs;
+    inputs.push_back(TensorValue(tensor));
+    op_params.inputs = &inputs;
+    gtl::InlinedVector<AllocatorAttributes, 4> input_aa(
+        {AllocatorAttributes()});
+    op_params.input_alloc_attrs = &input_aa;
+    DeviceContext* dev_ctx = new DeviceContext;
+    core::ScopedUnref unref_dev_ctx(dev_ctx);
+    op_params.op_device_context = dev_ctx;
+    int forward_from = 0;
+    op_params.forward_from_array = &forward_from;
+    AllocatorAttributes generic_alloc_attr;
+    op_params.output_attr_array = &generic_alloc_attr;
+    std::unique_ptr<OpKernel> op = GetBinOp("Add", tensor->dtype(), device);
+    op_params.op_kernel = op.get();
+    OpKernelContext ctx(&op_params, 1);
+    Tensor* output = nullptr;
+    TF_CHECK_OK(ctx.forward_input_or_allocate_output({0}, 0, tensor->shape(),
+                                                     &output));
+
+    HierarchicalRingReducer* reducer = new HierarchicalRingReducer;
+    core::ScopedUnref unref(reducer);
+    TF_RETURN_IF_ERROR(reducer->InitializeCollectiveParams(&col_params));
+    auto col_ctx = std::make_shared<CollectiveContext>(
+        col_exec_, dev_mgr_.get(), &ctx, &op_params, col_params,
+        strings::StrCat(col_params.instance.instance_key, ":0:0"), kStepId,
+        tensor, output);
+    TF_RETURN_IF_ERROR(reducer->InitializeCollectiveContext(col_ctx));
+    Status status;
+    reducer->Run([&status](const Status& s) { status = s; });
+    if (status.ok() && output != tensor) {
+      CHECK(tensor->CopyFrom(*output, tensor->shape()));
+    }
+    return status;
+  }
+
+  TestCollectiveExecutorMgr col_exec_mgr_;
+  CollectiveExecutor* col_exec_ = nullptr;
+  CollectiveRemoteAccessLocal* rma_;
+  std::unique_ptr<DeviceResolverLocal> dev_resolver_;
+  std::shared_ptr<UnboundedWorkQueue> work_queue_;
+  std::unique_ptr<DeviceMgr> dev_mgr_;
+  string gpu_ring_order_;
+  CollectiveParams col_params_;
+};
+
+TEST_F(HierarchicalRingReducerTest, TaskMembersAndLeaders) {
+  Init(/*num_workers=*/3, /*num_devices=*/2, DT_FLOAT, /*tensor_len=*/8);
+  EXPECT_EQ(std::vector<int>({0, 1}),
+            HierarchicalRingReducer::TaskMembers(col_params_, 1));
+  EXPECT_EQ(std::vector<int>({4, 5}),
+            HierarchicalRingReducer::TaskMembers(col_params_, 4));
+  EXPECT_EQ(std::vector<int>({0, 2, 4}),
+            HierarchicalRingReducer::TaskLeaders(col_params_));
+}
+
+TEST_F(HierarchicalRingReducerTest, OnlyCPU) {
+  Init(/*num_workers=*/2, /*num_devices=*/2, DT_FLOAT, /*tensor_len=*/8);
+  col_params_.group.device_type = DEVICE_GPU;
+  HierarchicalRingReducer* reducer = new HierarchicalRingReducer;
+  core::ScopedUnref unref(reducer);
+  EXPECT_TRUE(errors::IsUnimplemented(
+      reducer->InitializeCollectiveParams(&col_params_)));
+}
+
+TEST_F(HierarchicalRingReducerTest, SingleTask) {
+  RunTest<float>(DT_FLOAT, /*num_workers=*/1, /*num_devices=*/4, 1001);
+}
+
+TEST_F(HierarchicalRingReducerTest, SingleDevicePerTask) {
+  RunTest<float>(DT_FLOAT, /*num_workers=*/3, /*num_devices=*/1, 1001);
+}
+
+TEST_F(HierarchicalRingReducerTest, MultipleTasksFloat) {
+  RunTest<float>(DT_FLOAT, /*num_workers=*/2, /*num_devices=*/4, 4096);
+}
+
+TEST_F(HierarchicalRingReducerTest, MultipleTasksDouble) {
+  RunTest<double>(DT_DOUBLE, /*num_workers=*/4, /*num_devices=*/2, 1001);
+}
+
+TEST_F(HierarchicalRingReducerTest, MultipleTasksInt) {
+  RunTest<int64>(DT_INT64, /*num_workers=*/3, /*num_devices=*/3, 4095);
+}
+
+TEST_F(HierarchicalRingReducerTest, SegmentedLeaderRing) {
+  col_params_.instance.impl_details.ring_segment_bytes = 1 << 10;
+  RunTest<float>(DT_FLOAT, /*num_workers=*/4, /*num_devices=*/2, 104599);
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,217 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/huge_page_allocator.h"
+
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mem.h"
+#include "tensorflow/core/platform/numa.h"
+
+namespace tensorflow {
+
+#if !defined(_MSC_VER) && defined(MAP_ANONYMOUS)
+#define TF_HUGE_PAGE_ALLOCATOR_USE_MMAP 1
+#endif
+
+namespace {
+// Page stride used to pre-fault regions. Touching every base page is
+// required when the kernel declines to use a huge page for part of a region.
+constexpr size_t kBasePageSize = 4096;
+
+void TouchPages(void* ptr, size_t num_bytes) {
+  volatile char* p = static_cast<char*>(ptr);
+  for (size_t offset = 0; offset < num_bytes; offset += kBasePageSize) {
+    p[offset] = 0;
+  }
+}
+
+#if defined(TF_HUGE_PAGE_ALLOCATOR_USE_MMAP) && defined(SYS_mbind)
+// Sets a preferred NUMA node for the pages of a mapping that has not been
+// touched yet. Calls the system call directly to avoid a libnuma dependency.
+void PreferNumaNode(void* ptr, size_t num_bytes, int numa_node) {
+  constexpr int kMpolPreferred = 1;
+  constexpr int kMaxNodes = 8 * sizeof(unsigned long);  // NOLINT(runtime/int)
+  if (numa_node < 0 || numa_node >= kMaxNodes) return;
+  const unsigned long node_mask = 1UL << numa_node;  // NOLINT(runtime/int)
+  if (syscall(SYS_mbind, ptr, num_bytes, kMpolPreferred, &node_mask,
+              kMaxNodes + 1, 0) != 0) {
+    VLOG(1) << "mbind to NUMA node " << numa_node << " failed for "
+            << num_bytes << " bytes";
+  }
+}
+#else
+void PreferNumaNode(void* ptr, size_t num_bytes, int numa_node) {}
+#endif
+}  // namespace
+
+constexpr size_t HugePageSubAllocator::kHugePageSize;
+
+HugePageSubAllocator::HugePageSubAllocator(
+    Mode mode, int numa_node, const std::vector<Visitor>& alloc_visitors,
+    const std::vector<Visitor>& free_visitors)
+    : SubAllocator(alloc_visitors, free_visitors),
+      mode_(mode),
+      numa_node_(numa_node) {}
+
+void* HugePageSubAllocator::Map(size_t num_bytes, bool* is_explicit) {
+  *is_explicit = false;
+#ifdef TF_HUGE_PAGE_ALLOCATOR_USE_MMAP
+#ifdef MAP_HUGETLB
+  if (mode_ == Mode::kExplicit) {
+    void* ptr = mmap(nullptr, num_bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (ptr != MAP_FAILED) {
+      *is_explicit = true;
+      return ptr;
+    }
+    static std::atomic<bool> logged{false};
+    if (!logged.exchange(true)) {
+      LOG(WARNING) << "Could not map " << num_bytes
+                   << " bytes of explicit huge pages; falling back to "
+                   << "transparent huge pages. Consider raising "
+                   << "/proc/sys/vm/nr_hugepages.";
+    }
+  }
+#endif  // MAP_HUGETLB
+  // Transparent huge pages are only used for 2MiB-aligned ranges, so map an
+  // extra huge page and trim the unaligned head and tail.
+  const size_t map_bytes = num_bytes + kHugePageSize;
+  void* raw = mmap(nullptr, map_bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) {
+    return nullptr;
+  }
+  const uintptr_t raw_int = reinterpret_cast<uintptr_t>(raw);
+  const uintptr_t aligned_int =
+      (raw_int + kHugePageSize - 1) & ~(uintptr_t{kHugePageSize} - 1);
+  const size_t head = aligned_int - raw_int;
+  const size_t tail = map_bytes - head - num_bytes;
+  if (head > 0) munmap(raw, head);
+  if (tail > 0) munmap(reinterpret_cast<char*>(aligned_int + num_bytes), tail);
+  void* ptr = reinterpret_cast<void*>(aligned_int);
+#ifdef MADV_HUGEPAGE
+  if (madvise(ptr, num_bytes, MADV_HUGEPAGE) != 0) {
+    VLOG(1) << "madvise(MADV_HUGEPAGE) failed for " << num_bytes << " bytes";
+  }
+#endif  // MADV_HUGEPAGE
+  return ptr;
+#else
+  if (numa_node_ != port::kNUMANoAffinity) {
+    return port::NUMAMalloc(numa_node_, num_bytes, kHugePageSize);
+  }
+  return port::AlignedMalloc(num_bytes, kHugePageSize);
+#endif  // TF_HUGE_PAGE_ALLOCATOR_USE_MMAP
+}
+
+void HugePageSubAllocator::Unmap(void* ptr, size_t num_bytes) {
+#ifdef TF_HUGE_PAGE_ALLOCATOR_USE_MMAP
+  if (munmap(ptr, num_bytes) != 0) {
+    LOG(ERROR) << "munmap of " << num_bytes << " bytes at " << ptr
+               << " failed";
+  }
+#else
+  if (numa_node_ != port::kNUMANoAffinity) {
+    port::NUMAFree(ptr, num_bytes);
+  } else {
+    port::AlignedFree(ptr);
+  }
+#endif  // TF_HUGE_PAGE_ALLOCATOR_USE_MMAP
+}
+
+void* HugePageSubAllocator::Alloc(size_t alignment, size_t num_bytes) {
+  if (num_bytes == 0) return nullptr;
+  DCHECK_LE(alignment, kHugePageSize);
+  const size_t mapped_bytes = RoundUpToHugePage(num_bytes);
+  bool is_explicit = false;
+  void* ptr = Map(mapped_bytes, &is_explicit);
+  if (ptr == nullptr) {
+    return nullptr;
+  }
+  if (numa_node_ != port::kNUMANoAffinity && !is_explicit) {
+    PreferNumaNode(ptr, mapped_bytes, numa_node_);
+  }
+  const int64 mapped =
+      bytes_mapped_.fetch_add(mapped_bytes, std::memory_order_relaxed) +
+      mapped_bytes;
+  int64 peak = peak_bytes_mapped_.load(std::memory_order_relaxed);
+  while (mapped > peak && !peak_bytes_mapped_.compare_exchange_weak(
+                              peak, mapped, std::memory_order_relaxed)) {
+  }
+  if (is_explicit) {
+    mutex_lock l(mu_);
+    explicit_regions_.insert(ptr);
+    bytes_mapped_explicit_ += mapped_bytes;
+  }
+  VisitAlloc(ptr, numa_node_, num_bytes);
+  return ptr;
+}
+
+void HugePageSubAllocator::Free(void* ptr, size_t num_bytes) {
+  if (ptr == nullptr || num_bytes == 0) return;
+  VisitFree(ptr, numa_node_, num_bytes);
+  const size_t mapped_bytes = RoundUpToHugePage(num_bytes);
+  {
+    mutex_lock l(mu_);
+    if (explicit_regions_.erase(ptr) > 0) {
+      bytes_mapped_explicit_ -= mapped_bytes;
+    }
+  }
+  bytes_mapped_.fetch_sub(mapped_bytes, std::memory_order_relaxed);
+  Unmap(ptr, mapped_bytes);
+}
+
+HugePageCPUAllocator::HugePageCPUAllocator(
+    HugePageSubAllocator* sub_allocator, size_t total_memory,
+    size_t prefault_bytes, const string& name)
+    : BFCAllocator(sub_allocator, total_memory, true /*allow_growth*/, name),
+      huge_page_sub_allocator_(sub_allocator) {
+  if (prefault_bytes > 0) {
+    // Grow the BFC pool to `prefault_bytes` in one region, fault it in and
+    // hand it back, leaving the pages resident for later allocations.
+    AllocationAttributes attr;
+    attr.no_retry_on_failure = true;
+    const size_t num_bytes = std::min(prefault_bytes, total_memory);
+    void* ptr = AllocateRaw(Allocator::kAllocatorAlignment, num_bytes, attr);
+    if (ptr == nullptr) {
+      LOG(WARNING) << "HugePageCPUAllocator " << name << " could not prefault "
+                   << prefault_bytes << " bytes";
+    } else {
+      TouchPages(ptr, num_bytes);
+      DeallocateRaw(ptr);
+    }
+  }
+}
+
+absl::optional<AllocatorStats> HugePageCPUAllocator::GetStats() {
+  absl::optional<AllocatorStats> stats = BFCAllocator::GetStats();
+  if (stats) {
+    stats->bytes_reserved = huge_page_sub_allocator_->bytes_mapped();
+    stats->peak_bytes_reserved = huge_page_sub_allocator_->peak_bytes_mapped();
+    stats->bytes_reservable_limit = stats->bytes_limit;
+  }
+  return stats;
+}
+
+}  // namespace tensorflow
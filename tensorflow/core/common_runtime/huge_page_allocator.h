@@ -0,0 +1,127 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_HUGE_PAGE_ALLOCATOR_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_HUGE_PAGE_ALLOCATOR_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/core/common_runtime/bfc_allocator.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A SubAllocator that maps CPU memory in 2MiB-aligned regions backed by huge
+// pages, to cut page faults and TLB misses on large, long-lived buffers.
+//
+// In kTransparent mode regions are anonymous mappings advised with
+// MADV_HUGEPAGE, so the kernel backs them with transparent huge pages when it
+// can. In kExplicit mode regions are mapped with MAP_HUGETLB from the
+// preallocated hugetlbfs pool; if that pool is exhausted the region falls
+// back to transparent huge pages.
+//
+// If `numa_node` is not port::kNUMANoAffinity, regions prefer pages of that
+// NUMA node.
+//
+// On platforms without mmap this degrades to port::NUMAMalloc.
+class HugePageSubAllocator : public SubAllocator {
+ public:
+  enum class Mode { kTransparent, kExplicit };
+
+  static constexpr size_t kHugePageSize = 2 << 20;
+
+  HugePageSubAllocator(Mode mode, int numa_node,
+                       const std::vector<Visitor>& alloc_visitors,
+                       const std::vector<Visitor>& free_visitors);
+  ~HugePageSubAllocator() override {}
+
+  void* Alloc(size_t alignment, size_t num_bytes) override;
+  void Free(void* ptr, size_t num_bytes) override;
+
+  // Number of bytes currently mapped, rounded up to whole huge pages.
+  int64 bytes_mapped() const {
+    return bytes_mapped_.load(std::memory_order_relaxed);
+  }
+  // High-water mark of bytes_mapped().
+  int64 peak_bytes_mapped() const {
+    return peak_bytes_mapped_.load(std::memory_order_relaxed);
+  }
+  // Number of bytes currently mapped from the explicit hugetlbfs pool.
+  int64 bytes_mapped_explicit() const {
+    mutex_lock l(mu_);
+    return bytes_mapped_explicit_;
+  }
+
+  // Returns `num_bytes` rounded up to a whole number of huge pages.
+  static size_t RoundUpToHugePage(size_t num_bytes) {
+    return (num_bytes + kHugePageSize - 1) & ~(kHugePageSize - 1);
+  }
+
+ private:
+  // Maps `num_bytes` (a multiple of kHugePageSize) aligned to kHugePageSize.
+  // Sets `*is_explicit` if the mapping came from the hugetlbfs pool.
+  void* Map(size_t num_bytes, bool* is_explicit);
+  void Unmap(void* ptr, size_t num_bytes);
+
+  const Mode mode_;
+  const int numa_node_;
+  std::atomic<int64> bytes_mapped_{0};
+  std::atomic<int64> peak_bytes_mapped_{0};
+
+  // Regions come and go at BFC region granularity, so a mutex is cheap here.
+  mutable mutex mu_;
+  absl::flat_hash_set<void*> explicit_regions_ TF_GUARDED_BY(mu_);
+  int64 bytes_mapped_explicit_ TF_GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(HugePageSubAllocator);
+};
+
+// A BFCAllocator over a HugePageSubAllocator for CPU memory.
+//
+// `prefault_bytes` of memory are allocated as the first region, faulted in
+// and released back to the BFC pool at construction, so that the working set
+// of the first steps does not pay for page faults. Later regions are faulted
+// in on first use.
+//
+// GetStats() reports the memory mapped by the sub-allocator as
+// `bytes_reserved` / `peak_bytes_reserved`, and `bytes_reservable_limit` as
+// the memory limit.
+class HugePageCPUAllocator : public BFCAllocator {
+ public:
+  // Takes ownership of `sub_allocator`.
+  HugePageCPUAllocator(HugePageSubAllocator* sub_allocator,
+                       size_t total_memory, size_t prefault_bytes,
+                       const string& name);
+  ~HugePageCPUAllocator() override {}
+
+  absl::optional<AllocatorStats> GetStats() override;
+
+ private:
+  // Owned by the BFCAllocator base.
+  HugePageSubAllocator* huge_page_sub_allocator_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(HugePageCPUAllocator);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_HUGE_PAGE_ALLOCATOR_H_
@@ -0,0 +1,105 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/huge_page_allocator.h"
+
+#include <cstring>
+
+#include "tensorflow/core/platform/numa.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr size_t kHugePage = HugePageSubAllocator::kHugePageSize;
+
+TEST(HugePageSubAllocatorTest, AlignedAndAccounted) {
+  HugePageSubAllocator sub(HugePageSubAllocator::Mode::kTransparent,
+                           port::kNUMANoAffinity, {}, {});
+  void* p = sub.Alloc(64, 3 << 20);
+  ASSERT_NE(nullptr, p);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(p) % kHugePage);
+  EXPECT_EQ(2 * kHugePage, sub.bytes_mapped());
+  memset(p, 1, 3 << 20);
+  sub.Free(p, 3 << 20);
+  EXPECT_EQ(0, sub.bytes_mapped());
+  EXPECT_EQ(2 * kHugePage, sub.peak_bytes_mapped());
+}
+
+TEST(HugePageSubAllocatorTest, ExplicitFallsBackToTransparent) {
+  // Whether or not the machine has a hugetlbfs pool, allocation succeeds.
+  HugePageSubAllocator sub(HugePageSubAllocator::Mode::kExplicit,
+                           port::kNUMANoAffinity, {}, {});
+  void* p = sub.Alloc(64, kHugePage);
+  ASSERT_NE(nullptr, p);
+  EXPECT_LE(sub.bytes_mapped_explicit(), sub.bytes_mapped());
+  static_cast<char*>(p)[kHugePage - 1] = 1;
+  sub.Free(p, kHugePage);
+  EXPECT_EQ(0, sub.bytes_mapped());
+  EXPECT_EQ(0, sub.bytes_mapped_explicit());
+}
+
+TEST(HugePageSubAllocatorTest, VisitorsSeeNumaNode) {
+  int alloc_visits = 0;
+  int free_visits = 0;
+  HugePageSubAllocator sub(
+      HugePageSubAllocator::Mode::kTransparent, 0 /*numa_node*/,
+      {[&alloc_visits](void*, int numa_node, size_t) {
+        EXPECT_EQ(0, numa_node);
+        ++alloc_visits;
+      }},
+      {[&free_visits](void*, int numa_node, size_t) {
+        EXPECT_EQ(0, numa_node);
+        ++free_visits;
+      }});
+  void* p = sub.Alloc(64, 1024);
+  ASSERT_NE(nullptr, p);
+  static_cast<char*>(p)[0] = 1;
+  sub.Free(p, 1024);
+  EXPECT_EQ(1, alloc_visits);
+  EXPECT_EQ(1, free_visits);
+}
+
+TEST(HugePageCPUAllocatorTest, PrefaultAndStats) {
+  int alloc_visits = 0;
+  HugePageCPUAllocator a(
+      new HugePageSubAllocator(
+          HugePageSubAllocator::Mode::kTransparent, port::kNUMANoAffinity,
+          {[&alloc_visits](void*, int, size_t) { ++alloc_visits; }}, {}),
+      1LL << 30 /*total_memory*/, 16 << 20 /*prefault_bytes*/, "huge");
+  // Only the prefaulted region is mapped.
+  EXPECT_EQ(1, alloc_visits);
+  absl::optional<AllocatorStats> stats = a.GetStats();
+  ASSERT_TRUE(stats);
+  // The prefaulted region is mapped but not in use.
+  EXPECT_GE(stats->bytes_reserved, 16 << 20);
+  EXPECT_EQ(0, stats->bytes_reserved % kHugePage);
+  EXPECT_EQ(0, stats->bytes_in_use);
+  EXPECT_EQ(1LL << 30, *stats->bytes_reservable_limit);
+
+  // Allocations within the prefaulted region do not map more memory.
+  const int64 reserved = stats->bytes_reserved;
+  void* p = a.AllocateRaw(64, 8 << 20);
+  ASSERT_NE(nullptr, p);
+  memset(p, 0, 8 << 20);
+  stats = a.GetStats();
+  EXPECT_EQ(reserved, stats->bytes_reserved);
+  EXPECT_EQ(8 << 20, stats->bytes_in_use);
+  EXPECT_EQ(1, alloc_visits);
+  a.DeallocateRaw(p);
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -21,11 +21,14 @@ limitations under the License.
 
 #include "absl/base/call_once.h"
 #include "tensorflow/core/common_runtime/bfc_allocator.h"
+#include "tensorflow/core/common_runtime/huge_page_allocator.h"
 #include "tensorflow/core/common_runtime/pool_allocator.h"
+#include "tensorflow/core/common_runtime/size_class_caching_allocator.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/log_memory.h"
 #include "tensorflow/core/framework/tracking_allocator.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
@@ -82,14 +85,57 @@ Allocator* ProcessState::GetCPUAllocator(int numa_node) {
     if (!status.ok()) {
       LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
     }
+    // TF_CPU_ALLOCATOR_HUGE_PAGES selects a BFCAllocator over memory backed
+    // by "transparent" or "explicit" (hugetlbfs) huge pages.
+    string huge_pages_mode;
+    status = ReadStringFromEnvVar("TF_CPU_ALLOCATOR_HUGE_PAGES", "",
+                                  &huge_pages_mode);
+    if (!status.ok()) {
+      LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
+    }
+    const bool use_huge_pages =
+        huge_pages_mode == "transparent" || huge_pages_mode == "explicit";
+    if (!huge_pages_mode.empty() && !use_huge_pages) {
+      LOG(ERROR) << "GetCPUAllocator: unknown TF_CPU_ALLOCATOR_HUGE_PAGES "
+                 << "value \"" << huge_pages_mode
+                 << "\"; expected \"transparent\" or \"explicit\"";
+    }
     Allocator* allocator = nullptr;
     SubAllocator* sub_allocator =
-        (numa_enabled_ || alloc_visitors_defined || use_bfc_allocator)
+        !use_huge_pages &&
+                (numa_enabled_ || alloc_visitors_defined || use_bfc_allocator)
             ? new BasicCPUAllocator(
                   numa_enabled_ ? numa_node : port::kNUMANoAffinity,
                   cpu_alloc_visitors_, cpu_free_visitors_)
             : nullptr;
-    if (use_bfc_allocator) {
+    if (use_huge_pages) {
+      int64 cpu_mem_limit_in_mb = -1;
+      Status status = ReadInt64FromEnvVar("TF_CPU_BFC_MEM_LIMIT_IN_MB",
+                                          1LL << 16 /*64GB max by default*/,
+                                          &cpu_mem_limit_in_mb);
+      if (!status.ok()) {
+        LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
+      }
+      int64 prefault_mb = 0;
+      status = ReadInt64FromEnvVar("TF_CPU_HUGE_PAGES_PREFAULT_IN_MB", 0,
+                                   &prefault_mb);
+      if (!status.ok()) {
+        LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
+      }
+      HugePageSubAllocator* huge_page_sub_allocator = new HugePageSubAllocator(
+          huge_pages_mode == "explicit"
+              ? HugePageSubAllocator::Mode::kExplicit
+              : HugePageSubAllocator::Mode::kTransparent,
+          numa_enabled_ ? numa_node : port::kNUMANoAffinity,
+          cpu_alloc_visitors_, cpu_free_visitors_);
+      sub_allocator = huge_page_sub_allocator;
+      allocator = new HugePageCPUAllocator(
+          huge_page_sub_allocator, cpu_mem_limit_in_mb * (1LL << 20),
+          prefault_mb * (1LL << 20), "huge_page_cpu_allocator" /*name*/);
+      VLOG(2) << "Using HugePageCPUAllocator (" << huge_pages_mode
+              << ") with memory limit of " << cpu_mem_limit_in_mb
+              << " MB for ProcessState CPU allocator";
+    } else if (use_bfc_allocator) {
       // TODO(reedwm): evaluate whether 64GB by default is the best choice.
       int64 cpu_mem_limit_in_mb = -1;
       Status status = ReadInt64FromEnvVar("TF_CPU_BFC_MEM_LIMIT_IN_MB",
@@ -105,6 +151,22 @@ Allocator* ProcessState::GetCPUAllocator(int numa_node) {
                            "bfc_cpu_allocator_for_gpu" /*name*/);
       VLOG(2) << "Using BFCAllocator with memory limit of "
               << cpu_mem_limit_in_mb << " MB for ProcessState CPU allocator";
+      // Optionally put per-thread caches of small and medium sized buffers in
+      // front of the BFCAllocator to keep its lock off the common path.
+      int64 size_class_cache_max_bytes = 0;
+      status = ReadInt64FromEnvVar("TF_CPU_BFC_SIZE_CLASS_CACHE_MAX_BYTES", 0,
+                                   &size_class_cache_max_bytes);
+      if (!status.ok()) {
+        LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
+      }
+      if (size_class_cache_max_bytes > 0) {
+        allocator = new SizeClassCachingAllocator(
+            allocator, size_class_cache_max_bytes,
+            64 * size_class_cache_max_bytes /*max_bytes_per_shard*/,
+            port::MaxParallelism() /*num_shards*/);
+        VLOG(2) << "Using SizeClassCachingAllocator for allocations up to "
+                << size_class_cache_max_bytes << " bytes";
+      }
     } else if (sub_allocator) {
       DCHECK(sub_allocator);
       allocator =
@@ -103,7 +103,8 @@ RingAlg::RingAlg(CollectiveType type, const string& name)
       col_params_(nullptr),
       done_(nullptr),
       group_size_(-1),
-      num_subdivs_(-1) {}
+      num_subdivs_(-1),
+      num_segments_(1) {}
 
 namespace {
 Status GenerateSubdivsInCollectiveParams(CollectiveParams* col_params) {
@@ -310,11 +311,15 @@ void RingAlg::InitRingField(RingField* rf, int chunk_idx, int subdiv_idx,
   // chunk is the unit of data transferred in a time step.  However, if
   // a device can simultaneously send data by 2 or more independent
   // channels we can speed up the transfer by subdividing chunks and
-  // processing multiple subdivisions at once.  So the actual number
-  // of RingFields is group_size_ * num_subdivs_.
-  DCHECK_EQ(field_idx, (chunk_idx * num_subdivs_) + subdiv_idx);
+  // processing multiple subdivisions at once.  Each subdivision may be
+  // further split into num_segments_ segments that move around the ring
+  // independently, which pipelines the transfer of a subdivision with its
+  // reduction.  So the actual number of RingFields is
+  // group_size_ * num_subdivs_ * num_segments_.
+  DCHECK_EQ(field_idx / num_segments_, (chunk_idx * num_subdivs_) + subdiv_idx);
   rf->chunk_idx = chunk_idx;
   rf->subdiv_idx = subdiv_idx;
+  rf->segment_idx = field_idx % num_segments_;
   rf->sc_idx = field_idx;
   rf->rank = col_params_->subdiv_rank[subdiv_idx];
   rf->second_pass = false;
@@ -365,8 +370,8 @@ void RingAlg::AdvanceToSecondPass(RingField* rf) {
 
 string RingAlg::RingField::DebugString() const {
   string rv = strings::StrCat("RingField rank=", rank, " chunk_idx=", chunk_idx,
-                              " subdiv=", subdiv_idx, " sc_idx=", sc_idx,
-                              " action=", action);
+                              " subdiv=", subdiv_idx, " segment=", segment_idx,
+                              " sc_idx=", sc_idx, " action=", action);
   strings::StrAppend(&rv, " pass=", second_pass);
   strings::StrAppend(&rv, " do_send=", do_send, " do_recv=", do_recv,
                      " is_final=", is_final, " recv_is_remote=", recv_is_remote,
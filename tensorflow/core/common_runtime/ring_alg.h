@@ -69,6 +69,7 @@ class RingAlg : public CollectiveImplementationInterface {
   struct RingField {
     int16 chunk_idx;     // major division index
     int16 subdiv_idx;    // minor division index
+    int16 segment_idx;   // pipelining segment within the subdivision
     int16 sc_idx;        // subchunk index
     int16 rank;          // rank within subdiv permutation
     int16 recv_dev_idx;  // dev from which value should be recv'd
@@ -114,6 +115,10 @@ class RingAlg : public CollectiveImplementationInterface {
   StatusCallback done_;
   int group_size_;
   int num_subdivs_;
+  // Number of segments each subdivision of a chunk is split into.  Segments
+  // are transferred and reduced independently so that a device can forward
+  // the first segments of a field while the later ones are still in flight.
+  int num_segments_;
   Tensor group_size_tensor_;
   Notification group_size_tensor_ready_;
   std::unique_ptr<CollectiveAdapter> ca_;
@@ -16,6 +16,7 @@ limitations under the License.
 
 #include <stdlib.h>
 
+#include <algorithm>
 #include <atomic>
 #include <functional>
 #include <utility>
@@ -42,6 +43,28 @@ limitations under the License.
 #include "tensorflow/core/profiler/lib/traceme.h"
 
 namespace tensorflow {
+namespace {
+// Upper bound on the number of segments a ring field is split into, which
+// bounds the number of transfers in flight between two neighbors.
+constexpr int64 kMaxSegmentsPerField = 64;
+// RingField indices are int16.
+constexpr int64 kMaxRingFields = 32767;
+
+// Returns the number of segments each of the `num_fields` ring fields of
+// `tensor` is split into so that no segment exceeds `segment_bytes`.
+int NumRingSegments(const Tensor& tensor, int num_fields,
+                    int64 segment_bytes) {
+  if (segment_bytes <= 0 || num_fields <= 0) return 1;
+  const int64 field_bytes =
+      (static_cast<int64>(tensor.TotalBytes()) + num_fields - 1) / num_fields;
+  int64 num_segments = (field_bytes + segment_bytes - 1) / segment_bytes;
+  // Segments without any element would only add empty transfers.
+  num_segments = std::min(num_segments, tensor.NumElements() / num_fields);
+  num_segments = std::min(num_segments, kMaxSegmentsPerField);
+  num_segments = std::min(num_segments, kMaxRingFields / num_fields);
+  return static_cast<int>(std::max<int64>(num_segments, 1));
+}
+}  // namespace
 
 RingReducer::~RingReducer() { group_size_tensor_ready_.WaitForNotification(); }
 
@@ -64,6 +87,9 @@ void RingReducer::Run(StatusCallback done) {
   num_subdivs_ = static_cast<int>(
       col_params_->instance.impl_details.subdiv_permutations.size());
   CHECK_GT(num_subdivs_, 0);
+  num_segments_ = NumRingSegments(
+      *col_ctx_->output, group_size_ * num_subdivs_,
+      col_params_->instance.impl_details.ring_segment_bytes);
 
   if (VLOG_IS_ON(1)) {
     string buf;
@@ -81,7 +107,8 @@ void RingReducer::Run(StatusCallback done) {
       }
     }
     VLOG(1) << "RingReducer::Run for device " << col_ctx_->device_name
-            << " default_rank " << col_params_->default_rank << "\n"
+            << " default_rank " << col_params_->default_rank
+            << " num_segments " << num_segments_ << "\n"
             << buf;
   }
 
@@ -117,8 +144,9 @@ void RingReducer::Run(StatusCallback done) {
 // which cannot be blocked.
 void RingReducer::ContinueAfterInputCopy() {
   AllocatorAttributes attr = col_ctx_->op_ctx->output_alloc_attr(0);
-  ca_.reset(MakeCollectiveAdapter(col_ctx_->output, group_size_ * num_subdivs_,
-                                  col_ctx_->device->GetAllocator(attr)));
+  ca_.reset(MakeCollectiveAdapter(
+      col_ctx_->output, group_size_ * num_subdivs_ * num_segments_,
+      col_ctx_->device->GetAllocator(attr)));
 
   if (col_params_->final_op) {
     // Create an on-device scalar value from group_size_ that may be needed
@@ -178,13 +206,20 @@ bool RingReducer::RunAsyncParts() {
   // complete. Hence function local variables are accessible only by that
   // one thread and do not require an explicit mutex.
   rfv_.clear();
-  rfv_.resize(group_size_ * num_subdivs_);
+  rfv_.resize(group_size_ * num_subdivs_ * num_segments_);
   PCQueue ready_queue;
-  for (int chunk_idx = 0; chunk_idx < group_size_; ++chunk_idx) {
-    for (int subdiv_idx = 0; subdiv_idx < num_subdivs_; ++subdiv_idx) {
-      int rf_index = (chunk_idx * num_subdivs_) + subdiv_idx;
-      InitRingField(&rfv_[rf_index], chunk_idx, subdiv_idx, rf_index);
-      ready_queue.Enqueue(&rfv_[rf_index]);
+  // Queue the first segment of every field before the second one and so
+  // on, so that the neighbors receive the beginning of every field early
+  // and can start reducing and forwarding it while the rest is in flight.
+  for (int segment_idx = 0; segment_idx < num_segments_; ++segment_idx) {
+    for (int chunk_idx = 0; chunk_idx < group_size_; ++chunk_idx) {
+      for (int subdiv_idx = 0; subdiv_idx < num_subdivs_; ++subdiv_idx) {
+        int rf_index =
+            ((chunk_idx * num_subdivs_) + subdiv_idx) * num_segments_ +
+            segment_idx;
+        InitRingField(&rfv_[rf_index], chunk_idx, subdiv_idx, rf_index);
+        ready_queue.Enqueue(&rfv_[rf_index]);
+      }
     }
   }
   const DeviceBase::GpuDeviceInfo* gpu_info =
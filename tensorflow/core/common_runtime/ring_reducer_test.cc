@@ -209,6 +209,7 @@ class RingReducerTest : public ::testing::Test {
     col_params_.instance.impl_details.subdiv_offsets.clear();
     col_params_.instance.type = REDUCTION_COLLECTIVE;
     col_params_.instance.impl_details.collective_name = "RingReduce";
+    col_params_.instance.impl_details.ring_segment_bytes = ring_segment_bytes_;
     col_params_.instance.data_type = dtype;
     col_params_.instance.impl_details.subdiv_permutations.resize(num_subdivs);
     col_params_.subdiv_rank.resize(num_subdivs);
@@ -538,6 +539,7 @@ class RingReducerTest : public ::testing::Test {
   };
 
   bool stop_ = false;
+  int64 ring_segment_bytes_ = 0;
   DeviceType device_type_;
   TestCollectiveExecutorMgr col_exec_mgr_;
   CollectiveExecutor* col_exec_;
@@ -702,6 +704,28 @@ DEF_TEST(INT64, CPU, 2, 8, 3, 4095, 0)
 DEF_TEST(FLOAT, CPU, 2, 8, 1, 9408, 1)
 DEF_TEST(FLOAT, CPU, 2, 8, 1, 9408, 7)
 DEF_TEST(FLOAT, CPU, 2, 8, 2, 9408, 11)
+
+TEST_F(RingReducerTest, PipelinedSegments) {
+  // Each of the 8 fields holds ~510KiB, which is split into 32 segments.
+  ring_segment_bytes_ = 16 << 10;
+  RunTest<float>(DT_FLOAT, DEVICE_CPU, 2, 4, 1, 1045991, 0);
+}
+
+TEST_F(RingReducerTest, PipelinedSegmentsWithSubdivs) {
+  ring_segment_bytes_ = 4 << 10;
+  RunTest<double>(DT_DOUBLE, DEVICE_CPU, 2, 8, 3, 104599, 0);
+}
+
+TEST_F(RingReducerTest, PipelinedSegmentsSmallerThanAnElement) {
+  // The number of segments per field is capped.
+  ring_segment_bytes_ = 1;
+  RunTest<int64>(DT_INT64, DEVICE_CPU, 1, 2, 1, 1001, 0);
+}
+
+TEST_F(RingReducerTest, PipelinedSegmentsFailure) {
+  ring_segment_bytes_ = 1 << 10;
+  RunTest<float>(DT_FLOAT, DEVICE_CPU, 2, 8, 1, 94080, 9);
+}
 #endif
 
 #if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
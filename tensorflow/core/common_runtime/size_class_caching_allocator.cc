@@ -0,0 +1,247 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/size_class_caching_allocator.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>  // NOLINT(build/c++11)
+
+#include "tensorflow/core/lib/core/bits.h"
+#include "tensorflow/core/platform/hash.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+namespace {
+// The smallest size class. Matches the BFCAllocator minimum allocation size.
+constexpr size_t kMinClassBytes = 256;
+constexpr int kMinClassBits = 8;
+}  // namespace
+
+// static
+int SizeClassCachingAllocator::SizeClassForBytes(size_t num_bytes,
+                                                 size_t* class_bytes) {
+  if (num_bytes <= kMinClassBytes) {
+    *class_bytes = kMinClassBytes;
+    return 0;
+  }
+  // Classes are spaced four per power of two: for 2^lg < n <= 2^(lg+1) the
+  // candidate sizes are 2^lg + {1, 2, 3, 4} * 2^(lg-2).
+  const int lg = Log2Floor64(num_bytes - 1);
+  const size_t step = size_t{1} << (lg - 2);
+  const size_t sub = ((num_bytes - 1) >> (lg - 2)) & 3;
+  *class_bytes = (size_t{1} << lg) + (sub + 1) * step;
+  return 1 + (lg - kMinClassBits) * 4 + static_cast<int>(sub);
+}
+
+SizeClassCachingAllocator::SizeClassCachingAllocator(
+    Allocator* allocator, size_t max_cached_bytes, size_t max_bytes_per_shard,
+    int num_shards)
+    : allocator_(allocator),
+      max_cached_bytes_(std::max(max_cached_bytes, kMinClassBytes)),
+      max_bytes_per_shard_(max_bytes_per_shard),
+      num_size_classes_([max_cached_bytes]() {
+        size_t unused;
+        return SizeClassForBytes(std::max(max_cached_bytes, kMinClassBytes),
+                                 &unused) +
+               1;
+      }()),
+      num_cache_shards_(std::max(num_shards, 1)),
+      num_ptr_shards_(std::max(num_shards, 1)) {
+  CHECK(allocator_ != nullptr);
+  class_bytes_.resize(num_size_classes_);
+  for (size_t n = kMinClassBytes; n <= max_cached_bytes_;) {
+    size_t bytes;
+    class_bytes_[SizeClassForBytes(n, &bytes)] = bytes;
+    n = bytes + 1;
+  }
+  cache_shards_.reset(new CacheShard[num_cache_shards_]);
+  for (int i = 0; i < num_cache_shards_; ++i) {
+    mutex_lock l(cache_shards_[i].mu);
+    cache_shards_[i].free_lists.resize(num_size_classes_);
+  }
+  ptr_shards_.reset(new PtrShard[num_ptr_shards_]);
+  VLOG(1) << "SizeClassCachingAllocator for " << allocator_->Name()
+          << ": max_cached_bytes=" << max_cached_bytes_
+          << " max_bytes_per_shard=" << max_bytes_per_shard_
+          << " num_shards=" << num_cache_shards_
+          << " num_size_classes=" << num_size_classes_;
+}
+
+SizeClassCachingAllocator::~SizeClassCachingAllocator() { FlushCaches(); }
+
+SizeClassCachingAllocator::CacheShard*
+SizeClassCachingAllocator::ShardForCurrentThread() {
+  const size_t h = std::hash<std::thread::id>()(std::this_thread::get_id());
+  return &cache_shards_[Hash64Combine(h, 0) % num_cache_shards_];
+}
+
+SizeClassCachingAllocator::PtrShard* SizeClassCachingAllocator::ShardForPtr(
+    const void* ptr) const {
+  // Buffers are at least 256-byte aligned, so drop the low bits before
+  // hashing.
+  const uint64 p = reinterpret_cast<uintptr_t>(ptr) >> kMinClassBits;
+  return &ptr_shards_[Hash64Combine(p, 0) % num_ptr_shards_];
+}
+
+void* SizeClassCachingAllocator::AllocateFromWrapped(
+    size_t alignment, size_t num_bytes,
+    const AllocationAttributes& allocation_attr) {
+  if (cached_bytes() == 0) {
+    return allocator_->AllocateRaw(alignment, num_bytes, allocation_attr);
+  }
+  AllocationAttributes no_retry_attr(
+      /*no_retry_on_failure=*/true, allocation_attr.allocation_will_be_logged,
+      allocation_attr.freed_by_func);
+  void* ptr = allocator_->AllocateRaw(alignment, num_bytes, no_retry_attr);
+  if (ptr != nullptr) {
+    return ptr;
+  }
+  // Memory pressure: hand everything cached back and try again.
+  VLOG(1) << "SizeClassCachingAllocator for " << allocator_->Name()
+          << " flushing " << cached_bytes() << " cached bytes";
+  FlushCaches();
+  return allocator_->AllocateRaw(alignment, num_bytes, allocation_attr);
+}
+
+void* SizeClassCachingAllocator::AllocateRaw(
+    size_t alignment, size_t num_bytes,
+    const AllocationAttributes& allocation_attr) {
+  if (num_bytes == 0 || num_bytes > max_cached_bytes_ ||
+      alignment > Allocator::kAllocatorAlignment) {
+    return AllocateFromWrapped(alignment, num_bytes, allocation_attr);
+  }
+  size_t class_bytes;
+  const int size_class = SizeClassForBytes(num_bytes, &class_bytes);
+  DCHECK_LT(size_class, num_size_classes_);
+
+  void* ptr = nullptr;
+  CacheShard* shard = ShardForCurrentThread();
+  {
+    mutex_lock l(shard->mu);
+    std::vector<void*>& free_list = shard->free_lists[size_class];
+    if (!free_list.empty()) {
+      ptr = free_list.back();
+      free_list.pop_back();
+      shard->bytes -= class_bytes;
+    }
+  }
+  if (ptr != nullptr) {
+    cached_bytes_.fetch_sub(class_bytes, std::memory_order_relaxed);
+    cache_hits_.fetch_add(1, std::memory_order_relaxed);
+    PtrShard* ptr_shard = ShardForPtr(ptr);
+    mutex_lock l(ptr_shard->mu);
+    ptr_shard->buffers[ptr].requested_bytes = num_bytes;
+    return ptr;
+  }
+
+  cache_misses_.fetch_add(1, std::memory_order_relaxed);
+  ptr = AllocateFromWrapped(Allocator::kAllocatorAlignment, class_bytes,
+                            allocation_attr);
+  if (ptr != nullptr) {
+    PtrShard* ptr_shard = ShardForPtr(ptr);
+    mutex_lock l(ptr_shard->mu);
+    ptr_shard->buffers[ptr] = {size_class, num_bytes};
+  }
+  return ptr;
+}
+
+void SizeClassCachingAllocator::DeallocateRaw(void* ptr) {
+  if (ptr == nullptr) return;
+  int size_class = -1;
+  {
+    PtrShard* ptr_shard = ShardForPtr(ptr);
+    mutex_lock l(ptr_shard->mu);
+    auto it = ptr_shard->buffers.find(ptr);
+    if (it != ptr_shard->buffers.end()) {
+      size_class = it->second.size_class;
+    }
+  }
+  if (size_class < 0) {
+    allocator_->DeallocateRaw(ptr);
+    return;
+  }
+
+  const size_t class_bytes = class_bytes_[size_class];
+  CacheShard* shard = ShardForCurrentThread();
+  {
+    mutex_lock l(shard->mu);
+    if (shard->bytes + class_bytes <= max_bytes_per_shard_) {
+      shard->free_lists[size_class].push_back(ptr);
+      shard->bytes += class_bytes;
+      cached_bytes_.fetch_add(class_bytes, std::memory_order_relaxed);
+      return;
+    }
+  }
+  // The shard is full: release the buffer to the wrapped allocator.
+  {
+    PtrShard* ptr_shard = ShardForPtr(ptr);
+    mutex_lock l(ptr_shard->mu);
+    ptr_shard->buffers.erase(ptr);
+  }
+  allocator_->DeallocateRaw(ptr);
+}
+
+size_t SizeClassCachingAllocator::RequestedSize(const void* ptr) const {
+  {
+    PtrShard* ptr_shard = ShardForPtr(ptr);
+    mutex_lock l(ptr_shard->mu);
+    auto it = ptr_shard->buffers.find(ptr);
+    if (it != ptr_shard->buffers.end()) {
+      return it->second.requested_bytes;
+    }
+  }
+  return allocator_->RequestedSize(ptr);
+}
+
+void SizeClassCachingAllocator::FlushShard(CacheShard* shard) {
+  std::vector<void*> to_free;
+  {
+    mutex_lock l(shard->mu);
+    for (std::vector<void*>& free_list : shard->free_lists) {
+      to_free.insert(to_free.end(), free_list.begin(), free_list.end());
+      free_list.clear();
+    }
+    cached_bytes_.fetch_sub(shard->bytes, std::memory_order_relaxed);
+    shard->bytes = 0;
+  }
+  for (void* ptr : to_free) {
+    {
+      PtrShard* ptr_shard = ShardForPtr(ptr);
+      mutex_lock l(ptr_shard->mu);
+      ptr_shard->buffers.erase(ptr);
+    }
+    allocator_->DeallocateRaw(ptr);
+  }
+}
+
+void SizeClassCachingAllocator::FlushCaches() {
+  for (int i = 0; i < num_cache_shards_; ++i) {
+    FlushShard(&cache_shards_[i]);
+  }
+}
+
+absl::optional<AllocatorStats> SizeClassCachingAllocator::GetStats() {
+  absl::optional<AllocatorStats> stats = allocator_->GetStats();
+  if (!stats) return stats;
+  // Cached buffers are allocated from the point of view of the wrapped
+  // allocator but are available for reuse.
+  const int64 cached = static_cast<int64>(cached_bytes());
+  stats->bytes_in_use = std::max<int64>(0, stats->bytes_in_use - cached);
+  return stats;
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,166 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_SIZE_CLASS_CACHING_ALLOCATOR_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_SIZE_CLASS_CACHING_ALLOCATOR_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// An Allocator that keeps recently freed small and medium sized buffers in
+// per-thread-sharded caches in front of another (typically BFC) Allocator.
+//
+// Requests up to `max_cached_bytes` are rounded up to one of a small set of
+// size classes (four per power of two) and served from the cache shard of the
+// calling thread when possible, so the common allocate/free cycle of
+// short-lived tensors never takes the wrapped allocator's global lock.
+// Larger requests go straight to the wrapped allocator.
+//
+// Each cache shard holds at most `max_bytes_per_shard` bytes. When the wrapped
+// allocator cannot satisfy a request, all shards are flushed back to it and
+// the request is retried, so cached buffers never cause an OOM that the
+// wrapped allocator alone would not have hit.
+//
+// Memory sitting in a cache is reported as free in GetStats().
+class SizeClassCachingAllocator : public Allocator {
+ public:
+  // Takes ownership of `allocator`.
+  SizeClassCachingAllocator(Allocator* allocator, size_t max_cached_bytes,
+                            size_t max_bytes_per_shard, int num_shards);
+  ~SizeClassCachingAllocator() override;
+
+  string Name() override { return allocator_->Name(); }
+
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+    return AllocateRaw(alignment, num_bytes, AllocationAttributes());
+  }
+
+  void* AllocateRaw(size_t alignment, size_t num_bytes,
+                    const AllocationAttributes& allocation_attr) override;
+
+  void DeallocateRaw(void* ptr) override;
+
+  bool TracksAllocationSizes() const override {
+    return allocator_->TracksAllocationSizes();
+  }
+
+  // Returns the size the caller asked for, not the size of its class.
+  size_t RequestedSize(const void* ptr) const override;
+
+  // Returns the size of the buffer held in the wrapped allocator, which is at
+  // least the size of the class of `ptr`.
+  size_t AllocatedSize(const void* ptr) const override {
+    return allocator_->AllocatedSize(ptr);
+  }
+
+  int64 AllocationId(const void* ptr) const override {
+    return allocator_->AllocationId(ptr);
+  }
+
+  absl::optional<AllocatorStats> GetStats() override;
+
+  void ClearStats() override { allocator_->ClearStats(); }
+
+  void SetSafeFrontier(uint64 count) override {
+    allocator_->SetSafeFrontier(count);
+  }
+
+  // Returns every cached buffer to the wrapped allocator.
+  void FlushCaches();
+
+  // Number of allocations served from a cache shard.
+  int64 cache_hit_count() const {
+    return cache_hits_.load(std::memory_order_relaxed);
+  }
+  // Number of cacheable allocations forwarded to the wrapped allocator.
+  int64 cache_miss_count() const {
+    return cache_misses_.load(std::memory_order_relaxed);
+  }
+  // Total number of bytes currently held in cache shards.
+  size_t cached_bytes() const {
+    return cached_bytes_.load(std::memory_order_relaxed);
+  }
+
+  // Returns the index of the size class that holds `num_bytes`, and sets
+  // `*class_bytes` to the size of that class. Exposed for testing.
+  static int SizeClassForBytes(size_t num_bytes, size_t* class_bytes);
+
+ private:
+  // Per-thread-shard free lists, indexed by size class.
+  struct CacheShard {
+    mutex mu;
+    std::vector<std::vector<void*>> free_lists TF_GUARDED_BY(mu);
+    size_t bytes TF_GUARDED_BY(mu) = 0;
+  };
+
+  // A buffer allocated from the wrapped allocator through the caching path.
+  struct CachingBuffer {
+    int size_class;
+    // The size requested by the current user of the buffer.
+    size_t requested_bytes;
+  };
+
+  // Records every buffer handed out through the caching path, sharded by
+  // pointer so that frees from any thread only contend with a fraction of
+  // other frees.
+  struct PtrShard {
+    mutex mu;
+    absl::flat_hash_map<const void*, CachingBuffer> buffers TF_GUARDED_BY(mu);
+  };
+
+  CacheShard* ShardForCurrentThread();
+  PtrShard* ShardForPtr(const void* ptr) const;
+
+  // Allocates `num_bytes` from the wrapped allocator. If anything is cached,
+  // first tries without retry and, on failure, again after flushing all
+  // caches.
+  void* AllocateFromWrapped(size_t alignment, size_t num_bytes,
+                            const AllocationAttributes& allocation_attr);
+
+  // Returns the buffers in `shard` to the wrapped allocator.
+  void FlushShard(CacheShard* shard);
+
+  std::unique_ptr<Allocator> allocator_;
+  const size_t max_cached_bytes_;
+  const size_t max_bytes_per_shard_;
+  const int num_size_classes_;
+  std::vector<size_t> class_bytes_;
+
+  std::unique_ptr<CacheShard[]> cache_shards_;
+  const int num_cache_shards_;
+  std::unique_ptr<PtrShard[]> ptr_shards_;
+  const int num_ptr_shards_;
+
+  std::atomic<int64> cache_hits_{0};
+  std::atomic<int64> cache_misses_{0};
+  std::atomic<size_t> cached_bytes_{0};
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SizeClassCachingAllocator);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_SIZE_CLASS_CACHING_ALLOCATOR_H_
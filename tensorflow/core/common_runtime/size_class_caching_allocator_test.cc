@@ -0,0 +1,239 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/size_class_caching_allocator.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/bfc_allocator.h"
+#include "tensorflow/core/common_runtime/pool_allocator.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/numa.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+BFCAllocator* NewBFCAllocator(size_t total_memory) {
+  SubAllocator* sub_allocator =
+      new BasicCPUAllocator(port::kNUMANoAffinity, {}, {});
+  return new BFCAllocator(sub_allocator, total_memory, true /*allow_growth*/,
+                          "bfc");
+}
+
+TEST(SizeClassCachingAllocatorTest, SizeClasses) {
+  size_t class_bytes;
+  EXPECT_EQ(0, SizeClassCachingAllocator::SizeClassForBytes(1, &class_bytes));
+  EXPECT_EQ(256, class_bytes);
+  EXPECT_EQ(0,
+            SizeClassCachingAllocator::SizeClassForBytes(256, &class_bytes));
+  EXPECT_EQ(256, class_bytes);
+  EXPECT_EQ(1,
+            SizeClassCachingAllocator::SizeClassForBytes(257, &class_bytes));
+  EXPECT_EQ(320, class_bytes);
+  EXPECT_EQ(4,
+            SizeClassCachingAllocator::SizeClassForBytes(512, &class_bytes));
+  EXPECT_EQ(512, class_bytes);
+  EXPECT_EQ(5,
+            SizeClassCachingAllocator::SizeClassForBytes(513, &class_bytes));
+  EXPECT_EQ(640, class_bytes);
+
+  // Every size maps to the smallest class that holds it.
+  int prev_class = 0;
+  size_t prev_bytes = 256;
+  for (size_t n = 1; n <= (1 << 20); n += 7) {
+    const int c = SizeClassCachingAllocator::SizeClassForBytes(n, &class_bytes);
+    EXPECT_GE(class_bytes, n);
+    EXPECT_LE(class_bytes - n, class_bytes / 4);
+    EXPECT_GE(c, prev_class);
+    if (c == prev_class) {
+      EXPECT_EQ(prev_bytes, class_bytes);
+    }
+    prev_class = c;
+    prev_bytes = class_bytes;
+  }
+}
+
+TEST(SizeClassCachingAllocatorTest, ReusesFreedBuffers) {
+  SizeClassCachingAllocator a(NewBFCAllocator(1 << 30), 1 << 16, 1 << 20, 4);
+  void* p1 = a.AllocateRaw(64, 1000);
+  ASSERT_NE(nullptr, p1);
+  a.DeallocateRaw(p1);
+  EXPECT_EQ(1024, a.cached_bytes());
+  // A request in the same size class is served from the cache.
+  void* p2 = a.AllocateRaw(64, 900);
+  EXPECT_EQ(p1, p2);
+  EXPECT_EQ(1, a.cache_hit_count());
+  EXPECT_EQ(0, a.cached_bytes());
+  a.DeallocateRaw(p2);
+
+  // Requests above the cacheable size bypass the cache.
+  void* big = a.AllocateRaw(64, 1 << 20);
+  ASSERT_NE(nullptr, big);
+  a.DeallocateRaw(big);
+  EXPECT_EQ(1024, a.cached_bytes());
+}
+
+TEST(SizeClassCachingAllocatorTest, ReportsRequestedSize) {
+  SizeClassCachingAllocator a(NewBFCAllocator(1 << 30), 1 << 16, 1 << 20, 1);
+  void* p1 = a.AllocateRaw(64, 1000);
+  ASSERT_NE(nullptr, p1);
+  EXPECT_EQ(1000, a.RequestedSize(p1));
+  EXPECT_GE(a.AllocatedSize(p1), 1024);
+  a.DeallocateRaw(p1);
+
+  // The requested size follows the current user of a cached buffer.
+  void* p2 = a.AllocateRaw(64, 900);
+  ASSERT_EQ(p1, p2);
+  EXPECT_EQ(900, a.RequestedSize(p2));
+  EXPECT_GE(a.AllocatedSize(p2), 1024);
+  a.DeallocateRaw(p2);
+
+  // Buffers that bypass the cache report the wrapped allocator's sizes.
+  void* big = a.AllocateRaw(64, 100000);
+  ASSERT_NE(nullptr, big);
+  EXPECT_EQ(100000, a.RequestedSize(big));
+  a.DeallocateRaw(big);
+}
+
+TEST(SizeClassCachingAllocatorTest, CachedBytesAreReportedFree) {
+  SizeClassCachingAllocator a(NewBFCAllocator(1 << 30), 1 << 16, 1 << 20, 1);
+  std::vector<void*> ptrs;
+  for (int i = 0; i < 10; ++i) {
+    ptrs.push_back(a.AllocateRaw(64, 4096));
+  }
+  EXPECT_EQ(10 * 4096, a.GetStats()->bytes_in_use);
+  for (void* p : ptrs) a.DeallocateRaw(p);
+  EXPECT_EQ(10 * 4096, a.cached_bytes());
+  EXPECT_EQ(0, a.GetStats()->bytes_in_use);
+  a.FlushCaches();
+  EXPECT_EQ(0, a.cached_bytes());
+  EXPECT_EQ(0, a.GetStats()->bytes_in_use);
+}
+
+TEST(SizeClassCachingAllocatorTest, ShardLimit) {
+  BFCAllocator* bfc = NewBFCAllocator(1 << 30);
+  SizeClassCachingAllocator a(bfc, 1 << 16, 8192, 1);
+  std::vector<void*> ptrs;
+  for (int i = 0; i < 4; ++i) {
+    ptrs.push_back(a.AllocateRaw(64, 4096));
+  }
+  for (void* p : ptrs) a.DeallocateRaw(p);
+  // Only two 4KiB buffers fit in the 8KiB shard, and the others went back to
+  // the BFC allocator. Cached buffers are reported free.
+  EXPECT_EQ(8192, a.cached_bytes());
+  EXPECT_EQ(8192, bfc->GetStats()->bytes_in_use);
+  EXPECT_EQ(0, a.GetStats()->bytes_in_use);
+}
+
+TEST(SizeClassCachingAllocatorTest, FlushesUnderMemoryPressure) {
+  // The BFC arena holds exactly four 256KiB buffers.
+  const size_t kBufferBytes = 1 << 18;
+  SizeClassCachingAllocator a(NewBFCAllocator(4 * kBufferBytes), kBufferBytes,
+                              4 * kBufferBytes, 1);
+  std::vector<void*> ptrs;
+  for (int i = 0; i < 4; ++i) {
+    ptrs.push_back(a.AllocateRaw(64, kBufferBytes));
+    ASSERT_NE(nullptr, ptrs.back());
+  }
+  for (void* p : ptrs) a.DeallocateRaw(p);
+  EXPECT_EQ(4 * kBufferBytes, a.cached_bytes());
+
+  // A request of a different size class cannot reuse the cached buffers, so
+  // the caches must be flushed for it to succeed.
+  AllocationAttributes attr;
+  attr.no_retry_on_failure = true;
+  void* p = a.AllocateRaw(64, 2 * kBufferBytes, attr);
+  EXPECT_NE(nullptr, p);
+  EXPECT_EQ(0, a.cached_bytes());
+  a.DeallocateRaw(p);
+}
+
+TEST(SizeClassCachingAllocatorTest, ConcurrentAllocateAndFree) {
+  SizeClassCachingAllocator a(NewBFCAllocator(1 << 30), 1 << 16, 1 << 20, 8);
+  thread::ThreadPool pool(Env::Default(), "test", 8);
+  BlockingCounter counter(8);
+  for (int t = 0; t < 8; ++t) {
+    pool.Schedule([&a, &counter, t]() {
+      std::vector<void*> ptrs;
+      for (int i = 0; i < 1000; ++i) {
+        ptrs.push_back(a.AllocateRaw(64, 256 + ((i * 37 + t) % 8192)));
+        if (ptrs.size() > 16) {
+          a.DeallocateRaw(ptrs.front());
+          ptrs.erase(ptrs.begin());
+        }
+      }
+      for (void* p : ptrs) a.DeallocateRaw(p);
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+  a.FlushCaches();
+  EXPECT_EQ(0, a.GetStats()->bytes_in_use);
+}
+
+// Each thread repeatedly allocates and frees a small working set of buffers,
+// which is the pattern of short-lived intermediate tensors on inter-op
+// threads.
+void BenchmarkContention(int iters, int num_threads, bool use_cache) {
+  testing::StopTiming();
+  std::unique_ptr<Allocator> a;
+  if (use_cache) {
+    a.reset(new SizeClassCachingAllocator(NewBFCAllocator(1LL << 32), 1 << 20,
+                                          64 << 20, num_threads));
+  } else {
+    a.reset(NewBFCAllocator(1LL << 32));
+  }
+  thread::ThreadPool pool(Env::Default(), "bench", num_threads);
+  BlockingCounter counter(num_threads);
+  const int iters_per_thread = std::max(1, iters / num_threads);
+  testing::UseRealTime();
+  testing::StartTiming();
+  for (int t = 0; t < num_threads; ++t) {
+    pool.Schedule([&a, &counter, iters_per_thread]() {
+      static const size_t kSizes[] = {256, 1024, 4096, 16384, 65536};
+      void* ptrs[4];
+      for (int i = 0; i < iters_per_thread; ++i) {
+        for (int j = 0; j < 4; ++j) {
+          ptrs[j] = a->AllocateRaw(64, kSizes[(i + j) % 5]);
+        }
+        for (int j = 0; j < 4; ++j) {
+          a->DeallocateRaw(ptrs[j]);
+        }
+      }
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+  testing::StopTiming();
+}
+
+void BM_BFCContention(int iters, int num_threads) {
+  BenchmarkContention(iters, num_threads, false);
+}
+BENCHMARK(BM_BFCContention)->Arg(1)->Arg(8)->Arg(64);
+
+void BM_SizeClassCachingContention(int iters, int num_threads) {
+  BenchmarkContention(iters, num_threads, true);
+}
+BENCHMARK(BM_SizeClassCachingContention)->Arg(1)->Arg(8)->Arg(64);
+
+}  // namespace
+}  // namespace tensorflow
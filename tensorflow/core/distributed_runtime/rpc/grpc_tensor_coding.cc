@@ -19,6 +19,7 @@ limitations under the License.
 #include "grpcpp/support/slice.h"
 #include "absl/flags/flag.h"
 #include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/distributed_runtime/tensor_transport_encoding.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_reference.h"
@@ -26,6 +27,7 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/io/proto_encode_helper.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/protobuf/transport_options.pb.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
 
 // (Omitted internal-only flag)
@@ -137,23 +139,20 @@ static void EncodeSkeleton(const Tensor& val, io::ProtoEncodeHelper* e) {
 #endif
 }
 
-void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
-                              ::grpc::ByteBuffer* result) {
+// Encodes "response", which holds all fields but the tensor, followed by
+// "val" as the tensor field.
+static void EncodeResponseAndTensorToByteBuffer(RecvTensorResponse* response,
+                                                const Tensor& val,
+                                                ::grpc::ByteBuffer* result) {
   const int kLargeTensorBytes = 1024;
-  RecvTensorResponse response;
-  if (is_dead) {
-    response.set_is_dead(is_dead);
-  }
-  response.set_require_ack(require_ack);
-  response.set_send_start_micros(Env::Default()->NowMicros());
   if (!DataTypeCanUseMemcpy(val.dtype())) {
     // Straightforward but slow path for complicated kinds of tensor data
     // TODO(jeff,sanjay): If this becomes an issue, we could
     // go directly from val -> ByteBuffer, with some effort.
-    val.AsProtoTensorContent(response.mutable_tensor());
+    val.AsProtoTensorContent(response->mutable_tensor());
 
     // Encode full protocol buffer to a ByteBuffer
-    EncodeRecvTensorResponseToByteBuffer(response, result);
+    EncodeRecvTensorResponseToByteBuffer(*response, result);
   } else {
     // skeleton is the encoded TensorProto contents (dtype and shape), but
     // not the actual data
@@ -166,11 +165,11 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
         (e_skeleton.size() +
          VarLengthEncodingSize(TensorProto::kTensorContentFieldNumber,
                                tdata.size()));
-    string header;  // All of RecvTensorResponse except the tensor() field
-    response.AppendToString(&header);
+    // All of RecvTensorResponse except the tensor() field
+    const size_t header_size = response->ByteSizeLong();
 
     size_t expected_size =
-        (header.size() +
+        (header_size +
          VarLengthEncodingSize(RecvTensorResponse::kTensorFieldNumber,
                                overall_tensor_proto_bytesize));
     // If "share_tensor_slice_memory == false", we copy the tensor data to
@@ -190,35 +189,32 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
     size_t encoder_size = expected_size - tdata.size();
 
     // Encode all but the actual "tdata", but including the tag and
-    // varlength header for the "tdata"
-    gtl::InlinedVector<char, 1024> space(encoder_size);
-    io::ProtoEncodeHelper e(space.data(), space.size());
-    // (A)
-    e.WriteRawBytes(header);
-
-    // (B1) & (B2)
-    e.WriteVarlengthBeginning(RecvTensorResponse::kTensorFieldNumber,
-                              overall_tensor_proto_bytesize);
-    // (C)
-    e.WriteRawBytes(StringPiece(e_skeleton.data(), e_skeleton.size()));
-    // (D1) & (D2)
-    e.WriteVarlengthBeginning(TensorProto::kTensorContentFieldNumber,
-                              tdata.size());
-
-    // All but the tensor backing store are serialized now
-
-    // Now allocate memory and put into the ByteBuffer
+    // varlength header for the "tdata", directly into the first slice.
     ::grpc::Slice slices[2];
     int num_slices = 0;
     {
       size_t slice_len =
-          e.size() + (share_tensor_slice_memory ? 0 : tdata.size());
+          encoder_size + (share_tensor_slice_memory ? 0 : tdata.size());
       slices[0] = ::grpc::Slice(slice_len);
-      memcpy(const_cast<uint8_t*>(slices[0].begin()), e.data(), e.size());
+      char* begin =
+          const_cast<char*>(reinterpret_cast<const char*>(slices[0].begin()));
+      // (A)
+      response->SerializeWithCachedSizesToArray(reinterpret_cast<uint8*>(begin));
+      io::ProtoEncodeHelper e(begin + header_size, encoder_size - header_size);
+      // (B1) & (B2)
+      e.WriteVarlengthBeginning(RecvTensorResponse::kTensorFieldNumber,
+                                overall_tensor_proto_bytesize);
+      // (C)
+      e.WriteRawBytes(StringPiece(e_skeleton.data(), e_skeleton.size()));
+      // (D1) & (D2)
+      e.WriteVarlengthBeginning(TensorProto::kTensorContentFieldNumber,
+                                tdata.size());
+      // All but the tensor backing store are serialized now
+      CHECK_EQ(header_size + e.size(), encoder_size);
+
       if (!share_tensor_slice_memory) {
         // (E)
-        memcpy(const_cast<uint8_t*>(slices[0].begin()) + e.size(), tdata.data(),
-               tdata.size());
+        memcpy(begin + encoder_size, tdata.data(), tdata.size());
       }
       num_slices += 1;
     }
@@ -245,5 +241,36 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
   }
 }
 
+static void InitRecvTensorResponse(bool is_dead, bool require_ack,
+                                   RecvTensorResponse* response) {
+  if (is_dead) {
+    response->set_is_dead(is_dead);
+  }
+  response->set_require_ack(require_ack);
+  response->set_send_start_micros(Env::Default()->NowMicros());
+}
+
+void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
+                              ::grpc::ByteBuffer* result) {
+  RecvTensorResponse response;
+  InitRecvTensorResponse(is_dead, require_ack, &response);
+  EncodeResponseAndTensorToByteBuffer(&response, val, result);
+}
+
+void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
+                              const RecvTensorTransportOptions& options,
+                              ::grpc::ByteBuffer* result) {
+  Tensor payload;
+  RecvTensorTransportEncoding encoding;
+  if (is_dead || !EncodeTensorForTransport(options, val, &payload, &encoding)) {
+    EncodeTensorToByteBuffer(is_dead, val, require_ack, result);
+    return;
+  }
+  RecvTensorResponse response;
+  InitRecvTensorResponse(is_dead, require_ack, &response);
+  response.mutable_transport_options()->PackFrom(encoding);
+  EncodeResponseAndTensorToByteBuffer(&response, payload, result);
+}
+
 }  // namespace grpc
 }  // namespace tensorflow
@@ -21,6 +21,7 @@ limitations under the License.
 namespace tensorflow {
 class Tensor;
 class RecvTensorResponse;
+class RecvTensorTransportOptions;
 
 // TODO(jeff,sanjay): this should not be grpc specific.  Instead of
 // grpc::ByteBuffer*, it should accept an object of an interface type
@@ -49,6 +50,13 @@ void EncodeRecvTensorResponseToByteBuffer(const RecvTensorResponse& proto,
 void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
                               ::grpc::ByteBuffer* result);
 
+// Like above, but first applies the encodings that the receiver accepts in
+// "options" (see EncodeTensorForTransport) if they apply to "val". The
+// response then describes them in RecvTensorResponse::transport_options.
+void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
+                              const RecvTensorTransportOptions& options,
+                              ::grpc::ByteBuffer* result);
+
 }  // namespace grpc
 }  // namespace tensorflow
 
@@ -447,11 +447,23 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
 
   bool cache_enabled = (response_cache_ != nullptr && request_id != 0);
 
-  auto do_response = [response, done, cache_enabled](const Tensor& tensor,
-                                                     bool is_dead,
-                                                     const Status& status) {
+  // Encodings (compression, lower precision) the receiver accepts.
+  auto transport_options = std::make_shared<RecvTensorTransportOptions>();
+  const bool encode =
+      request->has_transport_options() &&
+      request->transport_options().UnpackTo(transport_options.get());
+
+  auto do_response = [response, done, cache_enabled, encode,
+                      transport_options](const Tensor& tensor, bool is_dead,
+                                         const Status& status) {
     if (status.ok()) {
-      grpc::EncodeTensorToByteBuffer(is_dead, tensor, cache_enabled, response);
+      if (encode) {
+        grpc::EncodeTensorToByteBuffer(is_dead, tensor, cache_enabled,
+                                       *transport_options, response);
+      } else {
+        grpc::EncodeTensorToByteBuffer(is_dead, tensor, cache_enabled,
+                                       response);
+      }
     }
     done(status);
   };
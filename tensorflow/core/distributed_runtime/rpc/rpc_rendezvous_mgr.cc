@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/distributed_runtime/request_id.h"
 #include "tensorflow/core/distributed_runtime/tensor_coding.h"
+#include "tensorflow/core/distributed_runtime/tensor_transport_encoding.h"
 #include "tensorflow/core/distributed_runtime/worker_cache.h"
 #include "tensorflow/core/distributed_runtime/worker_interface.h"
 #include "tensorflow/core/framework/types.h"
@@ -33,6 +34,7 @@ limitations under the License.
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/notification.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/transport_options.pb.h"
 
 namespace tensorflow {
 
@@ -40,8 +42,10 @@ namespace {
 
 class RpcRemoteRendezvous : public BaseRemoteRendezvous {
  public:
-  RpcRemoteRendezvous(const WorkerEnv* env, int64 step_id)
-      : BaseRemoteRendezvous(env, step_id) {}
+  RpcRemoteRendezvous(const WorkerEnv* env, int64 step_id,
+                      std::shared_ptr<const RPCOptions> rpc_options)
+      : BaseRemoteRendezvous(env, step_id),
+        rpc_options_(std::move(rpc_options)) {}
 
  protected:
   void RecvFromRemoteAsync(const Rendezvous::ParsedKey& parsed,
@@ -51,6 +55,8 @@ class RpcRemoteRendezvous : public BaseRemoteRendezvous {
  private:
   ~RpcRemoteRendezvous() override {}
 
+  const std::shared_ptr<const RPCOptions> rpc_options_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(RpcRemoteRendezvous);
 };
 
@@ -84,6 +90,8 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
     // opts_ appropriately.
     req_.Clear();
     resp_.Clear();
+    decoded_tensor_ = Tensor();
+    has_decoded_tensor_ = false;
     {
       mutex_lock l(mu_);
       status_ = Status::OK();
@@ -123,7 +131,32 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
     wi_ = nullptr;
   }
 
-  const Tensor& tensor() const { return resp_.tensor(); }
+  // Asks the sender to apply the encodings of "options" to the tensor.
+  void SetTransportOptions(const RecvTensorTransportOptions& options) {
+    req_.mutable_transport_options()->PackFrom(options);
+  }
+
+  // Decodes the received tensor if the sender encoded it.
+  Status DecodeTensor() {
+    const auto& transport_options = resp_.metadata().transport_options();
+    if (!transport_options.Is<RecvTensorTransportEncoding>()) {
+      return Status::OK();
+    }
+    RecvTensorTransportEncoding encoding;
+    if (!transport_options.UnpackTo(&encoding)) {
+      return errors::DataLoss("Invalid tensor transport encoding for ",
+                              req_.rendezvous_key());
+    }
+    TF_RETURN_IF_ERROR(DecodeTensorFromTransport(
+        encoding, resp_.tensor(), dst_device_->GetAllocator(alloc_attrs_),
+        &decoded_tensor_));
+    has_decoded_tensor_ = true;
+    return Status::OK();
+  }
+
+  const Tensor& tensor() const {
+    return has_decoded_tensor_ ? decoded_tensor_ : resp_.tensor();
+  }
 
   bool is_dead() const { return resp_.metadata().is_dead(); }
 
@@ -176,6 +209,8 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
   CallOptions opts_;
   RecvTensorRequest req_;
   TensorResponse resp_;
+  Tensor decoded_tensor_;
+  bool has_decoded_tensor_ = false;
   Rendezvous::Args recv_args_;
   Rendezvous::DoneCallback done_;
 
@@ -272,6 +307,16 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
   call->Init(rwi, step_id_, parsed.FullKey(), recv_args.alloc_attrs, dst_device,
              recv_args, std::move(done));
 
+  // Encoded tensors are decoded on the host, so only ask for encodings of
+  // tensors received in host memory.
+  RecvTensorTransportOptions transport_options;
+  if ((dst_device->device_type() == DEVICE_CPU ||
+       recv_args.alloc_attrs.on_host()) &&
+      GetRecvTensorTransportOptions(*rpc_options_, parsed.edge_name,
+                                    &transport_options)) {
+    call->SetTransportOptions(transport_options);
+  }
+
   // Record "call" in active_ so that it can be aborted cleanly.
   RegisterCall(call, recv_args);
 
@@ -295,6 +340,9 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
     // If StartAbort was called prior to DeregisterCall, then the
     // current status should be bad.
     Status s = call->status();
+    if (s.ok()) {
+      s = call->DecodeTensor();
+    }
     // NOTE: `*session()` can potentially be deleted before we return from
     // `call->done()(...)`, so we must release the worker before calling the
     // callback.
@@ -307,12 +355,14 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
 
 }  // namespace
 
-RpcRendezvousMgr::RpcRendezvousMgr(const WorkerEnv* env)
-    : BaseRendezvousMgr(env) {}
+RpcRendezvousMgr::RpcRendezvousMgr(const WorkerEnv* env,
+                                   const RPCOptions& rpc_options)
+    : BaseRendezvousMgr(env),
+      rpc_options_(std::make_shared<const RPCOptions>(rpc_options)) {}
 
 BaseRemoteRendezvous* RpcRendezvousMgr::Create(int64 step_id,
                                                const WorkerEnv* worker_env) {
-  return new RpcRemoteRendezvous(worker_env, step_id);
+  return new RpcRemoteRendezvous(worker_env, step_id, rpc_options_);
 }
 
 }  // end namespace tensorflow
@@ -0,0 +1,226 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/tensor_transport_encoding.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/framework/bfloat16.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/snappy.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Compression is only worth its decoding cost if it saves at least 1/8 of
+// the bytes.
+bool WorthCompressing(size_t compressed_bytes, size_t bytes) {
+  return compressed_bytes <= bytes - bytes / 8;
+}
+
+DataType WireDataType(const RecvTensorTransportEncoding& encoding) {
+  switch (encoding.float_encoding()) {
+    case RecvTensorTransportOptions::BFLOAT16:
+      return DT_BFLOAT16;
+    case RecvTensorTransportOptions::HALF:
+      return DT_HALF;
+    case RecvTensorTransportOptions::INT8_SCALED:
+      return DT_INT8;
+    default:
+      return encoding.dtype();
+  }
+}
+
+// Converts the float tensor `val` to `float_encoding` in `encoded`.
+bool EncodeFloats(RecvTensorTransportOptions::FloatEncoding float_encoding,
+                  const Tensor& val, Tensor* encoded, float* scale) {
+  auto in = val.flat<float>();
+  switch (float_encoding) {
+    case RecvTensorTransportOptions::BFLOAT16:
+      *encoded = Tensor(DT_BFLOAT16, val.shape());
+      encoded->flat<bfloat16>() = in.cast<bfloat16>();
+      return true;
+    case RecvTensorTransportOptions::HALF:
+      *encoded = Tensor(DT_HALF, val.shape());
+      encoded->flat<Eigen::half>() = in.cast<Eigen::half>();
+      return true;
+    case RecvTensorTransportOptions::INT8_SCALED: {
+      // The maximum reduction doesn't reliably propagate NaNs, and
+      // converting a non-finite value to int8 is undefined: check every
+      // value, and send the tensor unscaled if any of them isn't finite.
+      float max_abs = 0.0f;
+      for (int64 i = 0; i < in.size(); ++i) {
+        const float abs = std::abs(in(i));
+        if (!std::isfinite(abs)) return false;
+        max_abs = std::max(max_abs, abs);
+      }
+      // Tiny values would underflow the scale to zero or lose all precision
+      // in a subnormal one, so they are sent unscaled too.
+      *scale = max_abs > 0 ? max_abs / 127.0f : 1.0f;
+      if (!std::isnormal(*scale)) return false;
+      *encoded = Tensor(DT_INT8, val.shape());
+      encoded->flat<int8>() = (in / *scale).round().cast<int8>();
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+bool GetRecvTensorTransportOptions(const RPCOptions& rpc_options,
+                                   StringPiece tensor_name,
+                                   RecvTensorTransportOptions* options) {
+  options->Clear();
+  if (rpc_options.recv_tensor_compression() == "snappy") {
+    options->set_compression(RecvTensorTransportOptions::SNAPPY);
+  }
+  const string& scope = rpc_options.recv_tensor_lossy_encoding_scope();
+  if (scope.empty() || absl::StrContains(tensor_name, scope)) {
+    const string& float_encoding = rpc_options.recv_tensor_float_encoding();
+    if (float_encoding == "bfloat16") {
+      options->set_float_encoding(RecvTensorTransportOptions::BFLOAT16);
+    } else if (float_encoding == "half") {
+      options->set_float_encoding(RecvTensorTransportOptions::HALF);
+    } else if (float_encoding == "int8") {
+      options->set_float_encoding(RecvTensorTransportOptions::INT8_SCALED);
+    }
+  }
+  options->set_min_bytes(rpc_options.recv_tensor_encoding_min_bytes() > 0
+                             ? rpc_options.recv_tensor_encoding_min_bytes()
+                             : kDefaultTransportEncodingMinBytes);
+  return options->compression() != RecvTensorTransportOptions::NO_COMPRESSION ||
+         options->float_encoding() !=
+             RecvTensorTransportOptions::NO_FLOAT_ENCODING;
+}
+
+bool EncodeTensorForTransport(const RecvTensorTransportOptions& options,
+                              const Tensor& val, Tensor* payload,
+                              RecvTensorTransportEncoding* encoding) {
+  const int64 min_bytes = options.min_bytes() > 0
+                              ? options.min_bytes()
+                              : kDefaultTransportEncodingMinBytes;
+  if (!DataTypeCanUseMemcpy(val.dtype()) ||
+      static_cast<int64>(val.TotalBytes()) < min_bytes) {
+    return false;
+  }
+  encoding->Clear();
+  encoding->set_dtype(val.dtype());
+  val.shape().AsProto(encoding->mutable_tensor_shape());
+
+  Tensor wire = val;
+  float scale = 1.0f;
+  if (val.dtype() == DT_FLOAT &&
+      EncodeFloats(options.float_encoding(), val, &wire, &scale)) {
+    encoding->set_float_encoding(options.float_encoding());
+    if (options.float_encoding() == RecvTensorTransportOptions::INT8_SCALED) {
+      encoding->set_scale(scale);
+    }
+  }
+
+  StringPiece data = wire.tensor_data();
+  if (options.compression() == RecvTensorTransportOptions::SNAPPY) {
+    string compressed;
+    if (port::Snappy_Compress(data.data(), data.size(), &compressed) &&
+        WorthCompressing(compressed.size(), data.size())) {
+      encoding->set_compression(RecvTensorTransportOptions::SNAPPY);
+      *payload = Tensor(DT_UINT8, TensorShape({static_cast<int64>(
+                                      compressed.size())}));
+      memcpy(const_cast<char*>(payload->tensor_data().data()),
+             compressed.data(), compressed.size());
+      return true;
+    }
+  }
+  if (encoding->float_encoding() ==
+      RecvTensorTransportOptions::NO_FLOAT_ENCODING) {
+    return false;
+  }
+  return payload
+      ->BitcastFrom(wire, DT_UINT8,
+                    TensorShape({static_cast<int64>(data.size())}))
+      .ok();
+}
+
+Status DecodeTensorFromTransport(const RecvTensorTransportEncoding& encoding,
+                                 const Tensor& payload, Allocator* allocator,
+                                 Tensor* val) {
+  if (payload.dtype() != DT_UINT8 || payload.dims() != 1) {
+    return errors::InvalidArgument("Invalid encoded tensor: ",
+                                   payload.DebugString());
+  }
+  if (!DataTypeCanUseMemcpy(encoding.dtype()) ||
+      !TensorShape::IsValid(encoding.tensor_shape())) {
+    return errors::InvalidArgument("Invalid tensor transport encoding: ",
+                                   encoding.ShortDebugString());
+  }
+  const TensorShape shape(encoding.tensor_shape());
+  const bool float_encoded = encoding.float_encoding() !=
+                             RecvTensorTransportOptions::NO_FLOAT_ENCODING;
+  if (float_encoded && encoding.dtype() != DT_FLOAT) {
+    return errors::InvalidArgument("Float encoding of a ",
+                                   DataTypeString(encoding.dtype()),
+                                   " tensor");
+  }
+  const DataType wire_dtype = WireDataType(encoding);
+
+  Tensor wire;
+  StringPiece data = payload.tensor_data();
+  if (encoding.compression() == RecvTensorTransportOptions::SNAPPY) {
+    // Without a float encoding, decompress straight into the result.
+    wire = float_encoded ? Tensor(wire_dtype, shape)
+                         : Tensor(allocator, wire_dtype, shape);
+    size_t uncompressed_bytes;
+    if (!port::Snappy_GetUncompressedLength(data.data(), data.size(),
+                                            &uncompressed_bytes) ||
+        uncompressed_bytes != wire.TotalBytes() ||
+        !port::Snappy_Uncompress(data.data(), data.size(),
+                                 const_cast<char*>(wire.tensor_data().data()))) {
+      return errors::DataLoss("Can't uncompress received tensor");
+    }
+  } else {
+    TF_RETURN_IF_ERROR(wire.BitcastFrom(payload, wire_dtype, shape));
+  }
+  if (!float_encoded) {
+    *val = std::move(wire);
+    return Status::OK();
+  }
+
+  Tensor decoded(allocator, DT_FLOAT, shape);
+  auto out = decoded.flat<float>();
+  switch (encoding.float_encoding()) {
+    case RecvTensorTransportOptions::BFLOAT16:
+      out = wire.flat<bfloat16>().cast<float>();
+      break;
+    case RecvTensorTransportOptions::HALF:
+      out = wire.flat<Eigen::half>().cast<float>();
+      break;
+    case RecvTensorTransportOptions::INT8_SCALED:
+      out = wire.flat<int8>().cast<float>() * encoding.scale();
+      break;
+    default:
+      return errors::InvalidArgument("Unknown float encoding ",
+                                     encoding.float_encoding());
+  }
+  *val = std::move(decoded);
+  return Status::OK();
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,53 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_TENSOR_TRANSPORT_ENCODING_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_TENSOR_TRANSPORT_ENCODING_H_
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/protobuf/transport_options.pb.h"
+
+namespace tensorflow {
+
+// Minimum size of the tensors encoded when RecvTensorTransportOptions don't
+// specify one. Below this, the per-tensor overhead outweighs the savings.
+constexpr int64 kDefaultTransportEncodingMinBytes = 64 << 10;
+
+// Returns the encodings requested in `rpc_options` for the tensor named
+// `tensor_name`. Returns false if no encoding applies.
+bool GetRecvTensorTransportOptions(const RPCOptions& rpc_options,
+                                   StringPiece tensor_name,
+                                   RecvTensorTransportOptions* options);
+
+// Encodes `val` with the encodings of `options` that apply to it, and stores
+// the encoded bytes in `payload` (a vector of DT_UINT8) and the encodings in
+// `encoding`. Compression is only applied if it saves a significant amount
+// of bytes. Returns false if `val` is sent as is.
+bool EncodeTensorForTransport(const RecvTensorTransportOptions& options,
+                              const Tensor& val, Tensor* payload,
+                              RecvTensorTransportEncoding* encoding);
+
+// Decodes a tensor encoded by EncodeTensorForTransport into `val`, which is
+// allocated with `allocator`.
+Status DecodeTensorFromTransport(const RecvTensorTransportEncoding& encoding,
+                                 const Tensor& payload, Allocator* allocator,
+                                 Tensor* val);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_TENSOR_TRANSPORT_ENCODING_H_
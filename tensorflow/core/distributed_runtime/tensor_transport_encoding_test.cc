@@ -0,0 +1,211 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/tensor_transport_encoding.h"
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/snappy.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+Tensor RandomFloats(int64 n) {
+  Tensor t(DT_FLOAT, TensorShape({n / 4, 4}));
+  t.flat<float>().setRandom();
+  return t;
+}
+
+RecvTensorTransportOptions Options(
+    RecvTensorTransportOptions::Compression compression,
+    RecvTensorTransportOptions::FloatEncoding float_encoding) {
+  RecvTensorTransportOptions options;
+  options.set_compression(compression);
+  options.set_float_encoding(float_encoding);
+  options.set_min_bytes(1024);
+  return options;
+}
+
+Tensor RoundTrip(const RecvTensorTransportOptions& options, const Tensor& t) {
+  Tensor payload;
+  RecvTensorTransportEncoding encoding;
+  EXPECT_TRUE(EncodeTensorForTransport(options, t, &payload, &encoding));
+  EXPECT_EQ(DT_UINT8, payload.dtype());
+  Tensor decoded;
+  TF_EXPECT_OK(
+      DecodeTensorFromTransport(encoding, payload, cpu_allocator(), &decoded));
+  EXPECT_EQ(t.dtype(), decoded.dtype());
+  EXPECT_EQ(t.shape(), decoded.shape());
+  return decoded;
+}
+
+bool HasSnappy() {
+  string compressed;
+  return port::Snappy_Compress("a", 1, &compressed);
+}
+
+TEST(TensorTransportEncodingTest, OptionsFromRPCOptions) {
+  RPCOptions rpc_options;
+  RecvTensorTransportOptions options;
+  EXPECT_FALSE(GetRecvTensorTransportOptions(rpc_options, "edge_1_x", &options));
+
+  rpc_options.set_recv_tensor_compression("snappy");
+  rpc_options.set_recv_tensor_float_encoding("bfloat16");
+  rpc_options.set_recv_tensor_lossy_encoding_scope("gradients/");
+  ASSERT_TRUE(GetRecvTensorTransportOptions(rpc_options, "edge_1_x", &options));
+  EXPECT_EQ(RecvTensorTransportOptions::SNAPPY, options.compression());
+  EXPECT_EQ(RecvTensorTransportOptions::NO_FLOAT_ENCODING,
+            options.float_encoding());
+  EXPECT_EQ(kDefaultTransportEncodingMinBytes, options.min_bytes());
+
+  ASSERT_TRUE(GetRecvTensorTransportOptions(
+      rpc_options, "edge_2_gradients/MatMul_grad/MatMul", &options));
+  EXPECT_EQ(RecvTensorTransportOptions::BFLOAT16, options.float_encoding());
+}
+
+TEST(TensorTransportEncodingTest, FloatEncodings) {
+  const Tensor t = RandomFloats(4096);
+  const Tensor bf16 = RoundTrip(
+      Options(RecvTensorTransportOptions::NO_COMPRESSION,
+              RecvTensorTransportOptions::BFLOAT16),
+      t);
+  test::ExpectClose(t, bf16, /*atol=*/1e-2, /*rtol=*/1e-2);
+
+  const Tensor half =
+      RoundTrip(Options(RecvTensorTransportOptions::NO_COMPRESSION,
+                        RecvTensorTransportOptions::HALF),
+                t);
+  test::ExpectClose(t, half, /*atol=*/1e-3, /*rtol=*/1e-3);
+
+  const Tensor int8 =
+      RoundTrip(Options(RecvTensorTransportOptions::NO_COMPRESSION,
+                        RecvTensorTransportOptions::INT8_SCALED),
+                t);
+  // Random values are in [0, 1), so the quantization step is at most 1/127.
+  test::ExpectClose(t, int8, /*atol=*/1.0 / 127, /*rtol=*/0);
+}
+
+TEST(TensorTransportEncodingTest, Compression) {
+  if (!HasSnappy()) return;
+  Tensor t(DT_INT32, TensorShape({4096}));
+  t.flat<int32>().setConstant(7);
+  const RecvTensorTransportOptions options =
+      Options(RecvTensorTransportOptions::SNAPPY,
+              RecvTensorTransportOptions::NO_FLOAT_ENCODING);
+  Tensor payload;
+  RecvTensorTransportEncoding encoding;
+  ASSERT_TRUE(EncodeTensorForTransport(options, t, &payload, &encoding));
+  EXPECT_LT(payload.NumElements(), t.TotalBytes() / 8);
+  Tensor decoded;
+  TF_ASSERT_OK(
+      DecodeTensorFromTransport(encoding, payload, cpu_allocator(), &decoded));
+  test::ExpectTensorEqual<int32>(t, decoded);
+
+  // Random floats don't compress, but their lower precision encoding does.
+  const Tensor floats = RandomFloats(4096);
+  EXPECT_FALSE(EncodeTensorForTransport(options, floats, &payload, &encoding));
+  Tensor zeros(DT_FLOAT, TensorShape({4096}));
+  zeros.flat<float>().setZero();
+  test::ExpectTensorEqual<float>(
+      zeros, RoundTrip(Options(RecvTensorTransportOptions::SNAPPY,
+                               RecvTensorTransportOptions::INT8_SCALED),
+                       zeros));
+}
+
+TEST(TensorTransportEncodingTest, NotEncoded) {
+  const RecvTensorTransportOptions options =
+      Options(RecvTensorTransportOptions::NO_COMPRESSION,
+              RecvTensorTransportOptions::BFLOAT16);
+  Tensor payload;
+  RecvTensorTransportEncoding encoding;
+  // Too small.
+  EXPECT_FALSE(
+      EncodeTensorForTransport(options, RandomFloats(16), &payload, &encoding));
+  // Not a float tensor.
+  Tensor ints(DT_INT32, TensorShape({4096}));
+  ints.flat<int32>().setZero();
+  EXPECT_FALSE(EncodeTensorForTransport(options, ints, &payload, &encoding));
+  // Not representable with a scale.
+  Tensor inf(DT_FLOAT, TensorShape({4096}));
+  inf.flat<float>().setConstant(std::numeric_limits<float>::infinity());
+  EXPECT_FALSE(EncodeTensorForTransport(
+      Options(RecvTensorTransportOptions::NO_COMPRESSION,
+              RecvTensorTransportOptions::INT8_SCALED),
+      inf, &payload, &encoding));
+}
+
+TEST(TensorTransportEncodingTest, NonFiniteFloatsAreNotScaled) {
+  for (float value : {std::numeric_limits<float>::quiet_NaN(),
+                      std::numeric_limits<float>::infinity(),
+                      -std::numeric_limits<float>::infinity()}) {
+    // A single non-finite value among finite ones, at either end.
+    for (int64 index : {0, 1023}) {
+      Tensor t = RandomFloats(4096);
+      t.flat<float>()(index) = value;
+      Tensor payload;
+      RecvTensorTransportEncoding encoding;
+      EXPECT_FALSE(EncodeTensorForTransport(
+          Options(RecvTensorTransportOptions::NO_COMPRESSION,
+                  RecvTensorTransportOptions::INT8_SCALED),
+          t, &payload, &encoding));
+
+      if (!HasSnappy()) continue;
+      t.flat<float>().setZero();
+      t.flat<float>()(index) = value;
+      const Tensor decoded =
+          RoundTrip(Options(RecvTensorTransportOptions::SNAPPY,
+                            RecvTensorTransportOptions::INT8_SCALED),
+                    t);
+      EXPECT_EQ(t.tensor_data(), decoded.tensor_data());
+    }
+  }
+}
+
+TEST(TensorTransportEncodingTest, SubnormalFloatsAreNotScaled) {
+  // Scales of these maxima underflow to zero or are subnormal.
+  for (float value : {std::numeric_limits<float>::denorm_min(),
+                      std::numeric_limits<float>::min()}) {
+    Tensor t = RandomFloats(4096);
+    t.flat<float>().setZero();
+    t.flat<float>()(1023) = -value;
+    Tensor payload;
+    RecvTensorTransportEncoding encoding;
+    EXPECT_FALSE(EncodeTensorForTransport(
+        Options(RecvTensorTransportOptions::NO_COMPRESSION,
+                RecvTensorTransportOptions::INT8_SCALED),
+        t, &payload, &encoding));
+  }
+}
+
+TEST(TensorTransportEncodingTest, InvalidEncoding) {
+  Tensor payload(DT_UINT8, TensorShape({16}));
+  RecvTensorTransportEncoding encoding;
+  encoding.set_dtype(DT_FLOAT);
+  encoding.mutable_tensor_shape()->add_dim()->set_size(16);
+  encoding.set_float_encoding(RecvTensorTransportOptions::HALF);
+  Tensor decoded;
+  // 16 bytes can't hold 16 half values.
+  EXPECT_FALSE(
+      DecodeTensorFromTransport(encoding, payload, cpu_allocator(), &decoded)
+          .ok());
+  encoding.set_dtype(DT_INT32);
+  EXPECT_FALSE(
+      DecodeTensorFromTransport(encoding, payload, cpu_allocator(), &decoded)
+          .ok());
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -85,6 +85,10 @@ CollInstanceParams& CollInstanceParams::operator=(
         other.impl_details.subdiv_source_rank.begin(),
         other.impl_details.subdiv_source_rank.end());
     impl_details.dependencies = other.impl_details.dependencies;
+    impl_details.ring_segment_bytes = other.impl_details.ring_segment_bytes;
+    impl_details.fusion_threshold_bytes =
+        other.impl_details.fusion_threshold_bytes;
+    impl_details.fusion_cycle_time_us = other.impl_details.fusion_cycle_time_us;
   }
   return *this;
 }
@@ -126,6 +130,16 @@ string CollInstanceParams::ToString() const {
     }
     strings::StrAppend(&v, "}");
   }
+  if (impl_details.ring_segment_bytes > 0) {
+    strings::StrAppend(&v, " ring_segment_bytes=",
+                       impl_details.ring_segment_bytes);
+  }
+  if (impl_details.fusion_threshold_bytes > 0) {
+    strings::StrAppend(&v, " fusion_threshold_bytes=",
+                       impl_details.fusion_threshold_bytes,
+                       " fusion_cycle_time_us=",
+                       impl_details.fusion_cycle_time_us);
+  }
   strings::StrAppend(&v, "}");  // all subdivs
   return v;
 }
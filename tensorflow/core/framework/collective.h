@@ -86,6 +86,13 @@ struct CollImplDetails {
                               // e.g. ring or nccl
   float timeout_seconds;      // If non zero, set a completion timeout for the
                               // collective op to detect staleness.
+  int64 ring_segment_bytes = 0;  // If positive, ring algorithms transfer each
+                                 // chunk in segments of at most this many
+                                 // bytes.
+  int64 fusion_threshold_bytes = 0;  // If positive, all-reduces of smaller
+                                     // tensors may be fused with others.
+  int64 fusion_cycle_time_us = 0;    // How long an all-reduce may wait for
+                                     // others to be fused with.
 };
 
 // Data common to all members of a collective instance.
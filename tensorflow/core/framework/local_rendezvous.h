@@ -62,10 +62,26 @@ class LocalRendezvous {
 
   typedef gtl::FlatMap<uint64, ItemQueue> Table;
 
-  // TODO(zhifengc): shard table_.
-  mutex mu_;
-  Table table_ TF_GUARDED_BY(mu_);
-  Status status_ TF_GUARDED_BY(mu_);
+  // The item table is split into `kNumShards` independently locked shards so
+  // that Send/Recv pairs on unrelated keys do not contend on a single mutex.
+  // Each shard carries its own copy of the abort status; `StartAbort()` sets
+  // it on every shard before draining any of them.
+  struct TableShard {
+    mutex mu;
+    Table table TF_GUARDED_BY(mu);
+    Status status TF_GUARDED_BY(mu);
+  };
+
+  static constexpr int kNumShardsLog2 = 4;
+  static constexpr int kNumShards = 1 << kNumShardsLog2;
+
+  // Selects the shard for `key_hash`. The high bits are used because
+  // `gtl::FlatMap` derives the bucket index from the low bits of the key.
+  TableShard* ShardFor(uint64 key_hash) {
+    return &shards_[key_hash >> (64 - kNumShardsLog2)];
+  }
+
+  TableShard shards_[kNumShards];
 
   TF_DISALLOW_COPY_AND_ASSIGN(LocalRendezvous);
 };
@@ -36,6 +36,12 @@ auto* graph_optimization_usecs =
                                 "optimization pass in microseconds.",
                                 "kind", "name");
 
+auto* grappler_graph_cache_lookups = monitoring::Counter<1>::New(
+    "/tensorflow/core/grappler_graph_cache_lookups",
+    "The number of lookups in the persistent cache of Grappler-optimized "
+    "graphs.",
+    "result");
+
 auto* graph_run_time_usecs_histogram = monitoring::Sampler<0>::New(
     {"/tensorflow/core/graph_run_time_usecs_histogram",
      "The wall-clock time spent on executing graphs in microseconds."},
@@ -259,6 +265,10 @@ void UpdateGrapplerPassTime(const string& pass_name,
   }
 }
 
+void RecordGrapplerGraphCacheLookup(bool hit) {
+  grappler_graph_cache_lookups->GetCell(hit ? "hit" : "miss")->IncrementBy(1);
+}
+
 void UpdateGraphBuildTime(const uint64 running_time_usecs) {
   if (running_time_usecs > 0) {
     static auto* build_graph_calls_cell = build_graph_calls->GetCell();
@@ -117,6 +117,9 @@ void UpdateGraphOptimizationPassTime(const string& pass_name,
 void UpdateGrapplerPassTime(const string& pass_name,
                             const uint64 running_time_usecs);
 
+// Records a lookup in the persistent cache of Grappler-optimized graphs.
+void RecordGrapplerGraphCacheLookup(bool hit);
+
 // Updates the metrics stored about time XLA spents compiling graphs.
 void UpdateXlaCompilationTime(const uint64 compilation_time_usecs);
 
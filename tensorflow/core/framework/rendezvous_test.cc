@@ -21,6 +21,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
@@ -394,6 +395,60 @@ TEST_F(LocalRendezvousTest, AbortThenRecvOrSend) {
       errors::IsAborted(rendez_->Recv(KeyFoo(), args, &val, &val_dead)));
 }
 
+TEST_F(LocalRendezvousTest, AbortPendingRecvsOnManyKeys) {
+  // Pending receivers for many distinct keys are spread over all table
+  // shards, and StartAbort() must reach every one of them.
+  static const int N = 256;
+  mutex mu;
+  int num_aborted = 0;
+  for (int i = 0; i < N; ++i) {
+    rendez_->RecvAsync(
+        MakeKey(strings::StrCat("key", i)), Rendezvous::Args(),
+        [&mu, &num_aborted](const Status& s, const Rendezvous::Args& send_args,
+                            const Rendezvous::Args& recv_args,
+                            const Tensor& val, bool is_dead) {
+          EXPECT_TRUE(errors::IsAborted(s));
+          mutex_lock l(mu);
+          ++num_aborted;
+        });
+  }
+  rendez_->StartAbort(errors::Aborted(""));
+  {
+    mutex_lock l(mu);
+    EXPECT_EQ(N, num_aborted);
+  }
+  Tensor val(DT_STRING);
+  bool val_dead = false;
+  for (int i = 0; i < N; ++i) {
+    EXPECT_TRUE(errors::IsAborted(rendez_->Send(
+        MakeKey(strings::StrCat("key", i)), Rendezvous::Args(), val, false)));
+  }
+}
+
+TEST_F(LocalRendezvousTest, AbortIsVisibleToWaiters) {
+  // The waiter runs while StartAbort() drains the shards; by then sends on
+  // keys of every other shard must fail too.
+  static const int N = 256;
+  int num_sends_ok = 0;
+  rendez_->RecvAsync(
+      KeyFoo(), Rendezvous::Args(),
+      [this, &num_sends_ok](const Status& s, const Rendezvous::Args& send_args,
+                            const Rendezvous::Args& recv_args,
+                            const Tensor& val, bool is_dead) {
+        EXPECT_TRUE(errors::IsAborted(s));
+        for (int i = 0; i < N; ++i) {
+          if (rendez_
+                  ->Send(MakeKey(strings::StrCat("key", i)),
+                         Rendezvous::Args(), V("hello"), false)
+                  .ok()) {
+            ++num_sends_ok;
+          }
+        }
+      });
+  rendez_->StartAbort(errors::Aborted(""));
+  EXPECT_EQ(0, num_sends_ok);
+}
+
 class DummyDeviceContext : public DeviceContext {
  public:
   explicit DummyDeviceContext(int stream_id) : stream_id_(stream_id) {}
@@ -512,5 +567,44 @@ void BM_PingPong(int iters) {
 }
 BENCHMARK(BM_PingPong);
 
+// Each of `num_threads` threads repeatedly sends and receives on its own set
+// of keys, so the only shared state is the rendezvous table itself.
+void BM_SendRecvManyKeys(int iters, int num_threads) {
+  testing::StopTiming();
+  static const int kKeysPerThread = 64;
+  Rendezvous* rendez = NewLocalRendezvous();
+  std::vector<std::vector<Rendezvous::ParsedKey>> keys(num_threads);
+  for (int t = 0; t < num_threads; ++t) {
+    for (int k = 0; k < kKeysPerThread; ++k) {
+      keys[t].push_back(MakeKey(strings::StrCat("t", t, "_k", k)));
+    }
+  }
+  const int iters_per_thread = std::max(1, iters / num_threads);
+  thread::ThreadPool* pool =
+      new thread::ThreadPool(Env::Default(), "test", num_threads);
+  BlockingCounter counter(num_threads);
+  testing::UseRealTime();
+  testing::StartTiming();
+  for (int t = 0; t < num_threads; ++t) {
+    pool->Schedule([rendez, &keys, &counter, t, iters_per_thread]() {
+      Tensor orig = V("val");
+      Tensor val(DT_STRING, TensorShape({}));
+      bool is_dead = false;
+      Rendezvous::Args args;
+      for (int i = 0; i < iters_per_thread; ++i) {
+        const Rendezvous::ParsedKey& key = keys[t][i % kKeysPerThread];
+        TF_CHECK_OK(rendez->Send(key, args, orig, is_dead));
+        TF_CHECK_OK(rendez->Recv(key, args, &val, &is_dead));
+      }
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+  testing::StopTiming();
+  delete pool;
+  rendez->Unref();
+}
+BENCHMARK(BM_SendRecvManyKeys)->Arg(1)->Arg(4)->Arg(16)->Arg(64);
+
 }  // namespace
 }  // namespace tensorflow
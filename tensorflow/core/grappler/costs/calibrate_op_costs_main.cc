@@ -0,0 +1,71 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Measures common ops on the local CPU and writes the resulting op cost
+// calibration, to be used by setting TF_GRAPPLER_OP_COST_CALIBRATION.
+// ./calibrate_op_costs --output_file_path=/tmp/calibration.pbtxt
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/grappler/costs/op_cost_calibrator.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+Status RealMain(int argc, char** argv) {
+  string output_file_path;
+  int64 min_time_us = OpCalibrationOptions().min_time_us;
+
+  const std::vector<Flag> flag_list = {
+      Flag("output_file_path", &output_file_path,
+           "Location to write the calibration. Written as a text proto if the "
+           "path ends with .pbtxt, as a binary proto otherwise."),
+      Flag("min_time_us", &min_time_us,
+           "Minimum time spent measuring each op invocation."),
+  };
+  if (!Flags::Parse(&argc, argv, flag_list)) {
+    return errors::FailedPrecondition("Invalid flags passed");
+  }
+  port::InitMain(argv[0], &argc, &argv);
+
+  if (output_file_path.empty()) {
+    return errors::FailedPrecondition("output_file_path is a required flag.");
+  }
+
+  OpCalibrationOptions options;
+  options.min_time_us = min_time_us;
+  OpCostCalibration calibration;
+  TF_RETURN_IF_ERROR(
+      CalibrateOpCosts(DefaultOpCalibrationCases(), options, &calibration));
+  LOG(INFO) << "Calibrated " << calibration.entries_size() << " ops.";
+
+  if (absl::EndsWith(output_file_path, ".pbtxt")) {
+    return WriteTextProto(Env::Default(), output_file_path, calibration);
+  }
+  return WriteBinaryProto(Env::Default(), output_file_path, calibration);
+}
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
+
+int main(int argc, char** argv) {
+  TF_CHECK_OK(tensorflow::grappler::RealMain(argc, argv));
+  return 0;
+}
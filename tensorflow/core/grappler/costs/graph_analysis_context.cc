@@ -0,0 +1,69 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/costs/graph_analysis_context.h"
+
+#include <utility>
+
+namespace tensorflow {
+namespace grappler {
+
+GraphAnalysisContext::GraphAnalysisContext(const GraphDef* graph)
+    : graph_(graph) {}
+
+void GraphAnalysisContext::Invalidate() {
+  mutex_lock l(mu_);
+  static_properties_.clear();
+}
+
+void GraphAnalysisContext::Detach() {
+  mutex_lock l(mu_);
+  graph_ = nullptr;
+  static_properties_.clear();
+}
+
+void GraphAnalysisContext::set_function_library_stubbed(bool stubbed) {
+  mutex_lock l(mu_);
+  function_library_stubbed_ = stubbed;
+}
+
+int GraphAnalysisContext::StaticPropertiesKey(
+    const StaticInferenceOptions& options) const {
+  return (options.assume_valid_feeds ? 1 : 0) |
+         (options.aggressive_shape_inference ? 2 : 0) |
+         (options.include_input_tensor_values ? 4 : 0) |
+         (options.include_output_tensor_values ? 8 : 0) |
+         (function_library_stubbed_ ? 16 : 0);
+}
+
+std::shared_ptr<InferredGraphProperties>
+GraphAnalysisContext::FindStaticProperties(
+    const GraphDef& graph, const StaticInferenceOptions& options) const {
+  mutex_lock l(mu_);
+  if (&graph != graph_) return nullptr;
+  auto it = static_properties_.find(StaticPropertiesKey(options));
+  return it == static_properties_.end() ? nullptr : it->second;
+}
+
+void GraphAnalysisContext::AddStaticProperties(
+    const GraphDef& graph, const StaticInferenceOptions& options,
+    std::shared_ptr<InferredGraphProperties> properties) {
+  mutex_lock l(mu_);
+  if (&graph != graph_) return;
+  static_properties_[StaticPropertiesKey(options)] = std::move(properties);
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
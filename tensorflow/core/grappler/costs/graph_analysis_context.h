@@ -0,0 +1,114 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_COSTS_GRAPH_ANALYSIS_CONTEXT_H_
+#define TENSORFLOW_CORE_GRAPPLER_COSTS_GRAPH_ANALYSIS_CONTEXT_H_
+
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// The properties of the nodes of a graph, as inferred by GraphProperties.
+struct InferredGraphProperties {
+  absl::flat_hash_map<string, std::vector<OpInfo::TensorProperties>>
+      input_properties;
+  absl::flat_hash_map<string, std::vector<OpInfo::TensorProperties>>
+      output_properties;
+  // Nodes with output shape incompatible between shape inference and
+  // annotation.
+  std::unordered_set<string> incompatible_shape_nodes;
+};
+
+// The GraphProperties::InferStatically options that the inferred properties
+// depend on.
+struct StaticInferenceOptions {
+  bool assume_valid_feeds = false;
+  bool aggressive_shape_inference = false;
+  bool include_input_tensor_values = false;
+  bool include_output_tensor_values = false;
+};
+
+// Analysis results that the passes optimizing a graph can share while the
+// graph doesn't change.
+//
+// The context is bound to a single GraphDef, owned by whoever creates the
+// context (e.g. the MetaOptimizer binds it to the graph of the GrapplerItem
+// it hands to the passes, see GrapplerItem::analysis_context). The owner is
+// the only one allowed to change the graph, and must call Invalidate() every
+// time it does. Results are only looked up and stored for the bound GraphDef
+// object itself: copies of the item share the context but not the graph, so
+// passes that infer shapes on a copy they are mutating never see stale
+// results.
+//
+// The results are shared rather than copied: GraphProperties copies them
+// before modifying them. The context is thread safe.
+class GraphAnalysisContext {
+ public:
+  // `graph` must outlive the context, or the context must be detached before
+  // `graph` is destroyed.
+  explicit GraphAnalysisContext(const GraphDef* graph);
+  ~GraphAnalysisContext() {}
+
+  // Drops all the results. Must be called whenever the graph changes.
+  void Invalidate();
+
+  // Drops all the results and stops keeping new ones.
+  void Detach();
+
+  // Records whether the function library of the graph is currently replaced
+  // with a stub (e.g. the MetaOptimizer does so for the passes that don't use
+  // it). Function bodies take part in shape inference, so results obtained
+  // with and without the stub are kept apart.
+  void set_function_library_stubbed(bool stubbed);
+
+  // Returns the properties of `graph` statically inferred with `options`, or
+  // nullptr if `graph` isn't the bound graph or they are unknown.
+  std::shared_ptr<InferredGraphProperties> FindStaticProperties(
+      const GraphDef& graph, const StaticInferenceOptions& options) const;
+
+  // Keeps the properties of `graph` statically inferred with `options`. Does
+  // nothing if `graph` isn't the bound graph.
+  void AddStaticProperties(const GraphDef& graph,
+                           const StaticInferenceOptions& options,
+                           std::shared_ptr<InferredGraphProperties> properties);
+
+ private:
+  int StaticPropertiesKey(const StaticInferenceOptions& options) const
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  mutable mutex mu_;
+  const GraphDef* graph_ TF_GUARDED_BY(mu_);
+  bool function_library_stubbed_ TF_GUARDED_BY(mu_) = false;
+  absl::flat_hash_map<int, std::shared_ptr<InferredGraphProperties>>
+      static_properties_ TF_GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(GraphAnalysisContext);
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_COSTS_GRAPH_ANALYSIS_CONTEXT_H_
@@ -45,6 +45,11 @@ class GraphMemory {
 
   Status InferStatically(
       const std::unordered_map<string, DeviceProperties>& devices);
+  // Same as above, and also returns the simulated execution trace in
+  // `metadata` for callers that need the timing of the nodes.
+  Status InferStatically(
+      const std::unordered_map<string, DeviceProperties>& devices,
+      RunMetadata* metadata);
   Status InferDynamically(Cluster* cluster);
 
   // Worst case memory usage in bytes, or -1 if the usage is unknown. If there
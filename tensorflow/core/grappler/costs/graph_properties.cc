@@ -27,6 +27,7 @@ limitations under the License.
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/graph/tensor_id.h"
+#include "tensorflow/core/grappler/costs/graph_analysis_context.h"
 #include "tensorflow/core/grappler/costs/utils.h"
 #include "tensorflow/core/grappler/mutable_graph_view.h"
 #include "tensorflow/core/grappler/op_types.h"
@@ -2337,6 +2338,37 @@ Status GraphProperties::InferStatically(bool assume_valid_feeds,
                                         bool aggressive_shape_inference,
                                         bool include_input_tensor_values,
                                         bool include_output_tensor_values) {
+  StaticInferenceOptions options;
+  options.assume_valid_feeds = assume_valid_feeds;
+  options.aggressive_shape_inference = aggressive_shape_inference;
+  options.include_input_tensor_values = include_input_tensor_values;
+  options.include_output_tensor_values = include_output_tensor_values;
+
+  // Properties inferred earlier, e.g. dynamically, are kept alongside the new
+  // ones: only share the results of inference on a blank slate.
+  GraphAnalysisContext* context =
+      has_properties() ? nullptr : item_.analysis_context.get();
+  if (context == nullptr) return ComputeStaticProperties(options);
+
+  std::shared_ptr<InferredGraphProperties> cached =
+      context->FindStaticProperties(item_.graph, options);
+  if (cached != nullptr) {
+    VLOG(2) << "Reusing the inferred properties of " << item_.id;
+    properties_ = std::move(cached);
+    return Status::OK();
+  }
+  TF_RETURN_IF_ERROR(ComputeStaticProperties(options));
+  context->AddStaticProperties(item_.graph, options, properties_);
+  return Status::OK();
+}
+
+Status GraphProperties::ComputeStaticProperties(
+    const StaticInferenceOptions& options) {
+  const bool assume_valid_feeds = options.assume_valid_feeds;
+  const bool aggressive_shape_inference = options.aggressive_shape_inference;
+  const bool include_input_tensor_values = options.include_input_tensor_values;
+  const bool include_output_tensor_values =
+      options.include_output_tensor_values;
   FunctionLibraryDefinition function_library(OpRegistry::Global(),
                                              item_.graph.library());
   absl::flat_hash_map<string, absl::flat_hash_set<int>> fed_ports;
@@ -2474,6 +2506,7 @@ Status GraphProperties::InferStatically(bool assume_valid_feeds,
     }
   }
 
+  InferredGraphProperties* properties = MutableProperties();
   for (const NodeDef& node : item_.graph.node()) {
     VLOG(3) << "Filling in graph properties for node: " << node.name();
     auto ctx = refiner->GetNodeContext(&node);
@@ -2485,7 +2518,7 @@ Status GraphProperties::InferStatically(bool assume_valid_feeds,
 
     // Fill input properties.
     {
-      auto& input_properties = input_properties_[node.name()];
+      auto& input_properties = properties->input_properties[node.name()];
 
       // Should always be empty, node names in graph are supposed to be unique.
       CHECK_EQ(input_properties.size(), 0);
@@ -2521,7 +2554,7 @@ Status GraphProperties::InferStatically(bool assume_valid_feeds,
 
     // Fill output properties.
     {
-      auto& output_properties = output_properties_[node.name()];
+      auto& output_properties = properties->output_properties[node.name()];
 
       // Should always be empty, node names in graph are supposed to be unique.
       CHECK_EQ(output_properties.size(), 0);
@@ -2558,16 +2591,17 @@ Status GraphProperties::InferStatically(bool assume_valid_feeds,
     }
 
     if (aggressive_shape_inference && ctx->shape_incompatible)
-      incompatible_shape_nodes_.insert(node.name());
+      properties->incompatible_shape_nodes.insert(node.name());
   }
 
-  if (aggressive_shape_inference && !incompatible_shape_nodes_.empty())
-    LOG(WARNING) << incompatible_shape_nodes_.size()
+  if (aggressive_shape_inference &&
+      !properties->incompatible_shape_nodes.empty())
+    LOG(WARNING) << properties->incompatible_shape_nodes.size()
                  << " nodes have incompatible output shapes.";
 
   // Help trace the unknown dimensions to their origins.
-  VerboseLogUnknownDimensionSources(item_.graph, input_properties_,
-                                    output_properties_);
+  VerboseLogUnknownDimensionSources(item_.graph, properties->input_properties,
+                                    properties->output_properties);
 
   return Status::OK();
 }
@@ -2608,6 +2642,7 @@ Status GraphProperties::InferFromCostGraph(const CostGraphDef& cost_graph) {
   }
   std::unordered_map<string, const CostGraphDef::Node*> name_to_cost;
   std::unordered_map<string, const NodeDef*> name_to_node;  // Empty
+  InferredGraphProperties* inferred = MutableProperties();
   for (auto& node : cost_graph.node()) {
     name_to_cost[node.name()] = &node;
 
@@ -2618,7 +2653,7 @@ Status GraphProperties::InferFromCostGraph(const CostGraphDef& cost_graph) {
       *properties.mutable_shape() = out.shape();
       output_properties.push_back(properties);
     }
-    output_properties_[node.name()] = output_properties;
+    inferred->output_properties[node.name()] = output_properties;
   }
 
   for (const auto& node : item_.graph.node()) {
@@ -2633,23 +2668,25 @@ Status GraphProperties::InferFromCostGraph(const CostGraphDef& cost_graph) {
     std::vector<OpInfo::TensorProperties> inputs =
         FindInputFeatures(node, name_to_cost, name_to_node);
 
-    input_properties_[node.name()] = inputs;
+    inferred->input_properties[node.name()] = inputs;
   }
   return Status::OK();
 }
 
 bool GraphProperties::HasInputProperties(const string& node_name) const {
-  return input_properties_.find(node_name) != input_properties_.end();
+  return properties_->input_properties.find(node_name) !=
+         properties_->input_properties.end();
 }
 
 bool GraphProperties::HasOutputProperties(const string& node_name) const {
-  return output_properties_.find(node_name) != output_properties_.end();
+  return properties_->output_properties.find(node_name) !=
+         properties_->output_properties.end();
 }
 
 const std::vector<OpInfo::TensorProperties>&
 GraphProperties::GetInputProperties(const string& node_name) const {
-  auto it = input_properties_.find(node_name);
-  if (it != input_properties_.end()) {
+  auto it = properties_->input_properties.find(node_name);
+  if (it != properties_->input_properties.end()) {
     return it->second;
   }
   return missing_properties_;
@@ -2657,18 +2694,25 @@ GraphProperties::GetInputProperties(const string& node_name) const {
 
 const std::vector<OpInfo::TensorProperties>&
 GraphProperties::GetOutputProperties(const string& node_name) const {
-  auto it = output_properties_.find(node_name);
-  if (it != output_properties_.end()) {
+  auto it = properties_->output_properties.find(node_name);
+  if (it != properties_->output_properties.end()) {
     return it->second;
   }
   return missing_properties_;
 }
 
 void GraphProperties::ClearInputProperties(const string& node_name) {
-  input_properties_.erase(node_name);
+  MutableProperties()->input_properties.erase(node_name);
 }
 void GraphProperties::ClearOutputProperties(const string& node_name) {
-  output_properties_.erase(node_name);
+  MutableProperties()->output_properties.erase(node_name);
+}
+
+InferredGraphProperties* GraphProperties::MutableProperties() {
+  if (properties_.use_count() > 1) {
+    properties_ = std::make_shared<InferredGraphProperties>(*properties_);
+  }
+  return properties_.get();
 }
 
 }  // end namespace grappler
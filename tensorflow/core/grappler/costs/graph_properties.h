@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_GRAPPLER_COSTS_GRAPH_PROPERTIES_H_
 #define TENSORFLOW_CORE_GRAPPLER_COSTS_GRAPH_PROPERTIES_H_
 
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -23,6 +24,7 @@ limitations under the License.
 #include "absl/container/flat_hash_map.h"
 #include "tensorflow/core/framework/shape_inference.h"
 #include "tensorflow/core/grappler/clusters/cluster.h"
+#include "tensorflow/core/grappler/costs/graph_analysis_context.h"
 #include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 
@@ -81,7 +83,9 @@ class TopoQueue;
 class GraphProperties {
  public:
   // The item must outlive the properties
-  explicit GraphProperties(const GrapplerItem& item) : item_(item) {}
+  explicit GraphProperties(const GrapplerItem& item)
+      : item_(item),
+        properties_(std::make_shared<InferredGraphProperties>()) {}
 
   // Infer the shapes through abstract interpretation. Feed information can be
   // incorrect so it should be discarded to ensure correctness of the analysis.
@@ -96,6 +100,8 @@ class GraphProperties {
   // will included in the input properties.
   // If include_output_tensor_values is true, the values of constant tensors
   // will be included in the output properties.
+  // If the item has an analysis context, the properties inferred by earlier
+  // calls with the same options are reused as long as the graph is unchanged.
   Status InferStatically(bool assume_valid_feeds,
                          bool aggressive_shape_inference,
                          bool include_input_tensor_values,
@@ -149,15 +155,23 @@ class GraphProperties {
   void ClearOutputProperties(const string& node_name);
   // Returns true if we have *any* properties.
   bool has_properties() const {
-    return !input_properties_.empty() || !output_properties_.empty();
+    return !properties_->input_properties.empty() ||
+           !properties_->output_properties.empty();
   }
 
   bool CheckShapeIncompatible(const string& node_name) const {
-    return incompatible_shape_nodes_.find(node_name) !=
-           incompatible_shape_nodes_.end();
+    return properties_->incompatible_shape_nodes.find(node_name) !=
+           properties_->incompatible_shape_nodes.end();
   }
 
  private:
+  // Runs the static shape inference.
+  Status ComputeStaticProperties(const StaticInferenceOptions& options);
+
+  // Returns the properties for modification, copying them first if they are
+  // shared with the analysis context of the item.
+  InferredGraphProperties* MutableProperties();
+
   // Relaxes shapes <shapes_and_types>, determined from an EnqueueV2 node, into
   // <*queue_shapes_and_types>.
   static Status RelaxEnqueueShapesAndMergeTypes(
@@ -201,15 +215,9 @@ class GraphProperties {
 
   // Data members
   const GrapplerItem& item_;
-  absl::flat_hash_map<string, std::vector<OpInfo::TensorProperties>>
-      input_properties_;
-  absl::flat_hash_map<string, std::vector<OpInfo::TensorProperties>>
-      output_properties_;
+  // Never null. May be shared with item_.analysis_context.
+  std::shared_ptr<InferredGraphProperties> properties_;
   const std::vector<OpInfo::TensorProperties> missing_properties_;
-
-  // Nodes with output shape incompatible between shape inference and
-  // annotation.
-  std::unordered_set<string> incompatible_shape_nodes_;
 };
 
 // Helper function for GraphProperties.
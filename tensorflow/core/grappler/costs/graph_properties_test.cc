@@ -26,6 +26,7 @@ limitations under the License.
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/grappler/clusters/single_machine.h"
+#include "tensorflow/core/grappler/costs/graph_analysis_context.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/inputs/trivial_test_graph_input_yielder.h"
 #include "tensorflow/core/grappler/inputs/utils.h"
@@ -215,6 +216,57 @@ TEST_F(GraphPropertiesTest, ClearProperties) {
   }
 }
 
+TEST_F(GraphPropertiesTest, ReusesPropertiesOfUnchangedGraph) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({10, 1}));
+  Output y = ops::Square(s.WithOpName("y"), x);
+  GrapplerItem item;
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+  item.analysis_context = std::make_shared<GraphAnalysisContext>(&item.graph);
+
+  GraphProperties properties(item);
+  TF_ASSERT_OK(properties.InferStatically(false));
+  EXPECT_EQ(10, properties.GetOutputProperties("y")[0].shape().dim(0).size());
+
+  // Change the graph without telling the context: the properties inferred for
+  // the original graph are reused.
+  for (NodeDef& node : *item.graph.mutable_node()) {
+    if (node.name() == "x") {
+      TensorShape({20, 1}).AsProto(
+          (*node.mutable_attr())["shape"].mutable_shape());
+    }
+  }
+  GraphProperties reused(item);
+  TF_ASSERT_OK(reused.InferStatically(false));
+  EXPECT_EQ(10, reused.GetOutputProperties("y")[0].shape().dim(0).size());
+
+  // Clearing the reused properties doesn't affect the shared ones.
+  reused.ClearOutputProperties("y");
+  EXPECT_FALSE(reused.HasOutputProperties("y"));
+  GraphProperties reused_again(item);
+  TF_ASSERT_OK(reused_again.InferStatically(false));
+  EXPECT_TRUE(reused_again.HasOutputProperties("y"));
+
+  // Properties are only reused for the same options.
+  GraphProperties other_options(item);
+  TF_ASSERT_OK(other_options.InferStatically(true));
+  EXPECT_EQ(20,
+            other_options.GetOutputProperties("y")[0].shape().dim(0).size());
+
+  // Copies of the item share the context but not the graph.
+  GrapplerItem copy = item;
+  GraphProperties copy_properties(copy);
+  TF_ASSERT_OK(copy_properties.InferStatically(false));
+  EXPECT_EQ(20,
+            copy_properties.GetOutputProperties("y")[0].shape().dim(0).size());
+
+  item.analysis_context->Invalidate();
+  GraphProperties updated(item);
+  TF_ASSERT_OK(updated.InferStatically(false));
+  EXPECT_EQ(20, updated.GetOutputProperties("y")[0].shape().dim(0).size());
+}
+
 TEST_F(GraphPropertiesTest, DynamicProperties) {
   TrivialTestGraphInputYielder fake_input(4, 1, 10, false,
                                           cluster_->GetDeviceNames());
@@ -0,0 +1,158 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/costs/op_cost_calibration.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace grappler {
+
+OpCostCalibrationTable::OpCostCalibrationTable(
+    const OpCostCalibration& calibration) {
+  for (const auto& entry : calibration.entries()) {
+    Curve& curve = curves_[std::make_pair(entry.op(), entry.device_type())];
+    curve.clear();
+    for (const auto& point : entry.points()) {
+      if (point.predicted_time() < 0 || point.measured_time() < 0) continue;
+      curve.emplace_back(point.predicted_time(), point.measured_time());
+    }
+    std::sort(curve.begin(), curve.end());
+    if (curve.empty()) {
+      curves_.erase(std::make_pair(entry.op(), entry.device_type()));
+    }
+  }
+}
+
+/* static */
+Status OpCostCalibrationTable::Load(
+    Env* env, const string& path,
+    std::unique_ptr<OpCostCalibrationTable>* table) {
+  OpCostCalibration calibration;
+  Status s = ReadBinaryProto(env, path, &calibration);
+  if (!s.ok()) {
+    calibration.Clear();
+    s = ReadTextProto(env, path, &calibration);
+  }
+  if (!s.ok()) {
+    return errors::InvalidArgument("Can't read op cost calibration from ",
+                                   path, ": ", s.error_message());
+  }
+  table->reset(new OpCostCalibrationTable(calibration));
+  return Status::OK();
+}
+
+/* static */
+const OpCostCalibrationTable* OpCostCalibrationTable::Global() {
+  static const OpCostCalibrationTable* table = []() {
+    string path;
+    Status s = ReadStringFromEnvVar(kOpCostCalibrationEnvVar, "", &path);
+    if (!s.ok() || path.empty()) {
+      return static_cast<OpCostCalibrationTable*>(nullptr);
+    }
+    std::unique_ptr<OpCostCalibrationTable> loaded;
+    s = Load(Env::Default(), path, &loaded);
+    if (!s.ok()) {
+      LOG(WARNING) << s;
+      return static_cast<OpCostCalibrationTable*>(nullptr);
+    }
+    VLOG(1) << "Loaded " << loaded->num_curves()
+            << " op cost calibration curves from " << path;
+    return loaded.release();
+  }();
+  return table;
+}
+
+/* static */
+void OpCostCalibrationTable::FitCurve(
+    const string& op, const string& device_type,
+    std::vector<std::pair<double, double>> samples,
+    OpCostCalibration::Entry* entry) {
+  entry->Clear();
+  entry->set_op(op);
+  entry->set_device_type(device_type);
+  std::sort(samples.begin(), samples.end());
+
+  // Pool adjacent violators: each block holds the mean measured time of a run
+  // of consecutive samples, and adjacent blocks are merged until the means
+  // are non-decreasing.
+  struct Block {
+    double predicted;
+    double measured_sum;
+    int count;
+    double mean() const { return measured_sum / count; }
+  };
+  std::vector<Block> blocks;
+  for (const auto& sample : samples) {
+    if (sample.first < 0 || sample.second < 0) continue;
+    if (!blocks.empty() && blocks.back().predicted == sample.first) {
+      blocks.back().measured_sum += sample.second;
+      blocks.back().count++;
+    } else {
+      blocks.push_back({sample.first, sample.second, 1});
+    }
+    while (blocks.size() > 1 &&
+           blocks[blocks.size() - 2].mean() > blocks.back().mean()) {
+      Block last = blocks.back();
+      blocks.pop_back();
+      // The merged block keeps the predicted time of its first sample, so
+      // that the plateau starts where the violation was first observed.
+      blocks.back().measured_sum += last.measured_sum;
+      blocks.back().count += last.count;
+    }
+  }
+  for (const Block& block : blocks) {
+    auto* point = entry->add_points();
+    point->set_predicted_time(block.predicted);
+    point->set_measured_time(block.mean());
+  }
+}
+
+bool OpCostCalibrationTable::Calibrate(const string& op,
+                                       const string& device_type,
+                                       double predicted_ns,
+                                       double* measured_ns) const {
+  auto it = curves_.find(std::make_pair(op, device_type));
+  if (it == curves_.end()) {
+    return false;
+  }
+  const Curve& curve = it->second;
+  if (predicted_ns <= curve.front().first) {
+    *measured_ns = curve.front().second;
+    return true;
+  }
+  if (predicted_ns >= curve.back().first) {
+    const double ratio = curve.back().first > 0
+                             ? curve.back().second / curve.back().first
+                             : 1.0;
+    *measured_ns = std::max(curve.back().second, predicted_ns * ratio);
+    return true;
+  }
+  auto upper = std::upper_bound(
+      curve.begin(), curve.end(), predicted_ns,
+      [](double x, const std::pair<double, double>& p) { return x < p.first; });
+  auto lower = upper - 1;
+  const double t =
+      (predicted_ns - lower->first) / (upper->first - lower->first);
+  *measured_ns = lower->second + t * (upper->second - lower->second);
+  return true;
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
@@ -0,0 +1,86 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_COSTS_OP_COST_CALIBRATION_H_
+#define TENSORFLOW_CORE_GRAPPLER_COSTS_OP_COST_CALIBRATION_H_
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Environment variable naming an OpCostCalibration file (binary or text
+// proto) used by every OpLevelCostEstimator of the process.
+constexpr char kOpCostCalibrationEnvVar[] = "TF_GRAPPLER_OP_COST_CALIBRATION";
+
+// Maps the execution time predicted by the analytical cost model for an op to
+// the execution time measured on the local machine.
+//
+// Each (op, device type) pair has a curve of (predicted, measured) points.
+// Between two points the measured time is interpolated linearly. Below the
+// first point the measured time of the first point is used, since small ops
+// are dominated by a fixed per-op overhead. Above the last point the ratio of
+// the last point is applied, i.e. the largest measured size is assumed to run
+// at the asymptotic throughput of the op.
+class OpCostCalibrationTable {
+ public:
+  explicit OpCostCalibrationTable(const OpCostCalibration& calibration);
+
+  // Reads a binary or text OpCostCalibration proto from `path`.
+  static Status Load(Env* env, const string& path,
+                     std::unique_ptr<OpCostCalibrationTable>* table);
+
+  // Returns the table read from the file named by kOpCostCalibrationEnvVar, or
+  // nullptr if the variable isn't set or the file can't be read. The file is
+  // read once per process.
+  static const OpCostCalibrationTable* Global();
+
+  // Fits a calibration curve for `op` from (predicted, measured) samples and
+  // stores it in `entry`. Samples with the same predicted time are averaged,
+  // and the curve is made monotonic (isotonic regression) so that noisy
+  // measurements never make a larger op cheaper than a smaller one.
+  static void FitCurve(const string& op, const string& device_type,
+                       std::vector<std::pair<double, double>> samples,
+                       OpCostCalibration::Entry* entry);
+
+  // Returns true and sets `measured_ns` if `op` is calibrated on devices of
+  // type `device_type`.
+  bool Calibrate(const string& op, const string& device_type,
+                 double predicted_ns, double* measured_ns) const;
+
+  int num_curves() const { return curves_.size(); }
+
+ private:
+  // (predicted, measured) points sorted by predicted time.
+  using Curve = std::vector<std::pair<double, double>>;
+
+  absl::flat_hash_map<std::pair<string, string>, Curve> curves_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(OpCostCalibrationTable);
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_COSTS_OP_COST_CALIBRATION_H_
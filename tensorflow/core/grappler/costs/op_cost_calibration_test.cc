@@ -0,0 +1,140 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/costs/op_cost_calibration.h"
+
+#include "tensorflow/core/grappler/costs/op_level_cost_estimator.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+OpCostCalibration MakeCalibration() {
+  OpCostCalibration calibration;
+  OpCostCalibrationTable::FitCurve(
+      "Relu", "CPU", {{100, 1000}, {1000, 1500}, {10000, 5000}},
+      calibration.add_entries());
+  return calibration;
+}
+
+OpContext DescribeRelu(int64 elements) {
+  OpContext op_context;
+  auto& op_info = op_context.op_info;
+  op_info.set_op("Relu");
+  auto* input = op_info.add_inputs();
+  input->set_dtype(DT_FLOAT);
+  input->mutable_shape()->add_dim()->set_size(elements);
+  *op_info.add_outputs() = *input;
+  auto* device = op_info.mutable_device();
+  device->set_type("CPU");
+  device->set_num_cores(10);
+  device->set_bandwidth(10000000);
+  device->set_frequency(1000);
+  return op_context;
+}
+
+TEST(OpCostCalibrationTest, FitCurveIsMonotonic) {
+  OpCostCalibration::Entry entry;
+  OpCostCalibrationTable::FitCurve(
+      "MatMul", "CPU", {{300, 50}, {100, 10}, {200, 40}, {100, 20}, {400, 90}},
+      &entry);
+  EXPECT_EQ("MatMul", entry.op());
+  EXPECT_EQ("CPU", entry.device_type());
+  // The two samples at 100 are averaged.
+  ASSERT_EQ(4, entry.points_size());
+  EXPECT_EQ(100, entry.points(0).predicted_time());
+  EXPECT_EQ(15, entry.points(0).measured_time());
+  EXPECT_EQ(90, entry.points(3).measured_time());
+
+  OpCostCalibrationTable::FitCurve("MatMul", "CPU",
+                                   {{100, 10}, {200, 40}, {300, 20}}, &entry);
+  ASSERT_EQ(2, entry.points_size());
+  EXPECT_EQ(100, entry.points(0).predicted_time());
+  EXPECT_EQ(10, entry.points(0).measured_time());
+  EXPECT_EQ(200, entry.points(1).predicted_time());
+  EXPECT_EQ(30, entry.points(1).measured_time());
+}
+
+TEST(OpCostCalibrationTest, Calibrate) {
+  OpCostCalibrationTable table(MakeCalibration());
+  double measured;
+  EXPECT_FALSE(table.Calibrate("Relu", "GPU", 100, &measured));
+  EXPECT_FALSE(table.Calibrate("Tanh", "CPU", 100, &measured));
+
+  // Below the curve: fixed overhead.
+  ASSERT_TRUE(table.Calibrate("Relu", "CPU", 0, &measured));
+  EXPECT_EQ(1000, measured);
+  // Linear interpolation.
+  ASSERT_TRUE(table.Calibrate("Relu", "CPU", 550, &measured));
+  EXPECT_EQ(1250, measured);
+  // Above the curve: asymptotic throughput.
+  ASSERT_TRUE(table.Calibrate("Relu", "CPU", 20000, &measured));
+  EXPECT_EQ(10000, measured);
+}
+
+TEST(OpCostCalibrationTest, Load) {
+  const string path = io::JoinPath(testing::TmpDir(), "calibration.pbtxt");
+  TF_ASSERT_OK(WriteTextProto(Env::Default(), path, MakeCalibration()));
+  std::unique_ptr<OpCostCalibrationTable> table;
+  TF_ASSERT_OK(OpCostCalibrationTable::Load(Env::Default(), path, &table));
+  EXPECT_EQ(1, table->num_curves());
+
+  EXPECT_FALSE(OpCostCalibrationTable::Load(
+                   Env::Default(), io::JoinPath(testing::TmpDir(), "missing"),
+                   &table)
+                   .ok());
+}
+
+TEST(OpCostCalibrationTest, CalibratedEstimator) {
+  OpLevelCostEstimator estimator;
+  estimator.set_calibration(nullptr);
+  const OpContext op_context = DescribeRelu(1 << 20);
+  const Costs uncalibrated = estimator.PredictCosts(op_context);
+
+  OpCostCalibration calibration;
+  OpCostCalibrationTable::FitCurve(
+      "Relu", "CPU",
+      {{0, 500},
+       {static_cast<double>(uncalibrated.execution_time.count()), 1000000}},
+      calibration.add_entries());
+  OpCostCalibrationTable table(calibration);
+  estimator.set_calibration(&table);
+
+  const Costs calibrated = estimator.PredictCosts(op_context);
+  EXPECT_EQ(1000000, calibrated.execution_time.count());
+  EXPECT_FALSE(calibrated.inaccurate);
+  const double scale = 1000000.0 / uncalibrated.execution_time.count();
+  EXPECT_NEAR(uncalibrated.compute_time.count() * scale,
+              calibrated.compute_time.count(), 1);
+  EXPECT_NEAR(uncalibrated.memory_time.count() * scale,
+              calibrated.memory_time.count(), 1);
+
+  // Ops without a curve keep their analytical cost.
+  OpContext tanh_context = op_context;
+  tanh_context.op_info.set_op("Tanh");
+  estimator.set_calibration(nullptr);
+  const Costs expected = estimator.PredictCosts(tanh_context);
+  estimator.set_calibration(&table);
+  EXPECT_EQ(expected.execution_time, estimator.PredictCosts(tanh_context)
+                                         .execution_time);
+}
+
+}  // namespace
+}  // end namespace grappler
+}  // end namespace tensorflow
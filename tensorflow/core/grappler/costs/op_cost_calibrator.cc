@@ -0,0 +1,226 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/costs/op_cost_calibrator.h"
+
+#include <algorithm>
+#include <map>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/grappler/clusters/utils.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/costs/op_cost_calibration.h"
+#include "tensorflow/core/grappler/costs/op_level_cost_estimator.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+constexpr char kCalibratedOpName[] = "calibrated_op";
+
+Tensor RandomTensor(const TensorShape& shape) {
+  Tensor t(DT_FLOAT, shape);
+  t.flat<float>().setRandom();
+  return t;
+}
+
+Tensor Int32Vector(const std::vector<int32>& values) {
+  Tensor t(DT_INT32, TensorShape({static_cast<int64>(values.size())}));
+  std::copy(values.begin(), values.end(), t.flat<int32>().data());
+  return t;
+}
+
+AttrValue IntListAttr(const std::vector<int64>& values) {
+  AttrValue attr;
+  SetAttrValue(gtl::ArraySlice<int64>(values), &attr);
+  return attr;
+}
+
+AttrValue StringAttr(const string& value) {
+  AttrValue attr;
+  SetAttrValue(value, &attr);
+  return attr;
+}
+
+// Builds a graph feeding the inputs of `c` as constants to the op if
+// `with_op` is true, or a graph made of the constants only otherwise.
+Status BuildCalibrationGraph(const OpCalibrationCase& c, bool with_op,
+                             Graph** graph) {
+  std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
+  std::vector<Node*> inputs;
+  for (const Tensor& t : c.inputs) {
+    inputs.push_back(test::graph::Constant(g.get(), t));
+  }
+  if (with_op) {
+    NodeBuilder builder(kCalibratedOpName, c.op);
+    for (Node* input : inputs) {
+      builder.Input(input);
+    }
+    for (const auto& attr : c.attrs) {
+      builder.Attr(attr.first, attr.second);
+    }
+    Node* node;
+    TF_RETURN_IF_ERROR(builder.Finalize(g.get(), &node));
+  }
+  *graph = g.release();
+  return Status::OK();
+}
+
+// Predicts the execution time of the op of `c` the way the VirtualScheduler
+// would, from the statically inferred properties of its inputs and outputs.
+Status PredictTime(const OpCalibrationCase& c,
+                   const DeviceProperties& device, double* predicted_ns) {
+  Graph* graph;
+  TF_RETURN_IF_ERROR(BuildCalibrationGraph(c, /*with_op=*/true, &graph));
+  GrapplerItem item;
+  graph->ToGraphDef(&item.graph);
+  delete graph;
+
+  GraphProperties properties(item);
+  TF_RETURN_IF_ERROR(properties.InferStatically(false));
+  const NodeDef* node = nullptr;
+  for (const NodeDef& n : item.graph.node()) {
+    if (n.name() == kCalibratedOpName) node = &n;
+  }
+  if (node == nullptr) {
+    return errors::Internal("Missing calibrated node for op ", c.op);
+  }
+
+  OpContext op_context;
+  op_context.name = node->name();
+  auto& op_info = op_context.op_info;
+  op_info.set_op(node->op());
+  *op_info.mutable_attr() = node->attr();
+  for (const auto& input : properties.GetInputProperties(node->name())) {
+    *op_info.add_inputs() = input;
+  }
+  for (const auto& output : properties.GetOutputProperties(node->name())) {
+    *op_info.add_outputs() = output;
+  }
+  *op_info.mutable_device() = device;
+
+  OpLevelCostEstimator estimator;
+  estimator.set_calibration(nullptr);
+  *predicted_ns = estimator.PredictCosts(op_context).execution_time.count();
+  return Status::OK();
+}
+
+// Returns the time of one run of `graph`, which is consumed. Every call to
+// Benchmark::Run() starts with a few warmup steps, so the time per run is
+// derived from the difference between n and 2n runs.
+double MeasureNanosPerRun(Graph* graph, const OpCalibrationOptions& options) {
+  test::Benchmark bm("cpu", graph);
+  Env* env = Env::Default();
+  for (int iters = 1;; iters *= 2) {
+    const uint64 start = env->NowMicros();
+    bm.Run(iters);
+    const uint64 middle = env->NowMicros();
+    bm.Run(2 * iters);
+    const uint64 end = env->NowMicros();
+    if (end - start >= options.min_time_us || iters >= (1 << 20)) {
+      const double delta = static_cast<double>(end - middle) -
+                           static_cast<double>(middle - start);
+      return std::max(0.0, delta * 1000.0 / iters);
+    }
+  }
+}
+
+}  // namespace
+
+std::vector<OpCalibrationCase> DefaultOpCalibrationCases() {
+  std::vector<OpCalibrationCase> cases;
+  for (int64 n : {16, 64, 256, 512}) {
+    cases.push_back({"MatMul",
+                     {RandomTensor(TensorShape({n, n})),
+                      RandomTensor(TensorShape({n, n}))},
+                     {}});
+  }
+  for (int64 size : {8, 16, 32, 64}) {
+    cases.push_back({"Conv2D",
+                     {RandomTensor(TensorShape({8, size, size, 32})),
+                      RandomTensor(TensorShape({3, 3, 32, 32}))},
+                     {{"strides", IntListAttr({1, 1, 1, 1})},
+                      {"padding", StringAttr("SAME")}}});
+    for (const char* pool : {"MaxPool", "AvgPool"}) {
+      cases.push_back({pool,
+                       {RandomTensor(TensorShape({8, size, size, 32}))},
+                       {{"ksize", IntListAttr({1, 3, 3, 1})},
+                        {"strides", IntListAttr({1, 2, 2, 1})},
+                        {"padding", StringAttr("SAME")}}});
+    }
+  }
+  for (int64 rows : {1, 16, 256, 4096}) {
+    const TensorShape shape({rows, 1024});
+    for (const char* op : {"Relu", "Tanh", "Sigmoid", "Exp", "Softmax"}) {
+      cases.push_back({op, {RandomTensor(shape)}, {}});
+    }
+    for (const char* op : {"Add", "Mul", "RealDiv"}) {
+      cases.push_back({op, {RandomTensor(shape), RandomTensor(shape)}, {}});
+    }
+    cases.push_back(
+        {"BiasAdd", {RandomTensor(shape), RandomTensor(TensorShape({1024}))},
+         {}});
+    for (const char* op : {"Sum", "Mean"}) {
+      cases.push_back({op, {RandomTensor(shape), Int32Vector({1})}, {}});
+    }
+    cases.push_back(
+        {"Transpose", {RandomTensor(shape), Int32Vector({1, 0})}, {}});
+  }
+  return cases;
+}
+
+Status CalibrateOpCosts(const std::vector<OpCalibrationCase>& cases,
+                        const OpCalibrationOptions& options,
+                        OpCostCalibration* calibration) {
+  const DeviceProperties device = GetLocalCPUInfo();
+  std::map<string, std::vector<std::pair<double, double>>> samples;
+  for (const OpCalibrationCase& c : cases) {
+    double predicted_ns;
+    TF_RETURN_IF_ERROR(PredictTime(c, device, &predicted_ns));
+
+    Graph* op_graph;
+    TF_RETURN_IF_ERROR(BuildCalibrationGraph(c, /*with_op=*/true, &op_graph));
+    const double op_ns = MeasureNanosPerRun(op_graph, options);
+    Graph* input_graph;
+    TF_RETURN_IF_ERROR(
+        BuildCalibrationGraph(c, /*with_op=*/false, &input_graph));
+    const double input_ns = MeasureNanosPerRun(input_graph, options);
+    const double measured_ns = std::max(0.0, op_ns - input_ns);
+
+    VLOG(1) << "Op " << c.op << ": predicted " << predicted_ns
+            << " ns, measured " << measured_ns << " ns.";
+    samples[c.op].emplace_back(predicted_ns, measured_ns);
+  }
+
+  calibration->Clear();
+  for (auto& op_samples : samples) {
+    OpCostCalibrationTable::FitCurve(op_samples.first, device.type(),
+                                     std::move(op_samples.second),
+                                     calibration->add_entries());
+  }
+  return Status::OK();
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
@@ -0,0 +1,60 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_COSTS_OP_COST_CALIBRATOR_H_
+#define TENSORFLOW_CORE_GRAPPLER_COSTS_OP_COST_CALIBRATOR_H_
+
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// A single op invocation to measure. The inputs are fed as constants, and the
+// type attributes of the op are inferred from them.
+struct OpCalibrationCase {
+  string op;
+  std::vector<Tensor> inputs;
+  std::vector<std::pair<string, AttrValue>> attrs;
+};
+
+struct OpCalibrationOptions {
+  // Minimum time spent measuring each case.
+  int64 min_time_us = 100000;
+};
+
+// Returns a set of common ops (matrix multiplications, convolutions, pooling,
+// reductions and element-wise ops) over a range of sizes.
+std::vector<OpCalibrationCase> DefaultOpCalibrationCases();
+
+// Runs each case on the local CPU, compares its measured execution time to
+// the time predicted by the analytical OpLevelCostEstimator model, and fits
+// one calibration curve per op. The execution time of a case is the time of
+// the graph running the op minus the time of the graph producing its inputs,
+// so that the executor overhead shared by both graphs cancels out.
+Status CalibrateOpCosts(const std::vector<OpCalibrationCase>& cases,
+                        const OpCalibrationOptions& options,
+                        OpCostCalibration* calibration);
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_COSTS_OP_COST_CALIBRATOR_H_
@@ -25,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/grappler/clusters/utils.h"
 #include "tensorflow/core/grappler/costs/op_context.h"
+#include "tensorflow/core/grappler/costs/op_cost_calibration.h"
 #include "tensorflow/core/grappler/costs/utils.h"
 
 namespace tensorflow {
@@ -612,9 +613,49 @@ OpLevelCostEstimator::OpLevelCostEstimator() {
 
   // By default, use sum of memory_time and compute_time for execution_time.
   compute_memory_overlap_ = false;
+
+  calibration_ = OpCostCalibrationTable::Global();
 }
 
 Costs OpLevelCostEstimator::PredictCosts(const OpContext& op_context) const {
+  Costs costs = PredictUncalibratedCosts(op_context);
+  if (calibration_ != nullptr) {
+    CalibrateCosts(op_context.op_info, &costs);
+  }
+  return costs;
+}
+
+void OpLevelCostEstimator::CalibrateCosts(const OpInfo& op_info,
+                                          Costs* costs) const {
+  const double predicted = costs->execution_time.count();
+  double measured;
+  if (!calibration_->Calibrate(op_info.op(), op_info.device().type(),
+                               predicted, &measured)) {
+    return;
+  }
+  VLOG(1) << "Calibrated operation " << op_info.op() << " from " << predicted
+          << " ns to " << measured << " ns.";
+  if (predicted > 0) {
+    const double scale = measured / predicted;
+    auto rescale = [scale](Costs::Duration* d) {
+      *d = Costs::Duration(d->count() * scale);
+    };
+    rescale(&costs->compute_time);
+    rescale(&costs->memory_time);
+    rescale(&costs->intermediate_memory_time);
+    rescale(&costs->intermediate_memory_read_time);
+    rescale(&costs->intermediate_memory_write_time);
+  } else {
+    costs->compute_time = Costs::Duration(measured);
+  }
+  costs->execution_time = Costs::Duration(measured);
+  // The measurement replaces the missing or approximate analytical model, but
+  // the prediction is still off if the shapes weren't known.
+  costs->inaccurate = costs->num_ops_with_unknown_shapes > 0;
+}
+
+Costs OpLevelCostEstimator::PredictUncalibratedCosts(
+    const OpContext& op_context) const {
   const auto& op_info = op_context.op_info;
   auto it = device_cost_impl_.find(op_info.op());
   if (it != device_cost_impl_.end()) {
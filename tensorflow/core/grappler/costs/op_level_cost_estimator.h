@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "tensorflow/core/grappler/costs/cost_estimator.h"
 #include "tensorflow/core/grappler/costs/op_context.h"
+#include "tensorflow/core/grappler/costs/op_cost_calibration.h"
 #include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
 #include "tensorflow/core/util/padding.h"
 
@@ -39,7 +40,20 @@ class OpLevelCostEstimator {
   // Returns basic device performance info.
   virtual DeviceInfo GetDeviceInfo(const DeviceProperties& device) const;
 
+  // Measured op costs used to correct the analytical predictions. Defaults to
+  // OpCostCalibrationTable::Global(); nullptr disables calibration. Not owned.
+  void set_calibration(const OpCostCalibrationTable* calibration) {
+    calibration_ = calibration;
+  }
+
  protected:
+  // Predicts the cost of an op with the analytical model only.
+  Costs PredictUncalibratedCosts(const OpContext& op_context) const;
+
+  // Replaces the predicted execution time of `costs` by the measured one if
+  // the op is calibrated, and scales the other times by the same factor.
+  void CalibrateCosts(const OpInfo& op_info, Costs* costs) const;
+
   // Predict cost of an op for which no accurate estimator is defined.
   Costs PredictCostOfAnUnknownOp(const OpContext& op_context) const;
 
@@ -208,6 +222,7 @@ class OpLevelCostEstimator {
   // compute_time and memory_time, instead of sum of those two.
   bool compute_memory_overlap_;
   std::set<string> persistent_ops_;
+  const OpCostCalibrationTable* calibration_;
 
  private:
   friend class OpLevelCostEstimatorTest;
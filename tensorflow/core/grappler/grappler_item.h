@@ -31,6 +31,8 @@ limitations under the License.
 namespace tensorflow {
 namespace grappler {
 
+class GraphAnalysisContext;
+
 // A TensorFlow model to optimize.
 // Models are represented by the combination of a graph, one of more fetch
 // nodes, and potentially a set of nodes to feed.
@@ -70,6 +72,11 @@ struct GrapplerItem {
   // ensure that the optimized metagraph can still be loaded.
   std::vector<string> keep_ops;
 
+  // Analyses of `graph` shared by the optimizers of this item, e.g. inferred
+  // shapes, or null. Set by the owner of the item, which must keep it in sync
+  // with the graph (see GraphAnalysisContext).
+  std::shared_ptr<GraphAnalysisContext> analysis_context;
+
   // Return the set of node evaluated during a regular train/inference step.
   std::vector<const NodeDef*> MainOpsFanin() const;
   // Return the set of node run to populate the queues (if any).
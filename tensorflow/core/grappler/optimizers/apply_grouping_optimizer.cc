@@ -0,0 +1,301 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/apply_grouping_optimizer.h"
+
+#include <deque>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/utils.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+// An optimizer update op that can be grouped into a multi-variable op.
+struct GroupableApply {
+  const char* op;
+  const char* multi_op;
+  // Number of slot variables, e.g. m and v for Adam.
+  int num_slots;
+  // Number of hyperparameter inputs between the slots and the gradient.
+  int num_hyperparameters;
+  // Boolean attribute besides use_locking, and its default value.
+  const char* flag_attr;
+  bool flag_default;
+};
+
+constexpr GroupableApply kGroupableApplies[] = {
+    {"ResourceApplyAdam", "_ResourceApplyAdamMulti", 2, 6, "use_nesterov",
+     false},
+    {"ResourceApplyAdagrad", "_ResourceApplyAdagradMulti", 1, 1,
+     "update_slots", true},
+};
+
+// Groups are only formed from at least this many updates.
+constexpr int kMinGroupSize = 2;
+
+const GroupableApply* FindGroupableApply(const NodeDef& node) {
+  for (const GroupableApply& apply : kGroupableApplies) {
+    if (node.op() == apply.op) return &apply;
+  }
+  return nullptr;
+}
+
+bool GetBoolAttr(const NodeDef& node, const string& name, bool default_value) {
+  bool value;
+  return GetNodeAttr(node, name, &value).ok() ? value : default_value;
+}
+
+// Returns the key under which `node` is grouped, or an empty string if it
+// can't be grouped.
+string GroupKey(const NodeDef& node, const GroupableApply& apply,
+                const std::unordered_set<string>& nodes_to_preserve) {
+  if (!NodeIsOnCpu(&node) || nodes_to_preserve.count(node.name()) > 0) {
+    return "";
+  }
+  const int num_regular_inputs =
+      apply.num_slots + apply.num_hyperparameters + 2;
+  if (NumNonControlInputs(node) != num_regular_inputs) return "";
+  DataType dtype;
+  if (!GetNodeAttr(node, "T", &dtype).ok() ||
+      (dtype != DT_HALF && dtype != DT_BFLOAT16 && dtype != DT_FLOAT &&
+       dtype != DT_DOUBLE)) {
+    return "";
+  }
+  std::vector<string> hyperparameters(
+      node.input().begin() + apply.num_slots + 1,
+      node.input().begin() + apply.num_slots + 1 + apply.num_hyperparameters);
+  return absl::StrCat(node.op(), ";", node.device(), ";", dtype, ";",
+                      GetBoolAttr(node, "use_locking", false), ";",
+                      GetBoolAttr(node, apply.flag_attr, apply.flag_default),
+                      ";", absl::StrJoin(hyperparameters, ","));
+}
+
+// Returns true if a node of `group` is reachable from another one once the
+// groups already formed are contracted into their multi-variable ops, in
+// which case contracting `group` too would create a cycle. `replaced_by` maps
+// the nodes of the formed groups to the names of their multi-variable ops,
+// and `formed_groups` maps those names to the nodes they replace.
+bool CreatesCycle(
+    const std::vector<const NodeDef*>& group, const NodeMap& node_map,
+    const absl::flat_hash_map<string, string>& replaced_by,
+    const absl::flat_hash_map<string, std::vector<const NodeDef*>>&
+        formed_groups) {
+  absl::flat_hash_set<const NodeDef*> members(group.begin(), group.end());
+  absl::flat_hash_set<const NodeDef*> visited;
+  absl::flat_hash_set<string> visited_groups;
+  std::deque<const NodeDef*> queue;
+  const auto enqueue_outputs = [&](const NodeDef* node) {
+    for (const NodeDef* output : node_map.GetOutputs(node->name())) {
+      if (visited.insert(output).second) queue.push_back(output);
+    }
+  };
+  for (const NodeDef* node : group) enqueue_outputs(node);
+  while (!queue.empty()) {
+    const NodeDef* node = queue.front();
+    queue.pop_front();
+    if (members.contains(node)) return true;
+    auto it = replaced_by.find(node->name());
+    if (it == replaced_by.end()) {
+      enqueue_outputs(node);
+    } else if (visited_groups.insert(it->second).second) {
+      // A multi-variable op has the outputs of all the nodes it replaces.
+      for (const NodeDef* grouped : formed_groups.at(it->second)) {
+        enqueue_outputs(grouped);
+      }
+    }
+  }
+  return false;
+}
+
+// Returns the container, shared name and device of the resource variable
+// whose handle is `input`, or an empty string if the handle doesn't come
+// from a VarHandleOp.  Distinct VarHandleOps with the same values refer to
+// the same variable.
+string ResolveVariable(const string& input, const NodeMap& node_map) {
+  const NodeDef* node = node_map.GetNode(input);
+  while (node != nullptr && IsIdentity(*node) && node->input_size() > 0 &&
+         !IsControlInput(node->input(0))) {
+    node = node_map.GetNode(node->input(0));
+  }
+  string container;
+  string shared_name;
+  if (node == nullptr || node->op() != "VarHandleOp" ||
+      !GetNodeAttr(*node, "container", &container).ok() ||
+      !GetNodeAttr(*node, "shared_name", &shared_name).ok()) {
+    return "";
+  }
+  return absl::StrCat(container, ";", shared_name, ";", node->device());
+}
+
+// Drops the updates of variables or slots already updated by an earlier
+// member of `group`, which must stay sequential, and the updates of
+// variables that can't be told apart from the others.
+std::vector<const NodeDef*> WithDistinctVariables(
+    const std::vector<const NodeDef*>& group, const GroupableApply& apply,
+    const NodeMap& node_map) {
+  std::vector<const NodeDef*> result;
+  absl::flat_hash_set<string> variables;
+  for (const NodeDef* node : group) {
+    std::vector<string> node_variables;
+    bool distinct = true;
+    for (int i = 0; distinct && i <= apply.num_slots; ++i) {
+      node_variables.push_back(ResolveVariable(node->input(i), node_map));
+      distinct = !node_variables.back().empty() &&
+                 !variables.contains(node_variables.back());
+    }
+    if (!distinct) continue;
+    variables.insert(node_variables.begin(), node_variables.end());
+    result.push_back(node);
+  }
+  return result;
+}
+
+// Returns the multi-variable op that does the updates of `group`.
+NodeDef MakeMultiApply(const std::vector<const NodeDef*>& group,
+                       const GroupableApply& apply, const string& name) {
+  const NodeDef& first = *group[0];
+  NodeDef multi;
+  multi.set_name(name);
+  multi.set_op(apply.multi_op);
+  multi.set_device(first.device());
+  for (int i = 0; i <= apply.num_slots; ++i) {
+    for (const NodeDef* node : group) {
+      multi.add_input(node->input(i));
+    }
+  }
+  for (int i = 0; i < apply.num_hyperparameters; ++i) {
+    multi.add_input(first.input(apply.num_slots + 1 + i));
+  }
+  const int grad = apply.num_slots + 1 + apply.num_hyperparameters;
+  for (const NodeDef* node : group) {
+    multi.add_input(node->input(grad));
+  }
+  absl::flat_hash_set<string> control_inputs;
+  for (const NodeDef* node : group) {
+    for (int i = grad + 1; i < node->input_size(); ++i) {
+      if (control_inputs.insert(node->input(i)).second) {
+        multi.add_input(node->input(i));
+      }
+    }
+  }
+
+  auto& attr = *multi.mutable_attr();
+  attr["N"].set_i(group.size());
+  attr["T"] = first.attr().at("T");
+  attr["use_locking"].set_b(GetBoolAttr(first, "use_locking", false));
+  attr[apply.flag_attr].set_b(
+      GetBoolAttr(first, apply.flag_attr, apply.flag_default));
+  return multi;
+}
+
+}  // namespace
+
+Status ApplyGroupingOptimizer::Optimize(Cluster* cluster,
+                                        const GrapplerItem& item,
+                                        GraphDef* optimized_graph) {
+  const std::unordered_set<string> nodes_to_preserve = item.NodesToPreserve();
+  const NodeMap node_map(const_cast<GraphDef*>(&item.graph));
+
+  // Candidate groups, in order of their first node.
+  std::vector<std::vector<const NodeDef*>> groups;
+  std::vector<const GroupableApply*> group_applies;
+  absl::flat_hash_map<string, int> group_ids;
+  for (const NodeDef& node : item.graph.node()) {
+    const GroupableApply* apply = FindGroupableApply(node);
+    if (apply == nullptr) continue;
+    const string key = GroupKey(node, *apply, nodes_to_preserve);
+    if (key.empty()) continue;
+    auto it = group_ids.emplace(key, groups.size()).first;
+    if (it->second == groups.size()) {
+      groups.emplace_back();
+      group_applies.push_back(apply);
+    }
+    groups[it->second].push_back(&node);
+  }
+
+  std::vector<NodeDef> multi_applies;
+  // Maps the name of each grouped node to that of its multi-variable op, and
+  // the name of each multi-variable op to the nodes it replaces.
+  absl::flat_hash_map<string, string> replaced_by;
+  absl::flat_hash_map<string, std::vector<const NodeDef*>> formed_groups;
+  for (int g = 0; g < groups.size(); ++g) {
+    const GroupableApply& apply = *group_applies[g];
+    const std::vector<const NodeDef*> group =
+        WithDistinctVariables(groups[g], apply, node_map);
+    if (group.size() < kMinGroupSize ||
+        CreatesCycle(group, node_map, replaced_by, formed_groups)) {
+      continue;
+    }
+    const string name =
+        AddPrefixToNodeName(group[0]->name(), "ApplyGroupingOptimizer");
+    if (node_map.NodeExists(name)) continue;
+    multi_applies.push_back(MakeMultiApply(group, apply, name));
+    for (const NodeDef* node : group) {
+      replaced_by[node->name()] = name;
+    }
+    formed_groups[name] = group;
+  }
+  if (multi_applies.empty()) {
+    return errors::Aborted("Nothing to do.");
+  }
+
+  optimized_graph->Clear();
+  *optimized_graph->mutable_versions() = item.graph.versions();
+  *optimized_graph->mutable_library() = item.graph.library();
+  for (const NodeDef& node : item.graph.node()) {
+    if (replaced_by.contains(node.name())) continue;
+    NodeDef* new_node = optimized_graph->add_node();
+    *new_node = node;
+    // The grouped nodes have no outputs, so only control dependencies on
+    // them are redirected to their multi-variable ops.
+    new_node->clear_input();
+    absl::flat_hash_set<string> control_inputs;
+    for (const string& input : node.input()) {
+      if (!IsControlInput(input)) {
+        new_node->add_input(input);
+        continue;
+      }
+      auto it = replaced_by.find(NodeName(input));
+      const string new_input =
+          it == replaced_by.end() ? input : AsControlDependency(it->second);
+      if (control_inputs.insert(new_input).second) {
+        new_node->add_input(new_input);
+      }
+    }
+  }
+  for (NodeDef& multi_apply : multi_applies) {
+    // Control dependencies between grouped nodes were ruled out above, so
+    // those of the multi-variable ops need no redirection.
+    optimized_graph->add_node()->Swap(&multi_apply);
+  }
+  return Status::OK();
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
@@ -0,0 +1,55 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_APPLY_GROUPING_OPTIMIZER_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_APPLY_GROUPING_OPTIMIZER_H_
+
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Groups the dense optimizer updates of resource variables placed on the
+// CPU, e.g. ResourceApplyAdam, into multi-variable ops such as
+// _ResourceApplyAdamMulti. Updates are grouped when they run on the same
+// device with the same attributes and the same hyperparameter tensors. Models
+// with thousands of small variables otherwise spend more time in per-op
+// overhead than in the updates.
+//
+// A grouped op waits for the gradients of all its variables, so this is off
+// by default.
+class ApplyGroupingOptimizer : public GraphOptimizer {
+ public:
+  ApplyGroupingOptimizer() {}
+  explicit ApplyGroupingOptimizer(RewriterConfig::Toggle opt_level) {}
+
+  ~ApplyGroupingOptimizer() override {}
+
+  string name() const override { return "apply_grouping_optimizer"; };
+
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimized_graph, double result) override {}
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_APPLY_GROUPING_OPTIMIZER_H_
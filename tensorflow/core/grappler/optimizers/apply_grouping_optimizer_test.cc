@@ -0,0 +1,275 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/apply_grouping_optimizer.h"
+
+#include <map>
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+class ApplyGroupingOptimizerTest : public GrapplerTest {
+ protected:
+  // Returns a variable initialized to `value`, whose initializer is added to
+  // the init ops of `item_`.
+  Output Variable(const Scope& s, const string& name,
+                  const Input::Initializer& value) {
+    return Variable(s, name, name, value);
+  }
+
+  // Same as above, for a variable with the given shared name.
+  Output Variable(const Scope& s, const string& name,
+                  const string& shared_name, const Input::Initializer& value) {
+    Output handle =
+        ops::VarHandleOp(s.WithOpName(name), DT_FLOAT, value.tensor.shape(),
+                         ops::VarHandleOp::SharedName(shared_name));
+    ops::AssignVariableOp assign(s.WithOpName(name + "_init"), handle,
+                                 ops::Const(s, value));
+    item_.init_ops.push_back(assign.operation.node()->name());
+    handles_[name] = handle;
+    return handle;
+  }
+
+  // Adds an Adam update of new variables named `name`, `name`_m and `name`_v
+  // to `s`. All updates share the hyperparameters besides `lr`.
+  Operation Adam(const Scope& s, const string& name, Input lr, Input grad) {
+    if (beta1_power_.node() == nullptr) {
+      beta1_power_ = ops::Const(s.WithOpName("beta1_power"), 0.9f);
+      beta2_power_ = ops::Const(s.WithOpName("beta2_power"), 0.99f);
+      beta1_ = ops::Const(s.WithOpName("beta1"), 0.9f);
+      beta2_ = ops::Const(s.WithOpName("beta2"), 0.999f);
+      epsilon_ = ops::Const(s.WithOpName("epsilon"), 1e-7f);
+    }
+    Output var = Variable(s, name, {1.0f, 2.0f, 3.0f});
+    Output m = Variable(s, name + "_m", {0.1f, 0.2f, 0.3f});
+    Output v = Variable(s, name + "_v", {0.5f, 0.5f, 0.5f});
+    return ops::ResourceApplyAdam(s.WithOpName(name + "_apply"), var, m, v,
+                                  beta1_power_, beta2_power_, lr, beta1_,
+                                  beta2_, epsilon_, grad)
+        .operation;
+  }
+
+  // Adds the values of all the variables once `train` ran to the fetch nodes
+  // of `item_`.
+  void FetchVariablesAfter(const Scope& s, const Operation& train) {
+    for (const auto& handle : handles_) {
+      Output read = ops::ReadVariableOp(
+          s.WithOpName(handle.first + "_read").WithControlDependencies(train),
+          handle.second, DT_FLOAT);
+      item_.fetch.push_back(read.name());
+    }
+  }
+
+  int CountOps(const GraphDef& graph, const string& op) {
+    int count = 0;
+    for (const NodeDef& node : graph.node()) {
+      if (node.op() == op) ++count;
+    }
+    return count;
+  }
+
+  GrapplerItem item_;
+
+ private:
+  std::map<string, Output> handles_;
+  Output beta1_power_;
+  Output beta2_power_;
+  Output beta1_;
+  Output beta2_;
+  Output epsilon_;
+};
+
+TEST_F(ApplyGroupingOptimizerTest, GroupsAdamUpdates) {
+  Scope s = Scope::NewRootScope().WithDevice("/device:CPU:0");
+  Output lr = ops::Const(s.WithOpName("lr"), 0.01f);
+  Output other_lr = ops::Const(s.WithOpName("other_lr"), 0.02f);
+  Output grad = ops::Const(s.WithOpName("grad"), {0.5f, -1.0f, 2.0f});
+  Operation a = Adam(s, "a", lr, grad);
+  Operation b = Adam(s, "b", lr, ops::Neg(s, grad));
+  Operation c = Adam(s, "c", lr, grad);
+  Operation d = Adam(s, "d", other_lr, grad);
+  ops::NoOp train(s.WithOpName("train").WithControlDependencies({a, b, c, d}));
+  FetchVariablesAfter(s, train);
+  TF_CHECK_OK(s.ToGraphDef(&item_.graph));
+
+  ApplyGroupingOptimizer optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item_, &output));
+
+  EXPECT_EQ(1, CountOps(output, "ResourceApplyAdam"));
+  ASSERT_EQ(1, CountOps(output, "_ResourceApplyAdamMulti"));
+  for (const NodeDef& node : output.node()) {
+    if (node.op() == "_ResourceApplyAdamMulti") {
+      EXPECT_EQ(3, node.attr().at("N").i());
+      EXPECT_EQ("lr", node.input(11));
+      EXPECT_EQ("/device:CPU:0", node.device());
+    } else if (node.name() == "train") {
+      EXPECT_EQ(2, node.input_size());
+      EXPECT_EQ("^d_apply", node.input(1));
+    }
+  }
+
+  auto tensors_expected = EvaluateFetchNodes(item_);
+  item_.graph.Swap(&output);
+  auto tensors = EvaluateFetchNodes(item_);
+  ASSERT_EQ(tensors_expected.size(), tensors.size());
+  for (int i = 0; i < tensors.size(); ++i) {
+    test::ExpectTensorNear<float>(tensors_expected[i], tensors[i], 1e-6);
+  }
+}
+
+TEST_F(ApplyGroupingOptimizerTest, GroupsAdagradUpdates) {
+  Scope s = Scope::NewRootScope().WithDevice("/device:CPU:0");
+  Output lr = ops::Const(s.WithOpName("lr"), 0.1f);
+  Output grad = ops::Const(s.WithOpName("grad"), {0.5f, -1.0f});
+  std::vector<Operation> applies;
+  for (const string& name : {"a", "b"}) {
+    Output var = Variable(s, name, {1.0f, 2.0f});
+    Output accum = Variable(s, name + "_accum", {0.1f, 0.1f});
+    applies.push_back(ops::ResourceApplyAdagrad(s.WithOpName(name + "_apply"),
+                                                var, accum, lr, grad)
+                          .operation);
+  }
+  ops::NoOp train(s.WithOpName("train").WithControlDependencies(applies));
+  item_.fetch = {"train"};
+  TF_CHECK_OK(s.ToGraphDef(&item_.graph));
+
+  ApplyGroupingOptimizer optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item_, &output));
+  EXPECT_EQ(0, CountOps(output, "ResourceApplyAdagrad"));
+  EXPECT_EQ(1, CountOps(output, "_ResourceApplyAdagradMulti"));
+}
+
+TEST_F(ApplyGroupingOptimizerTest, DoesNotCreateCycles) {
+  Scope s = Scope::NewRootScope().WithDevice("/device:CPU:0");
+  Output lr = ops::Const(s.WithOpName("lr"), 0.01f);
+  Output grad = ops::Const(s.WithOpName("grad"), {0.5f, -1.0f, 2.0f});
+  Operation a = Adam(s, "a", lr, grad);
+  // The gradient of `b` is computed after the update of `a`.
+  Output b_grad =
+      ops::Identity(s.WithOpName("b_grad").WithControlDependencies(a), grad);
+  Operation b = Adam(s, "b", lr, b_grad);
+  ops::NoOp train(s.WithOpName("train").WithControlDependencies({a, b}));
+  item_.fetch = {"train"};
+  TF_CHECK_OK(s.ToGraphDef(&item_.graph));
+
+  ApplyGroupingOptimizer optimizer(RewriterConfig::ON);
+  GraphDef output;
+  Status status = optimizer.Optimize(nullptr, item_, &output);
+  EXPECT_TRUE(errors::IsAborted(status));
+}
+
+TEST_F(ApplyGroupingOptimizerTest, DoesNotCreateCyclesBetweenGroups) {
+  Scope s = Scope::NewRootScope().WithDevice("/device:CPU:0");
+  Output lr = ops::Const(s.WithOpName("lr"), 0.01f);
+  Output other_lr = ops::Const(s.WithOpName("other_lr"), 0.02f);
+  Output grad = ops::Const(s.WithOpName("grad"), {0.5f, -1.0f, 2.0f});
+  // The groups {a1, a2} and {b1, b2} have no paths within them, but a1
+  // reaches b1 and b2 reaches a2, so only one of them can be formed.
+  Operation a1 = Adam(s, "a1", lr, grad);
+  Output b1_grad =
+      ops::Identity(s.WithOpName("b1_grad").WithControlDependencies(a1), grad);
+  Operation b1 = Adam(s, "b1", other_lr, b1_grad);
+  Operation b2 = Adam(s, "b2", other_lr, grad);
+  Output a2_grad =
+      ops::Identity(s.WithOpName("a2_grad").WithControlDependencies(b2), grad);
+  Operation a2 = Adam(s, "a2", lr, a2_grad);
+  ops::NoOp train(
+      s.WithOpName("train").WithControlDependencies({a1, a2, b1, b2}));
+  FetchVariablesAfter(s, train);
+  TF_CHECK_OK(s.ToGraphDef(&item_.graph));
+
+  ApplyGroupingOptimizer optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item_, &output));
+
+  EXPECT_EQ(2, CountOps(output, "ResourceApplyAdam"));
+  EXPECT_EQ(1, CountOps(output, "_ResourceApplyAdamMulti"));
+
+  auto tensors_expected = EvaluateFetchNodes(item_);
+  item_.graph.Swap(&output);
+  auto tensors = EvaluateFetchNodes(item_);
+  ASSERT_EQ(tensors_expected.size(), tensors.size());
+  for (int i = 0; i < tensors.size(); ++i) {
+    test::ExpectTensorNear<float>(tensors_expected[i], tensors[i], 1e-6);
+  }
+}
+
+TEST_F(ApplyGroupingOptimizerTest, SkipsUpdatesOfTheSameVariable) {
+  Scope s = Scope::NewRootScope().WithDevice("/device:CPU:0");
+  Output lr = ops::Const(s.WithOpName("lr"), 0.01f);
+  Output grad = ops::Const(s.WithOpName("grad"), {0.5f, -1.0f, 2.0f});
+  Output var = Variable(s, "a", {1.0f, 2.0f, 3.0f});
+  Output m = Variable(s, "a_m", {0.1f, 0.2f, 0.3f});
+  Output v = Variable(s, "a_v", {0.5f, 0.5f, 0.5f});
+  std::vector<Operation> applies;
+  Output beta = ops::Const(s.WithOpName("beta"), 0.9f);
+  for (const string& name : {"a_apply", "a_apply_again"}) {
+    applies.push_back(ops::ResourceApplyAdam(s.WithOpName(name), var, m, v,
+                                             beta, beta, lr, beta, beta, lr,
+                                             grad)
+                          .operation);
+  }
+  ops::NoOp train(s.WithOpName("train").WithControlDependencies(applies));
+  item_.fetch = {"train"};
+  TF_CHECK_OK(s.ToGraphDef(&item_.graph));
+
+  ApplyGroupingOptimizer optimizer(RewriterConfig::ON);
+  GraphDef output;
+  Status status = optimizer.Optimize(nullptr, item_, &output);
+  EXPECT_TRUE(errors::IsAborted(status));
+}
+
+TEST_F(ApplyGroupingOptimizerTest, SkipsVariablesWithTheSameSharedName) {
+  Scope s = Scope::NewRootScope().WithDevice("/device:CPU:0");
+  Output lr = ops::Const(s.WithOpName("lr"), 0.01f);
+  Output grad = ops::Const(s.WithOpName("grad"), {0.5f, -1.0f, 2.0f});
+  Output beta = ops::Const(s.WithOpName("beta"), 0.9f);
+  std::vector<Operation> applies;
+  // "a" and "b" are two handles of the same variable, read through an
+  // Identity for "b".
+  for (const string& name : {"a", "b"}) {
+    Output var = Variable(s, name, "shared", {1.0f, 2.0f, 3.0f});
+    if (name == "b") var = ops::Identity(s.WithOpName("b_identity"), var);
+    Output m = Variable(s, name + "_m", {0.1f, 0.2f, 0.3f});
+    Output v = Variable(s, name + "_v", {0.5f, 0.5f, 0.5f});
+    applies.push_back(ops::ResourceApplyAdam(s.WithOpName(name + "_apply"),
+                                             var, m, v, beta, beta, lr, beta,
+                                             beta, lr, grad)
+                          .operation);
+  }
+  ops::NoOp train(s.WithOpName("train").WithControlDependencies(applies));
+  item_.fetch = {"train"};
+  TF_CHECK_OK(s.ToGraphDef(&item_.graph));
+
+  ApplyGroupingOptimizer optimizer(RewriterConfig::ON);
+  GraphDef output;
+  Status status = optimizer.Optimize(nullptr, item_, &output);
+  EXPECT_TRUE(errors::IsAborted(status));
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -25,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/framework/attr_value.pb.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/step_stats.pb.h"
 #include "tensorflow/core/framework/tensor.pb.h"  // NOLINT
 #include "tensorflow/core/framework/tensor_shape.pb.h"
 #include "tensorflow/core/grappler/clusters/virtual_cluster.h"
@@ -1270,6 +1271,396 @@ bool SwappingPass(RewriterConfig::MemOptType optimization_level,
   return updated_graph;
 }
 
+// Timing of the nodes and tensors of a simulated execution of a graph.
+struct SimulatedStep {
+  struct Tensor {
+    int64 bytes = 0;
+    Costs::Duration allocation_time = 0;
+    Costs::Duration deallocation_time = 0;
+  };
+  std::unordered_map<string, Costs::Duration> start_times;
+  std::unordered_map<string, Costs::Duration> completion_times;
+  // Keyed by "node:output_id".
+  std::unordered_map<string, Tensor> tensors;
+};
+
+void BuildSimulatedStep(const GraphDef& graph, const StepStats& step_stats,
+                        SimulatedStep* step) {
+  for (const auto& dev_stats : step_stats.dev_stats()) {
+    for (const auto& node_stats : dev_stats.node_stats()) {
+      const Costs::Duration start(
+          Costs::MicroSeconds(node_stats.all_start_micros()));
+      // Same convention as GraphMemory: deallocations happen one nanosecond
+      // after the completion of the last consumer.
+      const Costs::Duration completion =
+          Costs::NanoSeconds(1) +
+          Costs::MicroSeconds(node_stats.all_start_micros() +
+                              node_stats.op_end_rel_micros());
+      step->start_times[node_stats.node_name()] = start;
+      step->completion_times[node_stats.node_name()] = completion;
+      for (int i = 0; i < node_stats.output_size(); ++i) {
+        SimulatedStep::Tensor& tensor =
+            step->tensors[strings::StrCat(node_stats.node_name(), ":", i)];
+        tensor.bytes = node_stats.output(i)
+                           .tensor_description()
+                           .allocation_description()
+                           .allocated_bytes();
+        tensor.allocation_time = start;
+        tensor.deallocation_time =
+            std::max(tensor.deallocation_time, completion);
+      }
+    }
+  }
+  for (const NodeDef& node : graph.node()) {
+    auto it = step->completion_times.find(node.name());
+    if (it == step->completion_times.end()) continue;
+    for (const string& input : node.input()) {
+      const TensorId tensor_id = ParseTensorName(input);
+      if (tensor_id.index() < 0) continue;
+      auto tensor = step->tensors.find(tensor_id.ToString());
+      if (tensor != step->tensors.end()) {
+        tensor->second.deallocation_time =
+            std::max(tensor->second.deallocation_time, it->second);
+      }
+    }
+  }
+}
+
+// A way to release a tensor that is live at the time of peak memory usage,
+// and to bring it back for its uses after the peak.
+struct MemoryPlanCandidate {
+  MutableGraphView::OutputPort port;
+  // The fanouts of the tensor that execute after the peak.
+  std::vector<MutableGraphView::InputPort> late_uses;
+  // Estimated reduction of the peak memory usage.
+  int64 bytes_saved = 0;
+  // Estimated increase of the step time.
+  Costs::Duration extra_time = 0;
+  bool recompute = false;
+  // For recomputation: the node after which the tensor is recomputed, and
+  // its estimated completion time.
+  const NodeDef* trigger = nullptr;
+  Costs::Duration trigger_completion = 0;
+};
+
+bool CanRecompute(const NodeDef& node,
+                  const std::unordered_set<string>& feeds) {
+  if (feeds.count(node.name()) > 0 || IsPersistent(node) ||
+      ModifiesFrameInfo(node) || IsSwitch(node) || IsMerge(node) ||
+      !HasRegularInputs(node) ||
+      absl::StartsWith(node.name(),
+                       strings::StrCat(kRecomputedNodePrefix, "/"))) {
+    return false;
+  }
+  const OpDef* op_def;
+  if (!OpRegistry::Global()->LookUpOpDef(node.op(), &op_def).ok() ||
+      op_def->is_stateful()) {
+    return false;
+  }
+  for (const auto& arg : op_def->output_arg()) {
+    if (arg.is_ref()) return false;
+  }
+  for (const auto& arg : op_def->input_arg()) {
+    if (arg.is_ref()) return false;
+  }
+  return true;
+}
+
+// Fills in the cost of recomputing `candidate->port` right before its late
+// uses. Returns false if the tensor can't be recomputed.
+bool EvaluateRecomputation(const MutableGraphView& graph,
+                           const SimulatedStep& step,
+                           const std::unordered_set<string>& feeds,
+                           Costs::Duration peak_time,
+                           MemoryPlanCandidate* candidate) {
+  const NodeDef& producer = *candidate->port.node;
+  if (!CanRecompute(producer, feeds)) {
+    return false;
+  }
+  // Trigger the recomputation with the latest fanin of the first late use:
+  // the first late use has to wait for it anyway, and since it completes
+  // after all the ancestors of the trigger, no cycle can be created.
+  const NodeDef* first_use = nullptr;
+  Costs::Duration first_use_start = Costs::Duration::infinity();
+  for (const auto& use : candidate->late_uses) {
+    if (use.node->device() != producer.device()) {
+      return false;
+    }
+    const Costs::Duration start = step.start_times.at(use.node->name());
+    if (start < first_use_start) {
+      first_use_start = start;
+      first_use = use.node;
+    }
+  }
+  Costs::Duration trigger_completion = 0;
+  for (const string& input : first_use->input()) {
+    const NodeDef* fanin = graph.GetNode(NodeName(input));
+    if (fanin == nullptr || fanin == &producer) continue;
+    auto it = step.completion_times.find(fanin->name());
+    if (it != step.completion_times.end() &&
+        it->second > trigger_completion) {
+      trigger_completion = it->second;
+      candidate->trigger = fanin;
+    }
+  }
+  if (candidate->trigger == nullptr || trigger_completion <= peak_time ||
+      ModifiesFrameInfo(*candidate->trigger)) {
+    return false;
+  }
+  candidate->trigger_completion = trigger_completion;
+
+  // The inputs of the producer must now stay alive until the recomputation,
+  // which offsets the savings unless they are persistent or kept alive by
+  // other uses anyway.
+  int64 extended_bytes = 0;
+  for (const string& input : producer.input()) {
+    const TensorId tensor_id = ParseTensorName(input);
+    if (tensor_id.index() < 0) continue;
+    const NodeDef* fanin = graph.GetNode(tensor_id.node());
+    if (fanin == nullptr || IsPersistent(*fanin)) continue;
+    auto it = step.tensors.find(tensor_id.ToString());
+    if (it == step.tensors.end()) return false;
+    if (it->second.deallocation_time < trigger_completion) {
+      extended_bytes += it->second.bytes;
+    }
+  }
+  candidate->bytes_saved = step.tensors.at(strings::StrCat(
+                               producer.name(), ":", candidate->port.port_id))
+                               .bytes -
+                           extended_bytes;
+  candidate->extra_time = step.completion_times.at(producer.name()) -
+                          step.start_times.at(producer.name());
+  candidate->recompute = true;
+  return candidate->bytes_saved > 0;
+}
+
+// Fills in the cost of swapping `candidate->port` out to the host and back
+// in before its late uses. Returns false if the tensor can't be swapped.
+bool EvaluateSwapping(const MutableGraphView& graph,
+                      const SimulatedStep& step, const DeviceProperties& device,
+                      MemoryPlanCandidate* candidate) {
+  if (device.type() != "GPU" || !IsSwappable(graph, candidate->port)) {
+    return false;
+  }
+  Costs::Duration first_use_start = Costs::Duration::infinity();
+  for (const auto& use : candidate->late_uses) {
+    if (!IsSwappable(use)) return false;
+    first_use_start =
+        std::min(first_use_start, step.start_times.at(use.node->name()));
+  }
+  const string tensor_name = strings::StrCat(candidate->port.node->name(), ":",
+                                             candidate->port.port_id);
+  const SimulatedStep::Tensor& tensor = step.tensors.at(tensor_name);
+  // Like SwappingPass, assume the transfers run over PCIe at 16 GBps. They
+  // overlap with the computation as long as the tensor is not needed during
+  // the round trip.
+  const Costs::Duration round_trip = 2 * tensor.bytes / 16;
+  const Costs::Duration window =
+      first_use_start - step.completion_times.at(candidate->port.node->name());
+  candidate->bytes_saved = tensor.bytes;
+  candidate->extra_time =
+      std::max<Costs::Duration>(Costs::Duration(0), round_trip - window);
+  candidate->recompute = false;
+  return true;
+}
+
+// Simulates the execution of the graph, and rewrites it so that the peak
+// memory usage of every device fits within `memory_budget`, if possible. For
+// each tensor that is live at the peak, picks the cheapest of recomputing it
+// or swapping it out (on GPUs), and releases the tensors with the best ratio
+// of extra compute time to saved memory first. Swapping is requested through
+// the _swap_to_host annotation, which SwappingPass materializes. Returns true
+// if the graph was changed; `*fits` tells whether all the devices were
+// within budget before the changes.
+bool MemoryBudgetPass(Cluster* cluster, int64 memory_budget,
+                      GrapplerItem* item,
+                      std::unordered_set<string>* planned_tensors,
+                      bool* fits) {
+  *fits = false;
+  for (const NodeDef& node : item->graph.node()) {
+    if (IsNextIteration(node)) {
+      VLOG(1) << "Memory budget planning does not support loops";
+      return false;
+    }
+  }
+  GraphMemory memory(*item);
+  RunMetadata metadata;
+  Status s = memory.InferStatically(cluster->GetDevices(), &metadata);
+  if (!s.ok()) {
+    VLOG(1) << "Failed to infer memory usage: " << s.error_message();
+    return false;
+  }
+  SimulatedStep step;
+  BuildSimulatedStep(item->graph, metadata.step_stats(), &step);
+
+  std::unordered_set<string> feeds;
+  for (const auto& feed : item->feed) {
+    feeds.insert(NodeName(feed.first));
+  }
+
+  MutableGraphView graph(&item->graph);
+  std::vector<MemoryPlanCandidate> plan;
+  *fits = true;
+  for (const auto& device : cluster->GetDevices()) {
+    const GraphMemory::MemoryUsage& mem_usage =
+        memory.GetPeakMemoryUsage(device.first);
+    if (mem_usage.used_memory <= memory_budget) {
+      continue;
+    }
+    *fits = false;
+    int64 required_savings = mem_usage.used_memory - memory_budget;
+    VLOG(1) << "Peak memory usage of " << device.first << " is "
+            << mem_usage.used_memory << " bytes, budget is " << memory_budget;
+
+    Costs::Duration peak_time = -1;
+    for (const auto& live_tensor : mem_usage.live_tensors) {
+      peak_time = std::max(peak_time, live_tensor.allocation_time);
+    }
+
+    std::vector<MemoryPlanCandidate> candidates;
+    for (const auto& live_tensor : mem_usage.live_tensors) {
+      if (live_tensor.memory_used <= 1024) {
+        // Don't bother with small tensors.
+        continue;
+      }
+      const string tensor_name =
+          strings::StrCat(live_tensor.node, ":", live_tensor.output_id);
+      if (planned_tensors->count(tensor_name) > 0) {
+        continue;
+      }
+      MemoryPlanCandidate candidate;
+      candidate.port =
+          graph.GetOutputPort(live_tensor.node, live_tensor.output_id);
+      if (candidate.port.node == nullptr ||
+          step.completion_times.count(live_tensor.node) == 0) {
+        continue;
+      }
+      bool valid = true;
+      for (const auto& use : graph.GetFanout(candidate.port)) {
+        auto it = step.completion_times.find(use.node->name());
+        if (it == step.completion_times.end()) {
+          valid = false;
+          break;
+        }
+        if (it->second > peak_time) {
+          candidate.late_uses.push_back(use);
+        }
+      }
+      if (!valid || candidate.late_uses.empty()) {
+        continue;
+      }
+      MemoryPlanCandidate recompute = candidate;
+      const bool can_recompute =
+          EvaluateRecomputation(graph, step, feeds, peak_time, &recompute);
+      MemoryPlanCandidate swap = candidate;
+      const bool can_swap =
+          EvaluateSwapping(graph, step, device.second, &swap);
+      // Swapping doesn't add any computation, so prefer it on ties.
+      if (can_swap &&
+          (!can_recompute || swap.extra_time <= recompute.extra_time)) {
+        candidates.push_back(std::move(swap));
+      } else if (can_recompute) {
+        candidates.push_back(std::move(recompute));
+      }
+    }
+
+    std::sort(candidates.begin(), candidates.end(),
+              [](const MemoryPlanCandidate& a, const MemoryPlanCandidate& b) {
+                const double a_cost = a.extra_time.count() /
+                                      static_cast<double>(a.bytes_saved);
+                const double b_cost = b.extra_time.count() /
+                                      static_cast<double>(b.bytes_saved);
+                if (a_cost != b_cost) return a_cost < b_cost;
+                return a.bytes_saved > b.bytes_saved;
+              });
+    for (MemoryPlanCandidate& candidate : candidates) {
+      if (required_savings <= 0) break;
+      required_savings -= candidate.bytes_saved;
+      plan.push_back(std::move(candidate));
+    }
+    if (required_savings > 0) {
+      VLOG(1) << "Can't fit " << device.first << " within the memory budget, "
+              << required_savings << " bytes short";
+    }
+  }
+
+  // Rewrite the graph through `graph` so that the fanouts it tracks stay
+  // valid. NodeDef pointers remain valid as nodes are added.
+  std::unordered_map<string, const MemoryPlanCandidate*> recomputed_tensors;
+  // Completion time of the trigger of each recomputed node added below.
+  std::vector<std::pair<NodeDef*, Costs::Duration>> recomputed_nodes;
+  for (const MemoryPlanCandidate& candidate : plan) {
+    const NodeDef* producer = candidate.port.node;
+    const string tensor_name =
+        strings::StrCat(producer->name(), ":", candidate.port.port_id);
+    planned_tensors->insert(tensor_name);
+    VLOG(1) << (candidate.recompute ? "Recomputing " : "Swapping ")
+            << tensor_name << " to save " << candidate.bytes_saved
+            << " bytes at an estimated cost of "
+            << candidate.extra_time.count() << "ns";
+    if (!candidate.recompute) {
+      for (const auto& use : candidate.late_uses) {
+        AttrValue& swap_to_host = (*use.node->mutable_attr())["_swap_to_host"];
+        if (swap_to_host.value_case() == AttrValue::kI) {
+          const int64 input_id = swap_to_host.i();
+          swap_to_host.mutable_list()->add_i(input_id);
+        }
+        swap_to_host.mutable_list()->add_i(use.port_id);
+      }
+      continue;
+    }
+    recomputed_tensors[tensor_name] = &candidate;
+    const string recomputed_name =
+        AddPrefixToNodeName(producer->name(), kRecomputedNodePrefix);
+    if (graph.GetNode(recomputed_name) == nullptr &&
+        planned_tensors->insert(recomputed_name).second) {
+      NodeDef recomputed;
+      recomputed.set_name(recomputed_name);
+      recomputed.set_op(producer->op());
+      *recomputed.mutable_attr() = producer->attr();
+      recomputed.set_device(producer->device());
+      *recomputed.mutable_input() = producer->input();
+      *recomputed.add_input() = AsControlDependency(*candidate.trigger);
+      recomputed_nodes.emplace_back(graph.AddNode(std::move(recomputed)),
+                                    candidate.trigger_completion);
+    }
+  }
+
+  // Point the late uses at the recomputed tensors.
+  for (const auto& recomputed_tensor : recomputed_tensors) {
+    const MemoryPlanCandidate& candidate = *recomputed_tensor.second;
+    const string recomputed_name = AddPrefixToNodeName(
+        candidate.port.node->name(), kRecomputedNodePrefix);
+    for (const auto& use : candidate.late_uses) {
+      TF_CHECK_OK(graph.UpdateRegularFaninByPort(
+          use.node->name(), use.port_id,
+          {recomputed_name, candidate.port.port_id}));
+    }
+  }
+
+  // A recomputed node that reads a tensor which is itself recomputed must
+  // read the recomputed copy, or the original tensor stays alive until the
+  // recomputation and nothing is saved. Only do so when the copy is
+  // triggered no later than the reader, so that no cycle can be created.
+  for (const auto& recomputed_node : recomputed_nodes) {
+    NodeDef* node = recomputed_node.first;
+    for (int i = 0; i < node->input_size(); ++i) {
+      const TensorId tensor_id = ParseTensorName(node->input(i));
+      if (tensor_id.index() < 0) break;
+      auto it = recomputed_tensors.find(tensor_id.ToString());
+      if (it == recomputed_tensors.end() ||
+          it->second->trigger_completion > recomputed_node.second) {
+        continue;
+      }
+      const string recomputed_name = AddPrefixToNodeName(
+          string(tensor_id.node()), kRecomputedNodePrefix);
+      TF_CHECK_OK(graph.UpdateRegularFaninByPort(
+          node->name(), i, {recomputed_name, tensor_id.index()}));
+    }
+  }
+  return !plan.empty();
+}
+
 bool CrossesTaskOrCpuGpuBoundary(const NodeDef& node1, const NodeDef& node2) {
   string task1;
   string device1;
@@ -1394,8 +1785,17 @@ Status MemoryOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
   GrapplerItem optimized_item(item);
   RelaxAssignNodes(nodes_to_relax, &optimized_item.graph);
 
+  // With a memory budget, the planner replaces the recomputation and swapping
+  // heuristics, but manual annotations are still honored.
+  const bool plan_memory_budget =
+      memory_budget_bytes_ > 0 && !item.fetch.empty() && cluster != nullptr;
+  const RewriterConfig::MemOptType rewriting_level =
+      plan_memory_budget && optimization_level_ != RewriterConfig::MANUAL
+          ? RewriterConfig::MANUAL
+          : optimization_level_;
+
   if (run_recomputation_pass) {
-    RecomputationRewritingPass(optimization_level_,
+    RecomputationRewritingPass(rewriting_level,
                                recomputation_targets_name_scope_,
                                &optimized_item.graph, item);
   }
@@ -1428,7 +1828,7 @@ Status MemoryOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
            optimization_level_ == RewriterConfig::HEURISTICS ||
            optimization_level_ == RewriterConfig::MANUAL) &&
           cluster != nullptr) {
-        if (SwappingPass(optimization_level_, cluster, &memory, &optimized_item,
+        if (SwappingPass(rewriting_level, cluster, &memory, &optimized_item,
                          &skip_list)) {
           // Reset the inferred memory usage since the graph changed.
           memory.reset();
@@ -1438,6 +1838,30 @@ Status MemoryOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
     }
   }
 
+  if (plan_memory_budget) {
+    // Each round releases enough tensors to bring the previous peak within
+    // budget, but the peak may move elsewhere: simulate again until the graph
+    // fits or no more tensors can be released.
+    std::unordered_set<string> planned_tensors;
+    for (int i = 0; i < 10; ++i) {
+      GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
+      bool fits = false;
+      if (!MemoryBudgetPass(cluster, memory_budget_bytes_, &optimized_item,
+                            &planned_tensors, &fits)) {
+        if (!fits) {
+          VLOG(1) << "Could not fit the graph within a memory budget of "
+                  << memory_budget_bytes_ << " bytes";
+        }
+        break;
+      }
+      // Materialize the swaps requested by the planner.
+      memory.reset();
+      SwappingPass(RewriterConfig::MANUAL, cluster, &memory, &optimized_item,
+                   &skip_list);
+      memory.reset();
+    }
+  }
+
   optimized_graph->Swap(&optimized_item.graph);
   return Status::OK();
 }
@@ -448,6 +448,115 @@ TEST_F(MemoryOptimizerTest, AccumulationRewrites) {
   }
 }
 
+TEST_F(MemoryOptimizerTest, MemoryBudgetRecomputation) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output v = ops::Const(s.WithOpName("v").WithDevice("/cpu:0"), 1.0f,
+                        {128, 128, 8});
+  // b is computed early but only used at the very end, so it is live at the
+  // time of peak memory usage.
+  Output b = ops::Sqrt(s.WithOpName("b").WithDevice("/cpu:0"), v);
+  Output c1 = ops::Exp(
+      s.WithOpName("c1").WithDevice("/cpu:0").WithControlDependencies(b), v);
+  Output axis = ops::Const(s.WithOpName("axis"), 0);
+  Output c2 =
+      ops::Concat(s.WithOpName("c2").WithDevice("/cpu:0"), {c1, c1}, axis);
+  // The peak is reached when c3 is allocated.
+  Output c3 = ops::Exp(s.WithOpName("c3").WithDevice("/cpu:0"), c2);
+  Output c4 = ops::Slice(s.WithOpName("c4").WithDevice("/cpu:0"), c3,
+                         {0, 0, 0}, {128, 128, 8});
+  Output e = ops::Add(s.WithOpName("e").WithDevice("/cpu:0"), b, c4);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"e"};
+
+  std::unique_ptr<VirtualCluster> cluster(CreateVirtualCluster());
+
+  // Nothing to do if the graph fits.
+  {
+    MemoryOptimizer optimizer(RewriterConfig::MANUAL, "gradients/",
+                              /*memory_budget_bytes=*/1LL << 30);
+    GraphDef output;
+    TF_EXPECT_OK(optimizer.Optimize(cluster.get(), item, &output));
+    EXPECT_EQ(item.graph.node_size(), output.node_size());
+  }
+
+  MemoryOptimizer optimizer(RewriterConfig::MANUAL, "gradients/",
+                            /*memory_budget_bytes=*/1);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(cluster.get(), item, &output));
+
+  // Only b can be released: the other tensors live at the peak are used right
+  // away. b is recomputed from the constant once c4 is available.
+  NodeMap node_map(&output);
+  const NodeDef* recomputed = node_map.GetNode("Recomputed/b");
+  ASSERT_NE(nullptr, recomputed);
+  EXPECT_EQ("Sqrt", recomputed->op());
+  ASSERT_EQ(2, recomputed->input_size());
+  EXPECT_EQ("v", recomputed->input(0));
+  EXPECT_EQ("^c4", recomputed->input(1));
+  const NodeDef* add = node_map.GetNode("e");
+  ASSERT_NE(nullptr, add);
+  EXPECT_EQ("Recomputed/b", add->input(0));
+  EXPECT_EQ("c4", add->input(1));
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+  auto tensors = EvaluateNodes(output, item.fetch);
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-6);
+}
+
+TEST_F(MemoryOptimizerTest, MemoryBudgetChainedRecomputation) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output v = ops::Const(s.WithOpName("v").WithDevice("/cpu:0"), 1.0f,
+                        {128, 128, 8});
+  // b1 and b2 = f(b1) are both computed early and only used at the very end.
+  Output b1 = ops::Sqrt(s.WithOpName("b1").WithDevice("/cpu:0"), v);
+  Output b2 = ops::Sqrt(s.WithOpName("b2").WithDevice("/cpu:0"), b1);
+  Output c1 = ops::Exp(
+      s.WithOpName("c1").WithDevice("/cpu:0").WithControlDependencies(b2), v);
+  Output axis = ops::Const(s.WithOpName("axis"), 0);
+  Output c2 =
+      ops::Concat(s.WithOpName("c2").WithDevice("/cpu:0"), {c1, c1}, axis);
+  Output c3 = ops::Exp(s.WithOpName("c3").WithDevice("/cpu:0"), c2);
+  Output c4 = ops::Slice(s.WithOpName("c4").WithDevice("/cpu:0"), c3,
+                         {0, 0, 0}, {128, 128, 8});
+  Output e = ops::Add(s.WithOpName("e").WithDevice("/cpu:0"), b1, c4);
+  Output f = ops::Add(s.WithOpName("f").WithDevice("/cpu:0"), b2, e);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"f"};
+
+  std::unique_ptr<VirtualCluster> cluster(CreateVirtualCluster());
+  MemoryOptimizer optimizer(RewriterConfig::MANUAL, "gradients/",
+                            /*memory_budget_bytes=*/1);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(cluster.get(), item, &output));
+
+  // Both tensors are recomputed, and the recomputation of b2 reads the
+  // recomputed b1 so that b1 isn't kept alive through the peak.
+  NodeMap node_map(&output);
+  const NodeDef* recomputed_b1 = node_map.GetNode("Recomputed/b1");
+  ASSERT_NE(nullptr, recomputed_b1);
+  ASSERT_EQ(2, recomputed_b1->input_size());
+  EXPECT_EQ("v", recomputed_b1->input(0));
+  EXPECT_EQ("^c4", recomputed_b1->input(1));
+  const NodeDef* recomputed_b2 = node_map.GetNode("Recomputed/b2");
+  ASSERT_NE(nullptr, recomputed_b2);
+  ASSERT_EQ(2, recomputed_b2->input_size());
+  EXPECT_EQ("Recomputed/b1", recomputed_b2->input(0));
+  EXPECT_EQ("^e", recomputed_b2->input(1));
+  EXPECT_EQ("Recomputed/b1", node_map.GetNode("e")->input(0));
+  EXPECT_EQ("Recomputed/b2", node_map.GetNode("f")->input(0));
+  EXPECT_EQ(1, node_map.GetOutputs("b1").size());
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+  auto tensors = EvaluateNodes(output, item.fetch);
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-6);
+}
+
 class RelaxAllocatorConstraintsTest : public GrapplerTest {};
 
 TEST_F(RelaxAllocatorConstraintsTest, SameDevice) {
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/grappler/optimizers/meta_optimizer.h"
 
+#include "absl/algorithm/container.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/substitute.h"
 #include "tensorflow/core/common_runtime/function.h"
@@ -26,6 +27,8 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/grappler/clusters/virtual_cluster.h"
+#include "tensorflow/core/grappler/costs/graph_analysis_context.h"
+#include "tensorflow/core/grappler/optimizers/apply_grouping_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/arithmetic_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/auto_mixed_precision.h"
 #include "tensorflow/core/grappler/optimizers/auto_parallel.h"
@@ -50,8 +53,12 @@ limitations under the License.
 #include "tensorflow/core/grappler/utils/topological_sort.h"
 #include "tensorflow/core/grappler/utils/tpu.h"
 #include "tensorflow/core/grappler/verifiers/structure_verifier.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/util/dump_graph.h"
 #include "tensorflow/core/util/ptr_util.h"
 #include "tensorflow/core/util/xla_config_registry.h"
@@ -173,6 +180,47 @@ bool MemoryOptimizerEnabled(
 #define MK_OPT(NAME, VALUE) \
   if (optimizer == NAME) return std::unique_ptr<GraphOptimizer>(VALUE)
 
+int MetaOptimizer::NumFunctionOptimizationThreads(
+    const Cluster* cluster) const {
+  // Functions optimized concurrently get their own copy of a virtual
+  // cluster. Other clusters, e.g. ones running the graph, are only used by
+  // one function at a time.
+  if (cluster != nullptr && cluster->type() != "virtual") return 1;
+  return cfg_.function_optimization_threads() > 0
+             ? cfg_.function_optimization_threads()
+             : port::MaxParallelism();
+}
+
+Status MetaOptimizer::InitializeFunctionOptimizationWorkers(
+    Cluster* cluster, int num_threads) {
+  if (function_optimization_pool_ == nullptr) {
+    function_optimization_pool_ = absl::make_unique<thread::ThreadPool>(
+        Env::Default(), "grappler_function_optimizer", num_threads);
+    function_optimization_workers_.resize(num_threads);
+  }
+  DCHECK_EQ(num_threads, function_optimization_workers_.size());
+  for (FunctionOptimizationWorker& worker : function_optimization_workers_) {
+    // Optimizers constant fold on a CPU device of their own when they are
+    // not given one, so workers do not share `cpu_device_`.
+    if (worker.optimizer == nullptr) {
+      worker.optimizer =
+          absl::make_unique<MetaOptimizer>(/*cpu_device=*/nullptr,
+                                           config_proto_);
+    }
+    worker.optimizer->set_deadline_usec(deadline_usec());
+    worker.cluster.reset();
+    if (cluster != nullptr) {
+      DCHECK_EQ(cluster->type(), "virtual");
+      worker.cluster =
+          cluster->GetDeviceSet() != nullptr
+              ? absl::make_unique<VirtualCluster>(cluster->GetDeviceSet())
+              : absl::make_unique<VirtualCluster>(cluster->GetDevices());
+      worker.cluster->DisableDetailedStats(!cluster->DetailedStatsEnabled());
+    }
+  }
+  return Status::OK();
+}
+
 bool MetaOptimizer::IsSingleThreadedExecutor() const {
   return config_proto_.experimental().executor_type() ==
          "SINGLE_THREADED_EXECUTOR";
@@ -208,6 +256,7 @@ std::unique_ptr<GraphOptimizer> MetaOptimizer::MakeNewOptimizer(
                                       cfg_.scoped_allocator_opts()));
   MK_OPT("pin_to_host",
          new PinToHostOptimizer(cfg_.pin_to_host_optimization()));
+  MK_OPT("apply_grouping", new ApplyGroupingOptimizer(cfg_.apply_grouping()));
 
   return std::unique_ptr<GraphOptimizer>();
 }
@@ -217,7 +266,8 @@ std::unique_ptr<GraphOptimizer> MetaOptimizer::MakeNewOptimizer(
 MetaOptimizer::MetaOptimizer(DeviceBase* cpu_device, const ConfigProto& cfg)
     : cpu_device_(cpu_device),
       config_proto_(cfg),
-      cfg_(*config_proto_.mutable_graph_options()->mutable_rewrite_options()) {
+      cfg_(*config_proto_.mutable_graph_options()->mutable_rewrite_options()),
+      graph_cache_(OptimizedGraphCache::Global()) {
   DCHECK(cpu_device_ == nullptr ||
          cpu_device_->attributes().device_type() == "CPU");
 }
@@ -283,17 +333,23 @@ Status MetaOptimizer::InitializeOptimizers(
     optimizers->push_back(
         MakeUnique<DependencyOptimizer>(cfg_.dependency_optimization()));
   }
+  if (cfg_.apply_grouping() == RewriterConfig::ON) {
+    optimizers->push_back(MakeUnique<ApplyGroupingOptimizer>());
+  }
   auto global_jit_level =
       config_proto_.graph_options().optimizer_options().global_jit_level();
   if (MemoryOptimizerEnabled(cfg_.memory_optimization(), global_jit_level)) {
     if (cfg_.memory_optimizer_target_node_name_scope().empty()) {
       optimizers->push_back(
           // Use the default target node name prefix "gradients/"
-          MakeUnique<MemoryOptimizer>(cfg_.memory_optimization()));
+          MakeUnique<MemoryOptimizer>(
+              cfg_.memory_optimization(), "gradients/",
+              cfg_.memory_optimizer_memory_budget_bytes()));
     } else {
       optimizers->push_back(MakeUnique<MemoryOptimizer>(
           cfg_.memory_optimization(),
-          cfg_.memory_optimizer_target_node_name_scope()));
+          cfg_.memory_optimizer_target_node_name_scope(),
+          cfg_.memory_optimizer_memory_budget_bytes()));
     }
   }
   if (cfg_.auto_parallel().enable()) {
@@ -397,6 +453,13 @@ void MetaOptimizer::InitializeVerifiers(
 
 Status MetaOptimizer::OptimizeGraph(Cluster* cluster, GrapplerItem&& item,
                                     GraphDef* optimized_graph) {
+  return OptimizeGraph(cluster, std::move(item), optimized_graph,
+                       &optimization_results_);
+}
+
+Status MetaOptimizer::OptimizeGraph(
+    Cluster* cluster, GrapplerItem&& item, GraphDef* optimized_graph,
+    std::vector<GraphOptimizationResult>* results) {
   int min_graph_nodes = cfg_.min_graph_nodes() == 0 ? kDefaultMinGraphNodes
                                                     : cfg_.min_graph_nodes();
   if (item.graph.node_size() < min_graph_nodes) {
@@ -447,6 +510,16 @@ Status MetaOptimizer::OptimizeGraph(Cluster* cluster, GrapplerItem&& item,
   auto original_producer = item.graph.versions().producer();
   optimized_graph->Swap(&item.graph);
 
+  // Let the optimizers share the analyses of item.graph, e.g. the inferred
+  // shapes, for as long as it doesn't change. The graph handed to the next
+  // optimizer only changes when an optimizer succeeds (see RunOptimizer) or
+  // when the constants get compressed.
+  item.analysis_context = std::make_shared<GraphAnalysisContext>(&item.graph);
+  auto detach_analysis_context = gtl::MakeCleanup([&item] {
+    item.analysis_context->Detach();
+    item.analysis_context.reset();
+  });
+
   GraphOptimizationResult optimization_result(item.id);
   GraphOptimizer* sa_optimizer = nullptr;
 
@@ -454,6 +527,7 @@ Status MetaOptimizer::OptimizeGraph(Cluster* cluster, GrapplerItem&& item,
   // Do it here if model pruner is disabled.
   if (cfg_.disable_model_pruning()) {
     CompressConstants(optimized_graph);
+    item.analysis_context->Invalidate();
   }
 
   for (int iteration = 0; iteration < NumIterations(cfg_); ++iteration) {
@@ -488,6 +562,7 @@ Status MetaOptimizer::OptimizeGraph(Cluster* cluster, GrapplerItem&& item,
 
       if (iteration == 0 && optimizer->name() == "model_pruner") {
         CompressConstants(optimized_graph);
+        item.analysis_context->Invalidate();
       }
 
       if (VLOG_IS_ON(4)) {
@@ -528,7 +603,7 @@ Status MetaOptimizer::OptimizeGraph(Cluster* cluster, GrapplerItem&& item,
                                    }) != optimization_result.results.end();
 
   // Record graph optimization result.
-  optimization_results_.push_back(optimization_result);
+  results->push_back(optimization_result);
 
   if (is_optimized) {
     TF_RETURN_IF_ERROR(TopologicalSort(optimized_graph));
@@ -561,6 +636,9 @@ Status MetaOptimizer::RunOptimizer(
         GetFunctionDefLibraryStub(optimized_graph_function_library);
   }
 
+  optimized_item->analysis_context->set_function_library_stubbed(
+      !is_function_library_aware);
+
   // This swaps the current optimized_graph into optimized item and
   // resets optimized_graph to an empty graph.
   optimized_graph->Swap(&optimized_item->graph);
@@ -595,6 +673,9 @@ Status MetaOptimizer::RunOptimizer(
         PrintSizesBeforeAfter(optimized_item->graph, *optimized_graph),
         ", time = ", duration_ms, "ms.");
     VLOG(1) << optimizer->name() << ": " << message;
+    // The next optimizer gets the optimized graph: drop the analyses of the
+    // current one. When the optimizer fails, it gets the current one back.
+    optimized_item->analysis_context->Invalidate();
   }
 
   // Swap function library back into the main graph.
@@ -639,6 +720,18 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
           item.graph.library().function_size(),
       item.graph.library().function_size());
 
+  // A previous run, possibly in another process, may already have optimized
+  // the same item with the same configuration.
+  string cache_key;
+  if (graph_cache_ != nullptr) {
+    cache_key = OptimizedGraphCache::ComputeKey(item, cluster, config_proto_);
+    if (graph_cache_->Lookup(cache_key, optimized_graph)) {
+      VLOG(1) << "Loaded optimized graph for grappler item " << item.id
+              << " from " << graph_cache_->directory();
+      return Status::OK();
+    }
+  }
+
   // Save a few small fields from item before we move it.
   bool optimize_function_library =
       item.optimization_options().optimize_function_library;
@@ -697,13 +790,14 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
 
   // Optimize each function only once.
   absl::flat_hash_set<string> optimized_funcs;
+  bool function_optimization_workers_initialized = false;
   while (optimize_function_library) {
     optimize_function_library = false;
+    const bool is_tpu_graph = IsTPUGraphDef(*optimized_graph);
 
-    int function_idx = 0;
+    // Collect the functions to optimize in this pass, in library order.
+    std::vector<const FunctionDef*> funcs_to_optimize;
     for (const FunctionDef& func : optimized_graph->library().function()) {
-      GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
-
       const string& func_name = func.signature().name();
 
       // Skip functions that are not reachable from the optimized graph.
@@ -722,43 +816,72 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
       // Skip tf.data functions as they are optimized by tf.data meta optimizer.
       if (IsTFDataFunction(func)) continue;
 
-      VLOG(3) << "Optimize function: function=" << func_name << " ["
-              << function_idx++ << " of "
-              << optimized_graph->library().function_size() << "]";
-
-      // Function optimization might specialize nested function calls, so we
-      // have to reset the flag and do at least one more pass over the library.
-      optimize_function_library = true;
       optimized_funcs.insert(func_name);
-
-      // Make a GrapplerItem from a FunctionDef.
+      funcs_to_optimize.push_back(&func);
+    }
+    if (funcs_to_optimize.empty()) break;
+
+    // Function optimization might specialize nested function calls, so we
+    // have to do at least one more pass over the library.
+    optimize_function_library = true;
+
+    // Function bodies are optimized in waves of consecutive functions, whose
+    // results are applied to the library in library order. A function item
+    // only contains the functions reachable from the function, so as long as
+    // it does not reach an earlier function of its wave, optimizing it against
+    // the library as of the start of the wave is the same as optimizing it
+    // after the earlier functions were replaced in `flib`. This keeps the
+    // result identical to optimizing the functions one at a time, while the
+    // functions of a wave are optimized concurrently.
+    struct FunctionOptimization {
+      const FunctionDef* func;
       GrapplerFunctionItem func_item;
-      TF_RETURN_IF_ERROR(
-          MakeGrapplerFunctionItem(func, flib, producer, &func_item));
-
-      // If we need to compute the gradient of optimized function at runtime, we
-      // can't perform non-differentiable rewrites.
-      func_item.optimization_options().allow_non_differentiable_rewrites =
-          !differentiable_functions.contains(func_name);
-
-      // Device set available to the function is defined only by the runtime,
-      // when we instantiate and execute the function. We can't use all devices
-      // available to the main graph, because after partitioning the function
-      // call node might execute on a remote worker.
-      if (!func_item.devices().empty()) {
-        return errors::Internal("GrapplerFunctionItem devices must be empty.");
-      }
-
-      // We are not allowed to prune certain types of ops from the graph
-      // instantiated by the function definition, because we must guarantee
-      // function execution semantics wrt side effects (see
-      // function_optimizer.cc).
-      func_item.optimization_options().allow_pruning_stateful_and_dataset_ops =
-          false;
-
-      // Optimize function body graph.
       GraphDef optimized_func_graph;
-      if (IsTPUGraphDef(*optimized_graph)) {
+      std::vector<GraphOptimizationResult> results;
+      Status status;
+    };
+
+    // Makes the function item of `func` from the current library.
+    const auto make_function_item =
+        [&](const FunctionDef& func, GrapplerFunctionItem* func_item) {
+          const string& func_name = func.signature().name();
+
+          // Make a GrapplerItem from a FunctionDef.
+          TF_RETURN_IF_ERROR(
+              MakeGrapplerFunctionItem(func, flib, producer, func_item));
+
+          // If we need to compute the gradient of optimized function at
+          // runtime, we can't perform non-differentiable rewrites.
+          func_item->optimization_options().allow_non_differentiable_rewrites =
+              !differentiable_functions.contains(func_name);
+
+          // Device set available to the function is defined only by the
+          // runtime, when we instantiate and execute the function. We can't
+          // use all devices available to the main graph, because after
+          // partitioning the function call node might execute on a remote
+          // worker.
+          if (!func_item->devices().empty()) {
+            return errors::Internal(
+                "GrapplerFunctionItem devices must be empty.");
+          }
+
+          // We are not allowed to prune certain types of ops from the graph
+          // instantiated by the function definition, because we must
+          // guarantee function execution semantics wrt side effects (see
+          // function_optimizer.cc).
+          func_item->optimization_options()
+              .allow_pruning_stateful_and_dataset_ops = false;
+          return Status::OK();
+        };
+
+    // Optimizes the body of a function with `optimizer` and `func_cluster`.
+    const auto optimize_function = [&](FunctionOptimization* func_optimization,
+                                       MetaOptimizer* optimizer,
+                                       Cluster* func_cluster) -> Status {
+      GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
+      GrapplerFunctionItem& func_item = func_optimization->func_item;
+      GraphDef* optimized_func_graph = &func_optimization->optimized_func_graph;
+      if (is_tpu_graph) {
         // Skip optimizing functions if this is a TPU graph. Currently, Grappler
         // passes do not handle TPU functions correctly in a variety of ways
         // (Note that due to the pre-placement TPU graph rewriting passes, the
@@ -779,36 +902,95 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
         *func_item.graph.mutable_library() =
             GetFunctionDefLibraryStub(func_item_function_library);
 
-        TF_RETURN_IF_ERROR(implementation_selector.Optimize(
-            cluster, func_item, &optimized_func_graph));
-      } else {
-        GrapplerFunctionItem func_item_copy = func_item;
-        TF_RETURN_IF_ERROR(OptimizeGraph(cluster, std::move(func_item_copy),
-                                         &optimized_func_graph));
+        return implementation_selector.Optimize(func_cluster, func_item,
+                                                optimized_func_graph);
       }
+      GrapplerFunctionItem func_item_copy = func_item;
+      return optimizer->OptimizeGraph(func_cluster, std::move(func_item_copy),
+                                      optimized_func_graph,
+                                      &func_optimization->results);
+    };
+
+    const int num_threads = NumFunctionOptimizationThreads(cluster);
+    for (int wave_begin = 0, end = funcs_to_optimize.size();
+         wave_begin < end;) {
+      GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
 
-      // Function body optimization might have created new specialized
-      // functions for each instantiation context. Add them to the library.
-      for (const FunctionDef& func_def :
-           optimized_func_graph.library().function()) {
-        if (flib.Find(func_def.signature().name()) == nullptr) {
-          TF_RETURN_IF_ERROR(flib.AddFunctionDef(func_def));
+      std::vector<FunctionOptimization> wave;
+      absl::flat_hash_set<string> wave_func_names;
+      for (int i = wave_begin; i < end; ++i) {
+        if (num_threads <= 1 && !wave.empty()) break;
+        FunctionOptimization func_optimization;
+        func_optimization.func = funcs_to_optimize[i];
+        TF_RETURN_IF_ERROR(make_function_item(*func_optimization.func,
+                                              &func_optimization.func_item));
+        const bool reaches_wave = absl::c_any_of(
+            func_optimization.func_item.graph.library().function(),
+            [&](const FunctionDef& reachable) {
+              return wave_func_names.contains(reachable.signature().name());
+            });
+        if (reaches_wave) break;
+        wave_func_names.insert(func_optimization.func->signature().name());
+        wave.push_back(std::move(func_optimization));
+      }
+      wave_begin += wave.size();
+      VLOG(3) << "Optimize " << wave.size() << " functions: first function="
+              << wave.front().func->signature().name();
+
+      if (wave.size() == 1) {
+        wave[0].status = optimize_function(&wave[0], this, cluster);
+      } else {
+        if (!function_optimization_workers_initialized) {
+          TF_RETURN_IF_ERROR(
+              InitializeFunctionOptimizationWorkers(cluster, num_threads));
+          function_optimization_workers_initialized = true;
         }
+        BlockingCounter counter(wave.size());
+        for (FunctionOptimization& func_optimization : wave) {
+          FunctionOptimization* func_optimization_ptr = &func_optimization;
+          function_optimization_pool_->Schedule([&, func_optimization_ptr]() {
+            const FunctionOptimizationWorker& worker =
+                function_optimization_workers_
+                    [function_optimization_pool_->CurrentThreadId()];
+            func_optimization_ptr->status =
+                optimize_function(func_optimization_ptr,
+                                  worker.optimizer.get(), worker.cluster.get());
+            counter.DecrementCount();
+          });
+        }
+        counter.Wait();
       }
 
-      // Convert optimized graph back to FunctionDef.
-      FunctionDef optimized_func;
-      func_item.SwapFunctionBody(std::move(optimized_func_graph));
-      TF_RETURN_IF_ERROR(MakeFunctionDef(func_item, flib, &optimized_func));
+      for (FunctionOptimization& func_optimization : wave) {
+        TF_RETURN_IF_ERROR(func_optimization.status);
+        for (GraphOptimizationResult& result : func_optimization.results) {
+          optimization_results_.push_back(std::move(result));
+        }
+
+        // Function body optimization might have created new specialized
+        // functions for each instantiation context. Add them to the library.
+        for (const FunctionDef& func_def :
+             func_optimization.optimized_func_graph.library().function()) {
+          if (flib.Find(func_def.signature().name()) == nullptr) {
+            TF_RETURN_IF_ERROR(flib.AddFunctionDef(func_def));
+          }
+        }
 
-      // Replace optimized function with a new FunctionDef.
-      TF_RETURN_IF_ERROR(flib.ReplaceFunction(func_name, optimized_func));
-    }
+        // Convert optimized graph back to FunctionDef.
+        FunctionDef optimized_func;
+        GrapplerFunctionItem& func_item = func_optimization.func_item;
+        func_item.SwapFunctionBody(
+            std::move(func_optimization.optimized_func_graph));
+        TF_RETURN_IF_ERROR(MakeFunctionDef(func_item, flib, &optimized_func));
 
-    // If optimized at least one function, update the graph library.
-    if (optimize_function_library) {
-      *optimized_graph->mutable_library() = flib.ToProto();
+        // Replace optimized function with a new FunctionDef.
+        TF_RETURN_IF_ERROR(flib.ReplaceFunction(
+            func_optimization.func->signature().name(), optimized_func));
+      }
     }
+
+    // Update the graph library with the optimized functions.
+    *optimized_graph->mutable_library() = flib.ToProto();
   }
 
   VLOG(1) << "Optimized " << optimized_funcs.size()
@@ -821,6 +1003,24 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
         *optimized_graph);
   }
 
+  // Only cache complete optimizations. A failed optimizer leaves the graph
+  // valid but possibly less optimized than a later retry would.
+  if (graph_cache_ != nullptr) {
+    bool all_optimizers_ok = true;
+    for (const GraphOptimizationResult& graph_result : optimization_results_) {
+      for (const OptimizerResult& result : graph_result.results) {
+        all_optimizers_ok &= result.status.ok();
+      }
+    }
+    if (all_optimizers_ok) {
+      Status s = graph_cache_->Insert(cache_key, *optimized_graph);
+      if (!s.ok()) {
+        LOG(WARNING) << "Failed to store optimized graph in "
+                     << graph_cache_->directory() << ": " << s;
+      }
+    }
+  }
+
   const uint64 end_us = Env::Default()->NowMicros();
   metrics::UpdateGrapplerPassTime("*", end_us - start_us);
 
@@ -856,6 +1056,7 @@ bool MetaOptimizerEnabled(const ConfigProto& cfg) {
          rewrite_cfg.debug_stripper() == RewriterConfig::ON ||
          rewrite_cfg.scoped_allocator_optimization() == RewriterConfig::ON ||
          rewrite_cfg.pin_to_host_optimization() == RewriterConfig::ON ||
+         rewrite_cfg.apply_grouping() == RewriterConfig::ON ||
          AutoMixedPrecisionEnabled(rewrite_cfg.auto_mixed_precision()) ||
          AutoMixedPrecisionEnabled(rewrite_cfg.auto_mixed_precision_mkl()) ||
          !rewrite_cfg.optimizers().empty() ||
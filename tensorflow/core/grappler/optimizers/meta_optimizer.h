@@ -20,10 +20,13 @@ limitations under the License.
 #include "tensorflow/core/framework/device_base.h"
 #include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/grappler/clusters/cluster.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+#include "tensorflow/core/grappler/optimizers/optimized_graph_cache.h"
 #include "tensorflow/core/grappler/verifiers/graph_verifier.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/protobuf/config.pb.h"
 #include "tensorflow/core/protobuf/rewriter_config.pb.h"
 #include "tensorflow/core/protobuf/verifier_config.pb.h"
@@ -52,6 +55,10 @@ class MetaOptimizer : public GraphOptimizer {
 
   void PrintResult();
 
+  // Overrides the cache of optimized graphs, which defaults to
+  // OptimizedGraphCache::Global(). A null `cache` disables caching.
+  void set_graph_cache(OptimizedGraphCache* cache) { graph_cache_ = cache; }
+
   void Feedback(Cluster* cluster, const GrapplerItem& item,
                 const GraphDef& optimized_graph, double result) override {}
 
@@ -89,6 +96,7 @@ class MetaOptimizer : public GraphOptimizer {
   DeviceBase* const cpu_device_;  // may be NULL
   ConfigProto config_proto_;
   RewriterConfig& cfg_;
+  OptimizedGraphCache* graph_cache_;  // may be NULL, not owned
 
   struct OptimizerResult {
     string optimizer_name;
@@ -106,7 +114,35 @@ class MetaOptimizer : public GraphOptimizer {
                       GrapplerItem* optimized_item, GraphDef* optimized_graph,
                       GraphOptimizationResult* optimization_result);
 
+  // Same as OptimizeGraph above, but records the optimization result in
+  // `results` instead of `optimization_results_`, so that different items can
+  // be optimized concurrently.
+  Status OptimizeGraph(Cluster* cluster, GrapplerItem&& item,
+                       GraphDef* optimized_graph,
+                       std::vector<GraphOptimizationResult>* results);
+
+  // Returns the number of threads used to optimize the functions of the
+  // function library concurrently, with `cluster`.
+  int NumFunctionOptimizationThreads(const Cluster* cluster) const;
+
+  // Creates `function_optimization_pool_` with `num_threads` threads on first
+  // use, and resets the state of each of its threads for `cluster`.
+  Status InitializeFunctionOptimizationWorkers(Cluster* cluster,
+                                               int num_threads);
+
   std::vector<GraphOptimizationResult> optimization_results_;
+
+  // The state of a thread of `function_optimization_pool_`. Functions that
+  // are optimized concurrently do not share optimizers, clusters or devices.
+  struct FunctionOptimizationWorker {
+    std::unique_ptr<MetaOptimizer> optimizer;
+    std::unique_ptr<Cluster> cluster;  // Null if optimizing without a cluster.
+  };
+
+  // Optimizes the functions of the function library concurrently. Reused by
+  // every pass over the library.
+  std::unique_ptr<thread::ThreadPool> function_optimization_pool_;
+  std::vector<FunctionOptimizationWorker> function_optimization_workers_;
 };
 
 bool MetaOptimizerEnabled(const ConfigProto& cfg);
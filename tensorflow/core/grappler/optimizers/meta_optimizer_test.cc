@@ -21,6 +21,8 @@ limitations under the License.
 #include "tensorflow/core/framework/function_testlib.h"
 #include "tensorflow/core/framework/graph.pb.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/costs/graph_analysis_context.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/inputs/trivial_test_graph_input_yielder.h"
 #include "tensorflow/core/grappler/optimizers/custom_graph_optimizer.h"
@@ -29,8 +31,11 @@ limitations under the License.
 #include "tensorflow/core/grappler/utils/grappler_test.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/path.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/protobuf/config.pb.h"
 
 namespace tensorflow {
@@ -132,6 +137,72 @@ gtl::FlatMap<string, GrapplerItem::OptimizationOptions>*
 
 REGISTER_GRAPH_OPTIMIZER(GrapplerItemPropertiesAccumulator);
 
+// Infers the shapes of the graph and counts how many times the shapes
+// inferred by an earlier optimizer were reused.
+class ShapeInferringOptimizer : public CustomGraphOptimizer {
+ public:
+  static void ResetCounts() {
+    num_inferred_ = 0;
+    num_reused_ = 0;
+  }
+  static int num_inferred() { return num_inferred_; }
+  static int num_reused() { return num_reused_; }
+
+  ShapeInferringOptimizer() {}
+  string name() const override { return "shape_inferring_optimizer"; }
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Init(
+      const tensorflow::RewriterConfig_CustomGraphOptimizer* config) override {
+    return Status::OK();
+  }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override {
+    if (item.analysis_context != nullptr &&
+        item.analysis_context->FindStaticProperties(
+            item.graph, StaticInferenceOptions()) != nullptr) {
+      ++num_reused_;
+    } else {
+      ++num_inferred_;
+    }
+    GraphProperties properties(item);
+    TF_RETURN_IF_ERROR(properties.InferStatically(
+        /*assume_valid_feeds=*/false, /*aggressive_shape_inference=*/false,
+        /*include_input_tensor_values=*/false,
+        /*include_output_tensor_values=*/false));
+    return errors::Aborted("Nothing to do.");
+  }
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimized_graph, double result) override {}
+
+ private:
+  static int num_inferred_;
+  static int num_reused_;
+};
+
+int ShapeInferringOptimizer::num_inferred_;
+int ShapeInferringOptimizer::num_reused_;
+
+REGISTER_GRAPH_OPTIMIZER(ShapeInferringOptimizer);
+
+// Same, but returns a (copy of the) graph.
+class ShapeInferringRewriter : public ShapeInferringOptimizer {
+ public:
+  string name() const override { return "shape_inferring_rewriter"; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override {
+    ShapeInferringOptimizer::Optimize(cluster, item, optimized_graph)
+        .IgnoreError();
+    *optimized_graph = item.graph;
+    return Status::OK();
+  }
+};
+
+REGISTER_GRAPH_OPTIMIZER(ShapeInferringRewriter);
+
 class MetaOptimizerTest : public GrapplerTest {};
 
 TEST_F(MetaOptimizerTest, RunsCustomOptimizer) {
@@ -153,6 +224,72 @@ TEST_F(MetaOptimizerTest, RunsCustomOptimizer) {
   EXPECT_TRUE(TestOptimizer::IsOptimized());
 }
 
+TEST_F(MetaOptimizerTest, ReusesCachedOptimizedGraph) {
+  TrivialTestGraphInputYielder fake_input(4, 1, 10, false, {"CPU:0"});
+  GrapplerItem item;
+  ASSERT_TRUE(fake_input.NextItem(&item));
+
+  ConfigProto config_proto;
+  auto& rewriter_config =
+      *config_proto.mutable_graph_options()->mutable_rewrite_options();
+  rewriter_config.add_optimizers("TestOptimizer");
+  rewriter_config.set_min_graph_nodes(-1);
+
+  const string cache_dir =
+      io::JoinPath(testing::TmpDir(), "meta_optimizer_graph_cache");
+  int64 undeleted_files, undeleted_dirs;
+  Env::Default()
+      ->DeleteRecursively(cache_dir, &undeleted_files, &undeleted_dirs)
+      .IgnoreError();
+  TF_ASSERT_OK(Env::Default()->RecursivelyCreateDir(cache_dir));
+  OptimizedGraphCache cache(Env::Default(), cache_dir, 1 << 30);
+
+  TestOptimizer::SetOptimized(false);
+  MetaOptimizer optimizer(nullptr, config_proto);
+  optimizer.set_graph_cache(&cache);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_TRUE(TestOptimizer::IsOptimized());
+  EXPECT_EQ(1, cache.miss_count());
+
+  // A second optimizer with the same item and config loads the cached graph
+  // without running any pass.
+  TestOptimizer::SetOptimized(false);
+  MetaOptimizer warm_optimizer(nullptr, config_proto);
+  warm_optimizer.set_graph_cache(&cache);
+  GraphDef cached_output;
+  TF_EXPECT_OK(warm_optimizer.Optimize(nullptr, item, &cached_output));
+  EXPECT_FALSE(TestOptimizer::IsOptimized());
+  EXPECT_EQ(1, cache.hit_count());
+  CompareGraphs(output, cached_output);
+}
+
+TEST_F(MetaOptimizerTest, ReusesShapesUntilGraphChanges) {
+  TrivialTestGraphInputYielder fake_input(4, 1, 10, false, {"CPU:0"});
+  GrapplerItem item;
+  ASSERT_TRUE(fake_input.NextItem(&item));
+
+  ConfigProto config_proto;
+  auto& rewriter_config =
+      *config_proto.mutable_graph_options()->mutable_rewrite_options();
+  rewriter_config.add_optimizers("ShapeInferringOptimizer");
+  rewriter_config.add_optimizers("ShapeInferringOptimizer");
+  rewriter_config.add_optimizers("ShapeInferringRewriter");
+  rewriter_config.add_optimizers("ShapeInferringOptimizer");
+  rewriter_config.set_meta_optimizer_iterations(RewriterConfig::ONE);
+  rewriter_config.set_min_graph_nodes(-1);
+
+  ShapeInferringOptimizer::ResetCounts();
+  MetaOptimizer optimizer(nullptr, config_proto);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // The second optimizer and the rewriter get the graph left unchanged by the
+  // first optimizer, the last one gets the graph returned by the rewriter.
+  EXPECT_EQ(2, ShapeInferringOptimizer::num_inferred());
+  EXPECT_EQ(2, ShapeInferringOptimizer::num_reused());
+}
+
 TEST_F(MetaOptimizerTest, RunsCustomOptimizerWithParams) {
   TrivialTestGraphInputYielder fake_input(4, 1, 10, false, {"CPU:0"});
   GrapplerItem item;
@@ -1016,6 +1153,113 @@ TEST_F(MetaOptimizerTest, CompressConstants) {
   }
 }
 
+// Builds a graph that calls `num_functions` distinct non-inlinable functions,
+// each with a few foldable arithmetic ops. If `chained`, each function also
+// calls the previous one.
+GrapplerItem MakeFunctionLibraryItem(int num_functions, bool chained = false) {
+  using test::function::NDef;
+
+  std::vector<FunctionDef> funcs;
+  std::vector<NodeDef> nodes = {
+      NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice)};
+  GrapplerItem item;
+  item.id = "tf_graph";
+  for (int i = 0; i < num_functions; ++i) {
+    const string func_name = strings::StrCat("MyFunc", i);
+    std::vector<FunctionDefHelper::Node> func_nodes = {
+        FunctionDefHelper::Const("two", 2.0f),
+        FunctionDefHelper::Const("scale", static_cast<float>(i)),
+        {{"c"}, "Mul", {"two:output:0", "scale:output:0"}, {{"T", DT_FLOAT}}},
+        {{"y"}, "Mul", {"x", "c:z:0"}, {{"T", DT_FLOAT}}},
+        {{"z"}, "Add", {"y:z:0", "x"}, {{"T", DT_FLOAT}}}};
+    string ret = "z:z:0";
+    if (chained && i > 0) {
+      func_nodes.push_back(
+          {{"prev"}, strings::StrCat("MyFunc", i - 1), {"z:z:0"}, {}});
+      ret = "prev:z:0";
+    }
+    FunctionDef func = FunctionDefHelper::Create(
+        func_name, {"x:float"}, {"z:float"}, {}, func_nodes,
+        /*ret_def=*/
+        {{"z", ret}});
+    (*func.mutable_attr())["_noinline"].set_b(true);
+    funcs.push_back(func);
+
+    const string call = strings::StrCat("call", i);
+    const string out = strings::StrCat("out", i);
+    nodes.push_back(NDef(call, func_name, {"x"}, {}, kDevice));
+    nodes.push_back(NDef(out, "Identity", {strings::StrCat(call, ":0")},
+                         {{"T", DT_FLOAT}}, kDevice));
+    item.fetch.push_back(out);
+  }
+  item.graph = test::function::GDef(nodes, funcs);
+  return item;
+}
+
+Status OptimizeWithFunctionOptimizationThreads(const GrapplerItem& item,
+                                               int num_threads,
+                                               GraphDef* output) {
+  ConfigProto config_proto;
+  auto& rewriter_config =
+      *config_proto.mutable_graph_options()->mutable_rewrite_options();
+  rewriter_config.set_min_graph_nodes(-1);
+  rewriter_config.set_function_optimization_threads(num_threads);
+  MetaOptimizer optimizer(nullptr, config_proto);
+  optimizer.set_graph_cache(nullptr);
+  return optimizer.Optimize(nullptr, item, output);
+}
+
+void ExpectSameOptimizationInParallel(const GrapplerItem& item) {
+  GraphDef sequential_output;
+  TF_ASSERT_OK(
+      OptimizeWithFunctionOptimizationThreads(item, 1, &sequential_output));
+  GraphDef parallel_output;
+  TF_ASSERT_OK(
+      OptimizeWithFunctionOptimizationThreads(item, 8, &parallel_output));
+
+  CompareGraphs(sequential_output, parallel_output);
+  FunctionLibraryDefinition sequential_flib(OpRegistry::Global(),
+                                            sequential_output.library());
+  FunctionLibraryDefinition parallel_flib(OpRegistry::Global(),
+                                          parallel_output.library());
+  ASSERT_EQ(sequential_flib.num_functions(), parallel_flib.num_functions());
+  for (const string& name : sequential_flib.ListFunctionNames()) {
+    const FunctionDef* parallel_func = parallel_flib.Find(name);
+    ASSERT_NE(nullptr, parallel_func) << name;
+    CompareFunctions(*sequential_flib.Find(name), *parallel_func);
+  }
+}
+
+TEST_F(MetaOptimizerTest, OptimizeFunctionLibraryInParallel) {
+  // Optimizing independent functions concurrently gives the same result.
+  ExpectSameOptimizationInParallel(MakeFunctionLibraryItem(32));
+}
+
+TEST_F(MetaOptimizerTest, OptimizeCallingFunctionsInParallel) {
+  // Functions that call functions optimized earlier in the same pass see
+  // their optimized bodies, like in a sequential pass.
+  ExpectSameOptimizationInParallel(
+      MakeFunctionLibraryItem(32, /*chained=*/true));
+}
+
+void BM_OptimizeFunctionLibrary(int iters, int num_functions,
+                                int num_threads) {
+  testing::StopTiming();
+  const GrapplerItem item = MakeFunctionLibraryItem(num_functions);
+  testing::UseRealTime();
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    GraphDef output;
+    TF_CHECK_OK(
+        OptimizeWithFunctionOptimizationThreads(item, num_threads, &output));
+  }
+  testing::StopTiming();
+}
+BENCHMARK(BM_OptimizeFunctionLibrary)
+    ->ArgPair(500, 1)
+    ->ArgPair(500, 4)
+    ->ArgPair(500, 0);
+
 }  // namespace
 }  // namespace grappler
 }  // namespace tensorflow
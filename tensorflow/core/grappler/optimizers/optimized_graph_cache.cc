@@ -0,0 +1,249 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/optimized_graph_cache.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/framework/metrics.h"
+#include "tensorflow/core/framework/versions.pb.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/public/version.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+constexpr char kEntrySuffix[] = ".graphdef";
+constexpr int64 kDefaultMaxMegabytes = 1024;
+
+string FingerprintString(const string& s) {
+  const Fprint128 fp = Fingerprint128(s);
+  return strings::Printf("%016llx%016llx",
+                         static_cast<unsigned long long>(fp.high64),
+                         static_cast<unsigned long long>(fp.low64));
+}
+
+// Appends `proto` to `material`, prefixed with its length so that adjacent
+// fields can not alias each other.
+void AppendProto(const protobuf::MessageLite& proto, string* material) {
+  string serialized;
+  SerializeToStringDeterministic(proto, &serialized);
+  absl::StrAppend(material, serialized.size(), ":", serialized);
+}
+
+void AppendString(const string& s, string* material) {
+  absl::StrAppend(material, s.size(), ":", s);
+}
+
+}  // namespace
+
+OptimizedGraphCache::OptimizedGraphCache(Env* env, const string& directory,
+                                         int64 max_bytes)
+    : env_(env), directory_(directory), max_bytes_(max_bytes) {}
+
+/* static */
+OptimizedGraphCache* OptimizedGraphCache::Global() {
+  static OptimizedGraphCache* cache = []() -> OptimizedGraphCache* {
+    string directory;
+    Status s = ReadStringFromEnvVar("TF_GRAPPLER_GRAPH_CACHE_DIR", "",
+                                    &directory);
+    if (!s.ok()) {
+      LOG(ERROR) << "Disabling the Grappler graph cache: " << s;
+      return nullptr;
+    }
+    if (directory.empty()) return nullptr;
+    int64 max_mb;
+    s = ReadInt64FromEnvVar("TF_GRAPPLER_GRAPH_CACHE_MAX_MB",
+                            kDefaultMaxMegabytes, &max_mb);
+    if (!s.ok()) {
+      LOG(ERROR) << "Disabling the Grappler graph cache: " << s;
+      return nullptr;
+    }
+    Env* env = Env::Default();
+    s = env->RecursivelyCreateDir(directory);
+    if (!s.ok() && !errors::IsAlreadyExists(s)) {
+      LOG(WARNING) << "Disabling the Grappler graph cache: could not create "
+                   << directory << ": " << s;
+      return nullptr;
+    }
+    VLOG(1) << "Grappler graph cache enabled in " << directory << " (max "
+            << max_mb << " MB)";
+    return new OptimizedGraphCache(env, directory, max_mb << 20);
+  }();
+  return cache;
+}
+
+/* static */
+string OptimizedGraphCache::ComputeKey(const GrapplerItem& item,
+                                       const Cluster* cluster,
+                                       const ConfigProto& config) {
+  string material;
+  AppendString(TF_VERSION_STRING, &material);
+  AppendString(tf_git_version(), &material);
+  absl::StrAppend(&material, TF_GRAPH_DEF_VERSION, ";");
+
+  // The graph dominates the key material, so fingerprint it on its own.
+  string serialized_graph;
+  SerializeToStringDeterministic(item.graph, &serialized_graph);
+  AppendString(FingerprintString(serialized_graph), &material);
+
+  for (const auto& feed : item.feed) {
+    AppendString(feed.first, &material);
+    absl::StrAppend(&material, feed.second.dtype(), ":",
+                    feed.second.shape().DebugString(), ";");
+  }
+  absl::StrAppend(&material, "fetch;");
+  for (const string& fetch : item.fetch) AppendString(fetch, &material);
+  absl::StrAppend(&material, "init_ops;");
+  for (const string& init_op : item.init_ops) AppendString(init_op, &material);
+  absl::StrAppend(&material, "keep_ops;");
+  for (const string& keep_op : item.keep_ops) AppendString(keep_op, &material);
+  AppendString(item.save_op, &material);
+  AppendString(item.restore_op, &material);
+  AppendString(item.save_restore_loc_tensor, &material);
+  for (const QueueRunnerDef& queue_runner : item.queue_runners) {
+    AppendProto(queue_runner, &material);
+  }
+
+  const GrapplerItem::OptimizationOptions& options =
+      item.optimization_options();
+  absl::StrAppend(&material, "options;",
+                  options.allow_non_differentiable_rewrites,
+                  options.allow_pruning_stateful_and_dataset_ops,
+                  options.optimize_function_library, options.is_eager_mode,
+                  ";");
+
+  std::vector<string> devices(item.devices().begin(), item.devices().end());
+  std::sort(devices.begin(), devices.end());
+  absl::StrAppend(&material, "devices;");
+  for (const string& device : devices) AppendString(device, &material);
+
+  if (cluster != nullptr) {
+    // Layout and memory optimizations depend on the device properties, not
+    // only on the device names.
+    const std::map<string, DeviceProperties> properties(
+        cluster->GetDevices().begin(), cluster->GetDevices().end());
+    absl::StrAppend(&material, "cluster;");
+    for (const auto& device : properties) {
+      AppendString(device.first, &material);
+      AppendProto(device.second, &material);
+    }
+  }
+
+  // Custom optimizers are initialized with the whole config, so include
+  // everything that can influence graph rewriting.
+  AppendProto(config.graph_options(), &material);
+  AppendProto(config.experimental(), &material);
+
+  return FingerprintString(material);
+}
+
+string OptimizedGraphCache::PathForKey(const string& key) const {
+  return io::JoinPath(directory_, absl::StrCat(key, kEntrySuffix));
+}
+
+bool OptimizedGraphCache::Lookup(const string& key, GraphDef* graph) {
+  const string path = PathForKey(key);
+  bool hit = false;
+  if (env_->FileExists(path).ok()) {
+    Status s = ReadBinaryProto(env_, path, graph);
+    if (s.ok()) {
+      hit = true;
+    } else {
+      LOG(WARNING) << "Deleting unreadable Grappler graph cache entry " << path
+                   << ": " << s;
+      env_->DeleteFile(path).IgnoreError();
+    }
+  }
+  if (hit) {
+    hits_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+  }
+  metrics::RecordGrapplerGraphCacheLookup(hit);
+  VLOG(2) << "Grappler graph cache " << (hit ? "hit" : "miss") << " for "
+          << key;
+  return hit;
+}
+
+Status OptimizedGraphCache::Insert(const string& key, const GraphDef& graph) {
+  const string path = PathForKey(key);
+  // Write to a unique temporary file first, so that concurrent writers of the
+  // same key and concurrent readers never see a partially written entry.
+  const string tmp_path = strings::Printf(
+      "%s.tmp-%016llx", path.c_str(),
+      static_cast<unsigned long long>(random::New64()));
+  Status s = WriteBinaryProto(env_, tmp_path, graph);
+  if (s.ok()) {
+    s = env_->RenameFile(tmp_path, path);
+  }
+  if (!s.ok()) {
+    env_->DeleteFile(tmp_path).IgnoreError();
+    return s;
+  }
+  MaybeEvict();
+  return Status::OK();
+}
+
+void OptimizedGraphCache::MaybeEvict() {
+  mutex_lock l(evict_mu_);
+  std::vector<string> children;
+  if (!env_->GetChildren(directory_, &children).ok()) return;
+
+  struct Entry {
+    int64 mtime_nsec;
+    int64 length;
+    string path;
+  };
+  std::vector<Entry> entries;
+  int64 total_bytes = 0;
+  for (const string& child : children) {
+    if (!absl::EndsWith(child, kEntrySuffix)) continue;
+    const string path = io::JoinPath(directory_, child);
+    FileStatistics stat;
+    if (!env_->Stat(path, &stat).ok()) continue;
+    entries.push_back({stat.mtime_nsec, stat.length, path});
+    total_bytes += stat.length;
+  }
+  if (total_bytes <= max_bytes_) return;
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) {
+              return a.mtime_nsec < b.mtime_nsec;
+            });
+  for (const Entry& entry : entries) {
+    if (total_bytes <= max_bytes_) break;
+    if (env_->DeleteFile(entry.path).ok()) {
+      evictions_.fetch_add(1, std::memory_order_relaxed);
+      VLOG(2) << "Evicted Grappler graph cache entry " << entry.path;
+    }
+    total_bytes -= entry.length;
+  }
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,107 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_OPTIMIZED_GRAPH_CACHE_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_OPTIMIZED_GRAPH_CACHE_H_
+
+#include <atomic>
+#include <string>
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/grappler/clusters/cluster.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// A content-addressed, on-disk cache of graphs optimized by the
+// MetaOptimizer, shared by all processes that point it at the same
+// directory.
+//
+// Entries are keyed by a fingerprint of everything that determines the
+// optimizer's output: the input GraphDef (including its function library),
+// the feeds, fetches and other GrapplerItem fields, the optimization options,
+// the rewriter and graph options, the devices of the cluster and the
+// TensorFlow version. A warm start with an unchanged model and configuration
+// therefore skips all Grappler passes.
+//
+// Entries are written atomically (to a temporary file that is then renamed),
+// so concurrent writers and readers never observe partial graphs. Once the
+// total size of the cache directory exceeds `max_bytes`, the least recently
+// written entries are deleted.
+class OptimizedGraphCache {
+ public:
+  OptimizedGraphCache(Env* env, const string& directory, int64 max_bytes);
+  ~OptimizedGraphCache() {}
+
+  // Returns the process-wide cache, or nullptr if caching is disabled.
+  //
+  // The cache is enabled by setting TF_GRAPPLER_GRAPH_CACHE_DIR to a
+  // directory. Its size is bounded by TF_GRAPPLER_GRAPH_CACHE_MAX_MB
+  // (default 1024).
+  static OptimizedGraphCache* Global();
+
+  // Returns the cache key for optimizing `item` on `cluster` (which may be
+  // null) with the options in `config`.
+  static string ComputeKey(const GrapplerItem& item, const Cluster* cluster,
+                           const ConfigProto& config);
+
+  // Looks up `key`. On a hit, fills in `*graph` and returns true. Unreadable
+  // entries are deleted and reported as misses.
+  bool Lookup(const string& key, GraphDef* graph);
+
+  // Stores `graph` under `key`, then evicts old entries if the cache exceeds
+  // its size bound.
+  Status Insert(const string& key, const GraphDef& graph);
+
+  const string& directory() const { return directory_; }
+
+  int64 hit_count() const { return hits_.load(std::memory_order_relaxed); }
+  int64 miss_count() const { return misses_.load(std::memory_order_relaxed); }
+  int64 eviction_count() const {
+    return evictions_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  string PathForKey(const string& key) const;
+
+  // Deletes the oldest entries until the cache holds at most `max_bytes_`.
+  void MaybeEvict();
+
+  Env* const env_;
+  const string directory_;
+  const int64 max_bytes_;
+
+  // Serializes eviction within this process. Other processes may evict
+  // concurrently; deleting a file twice is harmless.
+  mutex evict_mu_;
+
+  std::atomic<int64> hits_{0};
+  std::atomic<int64> misses_{0};
+  std::atomic<int64> evictions_{0};
+
+  TF_DISALLOW_COPY_AND_ASSIGN(OptimizedGraphCache);
+};
+
+}  // namespace grappler
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_OPTIMIZED_GRAPH_CACHE_H_
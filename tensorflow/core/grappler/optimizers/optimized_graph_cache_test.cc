@@ -0,0 +1,149 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/optimized_graph_cache.h"
+
+#include <vector>
+
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/strcat.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+class OptimizedGraphCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = io::JoinPath(testing::TmpDir(), "optimized_graph_cache_test");
+    int64 undeleted_files, undeleted_dirs;
+    Env::Default()
+        ->DeleteRecursively(dir_, &undeleted_files, &undeleted_dirs)
+        .IgnoreError();
+    TF_ASSERT_OK(Env::Default()->RecursivelyCreateDir(dir_));
+  }
+
+  static GrapplerItem MakeItem(int num_nodes) {
+    GrapplerItem item;
+    item.id = "item";
+    for (int i = 0; i < num_nodes; ++i) {
+      NodeDef* node = item.graph.add_node();
+      node->set_name(strings::StrCat("node_", i));
+      node->set_op("NoOp");
+    }
+    item.fetch.push_back("node_0");
+    return item;
+  }
+
+  int NumEntries() {
+    std::vector<string> children;
+    TF_CHECK_OK(Env::Default()->GetChildren(dir_, &children));
+    return children.size();
+  }
+
+  string dir_;
+};
+
+TEST_F(OptimizedGraphCacheTest, KeyDependsOnInputs) {
+  const GrapplerItem item = MakeItem(3);
+  ConfigProto config;
+  const string key = OptimizedGraphCache::ComputeKey(item, nullptr, config);
+  EXPECT_EQ(32, key.size());
+
+  // The item id is not part of the key.
+  GrapplerItem renamed = item;
+  renamed.id = "other";
+  EXPECT_EQ(key, OptimizedGraphCache::ComputeKey(renamed, nullptr, config));
+
+  EXPECT_NE(key, OptimizedGraphCache::ComputeKey(MakeItem(4), nullptr, config));
+
+  GrapplerItem other_fetch = item;
+  other_fetch.fetch = {"node_1"};
+  EXPECT_NE(key, OptimizedGraphCache::ComputeKey(other_fetch, nullptr, config));
+
+  GrapplerItem with_device = item;
+  TF_ASSERT_OK(with_device.AddDevice("/job:localhost/replica:0/task:0/CPU:0"));
+  EXPECT_NE(key, OptimizedGraphCache::ComputeKey(with_device, nullptr, config));
+
+  GrapplerItem no_function_library = item;
+  no_function_library.optimization_options().optimize_function_library = false;
+  EXPECT_NE(key, OptimizedGraphCache::ComputeKey(no_function_library, nullptr,
+                                                 config));
+
+  ConfigProto no_constant_folding;
+  no_constant_folding.mutable_graph_options()
+      ->mutable_rewrite_options()
+      ->set_constant_folding(RewriterConfig::OFF);
+  EXPECT_NE(key, OptimizedGraphCache::ComputeKey(item, nullptr,
+                                                 no_constant_folding));
+}
+
+TEST_F(OptimizedGraphCacheTest, InsertAndLookup) {
+  OptimizedGraphCache cache(Env::Default(), dir_, 1 << 20);
+  const GrapplerItem item = MakeItem(3);
+  const string key =
+      OptimizedGraphCache::ComputeKey(item, nullptr, ConfigProto());
+
+  GraphDef graph;
+  EXPECT_FALSE(cache.Lookup(key, &graph));
+  EXPECT_EQ(1, cache.miss_count());
+
+  TF_ASSERT_OK(cache.Insert(key, MakeItem(2).graph));
+  EXPECT_EQ(1, NumEntries());
+
+  // A second cache over the same directory, as in a new process, sees the
+  // entry.
+  OptimizedGraphCache warm_cache(Env::Default(), dir_, 1 << 20);
+  ASSERT_TRUE(warm_cache.Lookup(key, &graph));
+  EXPECT_EQ(1, warm_cache.hit_count());
+  EXPECT_EQ(2, graph.node_size());
+}
+
+TEST_F(OptimizedGraphCacheTest, CorruptEntryIsDeleted) {
+  OptimizedGraphCache cache(Env::Default(), dir_, 1 << 20);
+  const string key = "0123456789abcdef0123456789abcdef";
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(),
+                                 io::JoinPath(dir_, key + ".graphdef"),
+                                 "not a graph"));
+  GraphDef graph;
+  EXPECT_FALSE(cache.Lookup(key, &graph));
+  EXPECT_EQ(0, NumEntries());
+}
+
+TEST_F(OptimizedGraphCacheTest, EvictsOldestEntries) {
+  const GraphDef graph = MakeItem(100).graph;
+  const int64 entry_bytes = graph.ByteSizeLong();
+  // Room for three entries.
+  OptimizedGraphCache cache(Env::Default(), dir_, 3 * entry_bytes + 1);
+  for (int i = 0; i < 5; ++i) {
+    TF_ASSERT_OK(cache.Insert(strings::StrCat("key_", i), graph));
+    // Keep modification times ordered on filesystems with coarse timestamps.
+    Env::Default()->SleepForMicroseconds(10 * 1000);
+  }
+  EXPECT_EQ(3, NumEntries());
+  EXPECT_EQ(2, cache.eviction_count());
+  GraphDef found;
+  EXPECT_FALSE(cache.Lookup("key_0", &found));
+  EXPECT_FALSE(cache.Lookup("key_1", &found));
+  EXPECT_TRUE(cache.Lookup("key_4", &found));
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
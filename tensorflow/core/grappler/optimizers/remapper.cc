@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/grappler/optimizers/remapper.h"
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
@@ -1679,6 +1680,52 @@ bool RequiresInferredShapes(const RemapperContext& ctx, int node_index) {
 #endif  // INTEL_MKL
 }
 
+#ifndef INTEL_MKL
+// Marks the CPU MatMuls whose right-hand side is a Const on the same device,
+// possibly read through Identity nodes, with a `_constant_rhs` attribute, and
+// such Conv2Ds with a `_constant_filter` attribute. Their kernels then pack the
+// right-hand side once instead of in every step. Must run after the fusions,
+// which do not copy the attributes to the fused nodes.
+void MarkConstantRhsContractions(GraphDef* graph) {
+  absl::flat_hash_map<string, const NodeDef*> nodes;
+  for (const NodeDef& node : graph->node()) {
+    nodes.emplace(node.name(), &node);
+  }
+
+  const auto is_constant_rhs = [&](const NodeDef& matmul) {
+    if (matmul.input_size() < 2 || IsControlInput(matmul.input(1))) {
+      return false;
+    }
+    auto it = nodes.find(NodeName(matmul.input(1)));
+    while (it != nodes.end() && IsIdentity(*it->second) &&
+           it->second->device() == matmul.device() &&
+           it->second->input_size() > 0 &&
+           !IsControlInput(it->second->input(0))) {
+      it = nodes.find(NodeName(it->second->input(0)));
+    }
+    return it != nodes.end() && IsConstant(*it->second) &&
+           it->second->device() == matmul.device();
+  };
+
+  for (NodeDef& node : *graph->mutable_node()) {
+    const bool is_packed_matmul =
+        (IsMatMul(node) && (HasDataType(&node, DT_FLOAT) ||
+                            HasDataType(&node, DT_BFLOAT16))) ||
+        (node.op() == kFusedMatMul && HasDataType(&node, DT_FLOAT));
+    const bool is_packed_conv2d =
+        (IsConv2D(node) || node.op() == kFusedConv2D) &&
+        HasDataType(&node, DT_FLOAT);
+    if (!(is_packed_matmul || is_packed_conv2d) || !NodeIsOnCpu(&node) ||
+        !is_constant_rhs(node)) {
+      continue;
+    }
+    (*node.mutable_attr())[is_packed_matmul ? "_constant_rhs"
+                                            : "_constant_filter"]
+        .set_b(true);
+  }
+}
+#endif  // !INTEL_MKL
+
 }  // namespace
 
 Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
@@ -1845,6 +1892,10 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
   }
   TF_RETURN_IF_ERROR(mutation->Apply());
 
+#ifndef INTEL_MKL
+  MarkConstantRhsContractions(&mutable_item.graph);
+#endif  // !INTEL_MKL
+
   *optimized_graph = std::move(mutable_item.graph);
 
   return Status::OK();
@@ -465,6 +465,150 @@ TEST_F(RemapperFuseMatMulWithBiasTest, Bf16) {
   RunTest<DT_BFLOAT16>();  // NOLINT
 }
 
+#ifndef INTEL_MKL
+TEST_F(RemapperTest, MarkMatMulsWithConstantRhs) {
+  using ::tensorflow::ops::Placeholder;
+
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto lhs_shape = ops::Placeholder::Shape({8, 32});
+  auto rhs_shape = ops::Placeholder::Shape({32, 64});
+
+  auto lhs = Placeholder(s.WithOpName("lhs"), DT_FLOAT, lhs_shape);
+  auto rhs = Placeholder(s.WithOpName("rhs"), DT_FLOAT, rhs_shape);
+  auto weights = ops::Const(s.WithOpName("weights"),
+                            GenerateRandomTensor<DT_FLOAT>({32, 64}));
+  auto weights_read = ops::Identity(s.WithOpName("weights_read"), weights);
+  auto bias = ops::Const(s.WithOpName("bias"),
+                         GenerateRandomTensor<DT_FLOAT>({64}));
+
+  Output constant_matmul =
+      ops::MatMul(s.WithOpName("constant_matmul"), lhs, weights_read);
+  Output fused_matmul =
+      ops::MatMul(s.WithOpName("fused_matmul"), lhs, weights);
+  Output bias_add = ops::BiasAdd(s.WithOpName("bias_add"), fused_matmul, bias);
+  Output matmul = ops::MatMul(s.WithOpName("matmul"), lhs, rhs);
+  auto fetch = ops::AddN(s.WithOpName("fetch"),
+                         {constant_matmul, bias_add, matmul});
+
+  auto lhs_t = GenerateRandomTensor<DT_FLOAT>({8, 32});
+  auto rhs_t = GenerateRandomTensor<DT_FLOAT>({32, 64});
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  item.feed = {{"lhs", lhs_t}, {"rhs", rhs_t}};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  // Place all nodes on CPU.
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "constant_matmul") {
+      EXPECT_EQ(node.op(), "MatMul");
+      ASSERT_EQ(node.attr().count("_constant_rhs"), 1);
+      EXPECT_TRUE(node.attr().at("_constant_rhs").b());
+      found++;
+    } else if (node.name() == "bias_add") {
+      EXPECT_EQ(node.op(), "_FusedMatMul");
+      ASSERT_EQ(node.attr().count("_constant_rhs"), 1);
+      EXPECT_TRUE(node.attr().at("_constant_rhs").b());
+      found++;
+    } else if (node.name() == "matmul") {
+      EXPECT_EQ(node.op(), "MatMul");
+      EXPECT_EQ(node.attr().count("_constant_rhs"), 0);
+      found++;
+    }
+  }
+  EXPECT_EQ(found, 3);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  ASSERT_EQ(tensors_expected.size(), 1);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  ASSERT_EQ(tensors.size(), 1);
+  test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-5);
+}
+
+TEST_F(RemapperTest, MarkConv2DsWithConstantFilter) {
+  using ::tensorflow::ops::Placeholder;
+
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto input_shape = ops::Placeholder::Shape({2, 3, 3, 32});
+  auto filter_shape = ops::Placeholder::Shape({1, 1, 32, 64});
+
+  auto input = Placeholder(s.WithOpName("input"), DT_FLOAT, input_shape);
+  auto filter = Placeholder(s.WithOpName("filter"), DT_FLOAT, filter_shape);
+  auto weights_1x1 = ops::Const(s.WithOpName("weights_1x1"),
+                                GenerateRandomTensor<DT_FLOAT>({1, 1, 32, 64}));
+  auto weights_read = ops::Identity(s.WithOpName("weights_read"), weights_1x1);
+  auto weights_3x3 = ops::Const(s.WithOpName("weights_3x3"),
+                                GenerateRandomTensor<DT_FLOAT>({3, 3, 32, 64}));
+  auto bias = ops::Const(s.WithOpName("bias"),
+                         GenerateRandomTensor<DT_FLOAT>({64}));
+
+  std::vector<int> strides = {1, 1, 1, 1};
+  auto constant_conv = ops::Conv2D(s.WithOpName("constant_conv"), input,
+                                   weights_read, strides, "SAME");
+  auto fused_conv = ops::Conv2D(s.WithOpName("fused_conv"), input, weights_3x3,
+                                strides, "VALID");
+  auto bias_add = ops::BiasAdd(s.WithOpName("bias_add"), fused_conv, bias);
+  auto conv = ops::Conv2D(s.WithOpName("conv"), input, filter, strides, "SAME");
+
+  auto input_t = GenerateRandomTensor<DT_FLOAT>({2, 3, 3, 32});
+  auto filter_t = GenerateRandomTensor<DT_FLOAT>({1, 1, 32, 64});
+
+  GrapplerItem item;
+  item.fetch = {"constant_conv", "bias_add", "conv"};
+  item.feed = {{"input", input_t}, {"filter", filter_t}};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  // Place all nodes on CPU.
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "constant_conv") {
+      EXPECT_EQ(node.op(), "Conv2D");
+      ASSERT_EQ(node.attr().count("_constant_filter"), 1);
+      EXPECT_TRUE(node.attr().at("_constant_filter").b());
+      found++;
+    } else if (node.name() == "bias_add") {
+      EXPECT_EQ(node.op(), "_FusedConv2D");
+      ASSERT_EQ(node.attr().count("_constant_filter"), 1);
+      EXPECT_TRUE(node.attr().at("_constant_filter").b());
+      found++;
+    } else if (node.name() == "conv") {
+      EXPECT_EQ(node.op(), "Conv2D");
+      EXPECT_EQ(node.attr().count("_constant_filter"), 0);
+      found++;
+    }
+  }
+  EXPECT_EQ(found, 3);
+
+  // Both constant convolutions run on the packed filter.
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  ASSERT_EQ(tensors_expected.size(), 3);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  ASSERT_EQ(tensors.size(), 3);
+  for (int i = 0; i < 3; ++i) {
+    test::ExpectTensorNear<float>(tensors[i], tensors_expected[i], 1e-4);
+  }
+}
+#endif  // !INTEL_MKL
+
 // TODO(b/161005848): Fix flaky test.
 TEST_F(RemapperTest, DISABLED_FuseConv2DWithBiasAndActivationOnGPU) {
 #if !(GOOGLE_CUDA)
@@ -42,19 +42,25 @@ class BatchResource : public serving::BatchResourceBase {
                        const std::vector<int32>& allowed_batch_sizes,
                        FunctionLibraryRuntime::Handle fhandle,
                        bool enable_large_batch_splitting,
+                       int64 latency_slo_micros,
                        std::unique_ptr<BatchResource>* resource) {
     BatcherT::Options batcher_options;
     batcher_options.num_batch_threads = num_batch_threads;
     std::shared_ptr<BatcherT> batcher;
     TF_RETURN_IF_ERROR(BatcherT::Create(batcher_options, &batcher));
 
-    resource->reset(new BatchResource(
-        fhandle, std::move(batcher),
-        GetBatcherQueueOptions(num_batch_threads, max_batch_size,
-                               batch_timeout_micros, max_enqueued_batches,
-                               allowed_batch_sizes,
-                               enable_large_batch_splitting),
-        allowed_batch_sizes));
+    BatcherT::QueueOptions batcher_queue_options = GetBatcherQueueOptions(
+        num_batch_threads, max_batch_size, batch_timeout_micros,
+        max_enqueued_batches, allowed_batch_sizes,
+        enable_large_batch_splitting);
+    if (latency_slo_micros > 0) {
+      TF_RETURN_IF_ERROR(AddAdaptiveBatchController(
+          latency_slo_micros, allowed_batch_sizes, &batcher_queue_options));
+    }
+
+    resource->reset(new BatchResource(fhandle, std::move(batcher),
+                                      batcher_queue_options,
+                                      allowed_batch_sizes));
     return Status::OK();
   }
 
@@ -133,6 +139,16 @@ class BatchFunctionKernel : public AsyncOpKernel {
       enable_large_batch_splitting_ = false;
     }
 
+    if (c->HasAttr("latency_slo_micros")) {
+      OP_REQUIRES_OK(c, c->GetAttr("latency_slo_micros", &latency_slo_micros_));
+      OP_REQUIRES(c, latency_slo_micros_ >= 0,
+                  errors::InvalidArgument(
+                      "latency_slo_micros must be non-negative; was ",
+                      latency_slo_micros_));
+    } else {
+      latency_slo_micros_ = 0;
+    }
+
     OP_REQUIRES_OK(c, ValidateAllowedBatchSizes());
   }
 
@@ -145,7 +161,7 @@ class BatchFunctionKernel : public AsyncOpKernel {
       TF_RETURN_IF_ERROR(BatchResource::Create(
           num_batch_threads_, max_batch_size_, batch_timeout_micros_,
           max_enqueued_batches_, allowed_batch_sizes_, fhandle_,
-          enable_large_batch_splitting_, &new_resource));
+          enable_large_batch_splitting_, latency_slo_micros_, &new_resource));
       *r = new_resource.release();
       return Status::OK();
     };
@@ -197,6 +213,7 @@ class BatchFunctionKernel : public AsyncOpKernel {
   std::vector<int32> allowed_batch_sizes_;
   FunctionLibraryRuntime::Handle fhandle_;
   bool enable_large_batch_splitting_;
+  int64 latency_slo_micros_;
 };
 
 REGISTER_KERNEL_BUILDER(Name("BatchFunction").Device(DEVICE_CPU),
@@ -229,7 +246,8 @@ class BatchKernel : public AsyncOpKernel {
       std::unique_ptr<BatchResource> new_resource;
       TF_RETURN_IF_ERROR(BatchResource::Create(
           num_batch_threads_, max_batch_size_, batch_timeout_micros_,
-          max_enqueued_batches_, allowed_batch_sizes_, kInvalidHandle, false,
+          max_enqueued_batches_, allowed_batch_sizes_, kInvalidHandle,
+          /*enable_large_batch_splitting=*/false, /*latency_slo_micros=*/0,
           &new_resource));
       *r = new_resource.release();
       return Status::OK();
@@ -0,0 +1,206 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/batching_util/adaptive_batch_controller.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "tensorflow/core/platform/errors.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+// Weight of the latest window in the moving averages.
+constexpr double kSmoothing = 0.3;
+
+// The latency budget is multiplied by kBudgetDecrease when the SLO is missed,
+// and grows by kBudgetIncrease (as a fraction of the SLO) while the observed
+// latency stays below kBudgetHeadroom times the SLO.
+constexpr double kBudgetDecrease = 0.8;
+constexpr double kBudgetIncrease = 0.05;
+constexpr double kBudgetHeadroom = 0.9;
+constexpr double kMinBudgetFraction = 0.1;
+
+// Bounds the memory used to compute the 99th percentile of a window.
+constexpr size_t kMaxLatencySamples = 10000;
+
+}  // namespace
+
+/*static*/ Status AdaptiveBatchController::Create(
+    const Options& options,
+    std::shared_ptr<AdaptiveBatchController>* controller) {
+  if (options.latency_slo_micros <= 0) {
+    return errors::InvalidArgument("latency_slo_micros must be positive; was ",
+                                   options.latency_slo_micros);
+  }
+  if (options.min_batch_timeout_micros < 0 ||
+      options.max_batch_timeout_micros < options.min_batch_timeout_micros) {
+    return errors::InvalidArgument(
+        "batch timeout bounds must satisfy 0 <= min <= max; were ",
+        options.min_batch_timeout_micros, " and ",
+        options.max_batch_timeout_micros);
+  }
+  if (options.max_batch_size <= 0) {
+    return errors::InvalidArgument("max_batch_size must be positive; was ",
+                                   options.max_batch_size);
+  }
+  int32 last_size = 0;
+  for (int32 size : options.allowed_batch_sizes) {
+    if (size <= last_size) {
+      return errors::InvalidArgument(
+          "allowed_batch_sizes entries must be positive and monotonically "
+          "increasing");
+    }
+    last_size = size;
+  }
+  if (options.adjustment_interval_micros <= 0) {
+    return errors::InvalidArgument(
+        "adjustment_interval_micros must be positive; was ",
+        options.adjustment_interval_micros);
+  }
+  controller->reset(new AdaptiveBatchController(options));
+  return Status::OK();
+}
+
+AdaptiveBatchController::AdaptiveBatchController(const Options& options)
+    : options_(options),
+      window_start_micros_(options.env->NowMicros()),
+      batch_timeout_micros_(options.max_batch_timeout_micros),
+      target_batch_size_(options.max_batch_size) {
+  for (int32 size : options.allowed_batch_sizes) {
+    if (size >= options.max_batch_size) break;
+    batch_sizes_.push_back(size);
+  }
+  if (options.allowed_batch_sizes.empty()) {
+    for (int32 size = 1; size < options.max_batch_size; size *= 2) {
+      batch_sizes_.push_back(size);
+    }
+  }
+  batch_sizes_.push_back(options.max_batch_size);
+  processing_micros_.resize(batch_sizes_.size(), -1);
+}
+
+void AdaptiveBatchController::RecordArrival(int64 size) {
+  window_arrivals_.fetch_add(size, std::memory_order_relaxed);
+}
+
+void AdaptiveBatchController::RecordBatch(int64 batch_size,
+                                          int64 processing_micros,
+                                          int64 latency_micros) {
+  mutex_lock l(mu_);
+  // Batches larger than every candidate, e.g. when padding is disabled, are
+  // accounted with the largest one.
+  const int i =
+      std::min<int>(std::lower_bound(batch_sizes_.begin(), batch_sizes_.end(),
+                                     batch_size) -
+                        batch_sizes_.begin(),
+                    batch_sizes_.size() - 1);
+  double& average = processing_micros_[i];
+  average = average < 0 ? processing_micros
+                        : kSmoothing * processing_micros +
+                              (1 - kSmoothing) * average;
+  if (window_latencies_micros_.size() < kMaxLatencySamples) {
+    window_latencies_micros_.push_back(latency_micros);
+  }
+  MaybeAdjust();
+}
+
+double AdaptiveBatchController::EstimatedProcessingMicros(int i) const {
+  if (processing_micros_[i] >= 0) return processing_micros_[i];
+  int lower = i - 1;
+  while (lower >= 0 && processing_micros_[lower] < 0) --lower;
+  int upper = i + 1;
+  while (upper < batch_sizes_.size() && processing_micros_[upper] < 0) {
+    ++upper;
+  }
+  const bool has_upper = upper < batch_sizes_.size();
+  if (lower >= 0 && has_upper) {
+    const double t =
+        static_cast<double>(batch_sizes_[i] - batch_sizes_[lower]) /
+        (batch_sizes_[upper] - batch_sizes_[lower]);
+    return processing_micros_[lower] +
+           t * (processing_micros_[upper] - processing_micros_[lower]);
+  }
+  // Extrapolates linearly to larger batches, which overestimates their cost
+  // as the fixed cost of a batch is amortized, and assumes smaller batches
+  // are no cheaper.
+  if (lower >= 0) {
+    return processing_micros_[lower] * batch_sizes_[i] / batch_sizes_[lower];
+  }
+  if (has_upper) return processing_micros_[upper];
+  return -1;
+}
+
+void AdaptiveBatchController::MaybeAdjust() {
+  const uint64 now_micros = options_.env->NowMicros();
+  const uint64 elapsed_micros = now_micros - window_start_micros_;
+  if (elapsed_micros < options_.adjustment_interval_micros ||
+      window_latencies_micros_.size() < options_.min_batches_per_adjustment) {
+    return;
+  }
+
+  const double window_rate =
+      static_cast<double>(window_arrivals_.exchange(0)) / elapsed_micros;
+  arrival_rate_ = arrival_rate_ < 0 ? window_rate
+                                    : kSmoothing * window_rate +
+                                          (1 - kSmoothing) * arrival_rate_;
+
+  auto p99 = window_latencies_micros_.begin() +
+             (window_latencies_micros_.size() - 1) * 99 / 100;
+  std::nth_element(window_latencies_micros_.begin(), p99,
+                   window_latencies_micros_.end());
+  if (*p99 > options_.latency_slo_micros) {
+    latency_budget_fraction_ = std::max(
+        kMinBudgetFraction, latency_budget_fraction_ * kBudgetDecrease);
+  } else if (*p99 < kBudgetHeadroom * options_.latency_slo_micros) {
+    latency_budget_fraction_ =
+        std::min(1.0, latency_budget_fraction_ + kBudgetIncrease);
+  }
+  window_latencies_micros_.clear();
+  window_start_micros_ = now_micros;
+
+  const double budget_micros =
+      latency_budget_fraction_ * options_.latency_slo_micros;
+  // Falls back to the smallest batches if no size fits in the budget.
+  int best = 0;
+  double best_throughput = 0;
+  for (int i = 0; i < batch_sizes_.size(); ++i) {
+    const double processing_micros = EstimatedProcessingMicros(i);
+    if (processing_micros < 0) return;
+    const double fill_micros = arrival_rate_ > 0
+                                   ? batch_sizes_[i] / arrival_rate_
+                                   : std::numeric_limits<double>::infinity();
+    if (i > 0 && fill_micros + processing_micros > budget_micros) continue;
+    const double throughput =
+        batch_sizes_[i] / std::max(processing_micros, 1.0);
+    if (throughput > best_throughput) {
+      best = i;
+      best_throughput = throughput;
+    }
+  }
+
+  const int64 timeout_micros =
+      static_cast<int64>(budget_micros - EstimatedProcessingMicros(best));
+  batch_timeout_micros_.store(
+      std::min(options_.max_batch_timeout_micros,
+               std::max(options_.min_batch_timeout_micros, timeout_micros)),
+      std::memory_order_relaxed);
+  target_batch_size_.store(batch_sizes_[best], std::memory_order_relaxed);
+}
+
+}  // namespace serving
+}  // namespace tensorflow
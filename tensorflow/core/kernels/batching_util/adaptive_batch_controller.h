@@ -0,0 +1,153 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_BATCHING_UTIL_ADAPTIVE_BATCH_CONTROLLER_H_
+#define TENSORFLOW_CORE_KERNELS_BATCHING_UTIL_ADAPTIVE_BATCH_CONTROLLER_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace serving {
+
+// Adjusts the batch timeout and the target batch size of batching queues
+// online, to maximize throughput while keeping the 99th percentile latency of
+// tasks under a target (the SLO), instead of hand-tuning a static timeout per
+// model and traffic pattern.
+//
+// The controller observes the arrival rate of tasks and the processing time
+// of batches of each candidate size, and models the latency of the oldest
+// task of a batch of size s as
+//
+//   s / arrival_rate + processing_micros(s),
+//
+// i.e. the time to fill the batch, followed by its processing. Among the
+// candidate sizes that fit in the latency budget, it targets the one that
+// processes the most tasks per unit of time, and sets the timeout to the rest
+// of the budget once the batch is processed. The budget starts at the SLO,
+// and shrinks multiplicatively whenever the observed 99th percentile exceeds
+// the SLO, e.g. due to batches queueing behind each other, which the model
+// ignores; it grows back additively while the SLO is met.
+//
+// Until enough batches are observed, the controller keeps the maximum timeout
+// and batch size, i.e. the static configuration.
+//
+// This class is thread-safe. The batching queue reads the parameters with
+// batch_timeout_micros() and target_batch_size(), which do not lock.
+class AdaptiveBatchController {
+ public:
+  struct Options {
+    // The target 99th percentile latency of tasks, from their arrival until
+    // the end of the processing of their batch. Must be positive.
+    int64 latency_slo_micros = 0;
+
+    // Bounds of the batch timeout.
+    int64 min_batch_timeout_micros = 0;
+    int64 max_batch_timeout_micros = 0;
+
+    // The largest size of a batch. Must be positive.
+    int32 max_batch_size = 0;
+
+    // The sizes batches are padded to, in increasing order. If empty, the
+    // controller considers powers of two and 'max_batch_size' instead.
+    std::vector<int32> allowed_batch_sizes;
+
+    // Observations are aggregated over windows of at least this duration and
+    // this number of batches, at the end of which the parameters are
+    // adjusted.
+    int64 adjustment_interval_micros = 100 * 1000;
+    int32 min_batches_per_adjustment = 10;
+
+    // The environment to use.
+    // (Typically only overridden by test code.)
+    Env* env = Env::Default();
+  };
+
+  static Status Create(const Options& options,
+                       std::shared_ptr<AdaptiveBatchController>* controller);
+
+  // Records the arrival of a task of 'size' items.
+  void RecordArrival(int64 size);
+
+  // Records a batch of 'batch_size' items (including padding) that took
+  // 'processing_micros' to process, and whose oldest task completed
+  // 'latency_micros' after its arrival. May adjust the parameters.
+  void RecordBatch(int64 batch_size, int64 processing_micros,
+                   int64 latency_micros) TF_LOCKS_EXCLUDED(mu_);
+
+  // The current batch timeout, in microseconds.
+  int64 batch_timeout_micros() const {
+    return batch_timeout_micros_.load(std::memory_order_relaxed);
+  }
+
+  // The current size at which batches are closed for processing.
+  int64 target_batch_size() const {
+    return target_batch_size_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  explicit AdaptiveBatchController(const Options& options);
+
+  // Adjusts the parameters if the current window of observations is complete.
+  void MaybeAdjust() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Returns the estimated processing time of a batch of 'batch_sizes_[i]'
+  // items, interpolated from the other sizes if it was not observed, or -1 if
+  // no batch was observed at all.
+  double EstimatedProcessingMicros(int i) const
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const Options options_;
+
+  // The candidate batch sizes, in increasing order.
+  std::vector<int32> batch_sizes_;
+
+  // The number of items that arrived since the start of the window.
+  std::atomic<int64> window_arrivals_{0};
+
+  mutex mu_;
+
+  uint64 window_start_micros_ TF_GUARDED_BY(mu_);
+
+  // The latencies of the batches processed since the start of the window.
+  std::vector<int64> window_latencies_micros_ TF_GUARDED_BY(mu_);
+
+  // Moving averages of the arrival rate, in items per microsecond, and of the
+  // processing time of batches of each of 'batch_sizes_' (or -1 until one is
+  // observed).
+  double arrival_rate_ TF_GUARDED_BY(mu_) = -1;
+  std::vector<double> processing_micros_ TF_GUARDED_BY(mu_);
+
+  // The fraction of the SLO the parameters are chosen to fit in.
+  double latency_budget_fraction_ TF_GUARDED_BY(mu_) = 1.0;
+
+  std::atomic<int64> batch_timeout_micros_;
+  std::atomic<int64> target_batch_size_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(AdaptiveBatchController);
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_BATCHING_UTIL_ADAPTIVE_BATCH_CONTROLLER_H_
@@ -0,0 +1,135 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/batching_util/adaptive_batch_controller.h"
+
+#include "tensorflow/core/kernels/batching_util/fake_clock_env.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+AdaptiveBatchController::Options TestOptions(Env* env) {
+  AdaptiveBatchController::Options options;
+  options.latency_slo_micros = 1000;
+  options.max_batch_timeout_micros = 10000;
+  options.max_batch_size = 4;
+  options.allowed_batch_sizes = {1, 2, 4};
+  options.adjustment_interval_micros = 100000;
+  options.min_batches_per_adjustment = 3;
+  options.env = env;
+  return options;
+}
+
+// Records 'items' arrivals over one adjustment interval, then batches of 1, 2
+// and 4 items that take 100, 150 and 250 microseconds to process and complete
+// 'latency_micros' after the arrival of their oldest task.
+void RecordWindow(int64 items, int64 latency_micros,
+                  test_util::FakeClockEnv* env,
+                  AdaptiveBatchController* controller) {
+  controller->RecordArrival(items);
+  env->AdvanceByMicroseconds(100000);
+  controller->RecordBatch(1, 100, latency_micros);
+  controller->RecordBatch(2, 150, latency_micros);
+  controller->RecordBatch(4, 250, latency_micros);
+}
+
+TEST(AdaptiveBatchControllerTest, InvalidOptions) {
+  std::shared_ptr<AdaptiveBatchController> controller;
+  AdaptiveBatchController::Options options = TestOptions(Env::Default());
+  options.latency_slo_micros = 0;
+  EXPECT_FALSE(AdaptiveBatchController::Create(options, &controller).ok());
+
+  options = TestOptions(Env::Default());
+  options.min_batch_timeout_micros = options.max_batch_timeout_micros + 1;
+  EXPECT_FALSE(AdaptiveBatchController::Create(options, &controller).ok());
+
+  options = TestOptions(Env::Default());
+  options.allowed_batch_sizes = {2, 1, 4};
+  EXPECT_FALSE(AdaptiveBatchController::Create(options, &controller).ok());
+}
+
+TEST(AdaptiveBatchControllerTest, KeepsStaticParametersUntilAdjusted) {
+  test_util::FakeClockEnv env(Env::Default());
+  std::shared_ptr<AdaptiveBatchController> controller;
+  TF_ASSERT_OK(AdaptiveBatchController::Create(TestOptions(&env), &controller));
+  EXPECT_EQ(10000, controller->batch_timeout_micros());
+  EXPECT_EQ(4, controller->target_batch_size());
+
+  // Too few batches for an adjustment.
+  controller->RecordArrival(400);
+  env.AdvanceByMicroseconds(100000);
+  controller->RecordBatch(1, 100, 200);
+  EXPECT_EQ(10000, controller->batch_timeout_micros());
+  EXPECT_EQ(4, controller->target_batch_size());
+}
+
+TEST(AdaptiveBatchControllerTest, TargetsLargestBatchesWithinSlo) {
+  test_util::FakeClockEnv env(Env::Default());
+  std::shared_ptr<AdaptiveBatchController> controller;
+  TF_ASSERT_OK(AdaptiveBatchController::Create(TestOptions(&env), &controller));
+
+  // At one item per 250 microseconds, filling a batch of 4 takes 1000
+  // microseconds, which leaves no time to process it within the SLO, while a
+  // batch of 2 completes after 500 + 150 microseconds.
+  RecordWindow(/*items=*/400, /*latency_micros=*/300, &env, controller.get());
+  EXPECT_EQ(2, controller->target_batch_size());
+  EXPECT_EQ(1000 - 150, controller->batch_timeout_micros());
+
+  // At one item per microsecond, batches of 4 fit.
+  RecordWindow(/*items=*/100000, /*latency_micros=*/300, &env,
+               controller.get());
+  EXPECT_EQ(4, controller->target_batch_size());
+  EXPECT_EQ(1000 - 250, controller->batch_timeout_micros());
+}
+
+TEST(AdaptiveBatchControllerTest, LowArrivalRateProcessesTasksAlone) {
+  test_util::FakeClockEnv env(Env::Default());
+  std::shared_ptr<AdaptiveBatchController> controller;
+  TF_ASSERT_OK(AdaptiveBatchController::Create(TestOptions(&env), &controller));
+
+  RecordWindow(/*items=*/1, /*latency_micros=*/300, &env, controller.get());
+  EXPECT_EQ(1, controller->target_batch_size());
+  EXPECT_EQ(1000 - 100, controller->batch_timeout_micros());
+}
+
+TEST(AdaptiveBatchControllerTest, MissedSloShrinksTimeout) {
+  test_util::FakeClockEnv env(Env::Default());
+  AdaptiveBatchController::Options options = TestOptions(&env);
+  options.min_batch_timeout_micros = 100;
+  std::shared_ptr<AdaptiveBatchController> controller;
+  TF_ASSERT_OK(AdaptiveBatchController::Create(options, &controller));
+
+  // The budget drops to 80% of the SLO, which batches of 2 still fit in.
+  RecordWindow(/*items=*/400, /*latency_micros=*/2000, &env, controller.get());
+  EXPECT_EQ(2, controller->target_batch_size());
+  EXPECT_EQ(800 - 150, controller->batch_timeout_micros());
+
+  // Then to 64%, which only leaves room for single tasks.
+  RecordWindow(/*items=*/400, /*latency_micros=*/2000, &env, controller.get());
+  EXPECT_EQ(1, controller->target_batch_size());
+  EXPECT_EQ(640 - 100, controller->batch_timeout_micros());
+
+  // The budget grows back once the SLO is met.
+  RecordWindow(/*items=*/400, /*latency_micros=*/300, &env, controller.get());
+  EXPECT_EQ(2, controller->target_batch_size());
+  EXPECT_EQ(690 - 150, controller->batch_timeout_micros());
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
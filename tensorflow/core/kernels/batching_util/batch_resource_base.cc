@@ -19,6 +19,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/kernels/batching_util/concat_split_util.h"
 #include "tensorflow/core/lib/gtl/cleanup.h"
+#include "tensorflow/core/lib/monitoring/gauge.h"
 #include "tensorflow/core/lib/monitoring/percentile_sampler.h"
 #include "tensorflow/core/util/incremental_barrier.h"
 
@@ -72,6 +73,22 @@ void RecordBatchDelayMs(int64 batch_delay_ms, const string& model_name) {
   cell->GetCell(model_name)->Add(static_cast<double>(batch_delay_ms));
 }
 
+void RecordAdaptiveBatchParameters(const AdaptiveBatchController& controller,
+                                   const string& model_name) {
+  static auto* timeout_cell = monitoring::Gauge<int64, 1>::New(
+      "/tensorflow/serving/batching/adaptive_batch_timeout_micros",
+      "Tracks the batch timeout chosen by the adaptive batch controller by "
+      "model_name (if available).",
+      "model_name");
+  static auto* size_cell = monitoring::Gauge<int64, 1>::New(
+      "/tensorflow/serving/batching/adaptive_target_batch_size",
+      "Tracks the target batch size chosen by the adaptive batch controller "
+      "by model_name (if available).",
+      "model_name");
+  timeout_cell->GetCell(model_name)->Set(controller.batch_timeout_micros());
+  size_cell->GetCell(model_name)->Set(controller.target_batch_size());
+}
+
 const string& GetModelName(OpKernelContext* ctx) {
   static string* kModelNameUnset = new string("model_name_unset");
   if (!ctx->session_metadata()) return *kModelNameUnset;
@@ -109,6 +126,10 @@ Status BatchResourceBase::RegisterInput(
     batch_components->inputs.push_back(tensor);
   }
   RecordInputBatchSize(tensors[0].shape().dim_size(0), GetModelName(context));
+  if (batcher_queue_options_.batch_controller != nullptr) {
+    batcher_queue_options_.batch_controller->RecordArrival(
+        tensors[0].shape().dim_size(0));
+  }
   OpInputList captured_tensors;
   const auto captured_status =
       context->input_list("captured_tensors", &captured_tensors);
@@ -162,6 +183,22 @@ BatchResourceBase::GetBatcherQueueOptions(
   return batcher_queue_options;
 }
 
+/*static*/ Status BatchResourceBase::AddAdaptiveBatchController(
+    int64 latency_slo_micros, const std::vector<int32>& allowed_batch_sizes,
+    BatcherT::QueueOptions* queue_options) {
+  AdaptiveBatchController::Options controller_options;
+  controller_options.latency_slo_micros = latency_slo_micros;
+  controller_options.max_batch_timeout_micros =
+      queue_options->batch_timeout_micros;
+  controller_options.max_batch_size =
+      queue_options->enable_large_batch_splitting
+          ? queue_options->max_execution_batch_size
+          : queue_options->max_batch_size;
+  controller_options.allowed_batch_sizes = allowed_batch_sizes;
+  return AdaptiveBatchController::Create(controller_options,
+                                         &queue_options->batch_controller);
+}
+
 /*static*/ Status BatchResourceBase::ValidateBatch(const BatchT& batch) {
   for (int task_idx = 0; task_idx < batch.num_tasks(); ++task_idx) {
     const BatchResourceBase::BatchTask& task = batch.task(task_idx);
@@ -487,16 +524,22 @@ void BatchResourceBase::ProcessFuncBatch(std::unique_ptr<BatchT> batch) const {
   args.insert(args.end(), captured_inputs.begin(), captured_inputs.end());
 
   uint64 current_time = EnvTime::NowNanos();
+  uint64 oldest_task_start_time = current_time;
   const string& model_name = GetModelName(last_task_context);
   for (int i = 0; i < batch->num_tasks(); ++i) {
     RecordBatchDelayMs((current_time - batch->task(i).start_time) * 1e-6,
                        model_name);
+    oldest_task_start_time =
+        std::min(oldest_task_start_time, batch->task(i).start_time);
   }
   // Releases the cleanup method here, because the callback of the function
   // library runtime will handle it now.
   finally.release();
   ProcessFuncBatchImpl(last_task_context, args, &combined_outputs,
                        [&](const Status& run_status) {
+                         RecordProcessedBatch(
+                             *batch, current_time, oldest_task_start_time,
+                             model_name);
                          Status final_status;
                          auto run_finally = gtl::MakeCleanup([&]() {
                            // We do the cleanup here as an optimization, so that
@@ -516,6 +559,21 @@ void BatchResourceBase::ProcessFuncBatch(std::unique_ptr<BatchT> batch) const {
                        });
 }
 
+void BatchResourceBase::RecordProcessedBatch(
+    const BatchT& batch, uint64 processing_start_time,
+    uint64 oldest_task_start_time, const string& model_name) const {
+  AdaptiveBatchController* controller =
+      batcher_queue_options_.batch_controller.get();
+  if (controller == nullptr) {
+    return;
+  }
+  const uint64 current_time = EnvTime::NowNanos();
+  controller->RecordBatch(RoundToLowestAllowedBatchSize(batch.size()),
+                          (current_time - processing_start_time) / 1000,
+                          (current_time - oldest_task_start_time) / 1000);
+  RecordAdaptiveBatchParameters(*controller, model_name);
+}
+
 // Processes a batch of one or more BatchTask entries.
 void BatchResourceBase::ProcessBatch(std::unique_ptr<BatchT> batch) const {
   if (batch->empty()) {
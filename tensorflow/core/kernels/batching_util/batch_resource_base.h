@@ -113,6 +113,14 @@ class BatchResourceBase : public ResourceBase {
       int32 max_enqueued_batches, const std::vector<int32>& allowed_batch_sizes,
       bool enable_large_batch_splitting);
 
+  // Creates a controller that adjusts the batch timeout (up to the one of
+  // 'queue_options') and the target batch size of the queues to keep the 99th
+  // percentile latency of tasks under 'latency_slo_micros', and sets it in
+  // 'queue_options'.
+  static Status AddAdaptiveBatchController(
+      int64 latency_slo_micros, const std::vector<int32>& allowed_batch_sizes,
+      BatcherT::QueueOptions* queue_options);
+
  private:
   // Implementation of calling the process batch function.
   virtual void ProcessFuncBatchImpl(
@@ -157,6 +165,13 @@ class BatchResourceBase : public ResourceBase {
 
   void ProcessFuncBatch(std::unique_ptr<BatchT> batch) const;
 
+  // Reports the processing time and the latency of the oldest task of 'batch'
+  // to 'batcher_queue_options_.batch_controller', if it is set. Start times
+  // are in nanoseconds.
+  void RecordProcessedBatch(const BatchT& batch, uint64 processing_start_time,
+                            uint64 oldest_task_start_time,
+                            const string& model_name) const;
+
   // Processes a batch of one or more BatchTask entries.
   void ProcessBatch(std::unique_ptr<BatchT> batch) const;
 
@@ -18,6 +18,7 @@ limitations under the License.
 
 #include <stddef.h>
 
+#include <algorithm>
 #include <deque>
 #include <functional>
 #include <list>
@@ -26,6 +27,7 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "tensorflow/core/kernels/batching_util/adaptive_batch_controller.h"
 #include "tensorflow/core/kernels/batching_util/batch_scheduler.h"
 #include "tensorflow/core/kernels/batching_util/periodic_function.h"
 #include "tensorflow/core/lib/core/errors.h"
@@ -195,6 +197,12 @@ class SharedBatchScheduler
     // submit batches whose size is in a small set of allowed sizes, that can be
     // done by adding padding in the process-batch callback.
     size_t max_execution_batch_size = 1000;
+
+    // If set, the queue reads its batch timeout from 'batch_controller'
+    // instead of 'batch_timeout_micros', and also schedules the open batch
+    // once it reaches the controller's target batch size (capped by the
+    // maximum batch size above). The controller may be shared by queues.
+    std::shared_ptr<AdaptiveBatchController> batch_controller;
   };
   Status AddQueue(const QueueOptions& options,
                   std::function<void(std::unique_ptr<Batch<TaskType>>)>
@@ -346,6 +354,11 @@ class Queue {
   // currently schedulable.
   bool IsOpenBatchSchedulable() const TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
+  // Returns the current batch timeout and the size at which the open batch is
+  // schedulable, from 'options_.batch_controller' if it is set.
+  int64 batch_timeout_micros() const;
+  size_t target_batch_size() const;
+
   const typename SharedBatchScheduler<TaskType>::QueueOptions options_;
 
   // The environment to use.
@@ -859,9 +872,27 @@ bool Queue<TaskType>::IsOpenBatchSchedulable() const {
   if (open_batch->empty()) {
     return false;
   }
-  return closed_ || open_batch->size() >= max_execution_batch_size() ||
+  return closed_ || open_batch->size() >= target_batch_size() ||
          env_->NowMicros() >=
-             open_batch_start_time_micros_ + options_.batch_timeout_micros;
+             open_batch_start_time_micros_ + batch_timeout_micros();
+}
+
+template <typename TaskType>
+int64 Queue<TaskType>::batch_timeout_micros() const {
+  if (options_.batch_controller == nullptr) {
+    return options_.batch_timeout_micros;
+  }
+  return options_.batch_controller->batch_timeout_micros();
+}
+
+template <typename TaskType>
+size_t Queue<TaskType>::target_batch_size() const {
+  if (options_.batch_controller == nullptr) {
+    return max_execution_batch_size();
+  }
+  return std::min<size_t>(
+      max_execution_batch_size(),
+      std::max<int64>(1, options_.batch_controller->target_batch_size()));
 }
 
 template <typename TaskType>
@@ -254,6 +254,84 @@ TEST(SharedBatchSchedulerTest, ObeysTimeout) {
   stop_teardown.Notify();
 }
 
+TEST(SharedBatchSchedulerTest, ObeysBatchController) {
+  // Set up a fake clock, which only advances when we explicitly tell it to.
+  test_util::FakeClockEnv env(Env::Default());
+  Notification start_teardown, stop_teardown;
+  std::unique_ptr<Thread> teardown_thread =
+      CreateFakeClockAdvancerThread(&env, &start_teardown, &stop_teardown);
+
+  {
+    Notification first_batch_processed, second_batch_processed;
+    auto callback = [&first_batch_processed, &second_batch_processed](
+                        std::unique_ptr<Batch<FakeTask>> batch) {
+      ASSERT_TRUE(batch->IsClosed());
+      if (batch->size() == 2) {
+        first_batch_processed.Notify();
+      } else if (batch->size() == 1) {
+        second_batch_processed.Notify();
+      } else {
+        EXPECT_TRUE(false) << "Unexpected batch size";
+      }
+    };
+
+    AdaptiveBatchController::Options controller_options;
+    controller_options.latency_slo_micros = 1000;
+    controller_options.max_batch_timeout_micros = 10000;
+    controller_options.max_batch_size = 4;
+    controller_options.allowed_batch_sizes = {1, 2, 4};
+    controller_options.adjustment_interval_micros = 100000;
+    controller_options.min_batches_per_adjustment = 3;
+    controller_options.env = &env;
+    std::shared_ptr<AdaptiveBatchController> controller;
+    TF_ASSERT_OK(
+        AdaptiveBatchController::Create(controller_options, &controller));
+
+    SharedBatchScheduler<FakeTask>::Options options;
+    options.num_batch_threads = 1;
+    options.env = &env;
+    std::shared_ptr<SharedBatchScheduler<FakeTask>> scheduler;
+    TF_ASSERT_OK(SharedBatchScheduler<FakeTask>::Create(options, &scheduler));
+    SharedBatchScheduler<FakeTask>::QueueOptions queue_options;
+    queue_options.max_batch_size = 4;
+    queue_options.batch_timeout_micros = 10000;
+    queue_options.max_enqueued_batches = 2;
+    queue_options.batch_controller = controller;
+    std::unique_ptr<BatchScheduler<FakeTask>> queue;
+    TF_ASSERT_OK(scheduler->AddQueue(queue_options, callback, &queue));
+
+    // At one item per 250 microseconds, the controller closes batches of 2
+    // items, and leaves 1000 - 150 microseconds for them to fill.
+    controller->RecordArrival(400);
+    env.AdvanceByMicroseconds(100000);
+    controller->RecordBatch(1, 100, 300);
+    controller->RecordBatch(2, 150, 300);
+    controller->RecordBatch(4, 250, 300);
+    ASSERT_EQ(2, controller->target_batch_size());
+    ASSERT_EQ(850, controller->batch_timeout_micros());
+
+    // A batch that reaches the target size is processed without waiting for
+    // any timeout, although it could hold 4 items.
+    TF_ASSERT_OK(ScheduleTask(1, queue.get()));
+    Env::Default()->SleepForMicroseconds(10 * 1000 /* 10 milliseconds */);
+    EXPECT_FALSE(first_batch_processed.HasBeenNotified());
+    TF_ASSERT_OK(ScheduleTask(1, queue.get()));
+    first_batch_processed.WaitForNotification();
+
+    // An underfull batch is processed at the controller's timeout rather than
+    // at the queue's.
+    TF_ASSERT_OK(ScheduleTask(1, queue.get()));
+    env.AdvanceByMicroseconds(849);
+    Env::Default()->SleepForMicroseconds(10 * 1000 /* 10 milliseconds */);
+    EXPECT_FALSE(second_batch_processed.HasBeenNotified());
+    env.AdvanceByMicroseconds(1);
+    second_batch_processed.WaitForNotification();
+
+    start_teardown.Notify();
+  }
+  stop_teardown.Notify();
+}
+
 TEST(SharedBatchSchedulerTest, ObeysTimeoutWithRealClock) {
   Notification first_batch_processed, second_batch_processed;
   auto callback = [&first_batch_processed, &second_batch_processed](
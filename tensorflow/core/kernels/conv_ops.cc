@@ -357,6 +357,10 @@ Status InitConv2DParameters(const OpKernelConstruction* context,
   TF_RETURN_IF_ERROR(context->GetAttr("data_format", &data_format_string));
   TF_REQUIRES(FormatFromString(data_format_string, &params->data_format),
               errors::InvalidArgument("Invalid data format"));
+  if (context->HasAttr("_constant_filter")) {
+    TF_RETURN_IF_ERROR(
+        context->GetAttr("_constant_filter", &params->constant_filter));
+  }
 
   const auto& strides = params->strides;
   const auto& dilations = params->dilations;
@@ -581,6 +585,17 @@ class Conv2DOp : public BinaryOp<T> {
       return;
     }
 
+    if (LaunchDirectConvOp<Device, T>::Run(context, input, filter, dimensions,
+                                           output, params_.data_format)) {
+      return;
+    }
+
+    if (params_.constant_filter &&
+        packed_filter_conv_.Run(context, input, filter, dimensions,
+                                params_.padding, output, params_.data_format)) {
+      return;
+    }
+
     launcher_(context, use_cudnn_, cudnn_use_autotune_, input, filter,
               dimensions.dilation_rows, dimensions.dilation_cols,
               dimensions.stride_rows, dimensions.stride_cols, params_.padding,
@@ -593,6 +608,7 @@ class Conv2DOp : public BinaryOp<T> {
   bool cudnn_use_autotune_;
 
   LaunchConv2DOp<Device, T> launcher_;
+  LaunchPackedFilterConvOp<Device, T> packed_filter_conv_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(Conv2DOp);
 };
@@ -17,7 +17,10 @@ limitations under the License.
 #define TENSORFLOW_CORE_KERNELS_CONV_OPS_H_
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/kernels/direct_conv2d.h"
+#include "tensorflow/core/kernels/packed_matmul.h"
 #include "tensorflow/core/platform/mem.h"
 #include "tensorflow/core/util/tensor_format.h"
 
@@ -75,6 +78,8 @@ struct Conv2DParameters {
   Padding padding;
   TensorFormat data_format;
   std::vector<int64> explicit_paddings;
+  // Set by Grappler on CPU nodes whose filter is a Const.
+  bool constant_filter = false;
 };
 
 // Convolution dimensions inferred from parameters, input and filter tensors.
@@ -115,6 +120,131 @@ Status ComputeConv2DDimension(const Conv2DParameters& params,
                               const Tensor& input, const Tensor& filter,
                               Conv2DDimensions* dimensions);
 
+template <typename Device, typename T, typename Enable = void>
+class LaunchDirectConvOp {
+ public:
+  static bool Run(OpKernelContext* ctx, const Tensor& input,
+                  const Tensor& filter, const Conv2DDimensions& dimensions,
+                  Tensor* output, TensorFormat data_format,
+                  const DirectConv2DOutputFn& output_fn = nullptr) {
+    return false;
+  }
+};
+
+// Conditionally launches DirectConv2D operation based on convolution
+// parameters. If `output_fn` is set, it is called on each block of the output
+// (see DirectConv2DOutputFn).
+template <typename T>
+class LaunchDirectConvOp<
+    Eigen::ThreadPoolDevice, T,
+    typename std::enable_if<IsDirectConv2DType<T>::value>::type> {
+ public:
+  static bool Run(OpKernelContext* ctx, const Tensor& input,
+                  const Tensor& filter, const Conv2DDimensions& dimensions,
+                  Tensor* output, TensorFormat data_format,
+                  const DirectConv2DOutputFn& output_fn = nullptr) {
+    if (data_format != FORMAT_NHWC) return false;
+
+    DirectConv2DArgs args;
+    args.batch = dimensions.batch;
+    args.in_rows = dimensions.input_rows;
+    args.in_cols = dimensions.input_cols;
+    args.in_depth = dimensions.in_depth;
+    args.filter_rows = dimensions.filter_rows;
+    args.filter_cols = dimensions.filter_cols;
+    args.stride_rows = dimensions.stride_rows;
+    args.stride_cols = dimensions.stride_cols;
+    args.dilation_rows = dimensions.dilation_rows;
+    args.dilation_cols = dimensions.dilation_cols;
+    args.pad_rows = dimensions.pad_rows_before;
+    args.pad_cols = dimensions.pad_cols_before;
+    args.out_rows = dimensions.out_rows;
+    args.out_cols = dimensions.out_cols;
+    args.out_depth = dimensions.out_depth;
+
+    // Grouped convolutions are not supported.
+    if (dimensions.patch_depth != dimensions.in_depth ||
+        !CanUseDirectConv2D<T>(args)) {
+      return false;
+    }
+
+    functor::DirectConv2D<Eigen::ThreadPoolDevice, T>()(
+        ctx, args, input.flat<T>().data(), filter.flat<T>().data(),
+        output->flat<T>().data(), output_fn);
+    return true;
+  }
+};
+
+template <typename Device, typename T, typename Enable = void>
+class LaunchPackedFilterConvOp {
+ public:
+  bool Run(OpKernelContext* ctx, const Tensor& input, const Tensor& filter,
+           const Conv2DDimensions& dimensions, Padding padding, Tensor* output,
+           TensorFormat data_format,
+           const DirectConv2DOutputFn& output_fn = nullptr) {
+    return false;
+  }
+};
+
+// Launches the matrix multiplications that 1x1 convolutions with unit strides
+// and convolutions with an input-sized filter reduce to, with a packing of the
+// filter that is cached across calls. Must only be used for constant filters.
+// If `output_fn` is set, it is called on each block of the output.
+template <typename T>
+class LaunchPackedFilterConvOp<
+    Eigen::ThreadPoolDevice, T,
+    typename std::enable_if<IsPackedMatMulType<T>::value>::type> {
+ public:
+  bool Run(OpKernelContext* ctx, const Tensor& input, const Tensor& filter,
+           const Conv2DDimensions& dimensions, Padding padding, Tensor* output,
+           TensorFormat data_format,
+           const DirectConv2DOutputFn& output_fn = nullptr) {
+    if (data_format != FORMAT_NHWC || !CachePackedMatMulRhs<T>() ||
+        dimensions.patch_depth != dimensions.in_depth) {
+      return false;
+    }
+
+    // Both cases multiply a [m, k] input matrix by a [k, out_depth] filter.
+    int64 m, k;
+    if (dimensions.filter_rows == 1 && dimensions.filter_cols == 1 &&
+        dimensions.stride_rows == 1 && dimensions.stride_cols == 1 &&
+        padding != EXPLICIT) {
+      m = dimensions.batch * dimensions.out_rows * dimensions.out_cols;
+      k = dimensions.in_depth;
+    } else if (dimensions.filter_rows == dimensions.input_rows &&
+               dimensions.filter_cols == dimensions.input_cols &&
+               dimensions.dilation_rows == 1 &&
+               dimensions.dilation_cols == 1 && padding == VALID) {
+      m = dimensions.batch;
+      k = static_cast<int64>(dimensions.filter_rows) * dimensions.filter_cols *
+          dimensions.in_depth;
+    } else {
+      return false;
+    }
+    const int64 n = dimensions.out_depth;
+    if (!PreferPackedMatMulRhs<T>(m, n)) return false;
+
+    Tensor filter_matrix;
+    if (!filter_matrix.CopyFrom(filter, TensorShape({k, n}))) return false;
+
+    const auto& worker_threads =
+        *ctx->device()->tensorflow_cpu_worker_threads();
+    typename PackedMatMulRhs<T>::TileFn tile_fn;
+    if (output_fn) {
+      tile_fn = [&output_fn](int64 row, int64 col, int64 rows, int64 cols) {
+        output_fn(row, rows, col, cols);
+      };
+    }
+    cache_.Get(worker_threads, filter_matrix, /*transpose_b=*/false)
+        ->Multiply(worker_threads, input.flat<T>().data(), m,
+                   /*transpose_a=*/false, output->flat<T>().data(), tile_fn);
+    return true;
+  }
+
+ private:
+  PackedMatMulRhsCache<T> cache_;
+};
+
 }  // namespace tensorflow
 
 #endif  // TENSORFLOW_CORE_KERNELS_CONV_OPS_H_
@@ -86,26 +86,60 @@ struct LaunchFusedConv2DOp {
 // This is CPU-only implementation that uses Eigen contraction output kernels.
 //
 // Dispatch 2D convolution to the appropriate primitive operation:
-//   (1) MatMul for the case of 1x1 convolution.
-//   (2) MatMul for the case when filter size equals to the input size.
-//   (3) General spatial 2D convolution for all other cases.
+//   (1) DirectConv2D for the small batches it is faster on.
+//   (2) MatMul for the case of 1x1 convolution.
+//   (3) MatMul for the case when filter size equals to the input size.
+//   (4) General spatial 2D convolution for all other cases.
+// The MatMuls of (2) and (3) reuse the packing of a constant filter if
+// `packed_filter_conv` is set.
 template <typename T>
 class LaunchFusedConv2DWithOutputKernel {
  public:
-  LaunchFusedConv2DWithOutputKernel(int row_stride, int col_stride,      //
-                                    int row_dilation, int col_dilation,  //
-                                    Padding padding,
-                                    const std::vector<int64>& explicit_paddings)
+  LaunchFusedConv2DWithOutputKernel(
+      int row_stride, int col_stride,      //
+      int row_dilation, int col_dilation,  //
+      Padding padding, const std::vector<int64>& explicit_paddings,
+      const Conv2DDimensions& dimensions,
+      LaunchPackedFilterConvOp<CPUDevice, T>* packed_filter_conv = nullptr)
       : row_stride_(row_stride),
         col_stride_(col_stride),
         row_dilation_(row_dilation),
         col_dilation_(col_dilation),
         padding_(padding),
-        explicit_paddings_(explicit_paddings) {}
+        explicit_paddings_(explicit_paddings),
+        dimensions_(dimensions),
+        packed_filter_conv_(packed_filter_conv) {}
 
   template <typename OutputKernel>
   void operator()(const OutputKernel& output_kernel, OpKernelContext* ctx,
                   const Tensor& input, const Tensor& filter, Tensor* output) {
+    // Applies the output kernel to each block written by DirectConv2D, whose
+    // output is a [pixels, out_depth] matrix like the MatMul cases below.
+    T* out = output->flat<T>().data();
+    const int64 out_depth = dimensions_.out_depth;
+    auto direct_output_fn = [&](int64 pixel, int64 pixels, int64 channel,
+                                int64 channels) {
+      ContractionOutputMapper<T, Eigen::Index> output_mapper(
+          out + pixel * out_depth + channel, out_depth);
+      output_kernel(output_mapper, Eigen::TensorContractionParams{true},
+                    static_cast<Eigen::Index>(channel),
+                    static_cast<Eigen::Index>(pixel),
+                    static_cast<Eigen::Index>(channels),
+                    static_cast<Eigen::Index>(pixels));
+    };
+
+    if (LaunchDirectConvOp<CPUDevice, T>::Run(ctx, input, filter, dimensions_,
+                                              output, FORMAT_NHWC,
+                                              direct_output_fn)) {
+      return;
+    }
+
+    if (packed_filter_conv_ != nullptr &&
+        packed_filter_conv_->Run(ctx, input, filter, dimensions_, padding_,
+                                 output, FORMAT_NHWC, direct_output_fn)) {
+      return;
+    }
+
     if (filter.dim_size(0) == 1 && filter.dim_size(1) == 1 &&
         row_stride_ == 1 && col_stride_ == 1 && padding_ != EXPLICIT) {
       int conv_width = 1;  // Width for the convolution step.
@@ -166,6 +200,8 @@ class LaunchFusedConv2DWithOutputKernel {
   int col_dilation_;
   const Padding padding_;
   const std::vector<int64>& explicit_paddings_;
+  const Conv2DDimensions& dimensions_;
+  LaunchPackedFilterConvOp<CPUDevice, T>* packed_filter_conv_;
 };
 
 template <typename T>
@@ -198,7 +234,8 @@ struct LaunchFusedConv2DOp<CPUDevice, T> {
     LaunchFusedConv2DWithOutputKernel<T> conv2d(
         dimensions.stride_rows, dimensions.stride_cols,
         dimensions.dilation_rows, dimensions.dilation_cols, params.padding,
-        params.explicit_paddings);
+        params.explicit_paddings, dimensions,
+        params.constant_filter ? &packed_filter_conv_ : nullptr);
 
     switch (fusion) {
       case FusedComputationType::kUndefined:
@@ -241,6 +278,9 @@ struct LaunchFusedConv2DOp<CPUDevice, T> {
         break;
     }
   }
+
+ private:
+  LaunchPackedFilterConvOp<CPUDevice, T> packed_filter_conv_;
 };
 
 #if GOOGLE_CUDA
@@ -741,10 +781,9 @@ class FusedConv2DOp : public OpKernel {
       return;
     }
 
-    LaunchFusedConv2DOp<Device, T>()(context, use_cudnn_, cudnn_use_autotune_,
-                                     input, filter, fused_computation_,
-                                     fused_computation_args_, params_,
-                                     dimensions, output);
+    launcher_(context, use_cudnn_, cudnn_use_autotune_, input, filter,
+              fused_computation_, fused_computation_args_, params_, dimensions,
+              output);
   }
 
  private:
@@ -755,6 +794,8 @@ class FusedConv2DOp : public OpKernel {
   FusedComputationType fused_computation_ = FusedComputationType::kUndefined;
   FusedComputationArgs fused_computation_args_;
 
+  LaunchFusedConv2DOp<Device, T> launcher_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(FusedConv2DOp);
 };
 
@@ -0,0 +1,297 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define USE_EIGEN_TENSOR
+#define EIGEN_USE_THREADS
+
+#include "tensorflow/core/kernels/direct_conv2d.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+// DirectConv2D computes each output pixel of an NHWC convolution as the sum
+// over the filter taps of products of the input pixel under the tap and the
+// [in_depth, out_depth] filter matrix of the tap:
+//
+//   out[b, y, x, :] += in[b, y * sr + fy * dr - pr, x * sc + fx * dc - pc, :]
+//                      * filter[fy, fx, :, :]
+//
+// Input pixels under the padding are read from a row of zeros, so the inner
+// loops have no bounds checks. The output is computed in blocks of
+// kBlockPixels consecutive pixels of an image by kPanelDepth output channels.
+// The filter is packed into panels of kPanelDepth channels, and micro kernels
+// accumulate kKernelPixels pixels by one panel in registers over all the taps
+// and a range of input channels, whose part of the panel stays in L1.
+//
+// SpatialConvolution instead contracts the filter with image patches, which
+// are packed with packet loads along the input channels. When in_depth is
+// not a multiple of the packet size, packing falls back to gathering scalars
+// and dominates the convolution, e.g. for the RGB input layers of vision
+// models, while the direct loops only read each input value once per tap.
+
+namespace {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+// Output pixels computed by each call to a micro kernel.
+constexpr int64 kKernelPixels = 4;
+// Output pixels of an image computed by each unit of work.
+constexpr int64 kBlockPixels = 64;
+static_assert(kBlockPixels % kKernelPixels == 0,
+              "Blocks must hold whole kernel calls");
+
+// Bytes of a filter panel read by each pass over a block of output pixels.
+constexpr int64 kPanelCacheSize = 32 * 1024;
+// Fewest input channels accumulated by each pass over a block.
+constexpr int64 kMinBlockDepth = 8;
+
+// Largest batch for which DirectConv2D is used.
+constexpr int kMaxBatch = 8;
+
+int64 DivUp(int64 x, int64 y) { return (x + y - 1) / y; }
+
+template <typename T>
+struct DirectConv2DKernel {
+  typedef typename Eigen::internal::packet_traits<T>::type Packet;
+  static constexpr int64 kPacketSize = Eigen::internal::packet_traits<T>::size;
+  // Output channels of a filter panel, computed in three packets.
+  static constexpr int64 kPanelDepth = 3 * kPacketSize;
+
+  // Copies output channels [channel, channel + kPanelDepth) of the
+  // [filter_rows, filter_cols, in_depth, out_depth] filter to a
+  // [filter_rows, filter_cols, in_depth, kPanelDepth] panel, padded with
+  // zeros.
+  static void PackFilterPanel(const DirectConv2DArgs& args, const T* filter,
+                              int64 channel, T* panel) {
+    const int64 channels = std::min(kPanelDepth, args.out_depth - channel);
+    const int64 filter_size =
+        static_cast<int64>(args.filter_rows) * args.filter_cols * args.in_depth;
+    for (int64 i = 0; i < filter_size; ++i) {
+      const T* src = filter + i * args.out_depth + channel;
+      T* dst = panel + i * kPanelDepth;
+      std::copy_n(src, channels, dst);
+      std::fill(dst + channels, dst + kPanelDepth, T(0));
+    }
+  }
+
+  // Adds the products of input channels [depth_begin, depth_end) by the
+  // kPanelDepth channels of `panel` for kKernelPixels consecutive output
+  // pixels of `image` starting at `pixel`, of which only the first `pixels`
+  // are valid, to `out`, which has a row of kPanelDepth per pixel. `zeros`
+  // holds in_depth zeros, read in place of the padding.
+  static void Run(const DirectConv2DArgs& args, const T* image, const T* zeros,
+                  const T* panel, int64 pixel, int64 pixels, int64 depth_begin,
+                  int64 depth_end, T* out) {
+    using Eigen::internal::pmadd;
+    using Eigen::internal::ploadu;
+    using Eigen::internal::pset1;
+    using Eigen::internal::pstoreu;
+    Packet c00 = ploadu<Packet>(out);
+    Packet c01 = ploadu<Packet>(out + kPacketSize);
+    Packet c02 = ploadu<Packet>(out + 2 * kPacketSize);
+    Packet c10 = ploadu<Packet>(out + kPanelDepth);
+    Packet c11 = ploadu<Packet>(out + kPanelDepth + kPacketSize);
+    Packet c12 = ploadu<Packet>(out + kPanelDepth + 2 * kPacketSize);
+    Packet c20 = ploadu<Packet>(out + 2 * kPanelDepth);
+    Packet c21 = ploadu<Packet>(out + 2 * kPanelDepth + kPacketSize);
+    Packet c22 = ploadu<Packet>(out + 2 * kPanelDepth + 2 * kPacketSize);
+    Packet c30 = ploadu<Packet>(out + 3 * kPanelDepth);
+    Packet c31 = ploadu<Packet>(out + 3 * kPanelDepth + kPacketSize);
+    Packet c32 = ploadu<Packet>(out + 3 * kPanelDepth + 2 * kPacketSize);
+
+    // Top left input pixel under the filter of each output pixel. The pixels
+    // may span several output rows.
+    int64 in_rows[kKernelPixels];
+    int64 in_cols[kKernelPixels];
+    for (int64 p = 0; p < kKernelPixels; ++p) {
+      const int64 out_row = (pixel + p) / args.out_cols;
+      const int64 out_col = (pixel + p) % args.out_cols;
+      in_rows[p] = out_row * args.stride_rows - args.pad_rows;
+      in_cols[p] = out_col * args.stride_cols - args.pad_cols;
+      // Reads zeros for the invalid pixels.
+      if (p >= pixels) in_rows[p] = -args.in_rows * args.dilation_rows;
+    }
+    const auto pixel_input = [&](int64 p, int64 fy, int64 fx) -> const T* {
+      const int64 row = in_rows[p] + fy * args.dilation_rows;
+      const int64 col = in_cols[p] + fx * args.dilation_cols;
+      return row >= 0 && row < args.in_rows && col >= 0 && col < args.in_cols
+                 ? image + (row * args.in_cols + col) * args.in_depth +
+                       depth_begin
+                 : zeros;
+    };
+
+    const int64 depth = depth_end - depth_begin;
+    const int64 tap_size = args.in_depth * kPanelDepth;
+    const T* w = panel + depth_begin * kPanelDepth;
+    for (int64 fy = 0; fy < args.filter_rows; ++fy) {
+      for (int64 fx = 0; fx < args.filter_cols; ++fx, w += tap_size) {
+        const T* in0 = pixel_input(0, fy, fx);
+        const T* in1 = pixel_input(1, fy, fx);
+        const T* in2 = pixel_input(2, fy, fx);
+        const T* in3 = pixel_input(3, fy, fx);
+        const T* wi = w;
+        for (int64 i = 0; i < depth; ++i, wi += kPanelDepth) {
+          const Packet w0 = ploadu<Packet>(wi);
+          const Packet w1 = ploadu<Packet>(wi + kPacketSize);
+          const Packet w2 = ploadu<Packet>(wi + 2 * kPacketSize);
+          Packet x = pset1<Packet>(in0[i]);
+          c00 = pmadd(x, w0, c00);
+          c01 = pmadd(x, w1, c01);
+          c02 = pmadd(x, w2, c02);
+          x = pset1<Packet>(in1[i]);
+          c10 = pmadd(x, w0, c10);
+          c11 = pmadd(x, w1, c11);
+          c12 = pmadd(x, w2, c12);
+          x = pset1<Packet>(in2[i]);
+          c20 = pmadd(x, w0, c20);
+          c21 = pmadd(x, w1, c21);
+          c22 = pmadd(x, w2, c22);
+          x = pset1<Packet>(in3[i]);
+          c30 = pmadd(x, w0, c30);
+          c31 = pmadd(x, w1, c31);
+          c32 = pmadd(x, w2, c32);
+        }
+      }
+    }
+
+    pstoreu(out, c00);
+    pstoreu(out + kPacketSize, c01);
+    pstoreu(out + 2 * kPacketSize, c02);
+    pstoreu(out + kPanelDepth, c10);
+    pstoreu(out + kPanelDepth + kPacketSize, c11);
+    pstoreu(out + kPanelDepth + 2 * kPacketSize, c12);
+    pstoreu(out + 2 * kPanelDepth, c20);
+    pstoreu(out + 2 * kPanelDepth + kPacketSize, c21);
+    pstoreu(out + 2 * kPanelDepth + 2 * kPacketSize, c22);
+    pstoreu(out + 3 * kPanelDepth, c30);
+    pstoreu(out + 3 * kPanelDepth + kPacketSize, c31);
+    pstoreu(out + 3 * kPanelDepth + 2 * kPacketSize, c32);
+  }
+};
+
+template <typename T>
+void DirectConv2DImpl(const DeviceBase::CpuWorkerThreads& worker_threads,
+                      const DirectConv2DArgs& args, const T* input,
+                      const T* filter, T* output,
+                      const DirectConv2DOutputFn& output_fn) {
+  using Kernel = DirectConv2DKernel<T>;
+  constexpr int64 kPanelDepth = Kernel::kPanelDepth;
+
+  const int64 filter_size =
+      static_cast<int64>(args.filter_rows) * args.filter_cols * args.in_depth;
+  const int64 panel_size = filter_size * kPanelDepth;
+  const int64 num_panels = DivUp(args.out_depth, kPanelDepth);
+  std::vector<T> panels(num_panels * panel_size);
+  auto pack = [&](int64 begin, int64 end) {
+    for (int64 p = begin; p < end; ++p) {
+      Kernel::PackFilterPanel(args, filter, p * kPanelDepth,
+                              panels.data() + p * panel_size);
+    }
+  };
+  Shard(worker_threads.num_threads, worker_threads.workers, num_panels,
+        panel_size, pack);
+
+  // Units of work are ordered by panel first, so that the units of a shard
+  // share the panel while streaming over the input.
+  const int64 image_size =
+      static_cast<int64>(args.in_rows) * args.in_cols * args.in_depth;
+  const int64 image_pixels = static_cast<int64>(args.out_rows) * args.out_cols;
+  const int64 image_blocks = DivUp(image_pixels, kBlockPixels);
+  const int64 units_per_panel = args.batch * image_blocks;
+  // Input channels accumulated by each pass over a block, so that the part
+  // of the panel they read stays in the L1 cache.
+  const int64 block_depth = std::min<int64>(
+      args.in_depth,
+      std::max<int64>(kMinBlockDepth,
+                      kPanelCacheSize / (sizeof(T) * kPanelDepth *
+                                         args.filter_rows * args.filter_cols)));
+  auto compute = [&](int64 begin, int64 end) {
+    const std::vector<T> zeros(args.in_depth, T(0));
+    std::vector<T> block(kBlockPixels * kPanelDepth);
+    for (int64 u = begin; u < end; ++u) {
+      const int64 panel_index = u / units_per_panel;
+      const int64 b = (u % units_per_panel) / image_blocks;
+      const int64 first_pixel = (u % image_blocks) * kBlockPixels;
+      const int64 pixels = std::min(kBlockPixels, image_pixels - first_pixel);
+
+      const T* image = input + b * image_size;
+      const T* panel = panels.data() + panel_index * panel_size;
+      std::fill(block.begin(), block.end(), T(0));
+      for (int64 d = 0; d < args.in_depth; d += block_depth) {
+        const int64 depth_end = std::min<int64>(d + block_depth, args.in_depth);
+        for (int64 x = 0; x < pixels; x += kKernelPixels) {
+          Kernel::Run(args, image, zeros.data(), panel, first_pixel + x,
+                      std::min(kKernelPixels, pixels - x), d, depth_end,
+                      block.data() + x * kPanelDepth);
+        }
+      }
+
+      const int64 channel = panel_index * kPanelDepth;
+      const int64 channels = std::min(kPanelDepth, args.out_depth - channel);
+      const int64 pixel = b * image_pixels + first_pixel;
+      for (int64 x = 0; x < pixels; ++x) {
+        std::copy_n(block.data() + x * kPanelDepth, channels,
+                    output + (pixel + x) * args.out_depth + channel);
+      }
+      if (output_fn) output_fn(pixel, pixels, channel, channels);
+    }
+  };
+  Shard(worker_threads.num_threads, worker_threads.workers,
+        num_panels * units_per_panel, 2 * kBlockPixels * panel_size, compute);
+}
+
+}  // namespace
+
+template <typename T>
+bool CanUseDirectConv2D(const DirectConv2DArgs& args) {
+  // 1x1 convolutions with unit strides are matrix multiplications of the
+  // input without patches, and so are convolutions with a single output
+  // pixel.
+  if (args.batch > kMaxBatch ||
+      (args.filter_rows == 1 && args.filter_cols == 1 &&
+       args.stride_rows == 1 && args.stride_cols == 1) ||
+      static_cast<int64>(args.out_rows) * args.out_cols < kKernelPixels) {
+    return false;
+  }
+  return args.in_depth % DirectConv2DKernel<T>::kPacketSize != 0;
+}
+
+template bool CanUseDirectConv2D<float>(const DirectConv2DArgs& args);
+template bool CanUseDirectConv2D<double>(const DirectConv2DArgs& args);
+
+namespace functor {
+
+template <typename T>
+struct DirectConv2D<CPUDevice, T> {
+  void operator()(OpKernelContext* ctx, const DirectConv2DArgs& args,
+                  const T* input, const T* filter, T* output,
+                  const DirectConv2DOutputFn& output_fn) {
+    DirectConv2DImpl(*ctx->device()->tensorflow_cpu_worker_threads(), args,
+                     input, filter, output, output_fn);
+  }
+};
+
+}  // namespace functor
+
+template struct functor::DirectConv2D<CPUDevice, float>;
+template struct functor::DirectConv2D<CPUDevice, double>;
+
+}  // namespace tensorflow
@@ -0,0 +1,90 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_DIRECT_CONV2D_H_
+#define TENSORFLOW_CORE_KERNELS_DIRECT_CONV2D_H_
+
+#include <functional>
+#include <type_traits>
+
+#include "tensorflow/core/framework/types.h"
+
+namespace tensorflow {
+
+class OpKernelContext;
+
+// DirectConv2D is a Conv2D implementation for NHWC inputs that accumulates
+// each output pixel directly from the input and filter, without building the
+// image patches matrix of SpatialConvolution (see direct_conv2d.cc for
+// details). It is meant for the small batches of latency sensitive inference,
+// where allocating and filling the patches dominates the convolution.
+
+// Conv2D arguments used by DirectConv2D implementation.
+struct DirectConv2DArgs {
+  // Input layer dimensions
+  int batch = 0;
+  int in_rows = 0;
+  int in_cols = 0;
+  int in_depth = 0;
+  int filter_rows = 0;
+  int filter_cols = 0;
+  int stride_rows = 1;
+  int stride_cols = 1;
+  int dilation_rows = 1;
+  int dilation_cols = 1;
+  // Padding before the first row and column of the input.
+  int pad_rows = 0;
+  int pad_cols = 0;
+
+  // Output layer dimensions
+  int out_rows = 0;
+  int out_cols = 0;
+  int out_depth = 0;
+};
+
+// Types supported by DirectConv2D.
+template <typename T>
+struct IsDirectConv2DType
+    : std::integral_constant<bool, std::is_same<T, float>::value ||
+                                       std::is_same<T, double>::value> {};
+
+// Returns true if convolution operation specified by `args` can use
+// DirectConv2D implementation, and is expected to be faster than the
+// patch-based implementations.
+template <typename T>
+bool CanUseDirectConv2D(const DirectConv2DArgs& args);
+
+// Called on each block of the output as soon as it is written, e.g. to add a
+// bias while the block is cached. The block covers `channels` channels
+// starting at `channel` of `pixels` consecutive output pixels starting at
+// `pixel`, where pixels are numbered in [batch, out_rows, out_cols] order.
+using DirectConv2DOutputFn = std::function<void(
+    int64 pixel, int64 pixels, int64 channel, int64 channels)>;
+
+namespace functor {
+
+// Calls DirectConv2D implementation (see direct_conv2d.cc for details).
+template <typename Device, typename T>
+struct DirectConv2D {
+  void operator()(OpKernelContext* ctx, const DirectConv2DArgs& args,
+                  const T* input, const T* filter, T* output,
+                  const DirectConv2DOutputFn& output_fn = nullptr);
+};
+
+}  // namespace functor
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_DIRECT_CONV2D_H_
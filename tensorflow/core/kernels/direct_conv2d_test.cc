@@ -0,0 +1,210 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/direct_conv2d.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns the arguments of a convolution of a [batch, 9, 11, in_depth] image
+// with 3x3 filters, a stride of one and SAME padding.
+DirectConv2DArgs SmallConv2DArgs(int batch, int in_depth, int out_depth) {
+  DirectConv2DArgs args;
+  args.batch = batch;
+  args.in_rows = 9;
+  args.in_cols = 11;
+  args.in_depth = in_depth;
+  args.filter_rows = 3;
+  args.filter_cols = 3;
+  args.pad_rows = 1;
+  args.pad_cols = 1;
+  args.out_rows = 9;
+  args.out_cols = 11;
+  args.out_depth = out_depth;
+  return args;
+}
+
+TEST(DirectConv2DTest, CanUseDirectConv2D) {
+  // Input depths that do not fill whole packets, e.g. RGB images.
+  EXPECT_TRUE(CanUseDirectConv2D<float>(SmallConv2DArgs(1, 3, 32)));
+  EXPECT_TRUE(CanUseDirectConv2D<float>(SmallConv2DArgs(8, 3, 32)));
+  EXPECT_TRUE(CanUseDirectConv2D<double>(SmallConv2DArgs(1, 3, 32)));
+
+  // Large batches.
+  EXPECT_FALSE(CanUseDirectConv2D<float>(SmallConv2DArgs(9, 3, 32)));
+
+  // Input depths that Eigen packs with whole packets.
+  EXPECT_FALSE(CanUseDirectConv2D<float>(SmallConv2DArgs(1, 64, 32)));
+
+  // 1x1 convolutions with unit strides.
+  DirectConv2DArgs one_by_one = SmallConv2DArgs(1, 3, 32);
+  one_by_one.filter_rows = 1;
+  one_by_one.filter_cols = 1;
+  one_by_one.pad_rows = 0;
+  one_by_one.pad_cols = 0;
+  EXPECT_FALSE(CanUseDirectConv2D<float>(one_by_one));
+
+  // Filters as large as the input.
+  DirectConv2DArgs image_size = SmallConv2DArgs(1, 3, 32);
+  image_size.filter_rows = image_size.in_rows;
+  image_size.filter_cols = image_size.in_cols;
+  image_size.pad_rows = 0;
+  image_size.pad_cols = 0;
+  image_size.out_rows = 1;
+  image_size.out_cols = 1;
+  EXPECT_FALSE(CanUseDirectConv2D<float>(image_size));
+}
+
+class DirectConv2DOpTest : public OpsTestBase {
+ protected:
+  // Runs Conv2D with explicit paddings, or _FusedConv2D with a bias and a
+  // Relu if `fused`, on inputs that DirectConv2D is used for, and compares
+  // the result with a naive convolution.
+  void VerifyConv2D(int batch, int in_rows, int in_cols, int in_depth,
+                    int filter_size, int out_depth, int stride, int dilation,
+                    int pad_before, int pad_after, bool fused) {
+    const std::vector<int64> explicit_paddings = {
+        0, 0, pad_before, pad_after, pad_before, pad_after, 0, 0};
+    NodeDefBuilder builder("conv", fused ? "_FusedConv2D" : "Conv2D");
+    builder.Input(FakeInput(DT_FLOAT)).Input(FakeInput(DT_FLOAT));
+    if (fused) {
+      builder.Input(FakeInput(1, DT_FLOAT))
+          .Attr("num_args", 1)
+          .Attr("fused_ops", {"BiasAdd", "Relu"});
+    }
+    TF_ASSERT_OK(builder.Attr("T", DT_FLOAT)
+                     .Attr("strides", {1, stride, stride, 1})
+                     .Attr("dilations", {1, dilation, dilation, 1})
+                     .Attr("padding", "EXPLICIT")
+                     .Attr("explicit_paddings", explicit_paddings)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+
+    Tensor input(DT_FLOAT, {batch, in_rows, in_cols, in_depth});
+    Tensor filter(DT_FLOAT, {filter_size, filter_size, in_depth, out_depth});
+    Tensor bias(DT_FLOAT, {out_depth});
+    input.flat<float>().setRandom();
+    filter.flat<float>().setRandom();
+    bias.flat<float>().setRandom();
+    bias.flat<float>() -= bias.flat<float>().constant(0.5f);
+
+    const int filter_extent = dilation * (filter_size - 1) + 1;
+    const int out_rows =
+        (in_rows + pad_before + pad_after - filter_extent) / stride + 1;
+    const int out_cols =
+        (in_cols + pad_before + pad_after - filter_extent) / stride + 1;
+
+    DirectConv2DArgs args;
+    args.batch = batch;
+    args.in_rows = in_rows;
+    args.in_cols = in_cols;
+    args.in_depth = in_depth;
+    args.filter_rows = filter_size;
+    args.filter_cols = filter_size;
+    args.stride_rows = stride;
+    args.stride_cols = stride;
+    args.dilation_rows = dilation;
+    args.dilation_cols = dilation;
+    args.pad_rows = pad_before;
+    args.pad_cols = pad_before;
+    args.out_rows = out_rows;
+    args.out_cols = out_cols;
+    args.out_depth = out_depth;
+    ASSERT_TRUE(CanUseDirectConv2D<float>(args));
+
+    Tensor expected(DT_FLOAT, {batch, out_rows, out_cols, out_depth});
+    auto in = input.tensor<float, 4>();
+    auto f = filter.tensor<float, 4>();
+    auto out = expected.tensor<float, 4>();
+    for (int b = 0; b < batch; ++b) {
+      for (int r = 0; r < out_rows; ++r) {
+        for (int c = 0; c < out_cols; ++c) {
+          for (int o = 0; o < out_depth; ++o) {
+            double sum = fused ? bias.flat<float>()(o) : 0.0;
+            for (int fr = 0; fr < filter_size; ++fr) {
+              const int in_r = r * stride + fr * dilation - pad_before;
+              if (in_r < 0 || in_r >= in_rows) continue;
+              for (int fc = 0; fc < filter_size; ++fc) {
+                const int in_c = c * stride + fc * dilation - pad_before;
+                if (in_c < 0 || in_c >= in_cols) continue;
+                for (int d = 0; d < in_depth; ++d) {
+                  sum += in(b, in_r, in_c, d) * f(fr, fc, d, o);
+                }
+              }
+            }
+            out(b, r, c, o) = fused ? std::max(sum, 0.0) : sum;
+          }
+        }
+      }
+    }
+
+    AddInputFromArray<float>(input.shape(), input.flat<float>());
+    AddInputFromArray<float>(filter.shape(), filter.flat<float>());
+    if (fused) AddInputFromArray<float>(bias.shape(), bias.flat<float>());
+    TF_ASSERT_OK(RunOpKernel());
+    test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-4);
+  }
+};
+
+TEST_F(DirectConv2DOpTest, Conv2D) {
+  VerifyConv2D(/*batch=*/1, /*in_rows=*/9, /*in_cols=*/11, /*in_depth=*/3,
+               /*filter_size=*/3, /*out_depth=*/32, /*stride=*/1,
+               /*dilation=*/1, /*pad_before=*/1, /*pad_after=*/1,
+               /*fused=*/false);
+}
+
+TEST_F(DirectConv2DOpTest, Conv2DWithPartialBlocks) {
+  // The output depth is not a multiple of the panels, and the output pixels
+  // are not a multiple of the blocks.
+  VerifyConv2D(/*batch=*/3, /*in_rows=*/7, /*in_cols=*/5, /*in_depth=*/5,
+               /*filter_size=*/3, /*out_depth=*/37, /*stride=*/1,
+               /*dilation=*/1, /*pad_before=*/0, /*pad_after=*/2,
+               /*fused=*/false);
+}
+
+TEST_F(DirectConv2DOpTest, Conv2DWithStrides) {
+  VerifyConv2D(/*batch=*/2, /*in_rows=*/16, /*in_cols=*/15, /*in_depth=*/3,
+               /*filter_size=*/5, /*out_depth=*/20, /*stride=*/2,
+               /*dilation=*/1, /*pad_before=*/2, /*pad_after=*/1,
+               /*fused=*/false);
+}
+
+TEST_F(DirectConv2DOpTest, Conv2DWithDilations) {
+  VerifyConv2D(/*batch=*/1, /*in_rows=*/12, /*in_cols=*/12, /*in_depth=*/7,
+               /*filter_size=*/3, /*out_depth=*/16, /*stride=*/1,
+               /*dilation=*/2, /*pad_before=*/2, /*pad_after=*/2,
+               /*fused=*/false);
+}
+
+TEST_F(DirectConv2DOpTest, FusedConv2DWithBiasAndRelu) {
+  VerifyConv2D(/*batch=*/2, /*in_rows=*/9, /*in_cols=*/10, /*in_depth=*/3,
+               /*filter_size=*/3, /*out_depth=*/29, /*stride=*/1,
+               /*dilation=*/1, /*pad_before=*/1, /*pad_after=*/1,
+               /*fused=*/true);
+}
+
+}  // namespace
+}  // namespace tensorflow
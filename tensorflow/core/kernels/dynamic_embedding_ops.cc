@@ -0,0 +1,609 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Kernels of the DynamicEmbeddingTable op and of the ops that only apply to
+// tables created by it. Lookups, inserts, removals, exports and imports of a
+// DynamicEmbeddingTable go through the generic LookupTable*V2 kernels.
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/framework/lookup_interface.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/kernels/lookup_table_op.h"
+#include "tensorflow/core/kernels/lookup_util.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/refcount.h"
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+namespace lookup {
+
+// Fixed-size rows of floats allocated from slabs of kRowsPerSlab rows. Rows
+// never move once allocated, and freed rows are reused before new slabs are
+// allocated, so the arena only grows to the largest number of rows live at
+// once.
+class EmbeddingArena {
+ public:
+  explicit EmbeddingArena(int64 row_size) : row_size_(row_size) {}
+
+  int64 Allocate() {
+    if (!free_rows_.empty()) {
+      const int64 row = free_rows_.back();
+      free_rows_.pop_back();
+      return row;
+    }
+    if (next_row_ == static_cast<int64>(slabs_.size()) * kRowsPerSlab) {
+      slabs_.emplace_back(new float[kRowsPerSlab * row_size_]);
+    }
+    return next_row_++;
+  }
+
+  void Free(int64 row) { free_rows_.push_back(row); }
+
+  void Clear() {
+    slabs_.clear();
+    free_rows_.clear();
+    next_row_ = 0;
+  }
+
+  float* row(int64 row) {
+    return slabs_[row / kRowsPerSlab].get() + (row % kRowsPerSlab) * row_size_;
+  }
+  const float* row(int64 row) const {
+    return slabs_[row / kRowsPerSlab].get() + (row % kRowsPerSlab) * row_size_;
+  }
+
+  int64 MemoryUsed() const {
+    return slabs_.size() * kRowsPerSlab * row_size_ * sizeof(float) +
+           free_rows_.capacity() * sizeof(int64);
+  }
+
+ private:
+  static constexpr int64 kRowsPerSlab = 1024;
+
+  int64 row_size_;
+  std::vector<std::unique_ptr<float[]>> slabs_;
+  std::vector<int64> free_rows_;
+  int64 next_row_ = 0;
+};
+
+// A hash table from keys to embedding rows, meant to back embeddings whose
+// vocabulary is not known in advance.
+//
+// The table only keeps a row for keys that were looked up at least
+// `min_frequency` times, and counts the lookups of the other keys until
+// they are admitted. A key gets the default value of the lookup that admits
+// it as initial embedding. When `max_rows` is positive and the table holds
+// more rows, the least recently (lru) or least frequently (lfu) used rows are
+// evicted, down to 7/8 of `max_rows` so that evictions are amortized. Keys
+// that are still counted are dropped the same way once there are more of
+// them than `max_rows`.
+//
+// Each row stores the embedding followed by `num_slots` optimizer slots of
+// the same size, so that the fused DynamicEmbeddingSparseApply* kernels
+// update the embeddings and their slots in place, without gathering them.
+template <class K>
+class DynamicEmbeddingTable final : public LookupInterface {
+ public:
+  DynamicEmbeddingTable(OpKernelContext* ctx, OpKernel* kernel)
+      : arena_(1) {
+    int64 embedding_dim;
+    OP_REQUIRES_OK(
+        ctx, GetNodeAttr(kernel->def(), "embedding_dim", &embedding_dim));
+    OP_REQUIRES_OK(ctx, GetNodeAttr(kernel->def(), "num_slots", &num_slots_));
+    OP_REQUIRES_OK(ctx, GetNodeAttr(kernel->def(), "slot_initial_value",
+                                    &slot_initial_value_));
+    OP_REQUIRES_OK(
+        ctx, GetNodeAttr(kernel->def(), "min_frequency", &min_frequency_));
+    OP_REQUIRES_OK(ctx, GetNodeAttr(kernel->def(), "max_rows", &max_rows_));
+    string eviction_policy;
+    OP_REQUIRES_OK(
+        ctx, GetNodeAttr(kernel->def(), "eviction_policy", &eviction_policy));
+    evict_lfu_ = eviction_policy == "lfu";
+    dim_ = embedding_dim;
+    value_shape_ = TensorShape({embedding_dim});
+    arena_ = EmbeddingArena(dim_ * (1 + num_slots_));
+  }
+
+  size_t size() const override {
+    tf_shared_lock l(mu_);
+    return num_rows_;
+  }
+
+  int64 num_slots() const { return num_slots_; }
+
+  float slot_initial_value() const { return slot_initial_value_; }
+
+  Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
+              const Tensor& default_value) override {
+    const auto key_values = key.flat<K>();
+    const float* default_flat = default_value.flat<float>().data();
+    float* value_flat = value->flat<float>().data();
+
+    mutex_lock l(mu_);
+    ++clock_;
+    for (int64 i = 0; i < key_values.size(); ++i) {
+      Entry& entry = entries_[SubtleMustCopyIfIntegral(key_values(i))];
+      ++entry.frequency;
+      entry.last_use = clock_;
+      if (entry.row < 0 && entry.frequency >= min_frequency_) {
+        Admit(&entry, default_flat);
+      }
+      const float* src = entry.row < 0 ? default_flat : arena_.row(entry.row);
+      std::copy_n(src, dim_, value_flat + i * dim_);
+    }
+    MaybeEvict();
+    return Status::OK();
+  }
+
+  Status Insert(OpKernelContext* ctx, const Tensor& keys,
+                const Tensor& values) override {
+    mutex_lock l(mu_);
+    DoInsert(keys, values);
+    MaybeEvict();
+    return Status::OK();
+  }
+
+  Status Remove(OpKernelContext* ctx, const Tensor& keys) override {
+    const auto key_values = keys.flat<K>();
+    mutex_lock l(mu_);
+    for (int64 i = 0; i < key_values.size(); ++i) {
+      auto it = entries_.find(SubtleMustCopyIfIntegral(key_values(i)));
+      if (it == entries_.end()) continue;
+      if (it->second.row >= 0) Release(&it->second);
+      entries_.erase(it);
+    }
+    return Status::OK();
+  }
+
+  Status ImportValues(OpKernelContext* ctx, const Tensor& keys,
+                      const Tensor& values) override {
+    mutex_lock l(mu_);
+    entries_.clear();
+    arena_.Clear();
+    num_rows_ = 0;
+    DoInsert(keys, values);
+    MaybeEvict();
+    return Status::OK();
+  }
+
+  Status ExportValues(OpKernelContext* ctx) override {
+    tf_shared_lock l(mu_);
+    Tensor* keys;
+    TF_RETURN_IF_ERROR(
+        ctx->allocate_output("keys", TensorShape({num_rows_}), &keys));
+    Tensor* values;
+    TF_RETURN_IF_ERROR(ctx->allocate_output(
+        "values", TensorShape({num_rows_, dim_}), &values));
+    auto keys_data = keys->flat<K>();
+    float* values_data = values->flat<float>().data();
+    int64 i = 0;
+    for (const auto& kv : entries_) {
+      if (kv.second.row < 0) continue;
+      keys_data(i) = kv.first;
+      std::copy_n(arena_.row(kv.second.row), dim_, values_data + i * dim_);
+      ++i;
+    }
+    return Status::OK();
+  }
+
+  // Outputs the rows, slots and frequencies of the admitted keys that hash to
+  // `shard` out of `num_shards`. Exporting a large table shard by shard keeps
+  // the size of the exported tensors, and of the checkpoint slices written
+  // from them, bounded.
+  Status ExportShard(OpKernelContext* ctx, int64 shard, int64 num_shards) {
+    tf_shared_lock l(mu_);
+    std::vector<typename EntryMap::const_iterator> selected;
+    for (auto it = entries_.cbegin(); it != entries_.cend(); ++it) {
+      if (it->second.row >= 0 && ShardOf(it->first, num_shards) == shard) {
+        selected.push_back(it);
+      }
+    }
+    const int64 n = selected.size();
+    Tensor* keys;
+    TF_RETURN_IF_ERROR(ctx->allocate_output("keys", TensorShape({n}), &keys));
+    Tensor* values;
+    TF_RETURN_IF_ERROR(
+        ctx->allocate_output("values", TensorShape({n, dim_}), &values));
+    Tensor* slots;
+    TF_RETURN_IF_ERROR(ctx->allocate_output(
+        "slots", TensorShape({n, num_slots_, dim_}), &slots));
+    Tensor* frequencies;
+    TF_RETURN_IF_ERROR(
+        ctx->allocate_output("frequencies", TensorShape({n}), &frequencies));
+    auto keys_data = keys->flat<K>();
+    float* values_data = values->flat<float>().data();
+    float* slots_data = slots->flat<float>().data();
+    auto frequencies_data = frequencies->flat<int64>();
+    for (int64 i = 0; i < n; ++i) {
+      keys_data(i) = selected[i]->first;
+      frequencies_data(i) = selected[i]->second.frequency;
+      const float* row = arena_.row(selected[i]->second.row);
+      std::copy_n(row, dim_, values_data + i * dim_);
+      std::copy_n(row + dim_, num_slots_ * dim_,
+                  slots_data + i * num_slots_ * dim_);
+    }
+    return Status::OK();
+  }
+
+  // Inserts or overwrites the rows of `keys` with the content exported by
+  // ExportShard(), without removing the other keys.
+  Status ImportShard(const Tensor& keys, const Tensor& values,
+                     const Tensor& slots, const Tensor& frequencies) {
+    const int64 n = keys.NumElements();
+    if (!TensorShapeUtils::IsVector(keys.shape()) ||
+        values.shape() != TensorShape({n, dim_}) ||
+        slots.shape() != TensorShape({n, num_slots_, dim_}) ||
+        frequencies.shape() != TensorShape({n})) {
+      return errors::InvalidArgument(
+          "Expected keys of shape [n], values of shape [n, ", dim_,
+          "], slots of shape [n, ", num_slots_,
+          ", ", dim_, "] and frequencies of shape [n], got ",
+          keys.shape().DebugString(), ", ", values.shape().DebugString(), ", ",
+          slots.shape().DebugString(), " and ",
+          frequencies.shape().DebugString());
+    }
+    const auto key_values = keys.flat<K>();
+    const float* values_data = values.flat<float>().data();
+    const float* slots_data = slots.flat<float>().data();
+    const auto frequencies_data = frequencies.flat<int64>();
+
+    mutex_lock l(mu_);
+    ++clock_;
+    for (int64 i = 0; i < n; ++i) {
+      Entry& entry = entries_[SubtleMustCopyIfIntegral(key_values(i))];
+      if (entry.row < 0) Admit(&entry, values_data + i * dim_);
+      float* row = arena_.row(entry.row);
+      std::copy_n(values_data + i * dim_, dim_, row);
+      std::copy_n(slots_data + i * num_slots_ * dim_, num_slots_ * dim_,
+                  row + dim_);
+      entry.frequency = frequencies_data(i);
+      entry.last_use = clock_;
+    }
+    MaybeEvict();
+    return Status::OK();
+  }
+
+  // Applies `update(row, grad_row)` to the row of every key of `keys` that
+  // has one, where grad_row is the matching row of `grad`. Keys that were not
+  // admitted, or were evicted since they were looked up, are skipped.
+  template <typename Update>
+  Status SparseApply(const Tensor& keys, const Tensor& grad,
+                     const Update& update) {
+    const int64 n = keys.NumElements();
+    if (!TensorShapeUtils::IsVector(keys.shape()) ||
+        grad.shape() != TensorShape({n, dim_})) {
+      return errors::InvalidArgument(
+          "Expected keys of shape [n] and grad of shape [n, ", dim_, "], got ",
+          keys.shape().DebugString(), " and ", grad.shape().DebugString());
+    }
+    const auto key_values = keys.flat<K>();
+    const float* grad_data = grad.flat<float>().data();
+
+    mutex_lock l(mu_);
+    for (int64 i = 0; i < n; ++i) {
+      auto it = entries_.find(SubtleMustCopyIfIntegral(key_values(i)));
+      if (it == entries_.end() || it->second.row < 0) continue;
+      update(arena_.row(it->second.row), grad_data + i * dim_);
+    }
+    return Status::OK();
+  }
+
+  int64 dim() const { return dim_; }
+
+  DataType key_dtype() const override { return DataTypeToEnum<K>::v(); }
+
+  DataType value_dtype() const override { return DT_FLOAT; }
+
+  TensorShape key_shape() const final { return TensorShape(); }
+
+  TensorShape value_shape() const override { return value_shape_; }
+
+  int64 MemoryUsed() const override {
+    tf_shared_lock l(mu_);
+    return sizeof(DynamicEmbeddingTable) + arena_.MemoryUsed() +
+           entries_.bucket_count() * sizeof(void*) +
+           entries_.size() * (sizeof(K) + sizeof(Entry) + sizeof(void*));
+  }
+
+ private:
+  struct Entry {
+    int64 row = -1;  // -1 until the key is admitted.
+    int64 frequency = 0;
+    int64 last_use = 0;
+  };
+  typedef std::unordered_map<K, Entry> EntryMap;
+
+  static int64 ShardOf(const K& key, int64 num_shards) {
+    return Hash64(reinterpret_cast<const char*>(&key), sizeof(key)) %
+           num_shards;
+  }
+
+  // Gives `entry` a row whose embedding is `value` and whose slots are set to
+  // their initial value.
+  void Admit(Entry* entry, const float* value)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    entry->row = arena_.Allocate();
+    float* row = arena_.row(entry->row);
+    std::copy_n(value, dim_, row);
+    std::fill_n(row + dim_, num_slots_ * dim_, slot_initial_value_);
+    ++num_rows_;
+  }
+
+  void Release(Entry* entry) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    arena_.Free(entry->row);
+    entry->row = -1;
+    --num_rows_;
+  }
+
+  // Inserts `values` for `keys`, admitting the keys without a row.
+  void DoInsert(const Tensor& keys, const Tensor& values)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    const auto key_values = keys.flat<K>();
+    const float* values_data = values.flat<float>().data();
+    ++clock_;
+    for (int64 i = 0; i < key_values.size(); ++i) {
+      Entry& entry = entries_[SubtleMustCopyIfIntegral(key_values(i))];
+      entry.last_use = clock_;
+      if (entry.row < 0) {
+        Admit(&entry, values_data + i * dim_);
+      } else {
+        std::copy_n(values_data + i * dim_, dim_, arena_.row(entry.row));
+      }
+    }
+  }
+
+  // Evicts rows, and drops counted keys, beyond the limit set by max_rows_.
+  void MaybeEvict() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (max_rows_ == 0) return;
+    const int64 num_counted = entries_.size() - num_rows_;
+    if (num_rows_ > max_rows_) {
+      Evict(/*admitted=*/true, num_rows_ - (max_rows_ - max_rows_ / 8));
+    }
+    if (num_counted > max_rows_) {
+      Evict(/*admitted=*/false, num_counted - max_rows_ / 2);
+    }
+  }
+
+  // Removes the `count` least recently or least frequently used entries that
+  // have a row if `admitted`, and that do not otherwise.
+  void Evict(bool admitted, int64 count) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    struct Candidate {
+      int64 primary;
+      int64 secondary;
+      typename EntryMap::iterator it;
+    };
+    std::vector<Candidate> candidates;
+    candidates.reserve(admitted ? num_rows_ : entries_.size() - num_rows_);
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+      if ((it->second.row >= 0) != admitted) continue;
+      const Entry& e = it->second;
+      if (evict_lfu_) {
+        candidates.push_back({e.frequency, e.last_use, it});
+      } else {
+        candidates.push_back({e.last_use, e.frequency, it});
+      }
+    }
+    count = std::min<int64>(count, candidates.size());
+    std::nth_element(candidates.begin(), candidates.begin() + count,
+                     candidates.end(),
+                     [](const Candidate& a, const Candidate& b) {
+                       return a.primary < b.primary ||
+                              (a.primary == b.primary &&
+                               a.secondary < b.secondary);
+                     });
+    for (int64 i = 0; i < count; ++i) {
+      if (admitted) Release(&candidates[i].it->second);
+      entries_.erase(candidates[i].it);
+    }
+  }
+
+  int64 dim_;
+  int64 num_slots_;
+  float slot_initial_value_;
+  int64 min_frequency_;
+  int64 max_rows_;
+  bool evict_lfu_;
+  TensorShape value_shape_;
+
+  mutable mutex mu_;
+  EntryMap entries_ TF_GUARDED_BY(mu_);
+  EmbeddingArena arena_ TF_GUARDED_BY(mu_);
+  int64 num_rows_ TF_GUARDED_BY(mu_) = 0;
+  // Incremented by every operation that touches keys, to order their uses.
+  int64 clock_ TF_GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace lookup
+
+#define REGISTER_KERNEL(key_dtype)                                            \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("DynamicEmbeddingTable")                                           \
+          .Device(DEVICE_CPU)                                                 \
+          .TypeConstraint<key_dtype>("key_dtype")                             \
+          .TypeConstraint<float>("value_dtype"),                              \
+      LookupTableOp<lookup::DynamicEmbeddingTable<key_dtype>, key_dtype,      \
+                    float>)
+
+REGISTER_KERNEL(int32);
+REGISTER_KERNEL(int64);
+
+#undef REGISTER_KERNEL
+
+namespace {
+
+// Returns the DynamicEmbeddingTable of the "table_handle" input of `ctx`.
+template <class K>
+Status GetDynamicEmbeddingTable(OpKernelContext* ctx,
+                                lookup::DynamicEmbeddingTable<K>** table) {
+  lookup::LookupInterface* lookup_table;
+  TF_RETURN_IF_ERROR(
+      GetResourceLookupTable("table_handle", ctx, &lookup_table));
+  *table = dynamic_cast<lookup::DynamicEmbeddingTable<K>*>(lookup_table);
+  if (*table == nullptr) {
+    const DataType key_dtype = lookup_table->key_dtype();
+    lookup_table->Unref();
+    return errors::InvalidArgument(
+        "Expected a DynamicEmbeddingTable with keys of type ",
+        DataTypeString(DataTypeToEnum<K>::v()), ", got a table with keys of "
+        "type ", DataTypeString(key_dtype));
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+template <class K>
+class DynamicEmbeddingSparseApplyGradientDescentOp : public OpKernel {
+ public:
+  explicit DynamicEmbeddingSparseApplyGradientDescentOp(
+      OpKernelConstruction* ctx)
+      : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    lookup::DynamicEmbeddingTable<K>* table;
+    OP_REQUIRES_OK(ctx, GetDynamicEmbeddingTable(ctx, &table));
+    core::ScopedUnref unref_me(table);
+
+    const Tensor& lr = ctx->input(1);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsScalar(lr.shape()),
+                errors::InvalidArgument("lr is not a scalar: ",
+                                        lr.shape().DebugString()));
+    const float alpha = lr.scalar<float>()();
+    const int64 dim = table->dim();
+    OP_REQUIRES_OK(
+        ctx, table->SparseApply(ctx->input(3), ctx->input(2),
+                                [alpha, dim](float* var, const float* grad) {
+                                  for (int64 j = 0; j < dim; ++j) {
+                                    var[j] -= alpha * grad[j];
+                                  }
+                                }));
+  }
+};
+
+template <class K>
+class DynamicEmbeddingSparseApplyAdagradOp : public OpKernel {
+ public:
+  explicit DynamicEmbeddingSparseApplyAdagradOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    lookup::DynamicEmbeddingTable<K>* table;
+    OP_REQUIRES_OK(ctx, GetDynamicEmbeddingTable(ctx, &table));
+    core::ScopedUnref unref_me(table);
+
+    OP_REQUIRES(ctx, table->num_slots() >= 1,
+                errors::InvalidArgument(
+                    "Adagrad keeps its accumulators in the first slot of the "
+                    "table, which has no slots"));
+    // A zero accumulator makes the first update of a key with a zero
+    // gradient compute 0 / 0.
+    OP_REQUIRES(ctx, table->slot_initial_value() > 0,
+                errors::InvalidArgument(
+                    "Adagrad requires a positive slot_initial_value, got ",
+                    table->slot_initial_value()));
+    const Tensor& lr = ctx->input(1);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsScalar(lr.shape()),
+                errors::InvalidArgument("lr is not a scalar: ",
+                                        lr.shape().DebugString()));
+    const float alpha = lr.scalar<float>()();
+    const int64 dim = table->dim();
+    OP_REQUIRES_OK(
+        ctx, table->SparseApply(ctx->input(3), ctx->input(2),
+                                [alpha, dim](float* var, const float* grad) {
+                                  float* accum = var + dim;
+                                  for (int64 j = 0; j < dim; ++j) {
+                                    accum[j] += grad[j] * grad[j];
+                                    var[j] -= alpha * grad[j] /
+                                              std::sqrt(accum[j]);
+                                  }
+                                }));
+  }
+};
+
+template <class K>
+class DynamicEmbeddingExportShardOp : public OpKernel {
+ public:
+  explicit DynamicEmbeddingExportShardOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("shard", &shard_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("num_shards", &num_shards_));
+    OP_REQUIRES(ctx, shard_ < num_shards_,
+                errors::InvalidArgument("shard ", shard_,
+                                        " is not lower than num_shards ",
+                                        num_shards_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    lookup::DynamicEmbeddingTable<K>* table;
+    OP_REQUIRES_OK(ctx, GetDynamicEmbeddingTable(ctx, &table));
+    core::ScopedUnref unref_me(table);
+    OP_REQUIRES_OK(ctx, table->ExportShard(ctx, shard_, num_shards_));
+  }
+
+ private:
+  int64 shard_;
+  int64 num_shards_;
+};
+
+template <class K>
+class DynamicEmbeddingImportShardOp : public OpKernel {
+ public:
+  explicit DynamicEmbeddingImportShardOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    lookup::DynamicEmbeddingTable<K>* table;
+    OP_REQUIRES_OK(ctx, GetDynamicEmbeddingTable(ctx, &table));
+    core::ScopedUnref unref_me(table);
+    OP_REQUIRES_OK(ctx, table->ImportShard(ctx->input(1), ctx->input(2),
+                                           ctx->input(3), ctx->input(4)));
+  }
+};
+
+#define REGISTER_KERNELS(key_dtype)                                           \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("DynamicEmbeddingSparseApplyGradientDescent")                      \
+          .Device(DEVICE_CPU)                                                 \
+          .TypeConstraint<key_dtype>("Tkeys"),                                \
+      DynamicEmbeddingSparseApplyGradientDescentOp<key_dtype>);               \
+  REGISTER_KERNEL_BUILDER(Name("DynamicEmbeddingSparseApplyAdagrad")          \
+                              .Device(DEVICE_CPU)                             \
+                              .TypeConstraint<key_dtype>("Tkeys"),            \
+                          DynamicEmbeddingSparseApplyAdagradOp<key_dtype>);   \
+  REGISTER_KERNEL_BUILDER(Name("DynamicEmbeddingExportShard")                 \
+                              .Device(DEVICE_CPU)                             \
+                              .TypeConstraint<key_dtype>("Tkeys"),            \
+                          DynamicEmbeddingExportShardOp<key_dtype>);          \
+  REGISTER_KERNEL_BUILDER(Name("DynamicEmbeddingImportShard")                 \
+                              .Device(DEVICE_CPU)                             \
+                              .TypeConstraint<key_dtype>("Tkeys"),            \
+                          DynamicEmbeddingImportShardOp<key_dtype>)
+
+REGISTER_KERNELS(int32);
+REGISTER_KERNELS(int64);
+
+#undef REGISTER_KERNELS
+
+}  // namespace tensorflow
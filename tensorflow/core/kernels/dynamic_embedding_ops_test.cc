@@ -0,0 +1,237 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/cc/client/client_session.h"
+#include "tensorflow/cc/ops/const_op.h"
+#include "tensorflow/cc/ops/lookup_ops.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace ops {
+namespace {
+
+// Returns the sorted keys that hold a row in `table`.
+std::vector<int64> RowKeys(ClientSession* session, const Scope& root,
+                           const Output& table) {
+  auto exported = LookupTableExport(root, table, DT_INT64, DT_FLOAT);
+  std::vector<Tensor> outputs;
+  TF_CHECK_OK(session->Run({exported.keys}, &outputs));
+  std::vector<int64> keys;
+  for (int64 i = 0; i < outputs[0].NumElements(); ++i) {
+    keys.push_back(outputs[0].flat<int64>()(i));
+  }
+  std::sort(keys.begin(), keys.end());
+  return keys;
+}
+
+TEST(DynamicEmbeddingTableTest, AdmitsKeysAfterMinFrequency) {
+  Scope root = Scope::NewRootScope();
+  auto table =
+      DynamicEmbeddingTable(root, DT_INT64, DT_FLOAT, /*embedding_dim=*/2,
+                            DynamicEmbeddingTable::MinFrequency(2));
+  auto find1 = LookupTableFind(root, table, Input({int64{1}}),
+                               Input({0.5f, -0.5f}));
+  auto find2 = LookupTableFind(root, table, Input({int64{1}}),
+                               Input({1.0f, 2.0f}));
+  auto size = LookupTableSize(root, table);
+  TF_ASSERT_OK(root.status());
+
+  ClientSession session(root);
+  std::vector<Tensor> outputs;
+  // The first lookup only counts the key.
+  TF_ASSERT_OK(session.Run({find1.values, size}, &outputs));
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({0.5f, -0.5f}, TensorShape({1, 2})), outputs[0]);
+  EXPECT_EQ(0, outputs[1].scalar<int64>()());
+
+  // The second one admits it, with the default value of that lookup.
+  TF_ASSERT_OK(session.Run({find2.values, size}, &outputs));
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({1.0f, 2.0f}, TensorShape({1, 2})), outputs[0]);
+  EXPECT_EQ(1, outputs[1].scalar<int64>()());
+
+  // Later lookups return the row, not their default value.
+  TF_ASSERT_OK(session.Run({find1.values}, &outputs));
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({1.0f, 2.0f}, TensorShape({1, 2})), outputs[0]);
+}
+
+TEST(DynamicEmbeddingTableTest, EvictsLeastRecentlyUsed) {
+  Scope root = Scope::NewRootScope();
+  auto table =
+      DynamicEmbeddingTable(root, DT_INT64, DT_FLOAT, /*embedding_dim=*/1,
+                            DynamicEmbeddingTable::MaxRows(4));
+  std::vector<Operation> inserts;
+  for (int64 key = 0; key < 5; ++key) {
+    inserts.push_back(LookupTableInsert(root, table, Input({key}),
+                                        Input({{static_cast<float>(key)}})));
+  }
+  auto find = LookupTableFind(root, table, Input({int64{0}}), Input({-1.0f}));
+  TF_ASSERT_OK(root.status());
+
+  ClientSession session(root);
+  for (int i = 0; i < 4; ++i) {
+    TF_ASSERT_OK(session.Run({}, {}, {inserts[i]}, nullptr));
+  }
+  TF_ASSERT_OK(session.Run({find.values}, nullptr));
+  TF_ASSERT_OK(session.Run({}, {}, {inserts[4]}, nullptr));
+  EXPECT_EQ(std::vector<int64>({0, 2, 3, 4}), RowKeys(&session, root, table));
+}
+
+TEST(DynamicEmbeddingTableTest, EvictsLeastFrequentlyUsed) {
+  Scope root = Scope::NewRootScope();
+  auto table = DynamicEmbeddingTable(
+      root, DT_INT64, DT_FLOAT, /*embedding_dim=*/1,
+      DynamicEmbeddingTable::MaxRows(2).EvictionPolicy("lfu"));
+  auto insert = LookupTableInsert(root, table, Input({int64{1}, int64{2}}),
+                                  Input({{1.0f}, {2.0f}}));
+  auto find1 = LookupTableFind(root, table, Input({int64{1}}), Input({0.0f}));
+  auto find3 = LookupTableFind(root, table, Input({int64{3}}), Input({0.0f}));
+  TF_ASSERT_OK(root.status());
+
+  ClientSession session(root);
+  TF_ASSERT_OK(session.Run({}, {}, {insert}, nullptr));
+  TF_ASSERT_OK(session.Run({find1.values}, nullptr));
+  TF_ASSERT_OK(session.Run({find1.values}, nullptr));
+  // Admits key 3, used once, so key 2, never used, goes.
+  TF_ASSERT_OK(session.Run({find3.values}, nullptr));
+  EXPECT_EQ(std::vector<int64>({1, 3}), RowKeys(&session, root, table));
+}
+
+TEST(DynamicEmbeddingTableTest, SparseApply) {
+  Scope root = Scope::NewRootScope();
+  auto table = DynamicEmbeddingTable(
+      root, DT_INT64, DT_FLOAT, /*embedding_dim=*/2,
+      DynamicEmbeddingTable::NumSlots(1).SlotInitialValue(0.1f));
+  auto insert = LookupTableInsert(root, table, Input({int64{5}, int64{6}}),
+                                  Input({{1.0f, 2.0f}, {3.0f, 4.0f}}));
+  // Key 7 has no row, so its gradient is dropped.
+  auto adagrad = DynamicEmbeddingSparseApplyAdagrad(
+      root, table, 0.5f, Input({{1.0f, 2.0f}, {3.0f, 3.0f}}),
+      Input({int64{5}, int64{7}}));
+  auto sgd = DynamicEmbeddingSparseApplyGradientDescent(
+      root, table, 0.5f, Input({{1.0f, 2.0f}}), Input({int64{6}}));
+  auto find = LookupTableFind(root, table, Input({int64{5}, int64{6}}),
+                              Input({0.0f, 0.0f}));
+  TF_ASSERT_OK(root.status());
+
+  ClientSession session(root);
+  TF_ASSERT_OK(session.Run({}, {}, {insert}, nullptr));
+  TF_ASSERT_OK(session.Run({}, {}, {adagrad, sgd}, nullptr));
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session.Run({find.values}, &outputs));
+  test::ExpectTensorNear<float>(
+      test::AsTensor<float>({1.0f - 0.5f * 1.0f / std::sqrt(1.1f),
+                             2.0f - 0.5f * 2.0f / std::sqrt(4.1f), 2.5f, 3.0f},
+                            TensorShape({2, 2})),
+      outputs[0], 1e-5);
+}
+
+TEST(DynamicEmbeddingTableTest, AdagradZeroGradientOnNewKey) {
+  Scope root = Scope::NewRootScope();
+  auto table = DynamicEmbeddingTable(
+      root, DT_INT64, DT_FLOAT, /*embedding_dim=*/2,
+      DynamicEmbeddingTable::NumSlots(1).SlotInitialValue(0.1f));
+  // Admits key 5 with fresh accumulators.
+  auto find = LookupTableFind(root, table, Input({int64{5}}),
+                              Input({1.0f, 2.0f}));
+  auto adagrad = DynamicEmbeddingSparseApplyAdagrad(
+      root, table, 0.5f, Input({{0.0f, 0.0f}}), Input({int64{5}}));
+  TF_ASSERT_OK(root.status());
+
+  ClientSession session(root);
+  TF_ASSERT_OK(session.Run({find.values}, nullptr));
+  TF_ASSERT_OK(session.Run({}, {}, {adagrad}, nullptr));
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session.Run({find.values}, &outputs));
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({1.0f, 2.0f}, TensorShape({1, 2})), outputs[0]);
+}
+
+TEST(DynamicEmbeddingTableTest, AdagradRequiresPositiveSlotInitialValue) {
+  Scope root = Scope::NewRootScope();
+  auto table =
+      DynamicEmbeddingTable(root, DT_INT64, DT_FLOAT, /*embedding_dim=*/2,
+                            DynamicEmbeddingTable::NumSlots(1));
+  auto find = LookupTableFind(root, table, Input({int64{5}}),
+                              Input({1.0f, 2.0f}));
+  auto adagrad = DynamicEmbeddingSparseApplyAdagrad(
+      root, table, 0.5f, Input({{0.0f, 0.0f}}), Input({int64{5}}));
+  TF_ASSERT_OK(root.status());
+
+  ClientSession session(root);
+  TF_ASSERT_OK(session.Run({find.values}, nullptr));
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      session.Run({}, {}, {adagrad}, nullptr)));
+}
+
+TEST(DynamicEmbeddingTableTest, ExportAndImportShards) {
+  Scope root = Scope::NewRootScope();
+  auto attrs = DynamicEmbeddingTable::NumSlots(1).SlotInitialValue(0.25f);
+  auto src = DynamicEmbeddingTable(root, DT_INT64, DT_FLOAT,
+                                   /*embedding_dim=*/3, attrs);
+  auto dst = DynamicEmbeddingTable(root, DT_INT64, DT_FLOAT,
+                                   /*embedding_dim=*/3, attrs);
+  const int64 n = 100;
+  Tensor keys(DT_INT64, TensorShape({n}));
+  Tensor values(DT_FLOAT, TensorShape({n, 3}));
+  for (int64 i = 0; i < n; ++i) {
+    keys.flat<int64>()(i) = i * 11;
+    for (int j = 0; j < 3; ++j) values.matrix<float>()(i, j) = i + j * 0.25f;
+  }
+  auto insert = LookupTableInsert(root, src, keys, values);
+  std::vector<Output> shard_keys;
+  std::vector<Operation> imports;
+  for (int shard = 0; shard < 3; ++shard) {
+    auto exported = DynamicEmbeddingExportShard(root, src, shard,
+                                                /*num_shards=*/3, DT_INT64);
+    shard_keys.push_back(exported.keys);
+    imports.push_back(DynamicEmbeddingImportShard(
+        root, dst, exported.keys, exported.values, exported.slots,
+        exported.frequencies));
+  }
+  auto find = LookupTableFind(root, dst, keys, Input({0.0f, 0.0f, 0.0f}));
+  TF_ASSERT_OK(root.status());
+
+  ClientSession session(root);
+  TF_ASSERT_OK(session.Run({}, {}, {insert}, nullptr));
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session.Run(shard_keys, &outputs));
+  // Every key is exported by exactly one shard.
+  std::vector<int64> exported_keys;
+  for (const Tensor& t : outputs) {
+    for (int64 i = 0; i < t.NumElements(); ++i) {
+      exported_keys.push_back(t.flat<int64>()(i));
+    }
+  }
+  std::sort(exported_keys.begin(), exported_keys.end());
+  ASSERT_EQ(n, exported_keys.size());
+  for (int64 i = 0; i < n; ++i) EXPECT_EQ(i * 11, exported_keys[i]);
+
+  TF_ASSERT_OK(session.Run({}, {}, imports, nullptr));
+  TF_ASSERT_OK(session.Run({find.values}, &outputs));
+  test::ExpectTensorEqual<float>(values, outputs[0]);
+}
+
+}  // namespace
+}  // namespace ops
+}  // namespace tensorflow
@@ -16,6 +16,8 @@ limitations under the License.
 #include "tensorflow/core/kernels/lookup_table_op.h"
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <type_traits>
 #include <utility>
@@ -26,15 +28,179 @@ limitations under the License.
 #include "tensorflow/core/kernels/initializable_lookup_table.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 namespace lookup {
 
+namespace {
+
+template <typename T>
+inline uint64 ShardHash(const T& key) {
+  return Hash64(reinterpret_cast<const char*>(&key), sizeof(key));
+}
+
+inline uint64 ShardHash(const tstring& key) { return Hash64(key); }
+
+// Returns the value of the optional "num_shards" attr of the op that creates
+// a MutableHashTable.
+int64 NumShards(OpKernel* kernel) {
+  int64 num_shards = 1;
+  TryGetNodeAttr(kernel->def(), "num_shards", &num_shards);
+  return std::max<int64>(num_shards, 1);
+}
+
+}  // namespace
+
+// The entries of a MutableHashTableOfScalars or MutableHashTableOfTensors,
+// split into shards that are each guarded by their own reader-writer lock.
+//
+// With a single shard, the default, every operation locks the whole table.
+// With more shards, the keys of a batch are grouped by shard, so that each
+// shard is locked once per batch, and the shards are processed in parallel
+// when the batch is large enough. Lookups and inserts issued from many
+// threads then mostly take different locks.
+template <class K, class V>
+class ShardedHashMap {
+ public:
+  typedef std::unordered_map<K, V> Map;
+
+  explicit ShardedHashMap(int64 num_shards)
+      : num_shards_(num_shards), shards_(new HashShard[num_shards]) {}
+
+  int64 num_shards() const { return num_shards_; }
+
+  int64 ShardOf(const K& key) const {
+    return num_shards_ == 1 ? 0 : ShardHash(key) % num_shards_;
+  }
+
+  size_t size() const {
+    size_t size = 0;
+    for (int64 s = 0; s < num_shards_; ++s) {
+      tf_shared_lock l(shards_[s].mu);
+      size += shards_[s].map.size();
+    }
+    return size;
+  }
+
+  // Calls fn(map, i) for every index i of `keys`, where map is the shard that
+  // holds keys(i), while holding the lock of the shard, in exclusive mode if
+  // `exclusive` and in shared mode otherwise. The keys of a shard are visited
+  // in order. `cost_per_key` is the estimated cost of one call, in cycles.
+  template <typename Fn>
+  void ForEachKey(OpKernelContext* ctx, typename TTypes<K>::ConstFlat keys,
+                  bool exclusive, int64 cost_per_key, const Fn& fn) {
+    const int64 num_keys = keys.size();
+    if (num_shards_ == 1) {
+      WithLock(&shards_[0], exclusive, [&fn, num_keys](Map* map) {
+        for (int64 i = 0; i < num_keys; ++i) fn(map, i);
+      });
+      return;
+    }
+    // Groups the indices of the keys by shard with a counting sort.
+    std::vector<int64> starts(num_shards_ + 1, 0);
+    std::vector<int64> shard_of(num_keys);
+    for (int64 i = 0; i < num_keys; ++i) {
+      shard_of[i] = ShardOf(SubtleMustCopyIfIntegral(keys(i)));
+      ++starts[shard_of[i] + 1];
+    }
+    for (int64 s = 0; s < num_shards_; ++s) starts[s + 1] += starts[s];
+    std::vector<int64> order(num_keys);
+    std::vector<int64> next(starts.begin(), starts.end() - 1);
+    for (int64 i = 0; i < num_keys; ++i) order[next[shard_of[i]]++] = i;
+
+    auto work = [this, exclusive, &fn, &starts, &order](int64 begin,
+                                                        int64 end) {
+      for (int64 s = begin; s < end; ++s) {
+        if (starts[s] == starts[s + 1]) continue;
+        WithLock(&shards_[s], exclusive, [&fn, &starts, &order, s](Map* map) {
+          for (int64 p = starts[s]; p < starts[s + 1]; ++p) fn(map, order[p]);
+        });
+      }
+    };
+    const DeviceBase::CpuWorkerThreads* worker_threads =
+        ctx == nullptr ? nullptr
+                       : ctx->device()->tensorflow_cpu_worker_threads();
+    if (worker_threads == nullptr) {
+      work(0, num_shards_);
+    } else {
+      Shard(worker_threads->num_threads, worker_threads->workers, num_shards_,
+            cost_per_key * std::max<int64>(num_keys / num_shards_, 1), work);
+    }
+  }
+
+  // Calls fn() while holding the locks of all the shards, so that it sees a
+  // consistent table through shard_map().
+  template <typename Fn>
+  void WithAllShards(bool exclusive, const Fn& fn)
+      TF_NO_THREAD_SAFETY_ANALYSIS {
+    for (int64 s = 0; s < num_shards_; ++s) {
+      if (exclusive) {
+        shards_[s].mu.lock();
+      } else {
+        shards_[s].mu.lock_shared();
+      }
+    }
+    fn();
+    for (int64 s = num_shards_ - 1; s >= 0; --s) {
+      if (exclusive) {
+        shards_[s].mu.unlock();
+      } else {
+        shards_[s].mu.unlock_shared();
+      }
+    }
+  }
+
+  // Must only be called by the function passed to WithAllShards().
+  Map* shard_map(int64 s) TF_NO_THREAD_SAFETY_ANALYSIS {
+    return &shards_[s].map;
+  }
+
+  int64 MemoryUsed() const {
+    int64 ret = 0;
+    for (int64 s = 0; s < num_shards_; ++s) {
+      tf_shared_lock l(shards_[s].mu);
+      const Map& map = shards_[s].map;
+      for (unsigned i = 0; i < map.bucket_count(); ++i) {
+        size_t bucket_size = map.bucket_size(i);
+        if (bucket_size == 0) {
+          ret++;
+        } else {
+          ret += bucket_size;
+        }
+      }
+    }
+    return sizeof(ShardedHashMap) + num_shards_ * sizeof(HashShard) + ret;
+  }
+
+ private:
+  struct HashShard {
+    mutable mutex mu;
+    Map map TF_GUARDED_BY(mu);
+  };
+
+  template <typename Fn>
+  static void WithLock(HashShard* shard, bool exclusive, const Fn& fn) {
+    if (exclusive) {
+      mutex_lock l(shard->mu);
+      fn(&shard->map);
+    } else {
+      tf_shared_lock l(shard->mu);
+      fn(&shard->map);
+    }
+  }
+
+  const int64 num_shards_;
+  std::unique_ptr<HashShard[]> shards_;
+};
+
 // Lookup table that wraps an unordered_map, where the key and value data type
 // is specified. Each individual value must be a scalar. If vector values are
 // required, use MutableHashTableOfTensors.
 //
 // This table is mutable and thread safe - Insert can be called at any time.
+// The "num_shards" attr of the op splits it into shards with separate locks,
+// see ShardedHashMap.
 //
 // Sample use case:
 //
@@ -47,12 +213,10 @@ namespace lookup {
 template <class K, class V>
 class MutableHashTableOfScalars final : public LookupInterface {
  public:
-  MutableHashTableOfScalars(OpKernelContext* ctx, OpKernel* kernel) {}
+  MutableHashTableOfScalars(OpKernelContext* ctx, OpKernel* kernel)
+      : table_(NumShards(kernel)) {}
 
-  size_t size() const override {
-    tf_shared_lock l(mu_);
-    return table_.size();
-  }
+  size_t size() const override { return table_.size(); }
 
   Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
               const Tensor& default_value) override {
@@ -60,69 +224,89 @@ class MutableHashTableOfScalars final : public LookupInterface {
     const auto key_values = key.flat<K>();
     auto value_values = value->flat<V>();
 
-    tf_shared_lock l(mu_);
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      value_values(i) = gtl::FindWithDefault(
-          table_, SubtleMustCopyIfIntegral(key_values(i)), default_val);
-    }
+    table_.ForEachKey(ctx, key_values, /*exclusive=*/false, kCostPerKey,
+                      [&](typename ShardedMap::Map* map, int64 i) {
+                        value_values(i) = gtl::FindWithDefault(
+                            *map, SubtleMustCopyIfIntegral(key_values(i)),
+                            default_val);
+                      });
 
     return Status::OK();
   }
 
-  Status DoInsert(bool clear, const Tensor& keys, const Tensor& values) {
+  Status DoInsert(OpKernelContext* ctx, bool clear, const Tensor& keys,
+                  const Tensor& values) {
     const auto key_values = keys.flat<K>();
     const auto value_values = values.flat<V>();
 
-    mutex_lock l(mu_);
-    if (clear) {
-      table_.clear();
-    }
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      gtl::InsertOrUpdate(&table_, SubtleMustCopyIfIntegral(key_values(i)),
+    auto insert = [&](typename ShardedMap::Map* map, int64 i) {
+      gtl::InsertOrUpdate(map, SubtleMustCopyIfIntegral(key_values(i)),
                           SubtleMustCopyIfIntegral(value_values(i)));
+    };
+    if (clear) {
+      // Readers see either the old or the new content of the table.
+      table_.WithAllShards(/*exclusive=*/true, [&]() {
+        for (int64 s = 0; s < table_.num_shards(); ++s) {
+          table_.shard_map(s)->clear();
+        }
+        for (int64 i = 0; i < key_values.size(); ++i) {
+          insert(table_.shard_map(table_.ShardOf(key_values(i))), i);
+        }
+      });
+    } else {
+      table_.ForEachKey(ctx, key_values, /*exclusive=*/true, kCostPerKey,
+                        insert);
     }
     return Status::OK();
   }
 
   Status Insert(OpKernelContext* ctx, const Tensor& keys,
                 const Tensor& values) override {
-    return DoInsert(false, keys, values);
+    return DoInsert(ctx, false, keys, values);
   }
 
   Status Remove(OpKernelContext* ctx, const Tensor& keys) override {
     const auto key_values = keys.flat<K>();
 
-    mutex_lock l(mu_);
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      table_.erase(SubtleMustCopyIfIntegral(key_values(i)));
-    }
+    table_.ForEachKey(ctx, key_values, /*exclusive=*/true, kCostPerKey,
+                      [&](typename ShardedMap::Map* map, int64 i) {
+                        map->erase(SubtleMustCopyIfIntegral(key_values(i)));
+                      });
     return Status::OK();
   }
 
   Status ImportValues(OpKernelContext* ctx, const Tensor& keys,
                       const Tensor& values) override {
-    return DoInsert(true, keys, values);
+    return DoInsert(ctx, true, keys, values);
   }
 
   Status ExportValues(OpKernelContext* ctx) override {
-    tf_shared_lock l(mu_);
-    int64 size = table_.size();
-
-    Tensor* keys;
-    Tensor* values;
-    TF_RETURN_IF_ERROR(
-        ctx->allocate_output("keys", TensorShape({size}), &keys));
-    TF_RETURN_IF_ERROR(
-        ctx->allocate_output("values", TensorShape({size}), &values));
-
-    auto keys_data = keys->flat<K>();
-    auto values_data = values->flat<V>();
-    int64 i = 0;
-    for (auto it = table_.begin(); it != table_.end(); ++it, ++i) {
-      keys_data(i) = it->first;
-      values_data(i) = it->second;
-    }
-    return Status::OK();
+    Status status;
+    table_.WithAllShards(/*exclusive=*/false, [this, ctx, &status]() {
+      int64 size = 0;
+      for (int64 s = 0; s < table_.num_shards(); ++s) {
+        size += table_.shard_map(s)->size();
+      }
+
+      Tensor* keys;
+      Tensor* values;
+      status = ctx->allocate_output("keys", TensorShape({size}), &keys);
+      if (!status.ok()) return;
+      status = ctx->allocate_output("values", TensorShape({size}), &values);
+      if (!status.ok()) return;
+
+      auto keys_data = keys->flat<K>();
+      auto values_data = values->flat<V>();
+      int64 i = 0;
+      for (int64 s = 0; s < table_.num_shards(); ++s) {
+        const typename ShardedMap::Map& map = *table_.shard_map(s);
+        for (auto it = map.begin(); it != map.end(); ++it, ++i) {
+          keys_data(i) = it->first;
+          values_data(i) = it->second;
+        }
+      }
+    });
+    return status;
   }
 
   DataType key_dtype() const override { return DataTypeToEnum<K>::v(); }
@@ -134,22 +318,15 @@ class MutableHashTableOfScalars final : public LookupInterface {
   TensorShape value_shape() const override { return TensorShape(); }
 
   int64 MemoryUsed() const override {
-    int64 ret = 0;
-    tf_shared_lock l(mu_);
-    for (unsigned i = 0; i < table_.bucket_count(); ++i) {
-      size_t bucket_size = table_.bucket_size(i);
-      if (bucket_size == 0) {
-        ret++;
-      } else {
-        ret += bucket_size;
-      }
-    }
-    return sizeof(MutableHashTableOfScalars) + ret;
+    return sizeof(MutableHashTableOfScalars) + table_.MemoryUsed();
   }
 
  private:
-  mutable mutex mu_;
-  std::unordered_map<K, V> table_ TF_GUARDED_BY(mu_);
+  typedef ShardedHashMap<K, V> ShardedMap;
+  // Estimated cost of looking up or inserting one key, in cycles.
+  static constexpr int64 kCostPerKey = 100;
+
+  ShardedMap table_;
 };
 
 // Lookup table that wraps an unordered_map. Behaves identical to
@@ -157,7 +334,8 @@ class MutableHashTableOfScalars final : public LookupInterface {
 template <class K, class V>
 class MutableHashTableOfTensors final : public LookupInterface {
  public:
-  MutableHashTableOfTensors(OpKernelContext* ctx, OpKernel* kernel) {
+  MutableHashTableOfTensors(OpKernelContext* ctx, OpKernel* kernel)
+      : table_(NumShards(kernel)) {
     OP_REQUIRES_OK(ctx,
                    GetNodeAttr(kernel->def(), "value_shape", &value_shape_));
     OP_REQUIRES(
@@ -166,10 +344,7 @@ class MutableHashTableOfTensors final : public LookupInterface {
                                 value_shape_.DebugString()));
   }
 
-  size_t size() const override {
-    tf_shared_lock l(mu_);
-    return table_.size();
-  }
+  size_t size() const override { return table_.size(); }
 
   Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
               const Tensor& default_value) override {
@@ -178,89 +353,110 @@ class MutableHashTableOfTensors final : public LookupInterface {
     auto value_values = value->flat_inner_dims<V, 2>();
     int64 value_dim = value_shape_.dim_size(0);
 
-    tf_shared_lock l(mu_);
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      ValueArray* value_vec =
-          gtl::FindOrNull(table_, SubtleMustCopyIfIntegral(key_values(i)));
-      if (value_vec != nullptr) {
-        for (int64 j = 0; j < value_dim; j++) {
-          value_values(i, j) = value_vec->at(j);
-        }
-      } else {
-        for (int64 j = 0; j < value_dim; j++) {
-          value_values(i, j) = default_flat(j);
-        }
-      }
-    }
+    table_.ForEachKey(
+        ctx, key_values, /*exclusive=*/false, kCostPerKey * (value_dim + 1),
+        [&](typename ShardedMap::Map* map, int64 i) {
+          ValueArray* value_vec =
+              gtl::FindOrNull(*map, SubtleMustCopyIfIntegral(key_values(i)));
+          if (value_vec != nullptr) {
+            for (int64 j = 0; j < value_dim; j++) {
+              value_values(i, j) = value_vec->at(j);
+            }
+          } else {
+            for (int64 j = 0; j < value_dim; j++) {
+              value_values(i, j) = default_flat(j);
+            }
+          }
+        });
 
     return Status::OK();
   }
 
-  Status DoInsert(bool clear, const Tensor& keys, const Tensor& values) {
+  Status DoInsert(OpKernelContext* ctx, bool clear, const Tensor& keys,
+                  const Tensor& values) {
     const auto key_values = keys.flat<K>();
     const auto value_values = values.flat_inner_dims<V, 2>();
     int64 value_dim = value_shape_.dim_size(0);
 
-    mutex_lock l(mu_);
-    if (clear) {
-      table_.clear();
-    }
-    for (int64 i = 0; i < key_values.size(); ++i) {
+    auto insert = [&](typename ShardedMap::Map* map, int64 i) {
       ValueArray value_vec;
       for (int64 j = 0; j < value_dim; j++) {
         V value = value_values(i, j);
         value_vec.push_back(value);
       }
-      gtl::InsertOrUpdate(&table_, SubtleMustCopyIfIntegral(key_values(i)),
+      gtl::InsertOrUpdate(map, SubtleMustCopyIfIntegral(key_values(i)),
                           value_vec);
+    };
+    if (clear) {
+      // Readers see either the old or the new content of the table.
+      table_.WithAllShards(/*exclusive=*/true, [&]() {
+        for (int64 s = 0; s < table_.num_shards(); ++s) {
+          table_.shard_map(s)->clear();
+        }
+        for (int64 i = 0; i < key_values.size(); ++i) {
+          insert(table_.shard_map(table_.ShardOf(key_values(i))), i);
+        }
+      });
+    } else {
+      table_.ForEachKey(ctx, key_values, /*exclusive=*/true,
+                        kCostPerKey * (value_dim + 1), insert);
     }
     return Status::OK();
   }
 
   Status Insert(OpKernelContext* ctx, const Tensor& keys,
                 const Tensor& values) override {
-    return DoInsert(false, keys, values);
+    return DoInsert(ctx, false, keys, values);
   }
 
   Status Remove(OpKernelContext* ctx, const Tensor& keys) override {
     const auto key_values = keys.flat<K>();
 
-    mutex_lock l(mu_);
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      table_.erase(SubtleMustCopyIfIntegral(key_values(i)));
-    }
+    table_.ForEachKey(ctx, key_values, /*exclusive=*/true, kCostPerKey,
+                      [&](typename ShardedMap::Map* map, int64 i) {
+                        map->erase(SubtleMustCopyIfIntegral(key_values(i)));
+                      });
     return Status::OK();
   }
 
   Status ImportValues(OpKernelContext* ctx, const Tensor& keys,
                       const Tensor& values) override {
-    return DoInsert(true, keys, values);
+    return DoInsert(ctx, true, keys, values);
   }
 
   Status ExportValues(OpKernelContext* ctx) override {
-    tf_shared_lock l(mu_);
-    int64 size = table_.size();
-    int64 value_dim = value_shape_.dim_size(0);
-
-    Tensor* keys;
-    Tensor* values;
-    TF_RETURN_IF_ERROR(
-        ctx->allocate_output("keys", TensorShape({size}), &keys));
-    TF_RETURN_IF_ERROR(ctx->allocate_output(
-        "values", TensorShape({size, value_dim}), &values));
-
-    auto keys_data = keys->flat<K>();
-    auto values_data = values->matrix<V>();
-    int64 i = 0;
-    for (auto it = table_.begin(); it != table_.end(); ++it, ++i) {
-      K key = it->first;
-      ValueArray value = it->second;
-      keys_data(i) = key;
-      for (int64 j = 0; j < value_dim; j++) {
-        values_data(i, j) = value[j];
+    Status status;
+    table_.WithAllShards(/*exclusive=*/false, [this, ctx, &status]() {
+      int64 size = 0;
+      for (int64 s = 0; s < table_.num_shards(); ++s) {
+        size += table_.shard_map(s)->size();
       }
-    }
-    return Status::OK();
+      int64 value_dim = value_shape_.dim_size(0);
+
+      Tensor* keys;
+      Tensor* values;
+      status = ctx->allocate_output("keys", TensorShape({size}), &keys);
+      if (!status.ok()) return;
+      status = ctx->allocate_output(
+          "values", TensorShape({size, value_dim}), &values);
+      if (!status.ok()) return;
+
+      auto keys_data = keys->flat<K>();
+      auto values_data = values->matrix<V>();
+      int64 i = 0;
+      for (int64 s = 0; s < table_.num_shards(); ++s) {
+        const typename ShardedMap::Map& map = *table_.shard_map(s);
+        for (auto it = map.begin(); it != map.end(); ++it, ++i) {
+          K key = it->first;
+          const ValueArray& value = it->second;
+          keys_data(i) = key;
+          for (int64 j = 0; j < value_dim; j++) {
+            values_data(i, j) = value[j];
+          }
+        }
+      }
+    });
+    return status;
   }
 
   DataType key_dtype() const override { return DataTypeToEnum<K>::v(); }
@@ -272,24 +468,17 @@ class MutableHashTableOfTensors final : public LookupInterface {
   TensorShape value_shape() const override { return value_shape_; }
 
   int64 MemoryUsed() const override {
-    int64 ret = 0;
-    tf_shared_lock l(mu_);
-    for (unsigned i = 0; i < table_.bucket_count(); ++i) {
-      size_t bucket_size = table_.bucket_size(i);
-      if (bucket_size == 0) {
-        ret++;
-      } else {
-        ret += bucket_size;
-      }
-    }
-    return sizeof(MutableHashTableOfTensors) + ret;
+    return sizeof(MutableHashTableOfTensors) + table_.MemoryUsed();
   }
 
  private:
-  TensorShape value_shape_;
-  mutable mutex mu_;
   typedef gtl::InlinedVector<V, 4> ValueArray;
-  std::unordered_map<K, ValueArray> table_ TF_GUARDED_BY(mu_);
+  typedef ShardedHashMap<K, ValueArray> ShardedMap;
+  // Estimated cost of looking up or inserting one value element, in cycles.
+  static constexpr int64 kCostPerKey = 100;
+
+  TensorShape value_shape_;
+  ShardedMap table_;
 };
 
 namespace {
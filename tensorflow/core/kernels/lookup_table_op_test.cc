@@ -0,0 +1,175 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <map>
+#include <vector>
+
+#include "tensorflow/cc/client/client_session.h"
+#include "tensorflow/cc/ops/const_op.h"
+#include "tensorflow/cc/ops/lookup_ops.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace ops {
+namespace {
+
+Tensor Iota(int64 n, int64 start, int64 step) {
+  Tensor t(DT_INT64, TensorShape({n}));
+  for (int64 i = 0; i < n; ++i) t.flat<int64>()(i) = start + i * step;
+  return t;
+}
+
+class MutableHashTableOpTest : public ::testing::TestWithParam<int> {};
+
+TEST_P(MutableHashTableOpTest, InsertFindRemoveExport) {
+  Scope root = Scope::NewRootScope();
+  auto table = MutableHashTable(root, DT_INT64, DT_FLOAT,
+                                MutableHashTable::NumShards(GetParam()));
+  const int64 n = 1000;
+  Tensor keys = Iota(n, 0, 3);
+  Tensor values(DT_FLOAT, TensorShape({n}));
+  for (int64 i = 0; i < n; ++i) values.flat<float>()(i) = i * 0.5f;
+  auto insert = LookupTableInsert(root, table, keys, values);
+  // Removes every other key, including keys that are absent.
+  auto remove = LookupTableRemove(root, table, Iota(n, 0, 6));
+  auto find = LookupTableFind(root, table, Iota(n, 0, 3), -1.0f);
+  auto size = LookupTableSize(root, table);
+  auto exported = LookupTableExport(root, table, DT_INT64, DT_FLOAT);
+  TF_ASSERT_OK(root.status());
+
+  ClientSession session(root);
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session.Run({}, {}, {insert}, nullptr));
+  TF_ASSERT_OK(session.Run({size}, &outputs));
+  EXPECT_EQ(n, outputs[0].scalar<int64>()());
+
+  TF_ASSERT_OK(session.Run({find.values}, &outputs));
+  test::ExpectTensorEqual<float>(values, outputs[0]);
+
+  TF_ASSERT_OK(session.Run({}, {}, {remove}, nullptr));
+  TF_ASSERT_OK(session.Run({find.values, size}, &outputs));
+  Tensor expected(DT_FLOAT, TensorShape({n}));
+  for (int64 i = 0; i < n; ++i) {
+    expected.flat<float>()(i) = i % 2 == 0 ? -1.0f : i * 0.5f;
+  }
+  test::ExpectTensorEqual<float>(expected, outputs[0]);
+  EXPECT_EQ(n / 2, outputs[1].scalar<int64>()());
+
+  TF_ASSERT_OK(session.Run({exported.keys, exported.values}, &outputs));
+  ASSERT_EQ(n / 2, outputs[0].NumElements());
+  std::map<int64, float> contents;
+  for (int64 i = 0; i < n / 2; ++i) {
+    contents[outputs[0].flat<int64>()(i)] = outputs[1].flat<float>()(i);
+  }
+  ASSERT_EQ(n / 2, contents.size());
+  for (const auto& kv : contents) {
+    EXPECT_EQ(3, kv.first % 6);
+    EXPECT_EQ(kv.first / 3 * 0.5f, kv.second);
+  }
+}
+
+TEST_P(MutableHashTableOpTest, DuplicateKeysInOneInsert) {
+  Scope root = Scope::NewRootScope();
+  auto table = MutableHashTable(root, DT_INT64, DT_FLOAT,
+                                MutableHashTable::NumShards(GetParam()));
+  // The last value of a key wins, as with a single shard.
+  auto insert =
+      LookupTableInsert(root, table, Input({int64{7}, int64{9}, int64{7}}),
+                        Input({1.0f, 2.0f, 3.0f}));
+  auto find = LookupTableFind(root, table, Input({int64{7}, int64{9}}), 0.0f);
+  TF_ASSERT_OK(root.status());
+
+  ClientSession session(root);
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session.Run({}, {}, {insert}, nullptr));
+  TF_ASSERT_OK(session.Run({find.values}, &outputs));
+  test::ExpectTensorEqual<float>(test::AsTensor<float>({3.0f, 2.0f}),
+                                 outputs[0]);
+}
+
+TEST_P(MutableHashTableOpTest, TableOfTensors) {
+  Scope root = Scope::NewRootScope();
+  auto table = MutableHashTableOfTensors(
+      root, DT_INT64, DT_FLOAT,
+      MutableHashTableOfTensors::ValueShape({2}).NumShards(GetParam()));
+  const int64 n = 100;
+  Tensor values(DT_FLOAT, TensorShape({n, 2}));
+  for (int64 i = 0; i < 2 * n; ++i) values.flat<float>()(i) = i;
+  auto insert = LookupTableInsert(root, table, Iota(n, 1, 1), values);
+  auto find = LookupTableFind(root, table, Iota(n + 1, 0, 1),
+                              Input({-1.0f, -2.0f}));
+  TF_ASSERT_OK(root.status());
+
+  ClientSession session(root);
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session.Run({}, {}, {insert}, nullptr));
+  TF_ASSERT_OK(session.Run({find.values}, &outputs));
+  Tensor expected(DT_FLOAT, TensorShape({n + 1, 2}));
+  expected.flat<float>()(0) = -1.0f;
+  expected.flat<float>()(1) = -2.0f;
+  for (int64 i = 0; i < 2 * n; ++i) expected.flat<float>()(i + 2) = i;
+  test::ExpectTensorEqual<float>(expected, outputs[0]);
+}
+
+INSTANTIATE_TEST_SUITE_P(NumShards, MutableHashTableOpTest,
+                         ::testing::Values(1, 4, 16));
+
+// Runs `num_finders` lookups of `batch_size` keys each concurrently against a
+// table of 1M entries split into `num_shards` shards.
+static void BM_MutableHashTableFind(int iters, int num_shards,
+                                    int num_finders) {
+  testing::StopTiming();
+  const int64 num_keys = 1 << 20;
+  const int64 batch_size = 1 << 14;
+
+  Scope init = Scope::NewRootScope();
+  auto init_table = MutableHashTable(
+      init, DT_INT64, DT_FLOAT,
+      MutableHashTable::SharedName("table").NumShards(num_shards));
+  Tensor values(DT_FLOAT, TensorShape({num_keys}));
+  values.flat<float>().setConstant(1.0f);
+  LookupTableInsert(init, init_table, Iota(num_keys, 0, 7), values);
+  Graph* init_graph = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(init.ToGraph(init_graph));
+
+  Scope root = Scope::NewRootScope();
+  auto table = MutableHashTable(
+      root, DT_INT64, DT_FLOAT,
+      MutableHashTable::SharedName("table").NumShards(num_shards));
+  for (int i = 0; i < num_finders; ++i) {
+    LookupTableFind(root, table, Iota(batch_size, i, 13), 0.0f);
+  }
+  Graph* graph = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(root.ToGraph(graph));
+
+  testing::ItemsProcessed(static_cast<int64>(iters) * num_finders *
+                          batch_size);
+  test::Benchmark("cpu", graph, nullptr, init_graph).Run(iters);
+}
+
+BENCHMARK(BM_MutableHashTableFind)
+    ->ArgPair(1, 1)
+    ->ArgPair(1, 8)
+    ->ArgPair(16, 1)
+    ->ArgPair(16, 8);
+
+}  // namespace
+}  // namespace ops
+}  // namespace tensorflow
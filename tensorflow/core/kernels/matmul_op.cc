@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/kernels/fill_functor.h"
+#include "tensorflow/core/kernels/packed_matmul.h"
 #include "tensorflow/core/util/matmul_autotune.h"
 #if GOOGLE_CUDA
 #include "third_party/gpus/cuda/include/cuda.h"
@@ -438,6 +439,41 @@ struct LaunchMatMul<GPUDevice, T, true /* USE_CUBLAS */> {
 
 #endif  // GOOGLE_CUDA || TENSORFLOW_USE_ROCM
 
+// Multiplies by a right-hand side read from a Const node, whose packing is
+// cached across steps. Returns false for the devices, types and shapes that
+// are left to LaunchMatMul, and for bfloat16 unless its caching is enabled.
+template <typename Device, typename T, typename Enable = void>
+class ConstantRhsMatMul {
+ public:
+  bool Compute(OpKernelContext* ctx, const Tensor& a, const Tensor& b,
+               bool transpose_a, bool transpose_b, Tensor* out) {
+    return false;
+  }
+};
+
+template <typename T>
+class ConstantRhsMatMul<
+    CPUDevice, T, typename std::enable_if<IsPackedMatMulType<T>::value>::type> {
+ public:
+  bool Compute(OpKernelContext* ctx, const Tensor& a, const Tensor& b,
+               bool transpose_a, bool transpose_b, Tensor* out) {
+    const int64 m = out->dim_size(0);
+    if (!CachePackedMatMulRhs<T>() ||
+        !PreferPackedMatMulRhs<T>(m, out->dim_size(1))) {
+      return false;
+    }
+    const auto& worker_threads =
+        *ctx->device()->tensorflow_cpu_worker_threads();
+    cache_.Get(worker_threads, b, transpose_b)
+        ->Multiply(worker_threads, a.flat<T>().data(), m, transpose_a,
+                   out->flat<T>().data());
+    return true;
+  }
+
+ private:
+  PackedMatMulRhsCache<T> cache_;
+};
+
 template <typename Device, typename T, bool USE_CUBLAS>
 class MatMulOp : public OpKernel {
  public:
@@ -445,6 +481,10 @@ class MatMulOp : public OpKernel {
       : OpKernel(ctx), algorithms_set_already_(false) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("transpose_a", &transpose_a_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("transpose_b", &transpose_b_));
+    // Set by Grappler on CPU nodes whose right-hand side is a Const.
+    if (ctx->HasAttr("_constant_rhs")) {
+      OP_REQUIRES_OK(ctx, ctx->GetAttr("_constant_rhs", &constant_rhs_));
+    }
 
     LaunchMatMul<Device, T, USE_CUBLAS>::GetBlasGemmAlgorithm(
         ctx, &algorithms_, &algorithms_set_already_);
@@ -495,27 +535,20 @@ class MatMulOp : public OpKernel {
       return;
     }
 
+    if (constant_rhs_ && constant_rhs_matmul_.Compute(ctx, a, b, transpose_a_,
+                                                      transpose_b_, out)) {
+      return;
+    }
+
     if (std::is_same<T, bfloat16>::value) {
       bool is_cpu = std::is_same<Device, CPUDevice>::value;
       OP_REQUIRES(ctx, is_cpu,
                   errors::Internal("bfloat16 matmul is not supported by GPU"));
-      Tensor a_float, b_float, out_float;
-      OP_REQUIRES_OK(ctx, ctx->allocate_temp(DT_FLOAT, a.shape(), &a_float));
-      OP_REQUIRES_OK(ctx, ctx->allocate_temp(DT_FLOAT, b.shape(), &b_float));
-      OP_REQUIRES_OK(ctx,
-                     ctx->allocate_temp(DT_FLOAT, out->shape(), &out_float));
-
-      // TODO: Avoid extra copy to make bfloat16 matmul efficient on CPU.
-      BFloat16ToFloat(a.flat<bfloat16>().data(), a_float.flat<float>().data(),
-                      a.NumElements());
-      BFloat16ToFloat(b.flat<bfloat16>().data(), b_float.flat<float>().data(),
-                      b.NumElements());
-
-      LaunchMatMul<Device, float, USE_CUBLAS>::launch(
-          ctx, a_float, b_float, dim_pair, &algorithms_, use_autotune_,
-          &out_float);
-      FloatToBFloat16(out_float.flat<float>().data(),
-                      out->flat<bfloat16>().data(), out->NumElements());
+      BFloat16MatMul(*ctx->device()->tensorflow_cpu_worker_threads(),
+                     a.flat<bfloat16>().data(), b.flat<bfloat16>().data(),
+                     out->dim_size(0), a.dim_size(dim_pair[0].first),
+                     out->dim_size(1), transpose_a_, transpose_b_,
+                     out->flat<bfloat16>().data());
     } else {
       LaunchMatMul<Device, T, USE_CUBLAS>::launch(
           ctx, a, b, dim_pair, &algorithms_, use_autotune_, out);
@@ -528,6 +561,8 @@ class MatMulOp : public OpKernel {
   bool use_autotune_;
   bool transpose_a_;
   bool transpose_b_;
+  bool constant_rhs_ = false;
+  ConstantRhsMatMul<Device, T> constant_rhs_matmul_;
 };
 
 namespace functor {
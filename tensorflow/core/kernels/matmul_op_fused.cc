@@ -38,6 +38,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/kernels/fill_functor.h"
 #include "tensorflow/core/kernels/fused_eigen_output_kernels.h"
+#include "tensorflow/core/kernels/packed_matmul.h"
 #include "tensorflow/core/util/tensor_format.h"
 
 #if defined(TENSORFLOW_USE_CUSTOM_CONTRACTION_KERNEL)
@@ -64,33 +65,36 @@ struct LaunchFusedMatMulOp<CPUDevice, T> {
       const Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1>& dim_pair,
       FusedComputationType fusion, const FusedComputationArgs& fusion_args,
       Tensor* output) {
-    auto lhs = a.matrix<T>();
-    auto rhs = b.matrix<T>();
-    auto out = output->matrix<T>();
-
-    auto& d = context->eigen_device<CPUDevice>();
+    operator()(context, a, b, dim_pair, fusion, fusion_args,
+               /*packed_rhs=*/nullptr, output);
+  }
 
+  // Multiplies by `packed_rhs` instead of `b`, unless it is null.
+  void operator()(
+      OpKernelContext* context, const Tensor& a, const Tensor& b,
+      const Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1>& dim_pair,
+      FusedComputationType fusion, const FusedComputationArgs& fusion_args,
+      const PackedMatMulRhs<T>* packed_rhs, Tensor* output) {
     BiasAddArgs<T> bias_add_args;
     if (BiasAddArgs<T>::IsSupported(fusion)) {
       OP_REQUIRES_OK(context, InitBiasAddArgs(context, &bias_add_args));
     }
 
+    auto contract = [&](const auto& output_kernel) {
+      Contract(context, a, b, dim_pair, packed_rhs, output_kernel, output);
+    };
     switch (fusion) {
       case FusedComputationType::kBiasAdd:
-        out.device(d) =
-            lhs.contract(rhs, dim_pair, WithBiasAdd<T>(bias_add_args));
+        contract(WithBiasAdd<T>(bias_add_args));
         break;
       case FusedComputationType::kBiasAddWithRelu:
-        out.device(d) =
-            lhs.contract(rhs, dim_pair, WithBiasAddAndRelu<T>(bias_add_args));
+        contract(WithBiasAddAndRelu<T>(bias_add_args));
         break;
       case FusedComputationType::kBiasAddWithRelu6:
-        out.device(d) =
-            lhs.contract(rhs, dim_pair, WithBiasAddAndRelu6<T>(bias_add_args));
+        contract(WithBiasAddAndRelu6<T>(bias_add_args));
         break;
       case FusedComputationType::kBiasAddWithElu:
-        out.device(d) =
-            lhs.contract(rhs, dim_pair, WithBiasAddAndElu<T>(bias_add_args));
+        contract(WithBiasAddAndElu<T>(bias_add_args));
         break;
       case FusedComputationType::kUndefined:
         OP_REQUIRES_OK(context, errors::Internal("Fusion type is undefined"));
@@ -100,6 +104,39 @@ struct LaunchFusedMatMulOp<CPUDevice, T> {
                        errors::Internal("Fusion type is not supported"));
     }
   }
+
+ private:
+  template <typename OutputKernel>
+  static void Contract(
+      OpKernelContext* context, const Tensor& a, const Tensor& b,
+      const Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1>& dim_pair,
+      const PackedMatMulRhs<T>* packed_rhs, const OutputKernel& output_kernel,
+      Tensor* output) {
+    if (packed_rhs == nullptr) {
+      auto& d = context->eigen_device<CPUDevice>();
+      output->matrix<T>().device(d) =
+          a.matrix<T>().contract(b.matrix<T>(), dim_pair, output_kernel);
+      return;
+    }
+
+    // Output kernels see the output of a contraction with swapped arguments,
+    // i.e. the column-major transpose of the row-major output, so each output
+    // row is a column of their blocks.
+    const int64 n = output->dim_size(1);
+    T* out = output->flat<T>().data();
+    packed_rhs->Multiply(
+        *context->device()->tensorflow_cpu_worker_threads(),
+        a.flat<T>().data(), output->dim_size(0), dim_pair[0].first == 0, out,
+        [&](int64 row, int64 col, int64 rows, int64 cols) {
+          ContractionOutputMapper<T, Eigen::Index> output_mapper(
+              out + row * n + col, n);
+          output_kernel(output_mapper, Eigen::TensorContractionParams{true},
+                        static_cast<Eigen::Index>(col),
+                        static_cast<Eigen::Index>(row),
+                        static_cast<Eigen::Index>(cols),
+                        static_cast<Eigen::Index>(rows));
+        });
+  }
 };
 
 template <typename Device, typename T>
@@ -108,6 +145,11 @@ class FusedMatMulOp : public OpKernel {
   explicit FusedMatMulOp(OpKernelConstruction* context) : OpKernel(context) {
     OP_REQUIRES_OK(context, context->GetAttr("transpose_a", &transpose_a_));
     OP_REQUIRES_OK(context, context->GetAttr("transpose_b", &transpose_b_));
+    // Set by Grappler on CPU nodes whose right-hand side is a Const.
+    if (context->HasAttr("_constant_rhs")) {
+      OP_REQUIRES_OK(context,
+                     context->GetAttr("_constant_rhs", &constant_rhs_));
+    }
 
     std::vector<FusedComputationPattern> patterns;
 
@@ -169,6 +211,14 @@ class FusedMatMulOp : public OpKernel {
     }
 
     auto launch = LaunchFusedMatMulOp<Device, T>();
+    if (constant_rhs_ && CachePackedMatMulRhs<T>() &&
+        PreferPackedMatMulRhs<T>(out->dim_size(0), out->dim_size(1))) {
+      const auto packed_rhs = packed_rhs_cache_.Get(
+          *ctx->device()->tensorflow_cpu_worker_threads(), b, transpose_b_);
+      launch(ctx, a, b, dim_pair, fused_computation_, fused_computation_args_,
+             packed_rhs.get(), out);
+      return;
+    }
     launch(ctx, a, b, dim_pair, fused_computation_, fused_computation_args_,
            out);
   }
@@ -176,6 +226,8 @@ class FusedMatMulOp : public OpKernel {
  private:
   bool transpose_a_;
   bool transpose_b_;
+  bool constant_rhs_ = false;
+  PackedMatMulRhsCache<T> packed_rhs_cache_;
 
   FusedComputationType fused_computation_ = FusedComputationType::kUndefined;
   FusedComputationArgs fused_computation_args_;
@@ -368,6 +368,7 @@ static Graph* Matmul(int m, int k, int n, bool transpose_a, bool transpose_b,
 
 #define BM_Matmul(M, K, N, TA, TB)                                       \
   BM_MatmulDev(M, K, N, TA, TB, float, DT_FLOAT, cpu);                   \
+  BM_MatmulDev(M, K, N, TA, TB, bfloat16, DT_BFLOAT16, cpu);             \
   BM_MatmulDev(M, K, N, TA, TB, std::complex<float>, DT_COMPLEX64, cpu); \
   BM_MatmulDev(M, K, N, TA, TB, float, DT_FLOAT, gpu);                   \
   BM_MatmulDev(M, K, N, TA, TB, std::complex<float>, DT_COMPLEX64, gpu); \
@@ -379,8 +380,9 @@ static Graph* Matmul(int m, int k, int n, bool transpose_a, bool transpose_b,
 
 #else
 
-#define BM_Matmul(M, K, N, TA, TB)                     \
-  BM_MatmulDev(M, K, N, TA, TB, float, DT_FLOAT, cpu); \
+#define BM_Matmul(M, K, N, TA, TB)                           \
+  BM_MatmulDev(M, K, N, TA, TB, float, DT_FLOAT, cpu);       \
+  BM_MatmulDev(M, K, N, TA, TB, bfloat16, DT_BFLOAT16, cpu); \
   BM_MatmulDev(M, K, N, TA, TB, std::complex<float>, DT_COMPLEX64, cpu);
 
 #endif  // GOOGLE_CUDA
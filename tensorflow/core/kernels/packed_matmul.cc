@@ -0,0 +1,446 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/packed_matmul.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/util/env_var.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+// VDPBF16PS intrinsics are available from GCC 10 and clang 9, and are only
+// used in functions compiled for AVX-512 BF16, after checking the CPU at
+// runtime.
+#if defined(__x86_64__) &&                                \
+    ((defined(__clang__) && __clang_major__ >= 9) ||      \
+     (!defined(__clang__) && defined(__GNUC__) && __GNUC__ >= 10))
+#define TENSORFLOW_PACKED_MATMUL_AVX512_BF16 1
+#include <immintrin.h>
+#endif
+
+namespace tensorflow {
+
+namespace {
+
+// The output is computed in tiles of kTileRows x kTileCols, accumulated in
+// float over blocks of kBlockDepth along the inner dimension. A block of the
+// left-hand side and a tile of the output (64KB and 96KB) stay in the L2
+// cache while the micro kernels go over them.
+constexpr int64 kTileRows = 64;
+constexpr int64 kTileCols = 384;
+constexpr int64 kBlockDepth = 256;
+
+// Rows of the output computed by each call to a micro kernel.
+constexpr int64 kKernelRows = 4;
+
+int64 RoundUp(int64 x, int64 multiple) {
+  return (x + multiple - 1) / multiple * multiple;
+}
+
+int64 DivUp(int64 x, int64 y) { return (x + y - 1) / y; }
+
+// Micro kernel converting its inputs to float and multiplying them with Eigen
+// packets, i.e. with the widest vector instructions of the target.
+struct VectorizedKernel {
+  using Scalar = float;
+  using Packet = Eigen::internal::packet_traits<float>::type;
+  static constexpr int64 kPacketSize =
+      Eigen::internal::packet_traits<float>::size;
+  // Columns of the output computed by each call.
+  static constexpr int64 kCols = 3 * kPacketSize;
+  // Values of the inner dimension consumed together.
+  static constexpr int64 kDepthStep = 1;
+
+  static float Convert(float x) { return x; }
+  static float Convert(bfloat16 x) { return static_cast<float>(x); }
+
+  // Adds the product of the kKernelRows x `depth` block of the left-hand
+  // side at `a` and the packed `depth` x kCols panel of the right-hand side
+  // at `b` to the output at `c`.
+  static void Run(const float* a, int64 lda, const float* b, int64 depth,
+                  float* c, int64 ldc) {
+    using Eigen::internal::pmadd;
+    using Eigen::internal::ploadu;
+    using Eigen::internal::pset1;
+    using Eigen::internal::pstoreu;
+    Packet c00 = ploadu<Packet>(c);
+    Packet c01 = ploadu<Packet>(c + kPacketSize);
+    Packet c02 = ploadu<Packet>(c + 2 * kPacketSize);
+    Packet c10 = ploadu<Packet>(c + ldc);
+    Packet c11 = ploadu<Packet>(c + ldc + kPacketSize);
+    Packet c12 = ploadu<Packet>(c + ldc + 2 * kPacketSize);
+    Packet c20 = ploadu<Packet>(c + 2 * ldc);
+    Packet c21 = ploadu<Packet>(c + 2 * ldc + kPacketSize);
+    Packet c22 = ploadu<Packet>(c + 2 * ldc + 2 * kPacketSize);
+    Packet c30 = ploadu<Packet>(c + 3 * ldc);
+    Packet c31 = ploadu<Packet>(c + 3 * ldc + kPacketSize);
+    Packet c32 = ploadu<Packet>(c + 3 * ldc + 2 * kPacketSize);
+    for (int64 i = 0; i < depth; ++i, b += kCols) {
+      const Packet b0 = ploadu<Packet>(b);
+      const Packet b1 = ploadu<Packet>(b + kPacketSize);
+      const Packet b2 = ploadu<Packet>(b + 2 * kPacketSize);
+      Packet a_i = pset1<Packet>(a[i]);
+      c00 = pmadd(a_i, b0, c00);
+      c01 = pmadd(a_i, b1, c01);
+      c02 = pmadd(a_i, b2, c02);
+      a_i = pset1<Packet>(a[lda + i]);
+      c10 = pmadd(a_i, b0, c10);
+      c11 = pmadd(a_i, b1, c11);
+      c12 = pmadd(a_i, b2, c12);
+      a_i = pset1<Packet>(a[2 * lda + i]);
+      c20 = pmadd(a_i, b0, c20);
+      c21 = pmadd(a_i, b1, c21);
+      c22 = pmadd(a_i, b2, c22);
+      a_i = pset1<Packet>(a[3 * lda + i]);
+      c30 = pmadd(a_i, b0, c30);
+      c31 = pmadd(a_i, b1, c31);
+      c32 = pmadd(a_i, b2, c32);
+    }
+    pstoreu(c, c00);
+    pstoreu(c + kPacketSize, c01);
+    pstoreu(c + 2 * kPacketSize, c02);
+    pstoreu(c + ldc, c10);
+    pstoreu(c + ldc + kPacketSize, c11);
+    pstoreu(c + ldc + 2 * kPacketSize, c12);
+    pstoreu(c + 2 * ldc, c20);
+    pstoreu(c + 2 * ldc + kPacketSize, c21);
+    pstoreu(c + 2 * ldc + 2 * kPacketSize, c22);
+    pstoreu(c + 3 * ldc, c30);
+    pstoreu(c + 3 * ldc + kPacketSize, c31);
+    pstoreu(c + 3 * ldc + 2 * kPacketSize, c32);
+  }
+};
+
+#ifdef TENSORFLOW_PACKED_MATMUL_AVX512_BF16
+
+// Micro kernel multiplying pairs of bfloat16 values along the inner
+// dimension with VDPBF16PS, which accumulates their products in float. The
+// right-hand side is packed with the values of each pair next to each other.
+struct Avx512Bf16Kernel {
+  using Scalar = bfloat16;
+  static constexpr int64 kCols = 48;
+  static constexpr int64 kDepthStep = 2;
+
+  static bfloat16 Convert(bfloat16 x) { return x; }
+
+  static void Run(const bfloat16* a, int64 lda, const bfloat16* b,
+                  int64 depth, float* c, int64 ldc);
+};
+
+__attribute__((target("avx512f,avx512bf16"))) inline __m512bh BroadcastPair(
+    const bfloat16* a) {
+  int32 pair;
+  std::memcpy(&pair, a, sizeof(pair));
+  return (__m512bh)_mm512_set1_epi32(pair);
+}
+
+__attribute__((target("avx512f,avx512bf16"))) void Avx512Bf16Kernel::Run(
+    const bfloat16* a, int64 lda, const bfloat16* b, int64 depth, float* c,
+    int64 ldc) {
+  __m512 c00 = _mm512_loadu_ps(c);
+  __m512 c01 = _mm512_loadu_ps(c + 16);
+  __m512 c02 = _mm512_loadu_ps(c + 32);
+  __m512 c10 = _mm512_loadu_ps(c + ldc);
+  __m512 c11 = _mm512_loadu_ps(c + ldc + 16);
+  __m512 c12 = _mm512_loadu_ps(c + ldc + 32);
+  __m512 c20 = _mm512_loadu_ps(c + 2 * ldc);
+  __m512 c21 = _mm512_loadu_ps(c + 2 * ldc + 16);
+  __m512 c22 = _mm512_loadu_ps(c + 2 * ldc + 32);
+  __m512 c30 = _mm512_loadu_ps(c + 3 * ldc);
+  __m512 c31 = _mm512_loadu_ps(c + 3 * ldc + 16);
+  __m512 c32 = _mm512_loadu_ps(c + 3 * ldc + 32);
+  for (int64 i = 0; i < depth; i += kDepthStep, b += kDepthStep * kCols) {
+    const __m512bh b0 = (__m512bh)_mm512_loadu_si512(b);
+    const __m512bh b1 = (__m512bh)_mm512_loadu_si512(b + 32);
+    const __m512bh b2 = (__m512bh)_mm512_loadu_si512(b + 64);
+    __m512bh a_i = BroadcastPair(a + i);
+    c00 = _mm512_dpbf16_ps(c00, a_i, b0);
+    c01 = _mm512_dpbf16_ps(c01, a_i, b1);
+    c02 = _mm512_dpbf16_ps(c02, a_i, b2);
+    a_i = BroadcastPair(a + lda + i);
+    c10 = _mm512_dpbf16_ps(c10, a_i, b0);
+    c11 = _mm512_dpbf16_ps(c11, a_i, b1);
+    c12 = _mm512_dpbf16_ps(c12, a_i, b2);
+    a_i = BroadcastPair(a + 2 * lda + i);
+    c20 = _mm512_dpbf16_ps(c20, a_i, b0);
+    c21 = _mm512_dpbf16_ps(c21, a_i, b1);
+    c22 = _mm512_dpbf16_ps(c22, a_i, b2);
+    a_i = BroadcastPair(a + 3 * lda + i);
+    c30 = _mm512_dpbf16_ps(c30, a_i, b0);
+    c31 = _mm512_dpbf16_ps(c31, a_i, b1);
+    c32 = _mm512_dpbf16_ps(c32, a_i, b2);
+  }
+  _mm512_storeu_ps(c, c00);
+  _mm512_storeu_ps(c + 16, c01);
+  _mm512_storeu_ps(c + 32, c02);
+  _mm512_storeu_ps(c + ldc, c10);
+  _mm512_storeu_ps(c + ldc + 16, c11);
+  _mm512_storeu_ps(c + ldc + 32, c12);
+  _mm512_storeu_ps(c + 2 * ldc, c20);
+  _mm512_storeu_ps(c + 2 * ldc + 16, c21);
+  _mm512_storeu_ps(c + 2 * ldc + 32, c22);
+  _mm512_storeu_ps(c + 3 * ldc, c30);
+  _mm512_storeu_ps(c + 3 * ldc + 16, c31);
+  _mm512_storeu_ps(c + 3 * ldc + 32, c32);
+}
+
+#endif  // TENSORFLOW_PACKED_MATMUL_AVX512_BF16
+
+// Converts columns [col, col + kCols) of op(b), a [k, n] matrix, to a panel
+// of `depth` rows padded with zeros. The values of each step along the inner
+// dimension are stored next to each other, column after column.
+template <typename Kernel, typename T>
+void PackRhsPanel(const T* b, int64 k, int64 n, bool transpose_b,
+                  int64 col, int64 depth, typename Kernel::Scalar* panel) {
+  using Scalar = typename Kernel::Scalar;
+  constexpr int64 kCols = Kernel::kCols;
+  constexpr int64 kDepthStep = Kernel::kDepthStep;
+  const int64 cols = std::min(kCols, n - col);
+  for (int64 s = 0; s < depth; ++s) {
+    Scalar* dst = panel + (s - s % kDepthStep) * kCols + s % kDepthStep;
+    int64 j = 0;
+    if (s < k) {
+      if (transpose_b) {
+        const T* src = b + col * k + s;
+        for (; j < cols; ++j) dst[j * kDepthStep] = Kernel::Convert(src[j * k]);
+      } else {
+        const T* src = b + s * n + col;
+        for (; j < cols; ++j) dst[j * kDepthStep] = Kernel::Convert(src[j]);
+      }
+    }
+    for (; j < kCols; ++j) dst[j * kDepthStep] = Scalar(0.0f);
+  }
+}
+
+// Converts rows [row, row + rows) and columns [i0, i0 + block_depth) of
+// op(a), a [m, k] matrix, to a row-major block with kBlockDepth columns,
+// padded with zeros to `padded_rows` x `padded_depth`.
+template <typename Kernel, typename T>
+void PackLhsBlock(const T* a, int64 m, int64 k, bool transpose_a,
+                  int64 row, int64 rows, int64 padded_rows, int64 i0,
+                  int64 block_depth, int64 padded_depth,
+                  typename Kernel::Scalar* block) {
+  using Scalar = typename Kernel::Scalar;
+  for (int64 r = 0; r < padded_rows; ++r) {
+    Scalar* dst = block + r * kBlockDepth;
+    int64 i = 0;
+    if (r < rows) {
+      if (transpose_a) {
+        const T* src = a + i0 * m + row + r;
+        for (; i < block_depth; ++i) dst[i] = Kernel::Convert(src[i * m]);
+      } else {
+        const T* src = a + (row + r) * k + i0;
+        for (; i < block_depth; ++i) dst[i] = Kernel::Convert(src[i]);
+      }
+    }
+    std::fill(dst + i, dst + padded_depth, Scalar(0.0f));
+  }
+}
+
+// Converts op(b), a [k, n] matrix, to panels of kCols columns.
+template <typename Kernel, typename T>
+void PackRhs(const DeviceBase::CpuWorkerThreads& worker_threads, const T* b,
+             int64 k, int64 n, bool transpose_b,
+             std::vector<typename Kernel::Scalar>* panels) {
+  constexpr int64 kCols = Kernel::kCols;
+  const int64 depth = RoundUp(k, Kernel::kDepthStep);
+  const int64 num_panels = DivUp(n, kCols);
+  panels->resize(num_panels * depth * kCols);
+  auto pack = [&](int64 begin, int64 end) {
+    for (int64 p = begin; p < end; ++p) {
+      PackRhsPanel<Kernel>(b, k, n, transpose_b, p * kCols, depth,
+                           panels->data() + p * depth * kCols);
+    }
+  };
+  Shard(worker_threads.num_threads, worker_threads.workers, num_panels,
+        depth * kCols, pack);
+}
+
+// Computes out = op(a) * op(b), where op(a) is [m, k] and op(b) is the
+// [k, n] matrix packed in `panels`.
+template <typename Kernel, typename T>
+void MultiplyPacked(const DeviceBase::CpuWorkerThreads& worker_threads,
+                    const T* a, int64 m, int64 k, int64 n, bool transpose_a,
+                    const typename Kernel::Scalar* panels, T* out,
+                    const std::function<void(int64, int64, int64, int64)>&
+                        tile_fn) {
+  using Scalar = typename Kernel::Scalar;
+  constexpr int64 kCols = Kernel::kCols;
+  constexpr int64 kDepthStep = Kernel::kDepthStep;
+  static_assert(kTileCols % kCols == 0, "Tiles must hold whole panels");
+  static_assert(kBlockDepth % kDepthStep == 0, "Blocks must hold whole steps");
+
+  const int64 depth = RoundUp(k, kDepthStep);
+  const int64 num_row_tiles = DivUp(m, kTileRows);
+  const int64 num_col_tiles = DivUp(n, kTileCols);
+  auto compute_tiles = [&](int64 begin, int64 end) {
+    std::vector<Scalar> a_block(kTileRows * kBlockDepth);
+    std::vector<float> c_tile(kTileRows * kTileCols);
+    for (int64 t = begin; t < end; ++t) {
+      const int64 row = (t / num_col_tiles) * kTileRows;
+      const int64 col = (t % num_col_tiles) * kTileCols;
+      const int64 rows = std::min(kTileRows, m - row);
+      const int64 cols = std::min(kTileCols, n - col);
+      const int64 padded_rows = RoundUp(rows, kKernelRows);
+      const int64 tile_panels = DivUp(cols, kCols);
+      std::fill(c_tile.begin(), c_tile.end(), 0.0f);
+
+      for (int64 i0 = 0; i0 < k; i0 += kBlockDepth) {
+        const int64 block_depth = std::min(kBlockDepth, k - i0);
+        const int64 padded_depth = RoundUp(block_depth, kDepthStep);
+        PackLhsBlock<Kernel>(a, m, k, transpose_a, row, rows, padded_rows, i0,
+                             block_depth, padded_depth, a_block.data());
+        for (int64 p = 0; p < tile_panels; ++p) {
+          const Scalar* panel =
+              panels + (col / kCols + p) * depth * kCols + i0 * kCols;
+          for (int64 r = 0; r < padded_rows; r += kKernelRows) {
+            Kernel::Run(a_block.data() + r * kBlockDepth, kBlockDepth, panel,
+                        padded_depth, c_tile.data() + r * kTileCols + p * kCols,
+                        kTileCols);
+          }
+        }
+      }
+
+      for (int64 r = 0; r < rows; ++r) {
+        const float* src = c_tile.data() + r * kTileCols;
+        T* dst = out + (row + r) * n + col;
+        for (int64 j = 0; j < cols; ++j) {
+          dst[j] = static_cast<T>(src[j]);
+        }
+      }
+      if (tile_fn) tile_fn(row, col, rows, cols);
+    }
+  };
+  Shard(worker_threads.num_threads, worker_threads.workers,
+        num_row_tiles * num_col_tiles, 2 * kTileRows * kTileCols * k,
+        compute_tiles);
+}
+
+// Float inputs are always multiplied in float.
+bool UseAvx512Bf16(PackedMatMulKernel kernel, const float*) { return false; }
+
+bool UseAvx512Bf16(PackedMatMulKernel kernel, const bfloat16*) {
+  return kernel != PackedMatMulKernel::kVectorized &&
+         HasAvx512Bf16MatMulKernel();
+}
+
+void PackRhsForKernel(const DeviceBase::CpuWorkerThreads& worker_threads,
+                      const float* b, int64 k, int64 n, bool transpose_b,
+                      bool use_avx512_bf16, std::vector<float>* float_panels,
+                      std::vector<bfloat16>* bfloat16_panels) {
+  PackRhs<VectorizedKernel>(worker_threads, b, k, n, transpose_b,
+                            float_panels);
+}
+
+void PackRhsForKernel(const DeviceBase::CpuWorkerThreads& worker_threads,
+                      const bfloat16* b, int64 k, int64 n, bool transpose_b,
+                      bool use_avx512_bf16, std::vector<float>* float_panels,
+                      std::vector<bfloat16>* bfloat16_panels) {
+#ifdef TENSORFLOW_PACKED_MATMUL_AVX512_BF16
+  if (use_avx512_bf16) {
+    PackRhs<Avx512Bf16Kernel>(worker_threads, b, k, n, transpose_b,
+                              bfloat16_panels);
+    return;
+  }
+#endif
+  PackRhs<VectorizedKernel>(worker_threads, b, k, n, transpose_b,
+                            float_panels);
+}
+
+void MultiplyForKernel(const DeviceBase::CpuWorkerThreads& worker_threads,
+                       const float* a, int64 m, int64 k, int64 n,
+                       bool transpose_a, bool use_avx512_bf16,
+                       const std::vector<float>& float_panels,
+                       const std::vector<bfloat16>& bfloat16_panels,
+                       float* out,
+                       const PackedMatMulRhs<float>::TileFn& tile_fn) {
+  MultiplyPacked<VectorizedKernel>(worker_threads, a, m, k, n, transpose_a,
+                                   float_panels.data(), out, tile_fn);
+}
+
+void MultiplyForKernel(const DeviceBase::CpuWorkerThreads& worker_threads,
+                       const bfloat16* a, int64 m, int64 k, int64 n,
+                       bool transpose_a, bool use_avx512_bf16,
+                       const std::vector<float>& float_panels,
+                       const std::vector<bfloat16>& bfloat16_panels,
+                       bfloat16* out,
+                       const PackedMatMulRhs<bfloat16>::TileFn& tile_fn) {
+#ifdef TENSORFLOW_PACKED_MATMUL_AVX512_BF16
+  if (use_avx512_bf16) {
+    MultiplyPacked<Avx512Bf16Kernel>(worker_threads, a, m, k, n, transpose_a,
+                                     bfloat16_panels.data(), out, tile_fn);
+    return;
+  }
+#endif
+  MultiplyPacked<VectorizedKernel>(worker_threads, a, m, k, n, transpose_a,
+                                   float_panels.data(), out, tile_fn);
+}
+
+}  // namespace
+
+bool HasAvx512Bf16MatMulKernel() {
+#ifdef TENSORFLOW_PACKED_MATMUL_AVX512_BF16
+  static const bool has_kernel =
+      port::TestCPUFeature(port::CPUFeature::AVX512_BF16);
+  return has_kernel;
+#else
+  return false;
+#endif
+}
+
+bool CachePackedBFloat16MatMulRhs() {
+  static const bool is_enabled = [] {
+    bool is_enabled = false;
+    TF_CHECK_OK(ReadBoolFromEnvVar("TF_CACHE_PACKED_BFLOAT16_MATMUL_RHS",
+                                   /*default_val=*/false, &is_enabled));
+    return is_enabled;
+  }();
+  return is_enabled;
+}
+
+template <typename T>
+PackedMatMulRhs<T>::PackedMatMulRhs(
+    const DeviceBase::CpuWorkerThreads& worker_threads, const T* b, int64 k,
+    int64 n, bool transpose_b, PackedMatMulKernel kernel)
+    : k_(k), n_(n), use_avx512_bf16_(UseAvx512Bf16(kernel, b)) {
+  PackRhsForKernel(worker_threads, b, k, n, transpose_b, use_avx512_bf16_,
+                   &float_panels_, &bfloat16_panels_);
+}
+
+template <typename T>
+void PackedMatMulRhs<T>::Multiply(
+    const DeviceBase::CpuWorkerThreads& worker_threads, const T* a, int64 m,
+    bool transpose_a, T* out, const TileFn& tile_fn) const {
+  MultiplyForKernel(worker_threads, a, m, k_, n_, transpose_a,
+                    use_avx512_bf16_, float_panels_, bfloat16_panels_, out,
+                    tile_fn);
+}
+
+template class PackedMatMulRhs<float>;
+template class PackedMatMulRhs<bfloat16>;
+
+void BFloat16MatMul(const DeviceBase::CpuWorkerThreads& worker_threads,
+                    const bfloat16* a, const bfloat16* b, int64 m, int64 k,
+                    int64 n, bool transpose_a, bool transpose_b,
+                    bfloat16* out, PackedMatMulKernel kernel) {
+  PackedMatMulRhs<bfloat16>(worker_threads, b, k, n, transpose_b, kernel)
+      .Multiply(worker_threads, a, m, transpose_a, out);
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,172 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_PACKED_MATMUL_H_
+#define TENSORFLOW_CORE_KERNELS_PACKED_MATMUL_H_
+
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "tensorflow/core/framework/bfloat16.h"
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Inner loops of the matrix multiplications below.
+enum class PackedMatMulKernel {
+  // The fastest kernel supported by the CPU for the type of the inputs.
+  kDefault,
+  // Converts blocks of the inputs to float and multiplies them with Eigen
+  // packet instructions of the target architecture.
+  kVectorized,
+  // Multiplies bfloat16 inputs directly with the dot product instruction of
+  // AVX-512 BF16 (VDPBF16PS). Falls back to kVectorized for float inputs, or
+  // unless `HasAvx512Bf16MatMulKernel()`.
+  kAvx512Bf16,
+};
+
+// Returns true if the kAvx512Bf16 kernel was compiled in and the CPU
+// supports it.
+bool HasAvx512Bf16MatMulKernel();
+
+// Types of the inputs and outputs of `PackedMatMulRhs`.
+template <typename T>
+struct IsPackedMatMulType
+    : std::integral_constant<bool, std::is_same<T, float>::value ||
+                                       std::is_same<T, bfloat16>::value> {};
+
+// The right-hand side of a matrix multiplication, converted once into the
+// panels read by the inner loops. Eigen contractions pack both sides on every
+// call, which dominates the time of multiplications with few rows; packing
+// constant weights once lets them be multiplied by many left-hand sides.
+template <typename T>
+class PackedMatMulRhs {
+ public:
+  // Called on each tile [row, row + rows) x [col, col + cols) of the output
+  // as soon as it is written, e.g. to add a bias while the tile is cached.
+  using TileFn =
+      std::function<void(int64 row, int64 col, int64 rows, int64 cols)>;
+
+  // Packs op(b), where op(x) is x or its transpose, b is a row-major matrix
+  // and op(b) is [k, n]. Runs in parallel on `worker_threads`.
+  PackedMatMulRhs(const DeviceBase::CpuWorkerThreads& worker_threads,
+                  const T* b, int64 k, int64 n, bool transpose_b,
+                  PackedMatMulKernel kernel = PackedMatMulKernel::kDefault);
+
+  int64 k() const { return k_; }
+  int64 n() const { return n_; }
+
+  // Computes out = op(a) * op(b), where op(a) is [m, k] and out is a [m, n]
+  // row-major matrix. Products are accumulated in float and rounded to T
+  // once. Runs in parallel on `worker_threads`, and may be called
+  // concurrently.
+  void Multiply(const DeviceBase::CpuWorkerThreads& worker_threads,
+                const T* a, int64 m, bool transpose_a, T* out,
+                const TileFn& tile_fn = nullptr) const;
+
+ private:
+  const int64 k_;
+  const int64 n_;
+  const bool use_avx512_bf16_;
+  // Panels of the kVectorized and of the kAvx512Bf16 kernels, respectively.
+  std::vector<float> float_panels_;
+  std::vector<bfloat16> bfloat16_panels_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PackedMatMulRhs);
+};
+
+// Caches the packing of the right-hand side of a kernel whose right-hand side
+// is constant, e.g. the weights of a MatMul read from a Const node.
+template <typename T>
+class PackedMatMulRhsCache {
+ public:
+  PackedMatMulRhsCache() {}
+
+  // Returns the packing of op(b), reusing the previous one if `b` is a view of
+  // the same buffer with the same data, type and shape. The cache holds a
+  // reference to the buffer, so that it can't be reused by another tensor in
+  // the meantime, and drops it once that reference is the last one.
+  std::shared_ptr<const PackedMatMulRhs<T>> Get(
+      const DeviceBase::CpuWorkerThreads& worker_threads, const Tensor& b,
+      bool transpose_b) TF_LOCKS_EXCLUDED(mu_) {
+    mutex_lock l(mu_);
+    if (tensor_.IsInitialized() && tensor_.RefCountIsOne()) {
+      tensor_ = Tensor();
+      packed_.reset();
+    }
+    if (packed_ == nullptr || transpose_b != transpose_b_ ||
+        !b.SharesBufferWith(tensor_) ||
+        b.tensor_data().data() != tensor_.tensor_data().data() ||
+        b.dtype() != tensor_.dtype() || b.shape() != tensor_.shape()) {
+      tensor_ = b;
+      transpose_b_ = transpose_b;
+      const int64 k = b.dim_size(transpose_b ? 1 : 0);
+      const int64 n = b.dim_size(transpose_b ? 0 : 1);
+      packed_ = std::make_shared<const PackedMatMulRhs<T>>(
+          worker_threads, b.flat<T>().data(), k, n, transpose_b);
+    }
+    return packed_;
+  }
+
+ private:
+  mutex mu_;
+  Tensor tensor_ TF_GUARDED_BY(mu_);
+  bool transpose_b_ TF_GUARDED_BY(mu_) = false;
+  std::shared_ptr<const PackedMatMulRhs<T>> packed_ TF_GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PackedMatMulRhsCache);
+};
+
+// Returns true if TF_CACHE_PACKED_BFLOAT16_MATMUL_RHS is set. The packing of
+// bfloat16 weights may take twice their memory, so kernels only keep packed
+// copies of them on request.
+bool CachePackedBFloat16MatMulRhs();
+
+// Returns true if kernels may keep a `PackedMatMulRhsCache` for type T.
+template <typename T>
+bool CachePackedMatMulRhs() {
+  static_assert(IsPackedMatMulType<T>::value, "Unsupported type");
+  return !std::is_same<T, bfloat16>::value || CachePackedBFloat16MatMulRhs();
+}
+
+// Returns true if a cached `PackedMatMulRhs` multiplies a [m, k] matrix into
+// a [m, n] output faster than an Eigen contraction, which packs its
+// right-hand side again on every call. Eigen is as fast on float outputs with
+// many rows, which amortize the packing, and on matrix-vector products.
+template <typename T>
+bool PreferPackedMatMulRhs(int64 m, int64 n) {
+  static_assert(IsPackedMatMulType<T>::value, "Unsupported type");
+  if (std::is_same<T, bfloat16>::value) return true;
+  return m > 1 && m <= 64 && n > 1;
+}
+
+// Computes out = op(a) * op(b) on bfloat16 matrices, as above, without
+// converting the whole inputs and output to float tensors first.
+void BFloat16MatMul(
+    const DeviceBase::CpuWorkerThreads& worker_threads, const bfloat16* a,
+    const bfloat16* b, int64 m, int64 k, int64 n, bool transpose_a,
+    bool transpose_b, bfloat16* out,
+    PackedMatMulKernel kernel = PackedMatMulKernel::kDefault);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_PACKED_MATMUL_H_
@@ -0,0 +1,288 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/packed_matmul.h"
+
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+template <typename T>
+std::vector<T> RandomMatrix(int64 rows, int64 cols, uint64 seed) {
+  random::PhiloxRandom philox(seed, rows * cols);
+  random::SimplePhilox rnd(&philox);
+  std::vector<T> matrix(rows * cols);
+  for (T& x : matrix) x = T(rnd.RandFloat() * 2.0f - 1.0f);
+  return matrix;
+}
+
+// Returns op(a) * op(b) computed in double.
+template <typename T>
+std::vector<double> ReferenceMatMul(const std::vector<T>& a,
+                                    const std::vector<T>& b, int64 m, int64 k,
+                                    int64 n, bool transpose_a,
+                                    bool transpose_b) {
+  std::vector<double> out(m * n);
+  for (int64 i = 0; i < m; ++i) {
+    for (int64 j = 0; j < n; ++j) {
+      double sum = 0.0;
+      for (int64 l = 0; l < k; ++l) {
+        const float a_il =
+            static_cast<float>(transpose_a ? a[l * m + i] : a[i * k + l]);
+        const float b_lj =
+            static_cast<float>(transpose_b ? b[j * k + l] : b[l * n + j]);
+        sum += static_cast<double>(a_il) * b_lj;
+      }
+      out[i * n + j] = sum;
+    }
+  }
+  return out;
+}
+
+class PackedMatMulTest : public ::testing::Test {
+ protected:
+  PackedMatMulTest() : pool_(Env::Default(), "packed_matmul_test", 4) {
+    worker_threads_.num_threads = 4;
+    worker_threads_.workers = &pool_;
+  }
+
+  thread::ThreadPool pool_;
+  DeviceBase::CpuWorkerThreads worker_threads_;
+};
+
+class BFloat16MatMulTest
+    : public PackedMatMulTest,
+      public ::testing::WithParamInterface<PackedMatMulKernel> {
+ protected:
+  // Checks op(a) * op(b) against a reference computed in double.
+  void CheckMatMul(int64 m, int64 k, int64 n, bool transpose_a,
+                   bool transpose_b) {
+    const std::vector<bfloat16> a = RandomMatrix<bfloat16>(m, k, 1);
+    const std::vector<bfloat16> b = RandomMatrix<bfloat16>(k, n, 2);
+    std::vector<bfloat16> out(m * n);
+    BFloat16MatMul(worker_threads_, a.data(), b.data(), m, k, n, transpose_a,
+                   transpose_b, out.data(), GetParam());
+    const std::vector<double> expected =
+        ReferenceMatMul(a, b, m, k, n, transpose_a, transpose_b);
+    for (int64 i = 0; i < m * n; ++i) {
+      // The output is rounded to 8 bits of mantissa.
+      ASSERT_NEAR(expected[i], static_cast<float>(out[i]),
+                  1e-2 * (1.0 + std::abs(expected[i])))
+          << "m=" << m << " k=" << k << " n=" << n << " i=" << i;
+    }
+  }
+};
+
+TEST_P(BFloat16MatMulTest, SmallShapes) {
+  for (bool transpose_a : {false, true}) {
+    for (bool transpose_b : {false, true}) {
+      CheckMatMul(1, 1, 1, transpose_a, transpose_b);
+      CheckMatMul(3, 5, 7, transpose_a, transpose_b);
+      CheckMatMul(1, 100, 70, transpose_a, transpose_b);
+      CheckMatMul(9, 3, 1, transpose_a, transpose_b);
+    }
+  }
+}
+
+TEST_P(BFloat16MatMulTest, PartialTilesAndBlocks) {
+  for (bool transpose_a : {false, true}) {
+    for (bool transpose_b : {false, true}) {
+      CheckMatMul(64, 256, 384, transpose_a, transpose_b);
+      CheckMatMul(67, 257, 33, transpose_a, transpose_b);
+      CheckMatMul(130, 513, 400, transpose_a, transpose_b);
+    }
+  }
+}
+
+TEST_P(BFloat16MatMulTest, EmptyInnerDimension) {
+  std::vector<bfloat16> out(6, bfloat16(1.0f));
+  BFloat16MatMul(worker_threads_, nullptr, nullptr, 2, 0, 3, false, false,
+                 out.data(), GetParam());
+  for (const bfloat16& x : out) EXPECT_EQ(0.0f, static_cast<float>(x));
+}
+
+INSTANTIATE_TEST_SUITE_P(Kernels, BFloat16MatMulTest,
+                         ::testing::Values(PackedMatMulKernel::kVectorized,
+                                           PackedMatMulKernel::kAvx512Bf16));
+
+TEST_F(PackedMatMulTest, FloatRhsIsReused) {
+  for (bool transpose_a : {false, true}) {
+    for (bool transpose_b : {false, true}) {
+      const int64 m = 67, k = 257, n = 400;
+      const std::vector<float> b = RandomMatrix<float>(k, n, 1);
+      const PackedMatMulRhs<float> packed_rhs(worker_threads_, b.data(), k, n,
+                                              transpose_b);
+      EXPECT_EQ(k, packed_rhs.k());
+      EXPECT_EQ(n, packed_rhs.n());
+      for (uint64 seed : {2, 3}) {
+        const std::vector<float> a = RandomMatrix<float>(m, k, seed);
+        std::vector<float> out(m * n);
+        packed_rhs.Multiply(worker_threads_, a.data(), m, transpose_a,
+                            out.data());
+        const std::vector<double> expected =
+            ReferenceMatMul(a, b, m, k, n, transpose_a, transpose_b);
+        for (int64 i = 0; i < m * n; ++i) {
+          ASSERT_NEAR(expected[i], out[i], 1e-4 * (1.0 + std::abs(expected[i])))
+              << "i=" << i;
+        }
+      }
+    }
+  }
+}
+
+TEST_F(PackedMatMulTest, TileFnSeesEachOutputOnce) {
+  const int64 m = 130, k = 33, n = 400;
+  const std::vector<float> a = RandomMatrix<float>(m, k, 1);
+  const std::vector<float> b = RandomMatrix<float>(k, n, 2);
+  const PackedMatMulRhs<float> packed_rhs(worker_threads_, b.data(), k, n,
+                                          /*transpose_b=*/false);
+  std::vector<float> out(m * n);
+  std::vector<int> visits(m * n);
+  packed_rhs.Multiply(worker_threads_, a.data(), m, /*transpose_a=*/false,
+                      out.data(),
+                      [&](int64 row, int64 col, int64 rows, int64 cols) {
+                        for (int64 i = row; i < row + rows; ++i) {
+                          for (int64 j = col; j < col + cols; ++j) {
+                            visits[i * n + j]++;
+                            out[i * n + j] += 1.0f;
+                          }
+                        }
+                      });
+  const std::vector<double> expected =
+      ReferenceMatMul(a, b, m, k, n, false, false);
+  for (int64 i = 0; i < m * n; ++i) {
+    ASSERT_EQ(1, visits[i]) << "i=" << i;
+    ASSERT_NEAR(expected[i] + 1.0, out[i], 1e-4 * (2.0 + std::abs(expected[i])))
+        << "i=" << i;
+  }
+}
+
+TEST_F(PackedMatMulTest, CacheRepacksNewTensors) {
+  const int64 m = 5, k = 7, n = 9;
+  Tensor a(DT_FLOAT, TensorShape({m, k}));
+  Tensor b(DT_FLOAT, TensorShape({k, n}));
+  Tensor other_b(DT_FLOAT, TensorShape({k, n}));
+  a.flat<float>().setRandom();
+  b.flat<float>().setRandom();
+  other_b.flat<float>().setConstant(1.0f);
+
+  PackedMatMulRhsCache<float> cache;
+  const auto packed_b = cache.Get(worker_threads_, b, /*transpose_b=*/false);
+  EXPECT_EQ(packed_b, cache.Get(worker_threads_, b, /*transpose_b=*/false));
+  Tensor b_view;
+  ASSERT_TRUE(b_view.CopyFrom(b, b.shape()));
+  EXPECT_EQ(packed_b,
+            cache.Get(worker_threads_, b_view, /*transpose_b=*/false));
+
+  // The same buffer is packed again when it is read differently.
+  const auto packed_b_transpose =
+      cache.Get(worker_threads_, b, /*transpose_b=*/true);
+  EXPECT_NE(packed_b, packed_b_transpose);
+  EXPECT_EQ(n, packed_b_transpose->k());
+  const auto packed_b_slice = cache.Get(
+      worker_threads_, b.Slice(1, k), /*transpose_b=*/false);
+  EXPECT_EQ(k - 1, packed_b_slice->k());
+
+  const auto packed_other_b =
+      cache.Get(worker_threads_, other_b, /*transpose_b=*/false);
+  EXPECT_NE(packed_b, packed_other_b);
+
+  // Each output is the sum of a row of `a`.
+  Tensor out(DT_FLOAT, TensorShape({m, n}));
+  packed_other_b->Multiply(worker_threads_, a.flat<float>().data(), m,
+                           /*transpose_a=*/false, out.flat<float>().data());
+  for (int64 i = 0; i < m; ++i) {
+    float sum = 0.0f;
+    for (int64 l = 0; l < k; ++l) sum += a.matrix<float>()(i, l);
+    for (int64 j = 0; j < n; ++j) {
+      EXPECT_NEAR(sum, out.matrix<float>()(i, j), 1e-5);
+    }
+  }
+}
+
+static void BFloat16MatMulBenchmark(int iters, int m, int k, int n,
+                                    PackedMatMulKernel kernel) {
+  testing::StopTiming();
+  thread::ThreadPool pool(Env::Default(), "bm_bfloat16_matmul", 8);
+  DeviceBase::CpuWorkerThreads worker_threads;
+  worker_threads.num_threads = 8;
+  worker_threads.workers = &pool;
+  const std::vector<bfloat16> a = RandomMatrix<bfloat16>(m, k, 1);
+  const std::vector<bfloat16> b = RandomMatrix<bfloat16>(k, n, 2);
+  std::vector<bfloat16> out(m * n);
+  testing::ItemsProcessed(static_cast<int64>(iters) * m * k * n * 2);
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    BFloat16MatMul(worker_threads, a.data(), b.data(), m, k, n, false, false,
+                   out.data(), kernel);
+  }
+}
+
+#define BM_BFloat16MatMul(M, K, N, KERNEL)                               \
+  static void BM_BFloat16MatMul_##M##_##K##_##N##_##KERNEL(int iters) {  \
+    BFloat16MatMulBenchmark(iters, M, K, N, PackedMatMulKernel::KERNEL); \
+  }                                                                      \
+  BENCHMARK(BM_BFloat16MatMul_##M##_##K##_##N##_##KERNEL)
+
+#define BM_BFloat16MatMulKernels(M, K, N)  \
+  BM_BFloat16MatMul(M, K, N, kVectorized); \
+  BM_BFloat16MatMul(M, K, N, kAvx512Bf16)
+
+BM_BFloat16MatMulKernels(1, 1024, 1024);
+BM_BFloat16MatMulKernels(16, 1024, 1024);
+BM_BFloat16MatMulKernels(128, 1024, 1024);
+BM_BFloat16MatMulKernels(512, 512, 512);
+BM_BFloat16MatMulKernels(1024, 1024, 1024);
+BM_BFloat16MatMulKernels(4096, 4096, 4096);
+
+// Multiplies by a float right-hand side packed before the timing starts, as
+// for the constant weights of MatMul and _FusedMatMul.
+static void BM_PackedFloatMatMul(int iters, int m, int k) {
+  testing::StopTiming();
+  const int n = k;
+  thread::ThreadPool pool(Env::Default(), "bm_packed_matmul", 8);
+  DeviceBase::CpuWorkerThreads worker_threads;
+  worker_threads.num_threads = 8;
+  worker_threads.workers = &pool;
+  const std::vector<float> a = RandomMatrix<float>(m, k, 1);
+  const std::vector<float> b = RandomMatrix<float>(k, n, 2);
+  const PackedMatMulRhs<float> packed_rhs(worker_threads, b.data(), k, n,
+                                          /*transpose_b=*/false);
+  std::vector<float> out(m * n);
+  testing::ItemsProcessed(static_cast<int64>(iters) * m * k * n * 2);
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    packed_rhs.Multiply(worker_threads, a.data(), m, /*transpose_a=*/false,
+                        out.data());
+  }
+}
+
+BENCHMARK(BM_PackedFloatMatMul)
+    ->ArgPair(8, 1024)
+    ->ArgPair(16, 1024)
+    ->ArgPair(64, 1024)
+    ->ArgPair(16, 4096);
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,265 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_RADIX_SORT_H_
+#define TENSORFLOW_CORE_KERNELS_RADIX_SORT_H_
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+// Whether `RadixSortKeys` and `RadixSortPairs` accept keys of type `T`.
+template <typename T>
+struct IsRadixSortKey
+    : std::integral_constant<bool, std::is_integral<T>::value &&
+                                       !std::is_same<T, bool>::value> {};
+
+namespace radix_sort_internal {
+
+// Each pass sorts by one digit of this many bits.
+constexpr int kDigitBits = 8;
+constexpr int kNumBuckets = 1 << kDigitBits;
+
+// Inputs are split into shards of at least this many elements.
+constexpr int64 kMinShardSize = 1 << 15;
+
+// Below this size, `SortAndUnique` uses std::sort.
+constexpr int64 kMinRadixSortSize = 1 << 11;
+
+// Keys are sorted as unsigned integers of the same width, with the sign bit
+// of signed keys flipped so that negative keys come first.
+template <typename K>
+typename std::make_unsigned<K>::type SignBit() {
+  using U = typename std::make_unsigned<K>::type;
+  return std::is_signed<K>::value ? static_cast<U>(U{1} << (8 * sizeof(U) - 1))
+                                  : U{0};
+}
+
+// Calls `fn` on subranges covering [0, total), in parallel when
+// `worker_threads` is not null.
+inline void ParallelFor(const DeviceBase::CpuWorkerThreads* worker_threads,
+                        int64 total, int64 cost_per_unit,
+                        const std::function<void(int64, int64)>& fn) {
+  if (worker_threads == nullptr || total <= 1) {
+    fn(0, total);
+  } else {
+    Shard(worker_threads->num_threads, worker_threads->workers, total,
+          cost_per_unit, fn);
+  }
+}
+
+// Least significant digit first radix sort of `keys[0, n)`, which moves
+// `values[0, n)` along unless `values` is null. Every pass is stable: each
+// shard counts its digits, and then scatters its elements to the positions
+// following those of the preceding shards in the same bucket. Passes over
+// digits that all keys share are skipped.
+template <typename U, typename V>
+void SortUnsigned(const DeviceBase::CpuWorkerThreads* worker_threads, int64 n,
+                  std::vector<U>* keys, std::vector<V>* values) {
+  int64 num_shards = 1;
+  if (worker_threads != nullptr) {
+    num_shards = std::max<int64>(
+        1, std::min<int64>(worker_threads->num_threads, n / kMinShardSize));
+  }
+  const int64 shard_size = (n + num_shards - 1) / num_shards;
+  const int64 cost_per_shard = 4 * shard_size;
+
+  std::vector<U> key_scratch(n);
+  std::vector<V> value_scratch(values != nullptr ? n : 0);
+  U* src_keys = keys->data();
+  U* dst_keys = key_scratch.data();
+  V* src_values = values != nullptr ? values->data() : nullptr;
+  V* dst_values = value_scratch.data();
+  // Offsets for the digits of shard `s` start at `s * kNumBuckets`.
+  std::vector<int64> offsets(num_shards * kNumBuckets);
+
+  for (int shift = 0; shift < 8 * static_cast<int>(sizeof(U));
+       shift += kDigitBits) {
+    ParallelFor(worker_threads, num_shards, cost_per_shard,
+                [&](int64 start_shard, int64 limit_shard) {
+                  for (int64 s = start_shard; s < limit_shard; ++s) {
+                    int64* counts = &offsets[s * kNumBuckets];
+                    std::fill(counts, counts + kNumBuckets, 0);
+                    const int64 limit = std::min(n, (s + 1) * shard_size);
+                    for (int64 i = s * shard_size; i < limit; ++i) {
+                      ++counts[(src_keys[i] >> shift) & (kNumBuckets - 1)];
+                    }
+                  }
+                });
+
+    bool all_in_one_bucket = false;
+    int64 offset = 0;
+    for (int b = 0; b < kNumBuckets; ++b) {
+      const int64 bucket_start = offset;
+      for (int64 s = 0; s < num_shards; ++s) {
+        const int64 count = offsets[s * kNumBuckets + b];
+        offsets[s * kNumBuckets + b] = offset;
+        offset += count;
+      }
+      if (offset - bucket_start == n) all_in_one_bucket = true;
+    }
+    if (all_in_one_bucket) continue;
+
+    ParallelFor(worker_threads, num_shards, cost_per_shard,
+                [&](int64 start_shard, int64 limit_shard) {
+                  for (int64 s = start_shard; s < limit_shard; ++s) {
+                    int64* next = &offsets[s * kNumBuckets];
+                    const int64 limit = std::min(n, (s + 1) * shard_size);
+                    for (int64 i = s * shard_size; i < limit; ++i) {
+                      const int64 pos =
+                          next[(src_keys[i] >> shift) & (kNumBuckets - 1)]++;
+                      dst_keys[pos] = src_keys[i];
+                      if (src_values != nullptr) {
+                        dst_values[pos] = std::move(src_values[i]);
+                      }
+                    }
+                  }
+                });
+    std::swap(src_keys, dst_keys);
+    std::swap(src_values, dst_values);
+  }
+
+  if (src_keys != keys->data()) {
+    keys->swap(key_scratch);
+    if (values != nullptr) values->swap(value_scratch);
+  }
+}
+
+template <typename K, typename V>
+void RadixSort(const DeviceBase::CpuWorkerThreads* worker_threads,
+               std::vector<K>* keys, std::vector<V>* values) {
+  static_assert(IsRadixSortKey<K>::value, "Keys must be integers.");
+  using U = typename std::make_unsigned<K>::type;
+  const int64 n = keys->size();
+  if (n <= 1) return;
+  const int64 cost_per_element = 2;
+  const U sign_bit = SignBit<K>();
+
+  std::vector<U> unsigned_keys(n);
+  ParallelFor(worker_threads, n, cost_per_element,
+              [&](int64 start, int64 limit) {
+                for (int64 i = start; i < limit; ++i) {
+                  unsigned_keys[i] = static_cast<U>((*keys)[i]) ^ sign_bit;
+                }
+              });
+  SortUnsigned(worker_threads, n, &unsigned_keys, values);
+  ParallelFor(worker_threads, n, cost_per_element,
+              [&](int64 start, int64 limit) {
+                for (int64 i = start; i < limit; ++i) {
+                  (*keys)[i] = static_cast<K>(unsigned_keys[i] ^ sign_bit);
+                }
+              });
+}
+
+template <typename T>
+void Sort(std::vector<T>* keys, std::false_type) {
+  std::sort(keys->begin(), keys->end());
+}
+
+template <typename T>
+void Sort(std::vector<T>* keys, std::true_type) {
+  if (static_cast<int64>(keys->size()) < kMinRadixSortSize) {
+    std::sort(keys->begin(), keys->end());
+  } else {
+    RadixSort<T, char>(nullptr, keys, nullptr);
+  }
+}
+
+}  // namespace radix_sort_internal
+
+// Sorts the integers `keys` in ascending order. Runs on `worker_threads` if
+// it is not null and there are enough keys to split.
+template <typename K>
+void RadixSortKeys(const DeviceBase::CpuWorkerThreads* worker_threads,
+                   std::vector<K>* keys) {
+  radix_sort_internal::RadixSort<K, char>(worker_threads, keys, nullptr);
+}
+
+// Sorts the integers `keys` in ascending order, and permutes `values` in the
+// same way. The sort is stable: the values of equal keys keep their order.
+template <typename K, typename V>
+void RadixSortPairs(const DeviceBase::CpuWorkerThreads* worker_threads,
+                    std::vector<K>* keys, std::vector<V>* values) {
+  DCHECK_EQ(keys->size(), values->size());
+  radix_sort_internal::RadixSort(worker_threads, keys, values);
+}
+
+// Sorts `keys` and removes the duplicates. Large vectors of integers are
+// radix sorted, anything else goes through std::sort.
+template <typename T>
+void SortAndUnique(std::vector<T>* keys) {
+  radix_sort_internal::Sort(keys, IsRadixSortKey<T>());
+  keys->erase(std::unique(keys->begin(), keys->end()), keys->end());
+}
+
+// Computes the unique elements of the integers `keys[0, n)` in `uniques`, in
+// order of first occurrence, and sets `idx[i]` to the position of `keys[i]`
+// in `uniques`. This sorts the keys along with their positions, so that the
+// first position of each run of equal keys is the first occurrence of that
+// key, and then sorts the runs by first occurrence.
+template <typename K, typename TIndex>
+void RadixUnique(const DeviceBase::CpuWorkerThreads* worker_threads,
+                 const K* keys, int64 n, std::vector<K>* uniques,
+                 TIndex* idx) {
+  std::vector<K> sorted_keys(keys, keys + n);
+  std::vector<int64> positions(n);
+  std::iota(positions.begin(), positions.end(), 0);
+  RadixSortPairs(worker_threads, &sorted_keys, &positions);
+
+  std::vector<int64> run_starts;
+  for (int64 i = 0; i < n; ++i) {
+    if (i == 0 || sorted_keys[i] != sorted_keys[i - 1]) {
+      run_starts.push_back(i);
+    }
+  }
+  const int64 num_runs = run_starts.size();
+  run_starts.push_back(n);
+
+  // `runs` ends up listing the runs in order of first occurrence.
+  std::vector<int64> first_positions(num_runs);
+  std::vector<int64> runs(num_runs);
+  for (int64 r = 0; r < num_runs; ++r) {
+    first_positions[r] = positions[run_starts[r]];
+    runs[r] = r;
+  }
+  RadixSortPairs(worker_threads, &first_positions, &runs);
+
+  uniques->resize(num_runs);
+  radix_sort_internal::ParallelFor(
+      worker_threads, num_runs, 2 * n / std::max<int64>(num_runs, 1) + 2,
+      [&](int64 start, int64 limit) {
+        for (int64 u = start; u < limit; ++u) {
+          const int64 r = runs[u];
+          (*uniques)[u] = sorted_keys[run_starts[r]];
+          for (int64 i = run_starts[r]; i < run_starts[r + 1]; ++i) {
+            idx[positions[i]] = static_cast<TIndex>(u);
+          }
+        }
+      });
+}
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_RADIX_SORT_H_
@@ -0,0 +1,209 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/radix_sort.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns `n` random keys, drawn from `num_distinct` values centered on zero
+// if `num_distinct` is positive, and from all the values of `K` otherwise.
+template <typename K>
+std::vector<K> RandomKeys(int64 n, int64 num_distinct) {
+  random::PhiloxRandom philox(n, num_distinct);
+  random::SimplePhilox rnd(&philox);
+  std::vector<K> keys(n);
+  for (int64 i = 0; i < n; ++i) {
+    const uint64 bits = rnd.Rand64();
+    keys[i] = num_distinct > 0
+                  ? static_cast<K>(static_cast<int64>(bits % num_distinct) -
+                                   num_distinct / 2)
+                  : static_cast<K>(bits);
+  }
+  return keys;
+}
+
+template <typename K>
+void CheckSortsPairsStably(const DeviceBase::CpuWorkerThreads* worker_threads,
+                           int64 n, int64 num_distinct) {
+  std::vector<K> keys = RandomKeys<K>(n, num_distinct);
+  std::vector<int64> positions(n);
+  std::vector<std::pair<K, int64>> expected(n);
+  for (int64 i = 0; i < n; ++i) {
+    positions[i] = i;
+    expected[i] = {keys[i], i};
+  }
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const std::pair<K, int64>& a,
+                      const std::pair<K, int64>& b) {
+                     return a.first < b.first;
+                   });
+
+  RadixSortPairs(worker_threads, &keys, &positions);
+  for (int64 i = 0; i < n; ++i) {
+    ASSERT_EQ(expected[i].first, keys[i]) << i;
+    ASSERT_EQ(expected[i].second, positions[i]) << i;
+  }
+}
+
+template <typename K>
+void CheckUnique(const DeviceBase::CpuWorkerThreads* worker_threads, int64 n,
+                 int64 num_distinct) {
+  const std::vector<K> keys = RandomKeys<K>(n, num_distinct);
+  std::map<K, int32> expected_idx;
+  std::vector<K> expected_uniques;
+  for (const K key : keys) {
+    if (expected_idx.emplace(key, expected_uniques.size()).second) {
+      expected_uniques.push_back(key);
+    }
+  }
+
+  std::vector<K> uniques;
+  std::vector<int32> idx(n);
+  RadixUnique(worker_threads, keys.data(), n, &uniques, idx.data());
+  EXPECT_EQ(expected_uniques, uniques);
+  for (int64 i = 0; i < n; ++i) {
+    ASSERT_EQ(expected_idx[keys[i]], idx[i]) << i;
+  }
+
+  std::vector<K> sorted = keys;
+  SortAndUnique(&sorted);
+  std::sort(expected_uniques.begin(), expected_uniques.end());
+  EXPECT_EQ(expected_uniques, sorted);
+}
+
+class RadixSortTest : public ::testing::TestWithParam<int> {
+ protected:
+  RadixSortTest() : pool_(Env::Default(), "radix_sort_test", 8) {
+    worker_threads_.num_threads = 8;
+    worker_threads_.workers = &pool_;
+  }
+
+  // Returns the threads to run on, or null to run inline.
+  const DeviceBase::CpuWorkerThreads* worker_threads() const {
+    return GetParam() > 0 ? &worker_threads_ : nullptr;
+  }
+
+ private:
+  thread::ThreadPool pool_;
+  DeviceBase::CpuWorkerThreads worker_threads_;
+};
+
+TEST_P(RadixSortTest, SortsPairsStably) {
+  for (const int64 n : {0, 1, 2, 1000, 300000}) {
+    for (const int64 num_distinct : {0, 7, 100000}) {
+      CheckSortsPairsStably<int8>(worker_threads(), n, num_distinct);
+      CheckSortsPairsStably<uint16>(worker_threads(), n, num_distinct);
+      CheckSortsPairsStably<int32>(worker_threads(), n, num_distinct);
+      CheckSortsPairsStably<int64>(worker_threads(), n, num_distinct);
+      CheckSortsPairsStably<uint64>(worker_threads(), n, num_distinct);
+    }
+  }
+}
+
+TEST_P(RadixSortTest, SortsKeys) {
+  std::vector<int64> keys = RandomKeys<int64>(100000, 0);
+  std::vector<int64> expected = keys;
+  std::sort(expected.begin(), expected.end());
+  RadixSortKeys(worker_threads(), &keys);
+  EXPECT_EQ(expected, keys);
+}
+
+TEST_P(RadixSortTest, Unique) {
+  for (const int64 n : {0, 1, 1000, 300000}) {
+    for (const int64 num_distinct : {0, 7, 100000}) {
+      CheckUnique<int32>(worker_threads(), n, num_distinct);
+      CheckUnique<int64>(worker_threads(), n, num_distinct);
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(NumThreads, RadixSortTest, ::testing::Values(0, 8));
+
+static void BM_RadixSortPairs(int iters, int n, int num_threads) {
+  testing::StopTiming();
+  thread::ThreadPool pool(Env::Default(), "bm_radix_sort",
+                          std::max(num_threads, 1));
+  DeviceBase::CpuWorkerThreads worker_threads;
+  worker_threads.num_threads = num_threads;
+  worker_threads.workers = &pool;
+  const std::vector<int64> keys = RandomKeys<int64>(n, n);
+  testing::ItemsProcessed(static_cast<int64>(iters) * n);
+  for (int i = 0; i < iters; ++i) {
+    std::vector<int64> sorted_keys = keys;
+    std::vector<int32> positions(n);
+    testing::StartTiming();
+    RadixSortPairs(num_threads > 0 ? &worker_threads : nullptr, &sorted_keys,
+                   &positions);
+    testing::StopTiming();
+  }
+}
+
+BENCHMARK(BM_RadixSortPairs)
+    ->ArgPair(1 << 16, 0)
+    ->ArgPair(1 << 20, 0)
+    ->ArgPair(1 << 20, 8)
+    ->ArgPair(1 << 24, 8);
+
+static void BM_StdSortPairs(int iters, int n) {
+  testing::StopTiming();
+  const std::vector<int64> keys = RandomKeys<int64>(n, n);
+  testing::ItemsProcessed(static_cast<int64>(iters) * n);
+  for (int i = 0; i < iters; ++i) {
+    std::vector<std::pair<int64, int32>> pairs(n);
+    for (int j = 0; j < n; ++j) pairs[j] = {keys[j], j};
+    testing::StartTiming();
+    std::stable_sort(pairs.begin(), pairs.end());
+    testing::StopTiming();
+  }
+}
+
+BENCHMARK(BM_StdSortPairs)->Arg(1 << 16)->Arg(1 << 20)->Arg(1 << 24);
+
+static void BM_RadixUnique(int iters, int n, int num_distinct) {
+  testing::StopTiming();
+  thread::ThreadPool pool(Env::Default(), "bm_radix_unique", 8);
+  DeviceBase::CpuWorkerThreads worker_threads;
+  worker_threads.num_threads = 8;
+  worker_threads.workers = &pool;
+  const std::vector<int64> keys = RandomKeys<int64>(n, num_distinct);
+  std::vector<int64> uniques;
+  std::vector<int32> idx(n);
+  testing::ItemsProcessed(static_cast<int64>(iters) * n);
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    RadixUnique(&worker_threads, keys.data(), n, &uniques, idx.data());
+  }
+}
+
+BENCHMARK(BM_RadixUnique)
+    ->ArgPair(1 << 20, 1 << 10)
+    ->ArgPair(1 << 20, 1 << 20)
+    ->ArgPair(1 << 24, 1 << 20);
+
+}  // namespace
+}  // namespace tensorflow
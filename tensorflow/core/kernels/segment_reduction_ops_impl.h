@@ -23,6 +23,8 @@ limitations under the License.
 #define EIGEN_USE_GPU
 #endif  // GOOGLE_CUDA || TENSORFLOW_USE_ROCM
 
+#include <algorithm>
+#include <type_traits>
 #include <vector>
 
 #include "third_party/eigen3/Eigen/Core"
@@ -38,7 +40,9 @@ limitations under the License.
 #include "tensorflow/core/kernels/segment_reduction_ops.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/prefetch.h"
 #include "tensorflow/core/util/util.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 #if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
 #include "tensorflow/core/common_runtime/gpu/gpu_event_mgr.h"
@@ -507,254 +511,123 @@ class SparseSegmentReductionOpBase : public OpKernel {
     OP_REQUIRES(context, output_rows > 0,
                 errors::InvalidArgument("segment ids must be >= 0"));
     auto output_flat = output->flat_outer_dims<T>();
-
-    Tensor temp;
-    if (input.dtype() == DT_BFLOAT16) {
-      temp = tensorflow::Tensor(DT_FLOAT, output_shape);
-    }
-    auto temp_flat = temp.flat_outer_dims<float>();
-
-    int64 start = 0, end = 1;
-    // Index from which the output is not initialized.
-    SegmentId uninitialized_index = 0;
-    SegmentId out_index = internal::SubtleMustCopy(segment_vec(start));
-
-    while (true) {
-      // We initialize next_index to 0 to avoid "warning: 'next_index' may be
-      // used uninitialized in this function" in the Mac build (since the
-      // compiler isn't smart enough to realize the code is safe).
-      SegmentId next_index = 0;
-      if (end < num_indices) {
-        next_index = internal::SubtleMustCopy(segment_vec(end));
-        if (out_index == next_index) {
-          ++end;
-          continue;
-        }
-        // We have a new segment here.  Verify that the segment ids are growing.
-        OP_REQUIRES(context, out_index < next_index,
+    const int64 num_rows = input_flat.dimension(0);
+
+    // Validates the indices and the segment ids, and splits the indices into
+    // runs of equal segment ids. The validated indices are copied, since the
+    // input may change while it is read.
+    std::vector<Index> rows(num_indices);
+    std::vector<int64> run_starts;
+    std::vector<SegmentId> run_ids;
+    for (int64 i = 0; i < num_indices; ++i) {
+      const SegmentId segment_id = internal::SubtleMustCopy(segment_vec(i));
+      if (run_ids.empty() || segment_id != run_ids.back()) {
+        OP_REQUIRES(context, run_ids.empty() || run_ids.back() < segment_id,
                     errors::InvalidArgument("segment ids are not increasing"));
+        OP_REQUIRES(
+            context, FastBoundsCheck(segment_id, output_rows),
+            errors::InvalidArgument(
+                "Segment id ", segment_id, " out of range [0, ", output_rows,
+                "), possibly because 'segment_ids' input is not sorted."));
+        run_starts.push_back(i);
+        run_ids.push_back(segment_id);
       }
-
-      OP_REQUIRES(
-          context, FastBoundsCheck(out_index, output_rows),
-          errors::InvalidArgument(
-              "Segment id ", out_index, " out of range [0, ", output_rows,
-              "), possibly because 'segment_ids' input is not sorted."));
-
-      // If there is a gap between two indices, we need to set that gap to the
-      // default value.
-      if (out_index > uninitialized_index) {
-        Eigen::DSizes<Eigen::DenseIndex, 2> gap_slice_shape(
-            out_index - uninitialized_index, num_col);
-        Eigen::TensorMap<Eigen::Tensor<T, 2, Eigen::RowMajor>, Eigen::Unaligned>
-            gap_slice(&output_flat(uninitialized_index, 0), gap_slice_shape);
-        gap_slice.setConstant(default_value_);
-      }
-
-      auto out = output_flat.template chip<0>(out_index);
-      auto temp = temp_flat.template chip<0>(out_index);
-      const int bad_offset = Reduce<T, Index>(input_flat, indices_vec, start,
-                                              end - start, out, temp);
-      OP_REQUIRES(context, bad_offset < 0,
-                  errors::InvalidArgument(
-                      "Bad: indices[", start + bad_offset,
-                      "] == ", indices_vec(start + bad_offset),
-                      " out of range [0, ", input_flat.dimension(0), ")"));
-
-      start = end;
-      ++end;
-      uninitialized_index = out_index + 1;
-      out_index = next_index;
-      if (end > num_indices) break;
+      rows[i] = internal::SubtleMustCopy(indices_vec(i));
+      OP_REQUIRES(context, FastBoundsCheck(rows[i], num_rows),
+                  errors::InvalidArgument("Bad: indices[", i, "] == ", rows[i],
+                                          " out of range [0, ", num_rows,
+                                          ")"));
     }
+    run_starts.push_back(num_indices);
+    const int64 num_runs = run_ids.size();
+
+    const T* input_data = input_flat.data();
+    T* output_data = output_flat.data();
+    auto reduce_runs = [&](int64 begin, int64 end) {
+      std::vector<Accum> accum_buffer;
+      for (int64 r = begin; r < end; ++r) {
+        // Sets the rows of the empty segments before this one to the default
+        // value.
+        const int64 gap_start = r == 0 ? 0 : run_ids[r - 1] + 1;
+        std::fill(output_data + gap_start * num_col,
+                  output_data + run_ids[r] * num_col, default_value_);
+        ReduceRows(input_data, num_col, rows.data() + run_starts[r],
+                   run_starts[r + 1] - run_starts[r],
+                   output_data + run_ids[r] * num_col, &accum_buffer);
+      }
+    };
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    const int64 cost_per_run =
+        std::max<int64>(num_indices / num_runs, 1) * num_col;
+    Shard(worker_threads.num_threads, worker_threads.workers, num_runs,
+          cost_per_run, reduce_runs);
 
     // Fill the gap at the end with the default value.
-    if (uninitialized_index < output_rows) {
-      Eigen::DSizes<Eigen::DenseIndex, 2> gap_slice_shape(
-          output_rows - uninitialized_index, num_col);
-      Eigen::TensorMap<Eigen::Tensor<T, 2, Eigen::RowMajor>, Eigen::Unaligned>
-          gap_slice(&output_flat(uninitialized_index, 0), gap_slice_shape);
-      gap_slice.setConstant(default_value_);
-    }
+    std::fill(output_data + (run_ids.back() + 1) * num_col,
+              output_data + output_rows * num_col, default_value_);
   }
 
  private:
-  template <typename Tin>
-  using EnableIfBfloat16 =
-      typename std::enable_if<std::is_same<Tin, bfloat16>::value, int>::type;
-  template <typename Tin>
-  using EnableIfNotBfloat16 =
-      typename std::enable_if<!std::is_same<Tin, bfloat16>::value, int>::type;
-
-  template <typename Tin, typename Tindex, EnableIfNotBfloat16<Tin> = 0>
-  EIGEN_ALWAYS_INLINE auto fetch_val(
-      const typename TTypes<Tin>::ConstMatrix& input_flat, Tindex index) {
-    return input_flat.template chip<0>(index);
-  }
-
-  template <typename Tin, typename Tindex, EnableIfBfloat16<Tin> = 0>
-  EIGEN_ALWAYS_INLINE auto fetch_val(
-      const typename TTypes<Tin>::ConstMatrix& input_flat, Tindex index) {
-    return input_flat.template chip<0>(index).template cast<float>();
-  }
-
-  template <typename Tout>
-  EIGEN_ALWAYS_INLINE Tout get_scaling_factor(int64 num) {
-    Tout m(1);
-    if (is_mean_ && (num < 10)) {
-      m = Tout(num);
+  // The type in which the rows are summed: float for 16-bit floating point
+  // values, so that long segments do not lose precision, and T otherwise.
+  typedef typename std::conditional<std::is_same<T, bfloat16>::value ||
+                                        std::is_same<T, Eigen::half>::value,
+                                    float, T>::type Accum;
+
+  // Reduces the rows `rows[0, num)` of the matrix `input`, of `num_col`
+  // columns, into the row `out`. `accum_buffer` is scratch space.
+  void ReduceRows(const T* input, int64 num_col, const Index* rows, int64 num,
+                  T* out, std::vector<Accum>* accum_buffer) const {
+    Accum* accum;
+    if (std::is_same<T, Accum>::value) {
+      accum = reinterpret_cast<Accum*>(out);
+    } else {
+      accum_buffer->resize(num_col);
+      accum = accum_buffer->data();
     }
-    if (is_sqrtn_ && (num < 10)) {
-      m = Tout(sqrt(num));
+    // Number of rows read ahead of the one being added.
+    const int64 kPrefetchRows = 4;
+    const int64 row_bytes = num_col * sizeof(T);
+    auto prefetch_row = [input, num_col, row_bytes](Index row) {
+      const char* data = reinterpret_cast<const char*>(input + row * num_col);
+      for (int64 offset = 0; offset < row_bytes; offset += 64) {
+        port::prefetch<port::PREFETCH_HINT_T0>(data + offset);
+      }
+    };
+    for (int64 i = 1; i < std::min(num, kPrefetchRows); ++i) {
+      prefetch_row(rows[i]);
     }
-    return Tout(1) / m;
-  }
-
-  template <typename Tin, typename Tindex, EnableIfNotBfloat16<Tin> = 0>
-  int64 Reduce(
-      const typename TTypes<Tin>::ConstMatrix& input_flat,
-      const typename TTypes<Tindex>::ConstVec& indices_vec, int64 start,
-      int64 num, Eigen::TensorChippingOp<0, typename TTypes<Tin>::Matrix> out,
-      Eigen::TensorChippingOp<0, typename TTypes<float>::Matrix> temp) {
-    return ReduceImpl<Tin, Tindex, Tin>(input_flat, indices_vec, start, num,
-                                        out, get_scaling_factor<Tin>(num));
-  }
 
-  template <typename Tin, typename Tindex, EnableIfBfloat16<Tin> = 0>
-  int64 Reduce(
-      const typename TTypes<Tin>::ConstMatrix& input_flat,
-      const typename TTypes<Tindex>::ConstVec& indices_vec, int64 start,
-      int64 num, Eigen::TensorChippingOp<0, typename TTypes<Tin>::Matrix> out,
-      Eigen::TensorChippingOp<0, typename TTypes<float>::Matrix> temp) {
-    int64 res =
-        ReduceImpl<Tin, Tindex, float>(input_flat, indices_vec, start, num,
-                                       temp, get_scaling_factor<float>(num));
-    out = temp.template cast<bfloat16>();
-    return res;
-  }
-
-  template <typename Tin, typename Tindex, typename Tout>
-  int64 ReduceImpl(
-      const typename TTypes<Tin>::ConstMatrix& input_flat,
-      const typename TTypes<Tindex>::ConstVec& indices_vec, int64 start,
-      int64 num, Eigen::TensorChippingOp<0, typename TTypes<Tout>::Matrix> out,
-      const Tout scaling_factor) {
-#define INDEX(n, i)                               \
-  const auto index##n = indices_vec(start + (i)); \
-  if (!FastBoundsCheck(index##n, input_flat.dimension(0))) return (i);
-
-#define L(n) fetch_val<Tin, Tindex>(input_flat, index##n)
-
-    if (num == 1) {
-      INDEX(0, 0);
-      out = L(0);
-    } else {
-      int64 r = num & 7;
-      switch (r) {
-        case 2: {
-          INDEX(0, 0);
-          INDEX(1, 1);
-          out = (L(0) + L(1)) * scaling_factor;
-          break;
-        }
-        case 3: {
-          INDEX(0, 0);
-          INDEX(1, 1);
-          INDEX(2, 2);
-          out = (L(0) + L(1) + L(2)) * scaling_factor;
-          break;
-        }
-        case 4: {
-          INDEX(0, 0);
-          INDEX(1, 1);
-          INDEX(2, 2);
-          INDEX(3, 3);
-          out = (L(0) + L(1) + L(2) + L(3)) * scaling_factor;
-          break;
-        }
-        case 5: {
-          INDEX(0, 0);
-          INDEX(1, 1);
-          INDEX(2, 2);
-          INDEX(3, 3);
-          INDEX(4, 4);
-          out = (L(0) + L(1) + L(2) + L(3) + L(4)) * scaling_factor;
-          break;
-        }
-        case 6: {
-          INDEX(0, 0);
-          INDEX(1, 1);
-          INDEX(2, 2);
-          INDEX(3, 3);
-          INDEX(4, 4);
-          INDEX(5, 5);
-          out = (L(0) + L(1) + L(2) + L(3) + L(4) + L(5)) * scaling_factor;
-          break;
-        }
-        case 7: {
-          INDEX(0, 0);
-          INDEX(1, 1);
-          INDEX(2, 2);
-          INDEX(3, 3);
-          INDEX(4, 4);
-          INDEX(5, 5);
-          INDEX(6, 6);
-          out =
-              (L(0) + L(1) + L(2) + L(3) + L(4) + L(5) + L(6)) * scaling_factor;
-          break;
-        }
-        case 0: {
-          INDEX(0, 0);
-          INDEX(1, 1);
-          INDEX(2, 2);
-          INDEX(3, 3);
-          INDEX(4, 4);
-          INDEX(5, 5);
-          INDEX(6, 6);
-          INDEX(7, 7);
-          out = (L(0) + L(1) + L(2) + L(3) + L(4) + L(5) + L(6) + L(7)) *
-                scaling_factor;
-          r = 8;
-          break;
-        }
-        case 1: {
-          INDEX(0, 0);
-          INDEX(1, 1);
-          INDEX(2, 2);
-          INDEX(3, 3);
-          INDEX(4, 4);
-          INDEX(5, 5);
-          INDEX(6, 6);
-          INDEX(7, 7);
-          INDEX(8, 8);
-          out = (L(0) + L(1) + L(2) + L(3) + L(4) + L(5) + L(6) + L(7) + L(8)) *
-                scaling_factor;
-          r = 9;
-          break;
-        }
+    const T* first = input + rows[0] * num_col;
+    for (int64 j = 0; j < num_col; ++j) {
+      accum[j] = static_cast<Accum>(first[j]);
+    }
+    for (int64 i = 1; i < num; ++i) {
+      if (i + kPrefetchRows - 1 < num) {
+        prefetch_row(rows[i + kPrefetchRows - 1]);
       }
-      for (; r < num; r += 8) {
-        INDEX(0, r);
-        INDEX(1, r + 1);
-        INDEX(2, r + 2);
-        INDEX(3, r + 3);
-        INDEX(4, r + 4);
-        INDEX(5, r + 5);
-        INDEX(6, r + 6);
-        INDEX(7, r + 7);
-        out += L(0) + L(1) + L(2) + L(3) + L(4) + L(5) + L(6) + L(7);
+      // Contiguous and free of aliasing, so that the compiler vectorizes it.
+      const T* __restrict row = input + rows[i] * num_col;
+      Accum* __restrict acc = accum;
+      for (int64 j = 0; j < num_col; ++j) {
+        acc[j] += static_cast<Accum>(row[j]);
       }
-      if (is_mean_ && num >= 10) {
-        out = out / static_cast<Tout>(num);
+    }
+
+    Accum divisor(1);
+    if (is_mean_ && num > 1) divisor = Accum(num);
+    if (is_sqrtn_ && num > 1) divisor = Accum(sqrt(num));
+    if (num < 10) {
+      const Accum scaling_factor = Accum(1) / divisor;
+      for (int64 j = 0; j < num_col; ++j) {
+        out[j] = static_cast<T>(accum[j] * scaling_factor);
       }
-      if (is_sqrtn_ && num >= 10) {
-        out = out / static_cast<Tout>(sqrt(num));
+    } else {
+      for (int64 j = 0; j < num_col; ++j) {
+        out[j] = static_cast<T>(accum[j] / divisor);
       }
     }
-
-    return -1;
-#undef L
-#undef INDEX
   }
 
   const bool is_mean_;
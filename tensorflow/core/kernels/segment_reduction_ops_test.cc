@@ -31,6 +31,8 @@ limitations under the License.
 #include "tensorflow/core/graph/testlib.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/public/session_options.h"
@@ -113,6 +115,59 @@ BM_Reduce_Arg(64, 32, 2);
 BM_Reduce_Arg(4096, 32, 2);
 BM_Reduce_Arg(4096, 128, 2);
 
+// Pools `batch` bags of `bag_size` random rows each out of a table of 100000
+// rows of `dim` values, as an embedding lookup does.
+template <typename T>
+static void SparseSegmentReductionHelper(int iters, const string& reduction,
+                                         int dim, int bag_size) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+  const int kVocabSize = 100000;
+  const int kBatch = 1024;
+  const int num_indices = kBatch * bag_size;
+
+  Tensor data(DataTypeToEnum<T>::v(), TensorShape({kVocabSize, dim}));
+  test::FillFn<T>(&data, [](int i) { return static_cast<T>(i % 100 * 0.01f); });
+  Tensor indices(DT_INT32, TensorShape({num_indices}));
+  Tensor segments(DT_INT32, TensorShape({num_indices}));
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  for (int i = 0; i < num_indices; ++i) {
+    indices.flat<int32>()(i) = rnd.Uniform(kVocabSize);
+    segments.flat<int32>()(i) = i / bag_size;
+  }
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), reduction)
+                  .Input(test::graph::Constant(g, data))
+                  .Input(test::graph::Constant(g, indices))
+                  .Input(test::graph::Constant(g, segments))
+                  .Attr("T", DataTypeToEnum<T>::v())
+                  .Finalize(g, &node));
+
+  testing::UseRealTime();
+  testing::BytesProcessed(static_cast<int64>(iters) * num_indices * dim *
+                          sizeof(T));
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+#define BM_SparseSegmentReduction(O, T)                             \
+  static void BM_##O##_##T(int iters, int dim, int bag_size) {      \
+    SparseSegmentReductionHelper<T>(iters, #O, dim, bag_size);      \
+  }                                                                 \
+  BENCHMARK(BM_##O##_##T)                                           \
+      ->ArgPair(16, 1)                                              \
+      ->ArgPair(16, 32)                                             \
+      ->ArgPair(64, 8)                                              \
+      ->ArgPair(256, 32);
+
+BM_SparseSegmentReduction(SparseSegmentSum, float);
+BM_SparseSegmentReduction(SparseSegmentMean, float);
+BM_SparseSegmentReduction(SparseSegmentSqrtN, float);
+BM_SparseSegmentReduction(SparseSegmentSum, bfloat16);
+BM_SparseSegmentReduction(SparseSegmentMean, bfloat16);
+
 static void SparseSegmentMeanGradHelper(int iters, float uniqueness, int size) {
   testing::StopTiming();
   Graph* g = new Graph(OpRegistry::Global());
@@ -21,11 +21,12 @@ limitations under the License.
 #define EIGEN_USE_THREADS
 
 #include <algorithm>
+#include <iterator>
+#include <map>
 #include <numeric>
-// TODO(ptucker): Consider switching back to hash_set - I had trouble getting it
-// to work with string values.
-#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -33,6 +34,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/radix_sort.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/util/sparse/sparse_tensor.h"
@@ -42,6 +44,8 @@ namespace tensorflow {
 using ShapeArray = sparse::SparseTensor::ShapeArray;
 using VarDimArray = sparse::SparseTensor::VarDimArray;
 
+// Sets are represented as sorted vectors of distinct values.
+
 // Validate rank >= 2.
 void CheckRankAtLeast2(OpKernelContext* ctx, const TensorShape& shape) {
   const auto rank = shape.dims();
@@ -141,7 +145,8 @@ const ShapeArray Strides(const VarDimArray& shape) {
 template <typename T>
 void OutputSparseTensor(OpKernelContext* ctx, const TensorShape& output_shape,
                         const int64 num_values,
-                        const std::map<std::vector<int64>, std::set<T>>& sets) {
+                        const std::map<std::vector<int64>, std::vector<T>>&
+                            sets) {
   // Allocate 3 output tensors for sparse data.
   Tensor *out_indices_t, *out_values_t, *out_shape_t;
   OP_REQUIRES_OK(ctx, ctx->allocate_output(
@@ -203,7 +208,7 @@ template <typename T>
 void PopulateFromDenseGroup(OpKernelContext* ctx, const Tensor& input_tensor,
                             const VarDimArray& input_strides,
                             const std::vector<int64>& group_indices,
-                            std::set<T>* result) {
+                            std::vector<T>* result) {
   OP_REQUIRES(ctx, group_indices.size() == input_strides.size() - 1,
               errors::Internal("group_indices.size ", group_indices.size(),
                                ", !=  input_strides.size-1 ",
@@ -215,8 +220,9 @@ void PopulateFromDenseGroup(OpKernelContext* ctx, const Tensor& input_tensor,
   const TensorShape& input_shape = input_tensor.shape();
   const auto end = start + input_shape.dim_size(input_shape.dims() - 1);
   for (int64 i = start; i < end; ++i) {
-    result->insert(input_flat(i));
+    result->push_back(input_flat(i));
   }
+  SortAndUnique(result);
 }
 
 // Populate `result` set from `group`. `sparse_tensor_shape` is the shape of the
@@ -225,13 +231,14 @@ void PopulateFromDenseGroup(OpKernelContext* ctx, const Tensor& input_tensor,
 template <typename T>
 void PopulateFromSparseGroup(OpKernelContext* ctx, const sparse::Group& group,
                              const VarDimArray& sparse_tensor_shape,
-                             std::set<T>* result) {
+                             std::vector<T>* result) {
   CheckGroup<T>(ctx, group, sparse_tensor_shape);
   result->clear();
   const auto& group_values = group.values<T>();
   for (int64 i = 0; i < group_values.size(); ++i) {
-    result->insert(group_values(i));
+    result->push_back(group_values(i));
   }
+  SortAndUnique(result);
 }
 
 template <typename T>
@@ -270,7 +277,7 @@ void SetSizeOp<T>::Compute(OpKernelContext* ctx) {
   // Group by all but last dimension, create a set of group values, and add set
   // size to output.
   VarDimArray group_ix = set_st.order().subspan(0, set_st.order().size() - 1);
-  std::set<T> group_set;
+  std::vector<T> group_set;
   for (const auto& group : set_st.group(group_ix)) {
     PopulateFromSparseGroup<T>(ctx, group, set_st.shape(), &group_set);
 
@@ -342,8 +349,8 @@ class SetOperationOp : public OpKernel {
   void Compute(OpKernelContext* ctx) override;
 
  private:
-  void ApplySetOperation(const std::set<T>& set1, const std::set<T>& set2,
-                         std::set<T>* result) const;
+  void ApplySetOperation(const std::vector<T>& set1, const std::vector<T>& set2,
+                         std::vector<T>* result) const;
   void ComputeDenseToDense(OpKernelContext* ctx) const;
   void ComputeDenseToSparse(OpKernelContext* ctx) const;
   void ComputeSparseToSparse(OpKernelContext* ctx) const;
@@ -353,25 +360,25 @@ class SetOperationOp : public OpKernel {
 };
 
 template <typename T>
-void SetOperationOp<T>::ApplySetOperation(const std::set<T>& set1,
-                                          const std::set<T>& set2,
-                                          std::set<T>* result) const {
+void SetOperationOp<T>::ApplySetOperation(const std::vector<T>& set1,
+                                          const std::vector<T>& set2,
+                                          std::vector<T>* result) const {
   switch (set_operation_) {
     case A_MINUS_B:
       std::set_difference(set1.begin(), set1.end(), set2.begin(), set2.end(),
-                          std::inserter(*result, result->begin()));
+                          std::back_inserter(*result));
       break;
     case B_MINUS_A:
       std::set_difference(set2.begin(), set2.end(), set1.begin(), set1.end(),
-                          std::inserter(*result, result->begin()));
+                          std::back_inserter(*result));
       break;
     case INTERSECTION:
       std::set_intersection(set1.begin(), set1.end(), set2.begin(), set2.end(),
-                            std::inserter(*result, result->begin()));
+                            std::back_inserter(*result));
       break;
     case UNION:
       std::set_union(set1.begin(), set1.end(), set2.begin(), set2.end(),
-                     std::inserter(*result, result->begin()));
+                     std::back_inserter(*result));
       break;
   }
 }
@@ -438,12 +445,12 @@ void SetOperationOp<T>::ComputeDenseToDense(OpKernelContext* ctx) const {
   const auto set1_strides = Strides(shape1);
   const auto set2_strides = Strides(shape2);
 
-  std::map<std::vector<int64>, std::set<T>> group_sets;
+  std::map<std::vector<int64>, std::vector<T>> group_sets;
   int64 num_result_values = 0;
   int64 max_set_size = 0;
 
-  std::set<T> set1_group_set;
-  std::set<T> set2_group_set;
+  std::vector<T> set1_group_set;
+  std::vector<T> set2_group_set;
   std::vector<int64> group_indices;
   int64 num_elements;
   OP_REQUIRES_OK(ctx,
@@ -456,11 +463,11 @@ void SetOperationOp<T>::ComputeDenseToDense(OpKernelContext* ctx) const {
     PopulateFromDenseGroup<T>(ctx, set2_t, set2_strides, group_indices,
                               &set2_group_set);
 
-    std::set<T> group_set;
+    std::vector<T> group_set;
     ApplySetOperation(set1_group_set, set2_group_set, &group_set);
     if (!group_set.empty()) {
-      group_sets[group_indices] = group_set;
       const auto set_size = group_set.size();
+      group_sets[group_indices] = std::move(group_set);
       if (set_size > max_set_size) {
         max_set_size = set_size;
       }
@@ -494,12 +501,12 @@ void SetOperationOp<T>::ComputeDenseToSparse(OpKernelContext* ctx) const {
 
   const ShapeArray set1_strides = Strides(TensorShapeToArray(set1_t.shape()));
 
-  std::map<std::vector<int64>, std::set<T>> group_sets;
+  std::map<std::vector<int64>, std::vector<T>> group_sets;
   int64 num_result_values = 0;
   int64 max_set_size = 0;
 
-  std::set<T> set1_group_set;
-  std::set<T> set2_group_set;
+  std::vector<T> set1_group_set;
+  std::vector<T> set2_group_set;
   auto set2_grouper =
       set2_st.group(set2_st.order().subspan(0, set2_st.order().size() - 1));
   auto set2_group_it = set2_grouper.begin();
@@ -538,11 +545,11 @@ void SetOperationOp<T>::ComputeDenseToSparse(OpKernelContext* ctx) const {
       }
     }
 
-    std::set<T> group_set;
+    std::vector<T> group_set;
     ApplySetOperation(set1_group_set, set2_group_set, &group_set);
     if (!group_set.empty()) {
-      group_sets[group_indices] = group_set;
       const auto set_size = group_set.size();
+      group_sets[group_indices] = std::move(group_set);
       if (set_size > max_set_size) {
         max_set_size = set_size;
       }
@@ -615,12 +622,12 @@ void SetOperationOp<T>::ComputeSparseToSparse(OpKernelContext* ctx) const {
   const ShapeArray set1_strides = Strides(set1_st.shape());
   const ShapeArray set2_strides = Strides(set2_st.shape());
 
-  std::map<std::vector<int64>, std::set<T>> group_sets;
+  std::map<std::vector<int64>, std::vector<T>> group_sets;
   int64 num_result_values = 0;
   int64 max_set_size = 0;
 
-  std::set<T> set1_group_set;
-  std::set<T> set2_group_set;
+  std::vector<T> set1_group_set;
+  std::vector<T> set2_group_set;
   auto set1_grouper =
       set1_st.group(set1_st.order().subspan(0, set1_st.order().size() - 1));
   auto set1_group_it = set1_grouper.begin();
@@ -661,11 +668,11 @@ void SetOperationOp<T>::ComputeSparseToSparse(OpKernelContext* ctx) const {
       group_indices = &set2_group_indices;
     }
 
-    std::set<T> group_set;
+    std::vector<T> group_set;
     ApplySetOperation(set1_group_set, set2_group_set, &group_set);
     if (!group_set.empty()) {
-      group_sets[*group_indices] = group_set;
       const auto set_size = group_set.size();
+      group_sets[*group_indices] = std::move(group_set);
       if (set_size > max_set_size) {
         max_set_size = set_size;
       }
@@ -19,17 +19,53 @@ limitations under the License.
 #include <numeric>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/radix_sort.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/util/overflow.h"
 #include "tensorflow/core/util/sparse/sparse_tensor.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
+namespace {
+
+// Unordered inputs with at least this many entries are reordered by radix
+// sorting their row-major linear indices rather than with std::sort.
+constexpr int64 kMinEntriesToRadixSort = 1 << 12;
+
+// Computes the row-major linear index of each entry of `indices` into
+// `shape`. Returns false if an index is out of bounds or the number of
+// elements of `shape` does not fit in an int64.
+bool LinearIndices(const Tensor& indices, const TensorShape& shape,
+                   std::vector<int64>* linear_indices) {
+  int64 num_elements = 1;
+  for (int d = 0; d < shape.dims(); ++d) {
+    num_elements = MultiplyWithoutOverflow(num_elements, shape.dim_size(d));
+    if (num_elements < 0) return false;
+  }
+  const auto indices_mat = indices.matrix<int64>();
+  linear_indices->resize(indices_mat.dimension(0));
+  for (int64 i = 0; i < indices_mat.dimension(0); ++i) {
+    int64 linear_index = 0;
+    for (int d = 0; d < shape.dims(); ++d) {
+      const int64 index = indices_mat(i, d);
+      if (index < 0 || index >= shape.dim_size(d)) return false;
+      linear_index = linear_index * shape.dim_size(d) + index;
+    }
+    (*linear_indices)[i] = linear_index;
+  }
+  return true;
+}
+
+}  // namespace
+
 template <typename T>
 class SparseReorderOp : public OpKernel {
  public:
@@ -65,9 +101,40 @@ class SparseReorderOp : public OpKernel {
         context, sparse::SparseTensor::Create(input_ind, input_val, input_shape,
                                               std_order, &input_sp));
 
+    std::vector<int64> linear_indices;
     if (input_sp.IndicesValid().ok()) {
       context->set_output(0, input_sp.indices());
       context->set_output(1, input_sp.values());
+    } else if (input_ind.dim_size(0) >= kMinEntriesToRadixSort &&
+               LinearIndices(input_ind, input_shape, &linear_indices)) {
+      // Sorts the entries by linear index, and gathers them in that order.
+      const int64 num_entries = linear_indices.size();
+      std::vector<int64> order(num_entries);
+      std::iota(order.begin(), order.end(), 0);
+      auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+      RadixSortPairs(worker_threads, &linear_indices, &order);
+
+      Tensor* output_ind = nullptr;
+      Tensor* output_val = nullptr;
+      OP_REQUIRES_OK(context, context->allocate_output(0, input_ind.shape(),
+                                                       &output_ind));
+      OP_REQUIRES_OK(context, context->allocate_output(1, input_val.shape(),
+                                                       &output_val));
+      const auto input_ind_mat = input_ind.matrix<int64>();
+      const auto input_val_vec = input_val.vec<T>();
+      auto output_ind_mat = output_ind->matrix<int64>();
+      auto output_val_vec = output_val->vec<T>();
+      const int64 rank = input_shape.dims();
+      auto gather = [&](int64 start, int64 limit) {
+        for (int64 i = start; i < limit; ++i) {
+          for (int64 d = 0; d < rank; ++d) {
+            output_ind_mat(i, d) = input_ind_mat(order[i], d);
+          }
+          output_val_vec(i) = input_val_vec(order[i]);
+        }
+      };
+      Shard(worker_threads->num_threads, worker_threads->workers, num_entries,
+            2 * rank + 10, gather);
     } else {
       // Deep-copy the input Tensors, then reorder in-place
       sparse::SparseTensor reordered_sp;
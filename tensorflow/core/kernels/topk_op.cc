@@ -136,6 +136,26 @@ struct TopKFunctor<CPUDevice, T> {
       return Status::OK();
     }
 
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+
+    // Sharding by row does not keep the threads busy when there are a few
+    // long rows. Instead, each row is split into column chunks whose top k
+    // are found in parallel, and merged. The chunks hold many more than k
+    // columns so that the merge is cheap.
+    const int64 kMinColsPerChunk = 16384;
+    const int64 num_chunks =
+        std::min<int64>(worker_threads.num_threads,
+                        num_cols / std::max<int64>(kMinColsPerChunk, 4 * k));
+    if (num_rows < worker_threads.num_threads && num_chunks >= 2) {
+      for (int64 b = 0; b < num_rows; ++b) {
+        TopKOfRowInChunks(worker_threads, &input(b, 0), num_cols, k,
+                          num_chunks, &indices(b, 0));
+        std::transform(&indices(b, 0), &indices(b, k), &values(b, 0),
+                       [b, &input](const int32 loc) { return input(b, loc); });
+      }
+      return Status::OK();
+    }
+
     auto SortIndices = [&](int start_batch, int limit_batch) {
       for (int32 b = start_batch; b < limit_batch; ++b) {
         const T* input_data = &input(b, 0);
@@ -221,12 +241,60 @@ struct TopKFunctor<CPUDevice, T> {
     const int64 final_cost = (total_cost >= static_cast<double>(kint64max))
                                  ? kint64max
                                  : static_cast<int64>(total_cost);
-    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
     Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
           final_cost, SortIndices);
 
     return Status::OK();
   }
+
+ private:
+  // Writes the sorted indices of the top k values of the row `input_data`
+  // to `indices`. Ties are broken in favor of the lower index, as when the
+  // row is processed at once.
+  static void TopKOfRowInChunks(
+      const DeviceBase::CpuWorkerThreads& worker_threads, const T* input_data,
+      int64 num_cols, int k, int64 num_chunks, int32* indices) {
+    const auto stable_comp = [input_data](const int32 a, const int32 b) {
+      if (input_data[b] < input_data[a]) {
+        return true;
+      } else if (input_data[b] > input_data[a]) {
+        return false;
+      } else {
+        return a < b;
+      }
+    };
+    // The top k of the row are among the top k of the chunks, which are
+    // collected in the k slots of each chunk in `candidates`.
+    const int64 chunk_size = (num_cols + num_chunks - 1) / num_chunks;
+    std::vector<int32> candidates(num_chunks * k);
+    std::vector<int64> num_candidates(num_chunks);
+    auto chunk_top_k = [&](int64 start_chunk, int64 limit_chunk) {
+      for (int64 c = start_chunk; c < limit_chunk; ++c) {
+        gtl::TopN<int32, decltype(stable_comp)> filter(k, stable_comp);
+        const int32 limit = std::min(num_cols, (c + 1) * chunk_size);
+        for (int32 i = c * chunk_size; i < limit; ++i) {
+          filter.push(i);
+        }
+        num_candidates[c] =
+            std::copy(filter.unsorted_begin(), filter.unsorted_end(),
+                      candidates.begin() + c * k) -
+            (candidates.begin() + c * k);
+      }
+    };
+    const int64 cost_per_chunk =
+        chunk_size * (3 * Eigen::TensorOpCost::AddCost<int32>() +
+                      Eigen::TensorOpCost::AddCost<T>());
+    Shard(worker_threads.num_threads, worker_threads.workers, num_chunks,
+          cost_per_chunk, chunk_top_k);
+
+    auto end = candidates.begin();
+    for (int64 c = 0; c < num_chunks; ++c) {
+      end = std::copy_n(candidates.begin() + c * k, num_candidates[c], end);
+    }
+    std::partial_sort(candidates.begin(), candidates.begin() + k, end,
+                      stable_comp);
+    std::copy_n(candidates.begin(), k, indices);
+  }
 };
 
 }  // namespace functor
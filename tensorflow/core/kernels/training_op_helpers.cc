@@ -15,10 +15,17 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/training_op_helpers.h"
 
+#include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/util/ptr_util.h"
 
 namespace tensorflow {
 
+namespace {
+
+// Number of mutexes that the rows of all variables are spread over.
+constexpr int kNumSparseRowMutexes = 1024;
+
+}  // namespace
 
 void MaybeForwardRefInputToRefOutput(OpKernelContext* ctx, int input,
                                      int output) {
@@ -27,4 +34,10 @@ void MaybeForwardRefInputToRefOutput(OpKernelContext* ctx, int input,
   }
 }
 
+mutex* SparseRowMutex(const void* row) {
+  static mutex* mutexes = new mutex[kNumSparseRowMutexes];
+  const uint64 hash = Hash64(reinterpret_cast<const char*>(&row), sizeof(row));
+  return &mutexes[hash % kNumSparseRowMutexes];
+}
+
 }  // end namespace tensorflow
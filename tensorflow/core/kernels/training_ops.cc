@@ -17,15 +17,21 @@ limitations under the License.
 #include "tensorflow/core/kernels/training_ops.h"
 
 #include <algorithm>  // NOLINT
+#include <functional>
+#include <numeric>
+#include <utility>
+#include <vector>
 
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/kernels/radix_sort.h"
 #include "tensorflow/core/kernels/training_op_helpers.h"
 #include "tensorflow/core/kernels/variable_ops.h"
 #include "tensorflow/core/lib/bfloat16/bfloat16.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/util/util.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 #ifdef TENSORFLOW_USE_SYCL
 #include "tensorflow/core/common_runtime/sycl/sycl_util.h"
@@ -1403,6 +1409,135 @@ REGISTER_KERNELS(GPU, complex128);
 #undef REGISTER_CPU_KERNELS
 #undef REGISTER_KERNELS
 
+// The multi-variable apply ops update the variables in blocks of up to this
+// many elements, so that the slices of a variable, of its slots and of its
+// gradient stay in cache while they are updated.
+constexpr int64 kMultiApplyBlockSize = 8192;
+
+// Reads the variables of a multi-variable apply op over `num_vars` variables
+// with `num_slots` slots each, whose gradients start at input `first_grad`.
+// `tensors` gets the variables followed by their first slots, second slots,
+// and so on, in input order.
+template <typename T>
+Status GetMultiApplyTensors(OpKernelContext* ctx, int num_vars, int num_slots,
+                            int first_grad, bool use_exclusive_lock,
+                            std::vector<Tensor>* tensors) {
+  const bool sparse = false;
+  const int num_tensors = num_vars * (num_slots + 1);
+  tensors->resize(num_tensors);
+  for (int i = 0; i < num_tensors; ++i) {
+    TF_RETURN_IF_ERROR(GetInputTensorFromVariable<CPUDevice, T>(
+        ctx, i, use_exclusive_lock, sparse, &(*tensors)[i]));
+    if (!(*tensors)[i].IsInitialized()) {
+      return errors::FailedPrecondition(
+          "Attempting to use uninitialized variables: ",
+          ctx->op_kernel().requested_input(i));
+    }
+    const Tensor& var = (*tensors)[i % num_vars];
+    if (!var.shape().IsSameSize((*tensors)[i].shape())) {
+      return errors::InvalidArgument(
+          "var ", i % num_vars, " and its slot ", i / num_vars,
+          " do not have the same shape", var.shape().DebugString(), " ",
+          (*tensors)[i].shape().DebugString());
+    }
+  }
+  for (int i = 0; i < num_vars; ++i) {
+    const Tensor& grad = ctx->input(first_grad + i);
+    if (!(*tensors)[i].shape().IsSameSize(grad.shape())) {
+      return errors::InvalidArgument(
+          "var ", i, " and its grad do not have the same shape",
+          (*tensors)[i].shape().DebugString(), " ",
+          grad.shape().DebugString());
+    }
+  }
+  return Status::OK();
+}
+
+// Calls `fn(i, start, size)` on blocks of the elements [start, start + size)
+// of each of `vars[i]`, in parallel.
+void ForEachMultiApplyBlock(
+    OpKernelContext* ctx, const std::vector<Tensor>& vars, int num_vars,
+    int64 cost_per_element,
+    const std::function<void(int, int64, int64)>& fn) {
+  std::vector<std::pair<int, int64>> blocks;
+  for (int i = 0; i < num_vars; ++i) {
+    const int64 num_elements = vars[i].NumElements();
+    for (int64 start = 0; start < num_elements;
+         start += kMultiApplyBlockSize) {
+      blocks.emplace_back(i, start);
+    }
+  }
+  auto update_blocks = [&](int64 start_block, int64 limit_block) {
+    for (int64 b = start_block; b < limit_block; ++b) {
+      const int i = blocks[b].first;
+      const int64 start = blocks[b].second;
+      fn(i, start,
+         std::min(kMultiApplyBlockSize, vars[i].NumElements() - start));
+    }
+  };
+  auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
+  Shard(worker_threads.num_threads, worker_threads.workers, blocks.size(),
+        cost_per_element * kMultiApplyBlockSize, update_blocks);
+}
+
+// Applies Adagrad to `N` variables at once. Unlike `N` ResourceApplyAdagrad
+// ops, this takes all the locks at once and updates the variables in a single
+// parallel sweep, which saves the per-op overhead for small variables.
+template <typename T>
+class ResourceApplyAdagradMultiOp : public OpKernel {
+ public:
+  explicit ResourceApplyAdagradMultiOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("update_slots", &update_slots_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("N", &num_vars_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const int n = num_vars_;
+    std::vector<int> variable_inputs(2 * n);
+    std::iota(variable_inputs.begin(), variable_inputs.end(), 0);
+    auto locks = MaybeLockVariableInputMutexesInOrder<CPUDevice, T>(
+        ctx, use_exclusive_lock_, /*sparse=*/false, variable_inputs);
+    std::vector<Tensor> tensors;
+    OP_REQUIRES_OK(ctx, GetMultiApplyTensors<T>(
+                            ctx, n, /*num_slots=*/1, /*first_grad=*/2 * n + 1,
+                            use_exclusive_lock_, &tensors));
+    const Tensor& lr_tensor = ctx->input(2 * n);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsScalar(lr_tensor.shape()),
+                errors::InvalidArgument("lr is not a scalar: ",
+                                        lr_tensor.shape().DebugString()));
+    const T lr = lr_tensor.scalar<T>()();
+
+    auto update = [&](int i, int64 start, int64 size) {
+      typename TTypes<T>::UnalignedTensor var(
+          tensors[i].flat<T>().data() + start, size);
+      typename TTypes<T>::UnalignedTensor accum(
+          tensors[n + i].flat<T>().data() + start, size);
+      typename TTypes<T>::UnalignedConstTensor grad(
+          ctx->input(2 * n + 1 + i).flat<T>().data() + start, size);
+      if (update_slots_) {
+        accum += grad.square();
+      }
+      var -= grad * lr * accum.rsqrt();
+    };
+    ForEachMultiApplyBlock(ctx, tensors, n, /*cost_per_element=*/10, update);
+  }
+
+ private:
+  bool use_exclusive_lock_;
+  bool update_slots_;
+  int num_vars_;
+};
+
+#define REGISTER_CPU_KERNELS(T)                                  \
+  REGISTER_KERNEL_BUILDER(Name("_ResourceApplyAdagradMulti")     \
+                              .Device(DEVICE_CPU)                \
+                              .TypeConstraint<T>("T"),           \
+                          ResourceApplyAdagradMultiOp<T>);
+TF_CALL_FLOAT_TYPES(REGISTER_CPU_KERNELS);
+#undef REGISTER_CPU_KERNELS
+
 template <typename Device, typename T>
 class ApplyAdagradV2Op : public OpKernel {
  public:
@@ -1620,6 +1755,100 @@ inline T FtrlCompute(const T& accum, const T& linear, const T& lr, const T& l1,
     return (l1_reg_adjust - linear) / quadratic;
   }
 }
+
+// Sums the rows of `grad` whose entries of `indices` are equal, so that
+// `*unique_indices` lists each index once and `*summed_grad` holds the sum of
+// its gradients, added in the order they were given. If there are no
+// duplicates, these are `indices` and `grad` themselves. Fails if an index is
+// not in [0, first_dim_size).
+template <typename T, typename Tindex>
+Status SumDuplicateIndices(OpKernelContext* ctx, const Tensor& indices,
+                           const Tensor& grad, int64 first_dim_size,
+                           Tensor* unique_indices, Tensor* summed_grad) {
+  const int64 n = indices.dim_size(0);
+  auto indices_vec = indices.vec<Tindex>();
+  std::vector<Tindex> sorted_indices(n);
+  for (int64 i = 0; i < n; ++i) {
+    const Tindex index = internal::SubtleMustCopy(indices_vec(i));
+    if (!FastBoundsCheck(index, first_dim_size)) {
+      return errors::InvalidArgument("Index ", index, " at offset ", i,
+                                     " in indices is out of range");
+    }
+    sorted_indices[i] = index;
+  }
+  // The sort is stable, so each run of equal indices lists the positions of
+  // their gradients in order.
+  std::vector<int64> positions(n);
+  std::iota(positions.begin(), positions.end(), 0);
+  const auto& worker_threads = *ctx->device()->tensorflow_cpu_worker_threads();
+  RadixSortPairs(&worker_threads, &sorted_indices, &positions);
+
+  std::vector<int64> run_starts;
+  for (int64 i = 0; i < n; ++i) {
+    if (i == 0 || sorted_indices[i] != sorted_indices[i - 1]) {
+      run_starts.push_back(i);
+    }
+  }
+  const int64 num_unique = run_starts.size();
+  if (num_unique == n) {
+    *unique_indices = indices;
+    *summed_grad = grad;
+    return Status::OK();
+  }
+  run_starts.push_back(n);
+
+  TF_RETURN_IF_ERROR(ctx->allocate_temp(DataTypeToEnum<Tindex>::value,
+                                        TensorShape({num_unique}),
+                                        unique_indices));
+  TensorShape summed_grad_shape = grad.shape();
+  summed_grad_shape.set_dim(0, num_unique);
+  TF_RETURN_IF_ERROR(ctx->allocate_temp(DataTypeToEnum<T>::value,
+                                        summed_grad_shape, summed_grad));
+  auto unique_vec = unique_indices->vec<Tindex>();
+  auto grad_flat = grad.flat_outer_dims<T>();
+  auto summed_flat = summed_grad->flat_outer_dims<T>();
+  const int64 cost_per_unique = grad_flat.dimension(1) * n / num_unique;
+  Shard(worker_threads.num_threads, worker_threads.workers, num_unique,
+        cost_per_unique, [&](int64 start, int64 limit) {
+          for (int64 u = start; u < limit; ++u) {
+            unique_vec(u) = sorted_indices[run_starts[u]];
+            auto sum = summed_flat.template chip<0>(u);
+            sum = grad_flat.template chip<0>(positions[run_starts[u]]);
+            for (int64 i = run_starts[u] + 1; i < run_starts[u + 1]; ++i) {
+              sum += grad_flat.template chip<0>(positions[i]);
+            }
+          }
+        });
+  return Status::OK();
+}
+
+// Calls `update_row(i)` for each entry `i` of `unique_indices`, in parallel.
+// The indices are distinct, so only other ops can update the same rows
+// concurrently. If `lock_rows` is true, each update holds the row mutex of
+// the row of `var` it updates.
+template <typename T, typename Tindex>
+void UpdateUniqueRows(OpKernelContext* ctx, const Tensor& var,
+                      const Tensor& unique_indices, bool lock_rows,
+                      int64 cost_per_row,
+                      const std::function<void(Tindex)>& update_row) {
+  auto indices_vec = unique_indices.vec<Tindex>();
+  const T* var_data = var.flat<T>().data();
+  const int64 row_size = var.NumElements() / var.dim_size(0);
+  const auto& worker_threads = *ctx->device()->tensorflow_cpu_worker_threads();
+  Shard(worker_threads.num_threads, worker_threads.workers,
+        unique_indices.NumElements(), cost_per_row,
+        [&](int64 start, int64 limit) {
+          for (int64 i = start; i < limit; ++i) {
+            if (lock_rows) {
+              const T* row = var_data + indices_vec(i) * row_size;
+              mutex_lock l(*SparseRowMutex(row));
+              update_row(i);
+            } else {
+              update_row(i);
+            }
+          }
+        });
+}
 }  // namespace
 
 // Note, this op works on cpu only.
@@ -1629,12 +1858,18 @@ class SparseApplyAdagradOp : public OpKernel {
   explicit SparseApplyAdagradOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("update_slots", &update_slots_));
+    if (ctx->HasAttr("sum_duplicate_indices")) {
+      OP_REQUIRES_OK(ctx, ctx->GetAttr("sum_duplicate_indices",
+                                       &sum_duplicate_indices_));
+    }
   }
 
   void Compute(OpKernelContext* ctx) override TF_NO_THREAD_SAFETY_ANALYSIS {
     const bool sparse = true;
+    // When duplicate indices are summed, rows rather than variables are
+    // locked, so the variables are only locked in shared mode.
     auto locks = MaybeLockVariableInputMutexesInOrder<CPUDevice, T>(
-        ctx, use_exclusive_lock_, sparse, {0, 1});
+        ctx, use_exclusive_lock_ && !sum_duplicate_indices_, sparse, {0, 1});
     Tensor var;
     OP_REQUIRES_OK(ctx, GetInputTensorFromVariable<CPUDevice, T>(
                             ctx, 0, use_exclusive_lock_, sparse, &var));
@@ -1693,7 +1928,31 @@ class SparseApplyAdagradOp : public OpKernel {
                                       Eigen::TensorOpCost::MulCost<T>() * 2);
       const Eigen::TensorOpCost cost(in_bytes, out_bytes, cycles);
 
-      if (inner_dim > 1) {
+      if (sum_duplicate_indices_) {
+        Tensor unique_indices;
+        Tensor summed_grad;
+        OP_REQUIRES_OK(ctx, SumDuplicateIndices<T, Tindex>(
+                                ctx, indices, grad, var.dim_size(0),
+                                &unique_indices, &summed_grad));
+        auto indices_vec = unique_indices.vec<Tindex>();
+        auto var_flat = var.flat_outer_dims<T>();
+        auto accum_flat = accum.flat_outer_dims<T>();
+        auto grad_flat = summed_grad.flat_outer_dims<T>();
+        const T lr_scalar = lr.scalar<T>()();
+
+        UpdateUniqueRows<T, Tindex>(
+            ctx, var, unique_indices, use_exclusive_lock_,
+            in_bytes + out_bytes + cycles, [&](Tindex i) {
+              const Tindex index = indices_vec(i);
+              auto a = accum_flat.template chip<0>(index);
+              auto g = grad_flat.template chip<0>(i);
+              auto v = var_flat.template chip<0>(index);
+              if (update_slots_) {
+                a += g.square();
+              }
+              v -= g.constant(lr_scalar) * g * a.rsqrt();
+            });
+      } else if (inner_dim > 1) {
         const Tindex first_dim_size = var.dim_size(0);
         auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat_outer_dims<T>();
@@ -1762,6 +2021,7 @@ class SparseApplyAdagradOp : public OpKernel {
  private:
   bool use_exclusive_lock_;
   bool update_slots_;
+  bool sum_duplicate_indices_ = false;
 };
 
 #define REGISTER_KERNELS(T, Tindices)                                \
@@ -1792,12 +2052,18 @@ class SparseApplyAdagradV2Op : public OpKernel {
   explicit SparseApplyAdagradV2Op(OpKernelConstruction* ctx) : OpKernel(ctx) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("update_slots", &update_slots_));
+    if (ctx->HasAttr("sum_duplicate_indices")) {
+      OP_REQUIRES_OK(ctx, ctx->GetAttr("sum_duplicate_indices",
+                                       &sum_duplicate_indices_));
+    }
   }
 
   void Compute(OpKernelContext* ctx) override TF_NO_THREAD_SAFETY_ANALYSIS {
     const bool sparse = true;
+    // When duplicate indices are summed, rows rather than variables are
+    // locked, so the variables are only locked in shared mode.
     auto locks = MaybeLockVariableInputMutexesInOrder<CPUDevice, T>(
-        ctx, use_exclusive_lock_, sparse, {0, 1});
+        ctx, use_exclusive_lock_ && !sum_duplicate_indices_, sparse, {0, 1});
     Tensor var;
     OP_REQUIRES_OK(ctx, GetInputTensorFromVariable<CPUDevice, T>(
                             ctx, 0, use_exclusive_lock_, sparse, &var));
@@ -1860,7 +2126,33 @@ class SparseApplyAdagradV2Op : public OpKernel {
                                       Eigen::TensorOpCost::MulCost<T>() * 2);
       const Eigen::TensorOpCost cost(in_bytes, out_bytes, cycles);
 
-      if (inner_dim > 1) {
+      if (sum_duplicate_indices_) {
+        Tensor unique_indices;
+        Tensor summed_grad;
+        OP_REQUIRES_OK(ctx, SumDuplicateIndices<T, Tindex>(
+                                ctx, indices, grad, var.dim_size(0),
+                                &unique_indices, &summed_grad));
+        auto indices_vec = unique_indices.vec<Tindex>();
+        auto var_flat = var.flat_outer_dims<T>();
+        auto accum_flat = accum.flat_outer_dims<T>();
+        auto grad_flat = summed_grad.flat_outer_dims<T>();
+        const T lr_scalar = lr.scalar<T>()();
+        const T epsilon_scalar = epsilon.scalar<T>()();
+
+        UpdateUniqueRows<T, Tindex>(
+            ctx, var, unique_indices, use_exclusive_lock_,
+            in_bytes + out_bytes + cycles, [&](Tindex i) {
+              const Tindex index = indices_vec(i);
+              auto a = accum_flat.template chip<0>(index);
+              auto g = grad_flat.template chip<0>(i);
+              auto v = var_flat.template chip<0>(index);
+              if (update_slots_) {
+                a += g.square();
+              }
+              v -= g.constant(lr_scalar) * g /
+                   (a.sqrt() + a.constant(epsilon_scalar));
+            });
+      } else if (inner_dim > 1) {
         const Tindex first_dim_size = var.dim_size(0);
         auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat_outer_dims<T>();
@@ -1933,6 +2225,7 @@ class SparseApplyAdagradV2Op : public OpKernel {
  private:
   bool use_exclusive_lock_;
   bool update_slots_;
+  bool sum_duplicate_indices_ = false;
 };
 
 #define REGISTER_KERNELS(T, Tindices)                                \
@@ -2650,12 +2943,19 @@ class SparseApplyFtrlOp : public OpKernel {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
     OP_REQUIRES_OK(
         ctx, ctx->GetAttr("multiply_linear_by_lr", &multiply_linear_by_lr_));
+    if (ctx->HasAttr("sum_duplicate_indices")) {
+      OP_REQUIRES_OK(ctx, ctx->GetAttr("sum_duplicate_indices",
+                                       &sum_duplicate_indices_));
+    }
   }
 
   void Compute(OpKernelContext* ctx) override TF_NO_THREAD_SAFETY_ANALYSIS {
     const bool sparse = true;
+    // When duplicate indices are summed, rows rather than variables are
+    // locked, so the variables are only locked in shared mode.
     auto locks = MaybeLockVariableInputMutexesInOrder<Device, T>(
-        ctx, use_exclusive_lock_, sparse, {0, 1, 2});
+        ctx, use_exclusive_lock_ && !sum_duplicate_indices_, sparse,
+        {0, 1, 2});
     Tensor var;
     OP_REQUIRES_OK(ctx, GetInputTensorFromVariable<Device, T>(
                             ctx, 0, use_exclusive_lock_, sparse, &var));
@@ -2754,13 +3054,20 @@ class SparseApplyFtrlOp : public OpKernel {
     }
 
     if (N > 0) {
-      if (inner_dim > 1) {
+      Tensor unique_indices = indices;
+      Tensor summed_grad = grad;
+      if (sum_duplicate_indices_) {
+        OP_REQUIRES_OK(ctx, SumDuplicateIndices<T, Tindex>(
+                                ctx, indices, grad, var.dim_size(0),
+                                &unique_indices, &summed_grad));
+      }
+      if (inner_dim > 1 || sum_duplicate_indices_) {
         const Tindex first_dim_size = var.dim_size(0);
-        auto indices_vec = indices.vec<Tindex>();
+        auto indices_vec = unique_indices.vec<Tindex>();
         auto var_flat = var.flat_outer_dims<T>();
         auto accum_flat = accum.flat_outer_dims<T>();
         auto linear_flat = linear.flat_outer_dims<T>();
-        auto grad_flat = grad.flat_outer_dims<T>();
+        auto grad_flat = summed_grad.flat_outer_dims<T>();
         T lr_scalar = lr.scalar<T>()();
         T l1_scalar = l1.scalar<T>()();
         T l2_scalar = l2.scalar<T>()();
@@ -2770,12 +3077,8 @@ class SparseApplyFtrlOp : public OpKernel {
         }
         T lr_power_scalar = lr_power.scalar<T>()();
 
-        for (Tindex i = 0; i < N; i++) {
+        const auto update_row = [&](Tindex i) {
           const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
           auto accum = accum_flat.template chip<0>(index);
           auto linear = linear_flat.template chip<0>(index);
           auto grad = grad_flat.template chip<0>(i);
@@ -2842,8 +3145,27 @@ class SparseApplyFtrlOp : public OpKernel {
           } else {
             COMPUTE_FTRL(grad, grad);
           }
-        }
+        };
 #undef COMPUTE_FTRL
+
+        if (sum_duplicate_indices_) {
+          const int64 cost_per_row =
+              inner_dim * (sizeof(T) * 6 +
+                           Eigen::TensorOpCost::AddCost<T>() * 8 +
+                           Eigen::TensorOpCost::MulCost<T>() * 8);
+          UpdateUniqueRows<T, Tindex>(ctx, var, unique_indices,
+                                      use_exclusive_lock_, cost_per_row,
+                                      update_row);
+        } else {
+          for (Tindex i = 0; i < N; i++) {
+            const Tindex index = internal::SubtleMustCopy(indices_vec(i));
+            OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
+                        errors::InvalidArgument(strings::StrCat(
+                            "Index ", index, " at offset ", i,
+                            " in indices is out of range")));
+            update_row(i);
+          }
+        }
       } else {
         T lr_scalar = lr.scalar<T>()();
         T l1_scalar = l1.scalar<T>()();
@@ -2900,6 +3222,7 @@ class SparseApplyFtrlOp : public OpKernel {
  private:
   bool use_exclusive_lock_;
   bool multiply_linear_by_lr_;
+  bool sum_duplicate_indices_ = false;
 };
 
 #define REGISTER_KERNELS(T, Tindices)                                         \
@@ -3705,6 +4028,83 @@ REGISTER_KERNELS(GPU, complex128);
 #undef REGISTER_CPU_KERNELS
 #undef REGISTER_KERNELS
 
+// Applies Adam to `N` variables at once, in a single parallel sweep.
+template <typename T>
+class ResourceApplyAdamMultiOp : public OpKernel {
+ public:
+  explicit ResourceApplyAdamMultiOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("use_nesterov", &use_nesterov_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("N", &num_vars_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const int n = num_vars_;
+    std::vector<int> variable_inputs(3 * n);
+    std::iota(variable_inputs.begin(), variable_inputs.end(), 0);
+    auto locks = MaybeLockVariableInputMutexesInOrder<CPUDevice, T>(
+        ctx, use_exclusive_lock_, /*sparse=*/false, variable_inputs);
+    std::vector<Tensor> tensors;
+    OP_REQUIRES_OK(ctx, GetMultiApplyTensors<T>(
+                            ctx, n, /*num_slots=*/2, /*first_grad=*/3 * n + 6,
+                            use_exclusive_lock_, &tensors));
+
+    static const char* const kScalarNames[] = {
+        "beta1_power", "beta2_power", "lr", "beta1", "beta2", "epsilon"};
+    T scalars[6];
+    for (int i = 0; i < 6; ++i) {
+      const Tensor& scalar = ctx->input(3 * n + i);
+      OP_REQUIRES(ctx, TensorShapeUtils::IsScalar(scalar.shape()),
+                  errors::InvalidArgument(kScalarNames[i], " is not a scalar: ",
+                                          scalar.shape().DebugString()));
+      scalars[i] = scalar.scalar<T>()();
+    }
+    const T beta1_power = scalars[0];
+    const T beta2_power = scalars[1];
+    const T lr = scalars[2];
+    const T beta1 = scalars[3];
+    const T beta2 = scalars[4];
+    const T epsilon = scalars[5];
+    const T alpha = lr * Eigen::numext::sqrt(T(1) - beta2_power) /
+                    (T(1) - beta1_power);
+
+    // Same updates as ApplyAdam<CPUDevice, T>.
+    auto update = [&](int i, int64 start, int64 size) {
+      typename TTypes<T>::UnalignedTensor var(
+          tensors[i].flat<T>().data() + start, size);
+      typename TTypes<T>::UnalignedTensor m(
+          tensors[n + i].flat<T>().data() + start, size);
+      typename TTypes<T>::UnalignedTensor v(
+          tensors[2 * n + i].flat<T>().data() + start, size);
+      typename TTypes<T>::UnalignedConstTensor g(
+          ctx->input(3 * n + 6 + i).flat<T>().data() + start, size);
+      m += (g - m) * (T(1) - beta1);
+      v += (g.square() - v) * (T(1) - beta2);
+      if (use_nesterov_) {
+        var -= ((g * (T(1) - beta1) + beta1 * m) * alpha) /
+               (v.sqrt() + epsilon);
+      } else {
+        var -= (m * alpha) / (v.sqrt() + epsilon);
+      }
+    };
+    ForEachMultiApplyBlock(ctx, tensors, n, /*cost_per_element=*/20, update);
+  }
+
+ private:
+  bool use_exclusive_lock_;
+  bool use_nesterov_;
+  int num_vars_;
+};
+
+#define REGISTER_CPU_KERNELS(T)                               \
+  REGISTER_KERNEL_BUILDER(Name("_ResourceApplyAdamMulti")     \
+                              .Device(DEVICE_CPU)             \
+                              .TypeConstraint<T>("T"),        \
+                          ResourceApplyAdamMultiOp<T>);
+TF_CALL_FLOAT_TYPES(REGISTER_CPU_KERNELS);
+#undef REGISTER_CPU_KERNELS
+
 template <typename Device, typename T>
 class ApplyAdamWithAmsgradOp : public OpKernel {
  public:
@@ -13,9 +13,15 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
+#include <cmath>
+
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/public/session_options.h"
@@ -185,6 +191,83 @@ BENCHMARK(BM_SparseAdagrad)
     ->ArgPair(128, 32 << 10)
     ->ArgPair(128, 128 << 10);
 
+static Node* ResourceVar(Graph* g, const string& name, int m, int n) {
+  Node* ret;
+  TF_CHECK_OK(NodeBuilder(name, "VarHandleOp")
+                  .Attr("dtype", DT_FLOAT)
+                  .Attr("shape", TensorShape({m, n}))
+                  .Attr("shared_name", name)
+                  .Finalize(g, &ret));
+  return ret;
+}
+
+static void AssignResourceVar(Graph* g, Node* var, Node* value) {
+  TF_CHECK_OK(NodeBuilder(g->NewName("assign"), "AssignVariableOp")
+                  .Input(var)
+                  .Input(value)
+                  .Attr("dtype", DT_FLOAT)
+                  .Finalize(g, nullptr));
+}
+
+// Returns `num_indices` indices into `m` rows, which follow a power law: the
+// first rows are much more frequent than the last ones, as with the ids of
+// embeddings.
+static Node* PowerLawIndices(Graph* g, int m, int num_indices) {
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  Tensor data(DT_INT32, TensorShape({num_indices}));
+  auto indices = data.flat<int32>();
+  for (int i = 0; i < num_indices; ++i) {
+    const int32 index = m * std::pow(rnd.RandDouble(), 4.0);
+    indices(i) = std::min(m - 1, index);
+  }
+  return test::graph::Constant(g, data);
+}
+
+static void ResourceSparseAdagrad(int32 m, int32 n, int32 num_indices,
+                                  bool sum_duplicate_indices, Graph** init_g,
+                                  Graph** train_g) {
+  {
+    Graph* g = new Graph(OpRegistry::Global());
+    auto zero = Zeros(g, m, n);
+    AssignResourceVar(g, ResourceVar(g, "var", m, n), zero);
+    AssignResourceVar(g, ResourceVar(g, "accum", m, n), zero);
+    *init_g = g;
+  }
+  {
+    Graph* g = new Graph(OpRegistry::Global());
+    TF_CHECK_OK(NodeBuilder(g->NewName("apply"), "ResourceSparseApplyAdagrad")
+                    .Input(ResourceVar(g, "var", m, n))
+                    .Input(ResourceVar(g, "accum", m, n))
+                    .Input(Scalar(g, 0.01))
+                    .Input(Random(g, num_indices, n))
+                    .Input(PowerLawIndices(g, m, num_indices))
+                    .Attr("sum_duplicate_indices", sum_duplicate_indices)
+                    .Finalize(g, nullptr));
+    *train_g = g;
+  }
+}
+
+static void BM_ResourceSparseAdagradPowerLaw(int iters, int num_indices,
+                                             int sum_duplicate_indices) {
+  const int m = 1 << 16;
+  const int n = 64;
+  const int64 tot = static_cast<int64>(iters) * num_indices * n;
+  testing::UseRealTime();
+  testing::ItemsProcessed(tot);
+  testing::BytesProcessed(tot * sizeof(float));
+  Graph* init;
+  Graph* train;
+  ResourceSparseAdagrad(m, n, num_indices, sum_duplicate_indices, &init,
+                        &train);
+  test::Benchmark("cpu", train, GetMultiThreadedOptions(), init).Run(iters);
+}
+BENCHMARK(BM_ResourceSparseAdagradPowerLaw)
+    ->ArgPair(1 << 12, 0)
+    ->ArgPair(1 << 12, 1)
+    ->ArgPair(1 << 16, 0)
+    ->ArgPair(1 << 16, 1);
+
 static void Momentum(int32 n, Graph** init_g, Graph** train_g) {
   TensorShape shape({n});
   {
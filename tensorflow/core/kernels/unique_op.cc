@@ -13,9 +13,12 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <functional>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "tensorflow/core/framework/bounds_check.h"
@@ -23,6 +26,7 @@ limitations under the License.
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/kernels/radix_sort.h"
 #include "tensorflow/core/lib/bfloat16/bfloat16.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/hash/hash.h"
@@ -68,6 +72,28 @@ struct UniqueOpHashMap<bfloat16, TIndex> {
   using map_type = std::unordered_map<bfloat16, TIndex>;
 };
 
+// Integer inputs of at least this many elements are uniquified by sorting
+// rather than with a hash map: the sort runs on all the threads, and its
+// memory accesses are sequential.
+constexpr int64 kMinElementsToUniqueBySorting = 1 << 16;
+
+// Computes the unique elements of `input[0, n)` in order of first occurrence
+// in `uniques`, and their indices in `idx`. Returns false if elements of type
+// `T` can't be radix sorted.
+template <typename T, typename TIndex>
+bool UniqueBySorting(OpKernelContext* context, const T* input, int64 n,
+                     std::vector<T>* uniques, TIndex* idx, std::true_type) {
+  RadixUnique(context->device()->tensorflow_cpu_worker_threads(), input, n,
+              uniques, idx);
+  return true;
+}
+
+template <typename T, typename TIndex>
+bool UniqueBySorting(OpKernelContext* context, const T* input, int64 n,
+                     std::vector<T>* uniques, TIndex* idx, std::false_type) {
+  return false;
+}
+
 // `UniqueOp` computes the unique elements in the input tensor.
 //
 // * `T` is the element type.
@@ -150,26 +176,40 @@ class UniqueOp : public OpKernel {
       auto Tin = input.flat<T>();
       const int64 N = static_cast<int64>(Tin.size());
 
-      typename UniqueOpHashMap<T, TIndex>::map_type uniq;
-      uniq.reserve(2 * N);
-      for (Eigen::Index i = 0, j = 0; i < N; ++i) {
-        auto it = uniq.emplace(Tin(i), j);
-        idx_vec(i) = it.first->second;
-        if (it.second) {
-          ++j;
+      std::vector<T> sorted_uniq;
+      if (N >= kMinElementsToUniqueBySorting &&
+          UniqueBySorting(context, Tin.data(), N, &sorted_uniq, idx_vec.data(),
+                          IsRadixSortKey<T>())) {
+        uniq_size = static_cast<int64>(sorted_uniq.size());
+        TensorShape output_shape(input.shape());
+        output_shape.set_dim(axis, uniq_size);
+        Tensor* output = nullptr;
+        OP_REQUIRES_OK(context,
+                       context->allocate_output(0, output_shape, &output));
+        std::copy(sorted_uniq.begin(), sorted_uniq.end(),
+                  output->flat<T>().data());
+      } else {
+        typename UniqueOpHashMap<T, TIndex>::map_type uniq;
+        uniq.reserve(2 * N);
+        for (Eigen::Index i = 0, j = 0; i < N; ++i) {
+          auto it = uniq.emplace(Tin(i), j);
+          idx_vec(i) = it.first->second;
+          if (it.second) {
+            ++j;
+          }
         }
-      }
 
-      uniq_size = static_cast<int64>(uniq.size());
-      TensorShape output_shape(input.shape());
-      output_shape.set_dim(axis, uniq_size);
-      Tensor* output = nullptr;
-      OP_REQUIRES_OK(context,
-                     context->allocate_output(0, output_shape, &output));
-      auto Tout = output->flat<T>();
+        uniq_size = static_cast<int64>(uniq.size());
+        TensorShape output_shape(input.shape());
+        output_shape.set_dim(axis, uniq_size);
+        Tensor* output = nullptr;
+        OP_REQUIRES_OK(context,
+                       context->allocate_output(0, output_shape, &output));
+        auto Tout = output->flat<T>();
 
-      for (const auto& it : uniq) {
-        Tout(it.second) = it.first;
+        for (const auto& it : uniq) {
+          Tout(it.second) = it.first;
+        }
       }
     } else {
       // General implementation when unique is run over multiple elements.
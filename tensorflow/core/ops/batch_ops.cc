@@ -54,6 +54,11 @@ REGISTER_OP("BatchFunction")
     // NOTE: Support for `enable_large_batch_splitting == true` is still
     // developed in progress.
     .Attr("enable_large_batch_splitting: bool = false")
+    // If 'latency_slo_micros' is positive, the batch timeout and the size at
+    // which batches are processed are adjusted online to keep the 99th
+    // percentile latency of the inputs under it, with 'batch_timeout_micros'
+    // as the upper bound of the timeout.
+    .Attr("latency_slo_micros: int = 0")
     // TODO(apassos): Fix this shape inference function. It requires shape
     // inference of function calls.
     .SetShapeFn(shape_inference::UnknownShape);
@@ -370,6 +370,7 @@ REGISTER_OP("MutableHashTableV2")
     .Attr("use_node_name_sharing: bool = false")
     .Attr("key_dtype: type")
     .Attr("value_dtype: type")
+    .Attr("num_shards: int >= 1 = 1")
     .SetIsStateful()
     .SetShapeFn([](InferenceContext* c) {
       return MutableHashTableShape(c, /*key=*/c->Scalar(),
@@ -395,6 +396,7 @@ REGISTER_OP("MutableHashTableOfTensorsV2")
     .Attr("key_dtype: type")
     .Attr("value_dtype: type")
     .Attr("value_shape: shape = {}")
+    .Attr("num_shards: int >= 1 = 1")
     .SetIsStateful()
     .SetShapeFn([](InferenceContext* c) {
       PartialTensorShape value_p;
@@ -439,6 +441,104 @@ REGISTER_OP("MutableDenseHashTableV2")
       return MutableHashTableShape(c, /*key=*/c->input(0), /*value=*/value_s);
     });
 
+REGISTER_OP("DynamicEmbeddingTable")
+    .Output("table_handle: resource")
+    .Attr("container: string = ''")
+    .Attr("shared_name: string = ''")
+    .Attr("use_node_name_sharing: bool = false")
+    .Attr("key_dtype: {int32, int64}")
+    .Attr("value_dtype: {float}")
+    .Attr("embedding_dim: int >= 1")
+    .Attr("num_slots: int >= 0 = 0")
+    .Attr("slot_initial_value: float = 0")
+    .Attr("min_frequency: int >= 1 = 1")
+    .Attr("max_rows: int >= 0 = 0")
+    .Attr("eviction_policy: {'lru', 'lfu'} = 'lru'")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      int64 embedding_dim;
+      TF_RETURN_IF_ERROR(c->GetAttr("embedding_dim", &embedding_dim));
+      return MutableHashTableShape(c, /*key=*/c->Scalar(),
+                                   /*value=*/c->Vector(embedding_dim));
+    });
+
+namespace {
+Status DynamicEmbeddingSparseApplyShape(InferenceContext* c) {
+  ShapeHandle unused;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));  // table_handle
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 0, &unused));  // lr
+  ShapeHandle grad;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &grad));
+  ShapeHandle keys;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 1, &keys));
+  DimensionHandle unused_dim;
+  TF_RETURN_IF_ERROR(c->Merge(c->Dim(grad, 0), c->Dim(keys, 0), &unused_dim));
+  return Status::OK();
+}
+}  // namespace
+
+REGISTER_OP("DynamicEmbeddingSparseApplyGradientDescent")
+    .Input("table_handle: resource")
+    .Input("lr: float")
+    .Input("grad: float")
+    .Input("keys: Tkeys")
+    .Attr("Tkeys: {int32, int64}")
+    .SetShapeFn(DynamicEmbeddingSparseApplyShape);
+
+REGISTER_OP("DynamicEmbeddingSparseApplyAdagrad")
+    .Input("table_handle: resource")
+    .Input("lr: float")
+    .Input("grad: float")
+    .Input("keys: Tkeys")
+    .Attr("Tkeys: {int32, int64}")
+    .SetShapeFn(DynamicEmbeddingSparseApplyShape);
+
+REGISTER_OP("DynamicEmbeddingExportShard")
+    .Input("table_handle: resource")
+    .Output("keys: Tkeys")
+    .Output("values: float")
+    .Output("slots: float")
+    .Output("frequencies: int64")
+    .Attr("shard: int >= 0")
+    .Attr("num_shards: int >= 1")
+    .Attr("Tkeys: {int32, int64}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle handle;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &handle));
+      ShapeHandle keys = c->Vector(InferenceContext::kUnknownDim);
+      c->set_output(0, keys);
+      c->set_output(1, c->UnknownShapeOfRank(2));
+      c->set_output(2, c->UnknownShapeOfRank(3));
+      c->set_output(3, keys);
+      return Status::OK();
+    });
+
+REGISTER_OP("DynamicEmbeddingImportShard")
+    .Input("table_handle: resource")
+    .Input("keys: Tkeys")
+    .Input("values: float")
+    .Input("slots: float")
+    .Input("frequencies: int64")
+    .Attr("Tkeys: {int32, int64}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle handle;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &handle));
+      ShapeHandle keys;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &keys));
+      ShapeHandle values;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &values));
+      ShapeHandle slots;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 3, &slots));
+      ShapeHandle frequencies;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(4), 1, &frequencies));
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(keys, 0), c->Dim(values, 0), &unused));
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(keys, 0), c->Dim(slots, 0), &unused));
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(keys, 0), c->Dim(frequencies, 0), &unused));
+      return Status::OK();
+    });
+
 REGISTER_OP("InitializeTable")
     .Input("table_handle: Ref(string)")
     .Input("keys: Tkey")
@@ -122,6 +122,7 @@ enum CPUFeature {
   AVX512IFMA = 35,     // Integer multiply-add
   AVX512_4VNNIW = 36,  // Integer neural network
   AVX512_4FMAPS = 37,  // Floating point neural network
+  AVX512_BF16 = 38,    // Bfloat16 conversions and dot products
 };
 
 // Checks whether the current processor supports one of the features above.
@@ -91,6 +91,23 @@ class SparseReorderTest(test.TestCase):
         self.assertAllEqual(output_val.dense_shape,
                             expected_output_val.dense_shape)
 
+  def testLargeOutOfOrder(self):
+    # Enough entries to be reordered by radix sort on CPU.
+    n = 20000
+    shape = np.array([50, 1000, 7]).astype(np.int64)
+    ind = np.stack([np.random.randint(0, d, size=n) for d in shape],
+                   axis=1).astype(np.int64)
+    val = np.arange(n).astype(np.float64)
+    with self.session(use_gpu=False):
+      sp_output = sparse_ops.sparse_reorder(
+          sparse_tensor.SparseTensorValue(ind, val, shape))
+      output_val = self.evaluate(sp_output)
+
+    order = np.lexsort(ind.T[::-1])
+    self.assertAllEqual(ind[order], output_val.indices)
+    self.assertAllEqual(ind[output_val.values.astype(np.int64)],
+                        output_val.indices)
+
   @test_util.run_deprecated_v1
   def testFeedOutOfOrder(self):
     expected_output_val = self._SparseTensorValue_5x6(np.arange(6))
@@ -48,6 +48,18 @@ class UniqueTest(test.TestCase):
     for i in range(len(x)):
       self.assertEqual(x[i], tf_y[tf_idx[i]])
 
+  def testLargeInt64(self):
+    # Large enough to be uniquified by sorting on CPU.
+    for high in [10, 1 << 40]:
+      x = np.random.randint(-high, high=high, size=100000, dtype=np.int64)
+      y, idx = array_ops.unique(x)
+      tf_y, tf_idx = self.evaluate([y, idx])
+
+      # The unique elements are in order of first occurrence.
+      _, first = np.unique(x, return_index=True)
+      self.assertAllEqual(x[np.sort(first)], tf_y)
+      self.assertAllEqual(x, tf_y[tf_idx])
+
   def testString(self):
     indx = np.random.randint(65, high=122, size=7000)
     x = [chr(i) for i in indx]
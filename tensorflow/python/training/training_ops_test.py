@@ -381,6 +381,55 @@ class TrainingOpsTest(TensorFlowTestCase):
       indices = np.array([0, 2]).astype(index_type)
       self._testTypesForSparseFtrlMultiplyLinearByLr(x, y, z, lr, grad, indices)
 
+  def _testResourceSparseApplySumsDuplicateIndices(self, apply_fn, num_slots):
+    x = np.arange(30).reshape(10, 3).astype(np.float32)
+    slots = [np.full([10, 3], 0.1 * (s + 1), np.float32)
+             for s in range(num_slots)]
+    grad = np.arange(18).reshape(6, 3).astype(np.float32) - 5.0
+    indices = np.array([7, 2, 7, 0, 2, 7], np.int64)
+    unique_indices = np.array([0, 2, 7], np.int64)
+    summed_grad = np.stack([grad[3], grad[1] + grad[4],
+                            grad[0] + grad[2] + grad[5]])
+
+    results = []
+    for (g, i, sum_duplicate_indices) in [(grad, indices, True),
+                                          (summed_grad, unique_indices, False)]:
+      with self.session(use_gpu=False):
+        variables_ = [resource_variable_ops.ResourceVariable(v)
+                      for v in [x] + slots]
+        self.evaluate(variables.global_variables_initializer())
+        self.evaluate(apply_fn([v.handle for v in variables_], g, i,
+                               sum_duplicate_indices))
+        results.append([self.evaluate(v) for v in variables_])
+    for (value, expected) in zip(*results):
+      self.assertAllClose(expected, value)
+
+  @test_util.run_v1_only("b/120545219")
+  def testResourceSparseApplyAdagradSumsDuplicateIndices(self):
+    for use_locking in [False, True]:
+
+      def apply_adagrad(handles, grad, indices, sum_duplicate_indices):
+        return training_ops.resource_sparse_apply_adagrad(
+            handles[0], handles[1], 0.5, grad, indices,
+            use_locking=use_locking,  # pylint: disable=cell-var-from-loop
+            sum_duplicate_indices=sum_duplicate_indices)
+
+      self._testResourceSparseApplySumsDuplicateIndices(
+          apply_adagrad, num_slots=1)
+
+  @test_util.run_v1_only("b/120545219")
+  def testResourceSparseApplyFtrlSumsDuplicateIndices(self):
+    for use_locking in [False, True]:
+
+      def apply_ftrl(handles, grad, indices, sum_duplicate_indices):
+        return training_ops.resource_sparse_apply_ftrl(
+            handles[0], handles[1], handles[2], grad, indices, 0.5, 0.1, 0.2,
+            -0.5, use_locking=use_locking,  # pylint: disable=cell-var-from-loop
+            sum_duplicate_indices=sum_duplicate_indices)
+
+      self._testResourceSparseApplySumsDuplicateIndices(
+          apply_ftrl, num_slots=2)
+
   @test_util.run_v1_only("b/120545219")
   def testApplyAdam(self):
     for dtype, use_gpu in itertools.product(